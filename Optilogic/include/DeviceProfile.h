@@ -0,0 +1,152 @@
+#pragma once
+// Enhedsprofiler i stedet for #defines kopieret mellem sketches
+//
+// Hver hardware-variant er én struct med constexpr-felter: RS485-pins, baud,
+// slave-id, start/stop-register og standard register-map. Profilen vælges
+// pr. PlatformIO env med -DDEVICE_PROFILE=<navn>, og firmwaren bruger kun
+// `Device::...`, så alt afgøres ved compile-time:
+//   - kode for udstyr profilen ikke har (fx status-LED) fjernes med if constexpr
+//   - pipelinens fast-komma typer får decimaler fra profilens metric-tabel
+//   - manglende påkrævede metrics giver compile-fejl i stedet for runtime-fejl
+//
+// En gateway-profil (fx PlantRoom) har i stedet en liste af members: flere
+// slaves på samme RS485-segment, som hver publiceres som sin egen Sparkplug
+// device under én EoN node. Enkeltenheds-profiler behandles som en gateway
+// med ét member, så firmwaren kun har én kodesti.
+//
+// Standard-mappet kan stadig erstattes under drift med "regmap=" (RegisterMap.h).
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <type_traits>
+
+#include <RegisterMap.h>
+
+namespace profile {
+
+struct Rs485 {
+  uint8_t  rxPin;
+  uint8_t  txPin;
+  uint8_t  dePin;      // driver enable
+  uint8_t  reNegPin;   // receiver enable (aktiv lav)
+  uint32_t baud;
+  uint8_t  slaveId;
+};
+
+// ================= PROFILER =================
+// Ventilationsanlægget (Olimex-Publisher.cpp, 9600 baud)
+struct Ventilation {
+  static constexpr const char* name = "ventilation";
+  static constexpr Rs485 bus = {36, 4, 5, 14, 9600, 1};
+  static constexpr int runRegister = 367;     // holding, 0 = sluk og 3 = start; -1 = intet register
+  static constexpr uint16_t bootRunValue = 0; // skrives ved opstart (som firmwaren altid har gjort)
+  static constexpr int statusLedPin = -1;     // -1 = ingen LED
+  static constexpr regmap::Definition metrics[] = {
+    {"temp", regmap::INPUT_REG, 19, 1, false},   // deci-grader (215 = 21.5 °C)
+    {"tryk", regmap::INPUT_REG, 13, 1, false},   // tryk med én decimal
+    {"rpm",  regmap::INPUT_REG, 15, 0, false},   // airflow/rpm er et helt tal
+  };
+};
+
+// Varmepumpen (lib/no/Olimex_Varmpumpe_1LED_Modbus.ino, 38400 baud, grøn LED på pin 3)
+struct HeatPump {
+  static constexpr const char* name = "heatpump";
+  static constexpr Rs485 bus = {36, 4, 5, 14, 38400, 1};
+  static constexpr int runRegister = 368;
+  static constexpr uint16_t bootRunValue = 0; // sketchen starter i "off"
+  static constexpr int statusLedPin = 3;      // tændt når anlægget kører
+  static constexpr regmap::Definition metrics[] = {
+    {"temp", regmap::INPUT_REG, 19, 1, false},   // samme input-registre som ventilationen
+    {"tryk", regmap::INPUT_REG, 13, 1, false},
+    {"rpm",  regmap::INPUT_REG, 15, 0, false},
+  };
+};
+
+// ================= GATEWAY =================
+// Én slave på segmentet
+struct Member {
+  const char* deviceId;               // Sparkplug device id (sidste topic-niveau)
+  uint8_t     slaveId;
+  const regmap::Definition* metrics;  // standard register-map
+  size_t      metricCount;
+  int         runRegister;            // -1 = intet start/stop-register
+  uint16_t    bootRunValue;
+  uint8_t     weight;                 // andel af bustiden (se BusScheduler.h)
+};
+
+template <class P>
+constexpr Member member(const char* deviceId, uint8_t slaveId, uint8_t weight = 1) {
+  return Member{deviceId, slaveId, P::metrics, sizeof(P::metrics) / sizeof(P::metrics[0]),
+                P::runRegister, P::bootRunValue, weight};
+}
+
+// Ventilation og varmepumpe på ét segment. Alle slaves deler UART og dermed
+// baud, så varmepumpen skal stilles til 9600 baud og slave-id 2.
+struct PlantRoom {
+  typedef Ventilation Primary;   // første member: pipelinens skala, alarmer, historik og live-data
+  static constexpr const char* name = "plantroom";
+  static constexpr Rs485 bus = Ventilation::bus;
+  static constexpr int statusLedPin = -1;
+  static constexpr Member members[] = {
+    member<Ventilation>("ventilation", 1),
+    member<HeatPump>("heatpump", 2),
+  };
+};
+
+// ================= COMPILE-TIME OPSLAG =================
+constexpr bool sameName(const char* a, const char* b) {
+  while (*a && *a == *b) { a++; b++; }
+  return *a == *b;
+}
+
+template <class P>
+constexpr size_t metricCount() { return sizeof(P::metrics) / sizeof(P::metrics[0]); }
+
+// Index i profilens metric-tabel, -1 hvis den ikke findes
+template <class P>
+constexpr int metricIndex(const char* name) {
+  for (size_t i = 0; i < metricCount<P>(); i++) {
+    if (sameName(P::metrics[i].name, name)) return int(i);
+  }
+  return -1;
+}
+
+template <class P>
+constexpr uint8_t decimalsOf(const char* name) {
+  return metricIndex<P>(name) < 0 ? 0 : P::metrics[metricIndex<P>(name)].decimals;
+}
+
+// Enkeltenhed: ét member med profilens egne felter
+template <class P, class = void>
+struct Traits {
+  typedef P Primary;
+  static constexpr bool isGateway = false;
+  static constexpr bool hasStatusLed = P::statusLedPin >= 0;
+  static constexpr Member members[] = {member<P>(P::name, P::bus.slaveId)};
+  static constexpr size_t memberCount = 1;
+  static_assert(metricCount<P>() <= regmap::MAX_ENTRIES, "for mange metrics i profilen");
+};
+
+// Gateway: profilen har en members-liste
+template <class P>
+struct Traits<P, std::void_t<decltype(P::members)>> {
+  typedef typename P::Primary Primary;
+  static constexpr bool isGateway = true;
+  static constexpr bool hasStatusLed = P::statusLedPin >= 0;
+  static constexpr const Member* members = P::members;
+  static constexpr size_t memberCount = sizeof(P::members) / sizeof(P::members[0]);
+  static_assert(memberCount >= 1, "gateway uden members");
+  static_assert(metricCount<Primary>() <= regmap::MAX_ENTRIES, "for mange metrics i profilen");
+};
+
+}  // namespace profile
+
+// ================= VALG AF PROFIL =================
+#ifndef DEVICE_PROFILE
+#define DEVICE_PROFILE Ventilation
+#endif
+
+typedef profile::DEVICE_PROFILE Device;
+typedef profile::Traits<Device> DeviceTraits;
+typedef DeviceTraits::Primary PrimaryDevice;   // = Device for enkeltenheder
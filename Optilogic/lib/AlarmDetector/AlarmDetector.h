@@ -0,0 +1,190 @@
+#pragma once
+// Inkrementelle alarm-detektorer til firmwaren
+//
+// Hver detektor opdateres med én sample ad gangen i O(1) tid og giver en
+// hændelse når alarmen går fra normal til aktiv (Raised) eller tilbage
+// (Cleared). Alle detektorer har hysterese, så en værdi omkring grænsen
+// ikke giver en strøm af alarmer:
+//   ThresholdDetector     – fast grænse (høj eller lav) med hysterese
+//   EwmaDetector          – afvigelse fra eksponentielt glidende middel/varians
+//   RollingStdDetector<N> – z-score mod de sidste N samples (ring, løbende sum)
+//   RateDetector          – ændring pr. sekund mellem to samples
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum class AlarmEvent : uint8_t { None, Raised, Cleared };
+
+class AlarmDetector {
+public:
+  explicit AlarmDetector(const char* name) : name_(name) {}
+  virtual ~AlarmDetector() {}
+
+  const char* name() const { return name_; }
+  bool  active() const { return active_; }
+  float score() const  { return score_; }   // det der sammenlignes med grænsen (værdi, sigma, rate)
+  float limit() const  { return limit_; }
+
+  /**
+   * @brief Opdaterer detektoren med en ny sample
+   *
+   * @return Raised/Cleared ved tilstandsskift, ellers None
+   */
+  virtual AlarmEvent update(float v, uint32_t nowMs) = 0;
+
+protected:
+  // Fælles låsning: aktiv over tripAt, inaktiv igen under clearAt
+  AlarmEvent latch(bool over, bool under) {
+    if (!active_ && over)  { active_ = true;  return AlarmEvent::Raised; }
+    if (active_ && under)  { active_ = false; return AlarmEvent::Cleared; }
+    return AlarmEvent::None;
+  }
+
+  float score_ = 0.0f;
+  float limit_ = 0.0f;
+
+private:
+  const char* name_;
+  bool active_ = false;
+};
+
+// ================= FAST GRÆNSE =================
+class ThresholdDetector : public AlarmDetector {
+public:
+  enum Direction { High, Low };
+
+  /**
+   * @param threshold  grænse der udløser alarmen
+   * @param hysteresis hvor langt tilbage værdien skal før alarmen ophører
+   */
+  ThresholdDetector(const char* name, Direction dir, float threshold, float hysteresis)
+      : AlarmDetector(name), dir_(dir), threshold_(threshold), hysteresis_(hysteresis) {
+    limit_ = threshold;
+  }
+
+  AlarmEvent update(float v, uint32_t) override {
+    score_ = v;
+    if (dir_ == High) return latch(v > threshold_, v < threshold_ - hysteresis_);
+    return latch(v < threshold_, v > threshold_ + hysteresis_);
+  }
+
+private:
+  Direction dir_;
+  float threshold_;
+  float hysteresis_;
+};
+
+// ================= EWMA =================
+// Middel og varians opdateres eksponentielt (alpha = vægt på ny sample).
+// Alarm når |v - middel| > k * sigma; minSigma hindrer alarmer på et fladt signal.
+class EwmaDetector : public AlarmDetector {
+public:
+  EwmaDetector(const char* name, float alpha, float k, float minSigma, uint16_t warmup = 20)
+      : AlarmDetector(name), alpha_(alpha), k_(k), minSigma_(minSigma), warmup_(warmup) {
+    limit_ = k;
+  }
+
+  AlarmEvent update(float v, uint32_t) override {
+    if (n_ == 0) {
+      mean_ = v;
+      n_ = 1;
+      return AlarmEvent::None;
+    }
+    float diff = v - mean_;
+    float sigma = sqrtf(var_);
+    if (sigma < minSigma_) sigma = minSigma_;
+    score_ = fabsf(diff) / sigma;   // afvigelse målt mod hidtidig baseline
+    // West (1979): inkrementel eksponentiel varians
+    float incr = alpha_ * diff;
+    mean_ += incr;
+    var_ = (1.0f - alpha_) * (var_ + diff * incr);
+    if (n_ < warmup_) {
+      n_++;
+      return AlarmEvent::None;
+    }
+    return latch(score_ > k_, score_ < k_ * 0.5f);
+  }
+
+  float mean() const { return mean_; }
+
+private:
+  float alpha_, k_, minSigma_;
+  uint16_t warmup_;
+  uint16_t n_ = 0;
+  float mean_ = 0.0f;
+  float var_ = 0.0f;
+};
+
+// ================= GLIDENDE STANDARDAFVIGELSE =================
+// Sum og kvadratsum over de sidste N samples i double, så fjernelse af den
+// ældste sample ikke ophober afrundingsfejl (float ville drive efter timer).
+template <size_t N>
+class RollingStdDetector : public AlarmDetector {
+public:
+  RollingStdDetector(const char* name, float k, float minSigma)
+      : AlarmDetector(name), k_(k), minSigma_(minSigma) {
+    limit_ = k;
+  }
+
+  AlarmEvent update(float v, uint32_t) override {
+    AlarmEvent ev = AlarmEvent::None;
+    if (count_ == N) {
+      double mean = sum_ / N;
+      double var = sumSq_ / N - mean * mean;
+      float sigma = var > 0.0 ? float(sqrt(var)) : 0.0f;
+      if (sigma < minSigma_) sigma = minSigma_;
+      score_ = float(fabs(v - mean)) / sigma;
+      ev = latch(score_ > k_, score_ < k_ * 0.5f);
+      double old = ring_[head_];
+      sum_ -= old;
+      sumSq_ -= old * old;
+    } else {
+      count_++;
+    }
+    ring_[head_] = v;
+    head_ = (head_ + 1) % N;
+    sum_ += v;
+    sumSq_ += double(v) * v;
+    return ev;
+  }
+
+private:
+  float  k_, minSigma_;
+  float  ring_[N] = {};
+  size_t head_ = 0;
+  size_t count_ = 0;
+  double sum_ = 0.0;
+  double sumSq_ = 0.0;
+};
+
+// ================= ÆNDRINGSHASTIGHED =================
+// |dv/dt| i enheder pr. sekund mellem to på hinanden følgende samples
+class RateDetector : public AlarmDetector {
+public:
+  RateDetector(const char* name, float maxPerSecond)
+      : AlarmDetector(name), maxPerSecond_(maxPerSecond) {
+    limit_ = maxPerSecond;
+  }
+
+  AlarmEvent update(float v, uint32_t nowMs) override {
+    AlarmEvent ev = AlarmEvent::None;
+    if (hasLast_) {
+      uint32_t dt = nowMs - lastMs_;
+      if (dt > 0) {
+        score_ = fabsf(v - last_) * 1000.0f / float(dt);
+        ev = latch(score_ > maxPerSecond_, score_ < maxPerSecond_ * 0.5f);
+      }
+    }
+    last_ = v;
+    lastMs_ = nowMs;
+    hasLast_ = true;
+    return ev;
+  }
+
+private:
+  float    maxPerSecond_;
+  float    last_ = 0.0f;
+  uint32_t lastMs_ = 0;
+  bool     hasLast_ = false;
+};
@@ -0,0 +1,222 @@
+#pragma once
+// Udnyttelse af RS485-segmentet og automatisk justering af pollperioder
+//
+// BusMeter bogfører hver Modbus-transaktion: request- og responsbytes,
+// deres tid på ledningen (10 bit pr. tegn ved 8N1 plus 3,5 tegns pause pr.
+// frame), slavens svartid (turnaround) og timeouts. Bussen regnes optaget
+// i hele transaktionen, også mens master venter på et svar der aldrig
+// kommer. Optaget tid samles i spande á 1 s, og udnyttelsen er summen over
+// de sidste 10 hele spande.
+//
+// MeteredMaster lægger sig om RtuMaster (lib/RtuMaster) med samme
+// interface, så CompiledMap::poll() og writeThenRead() kan bruge den direkte.
+//
+// PeriodTuner strækker alle pollperioder med samme faktor, når
+// udnyttelsen er over målet, og trækker dem tilbage mod basisperioden når
+// der er luft igen. Faktoren ændres højst 25 % pr. justering, og der er et
+// dødbånd under målet, så perioderne ikke svinger.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ================= BOGFØRING =================
+class BusMeter {
+public:
+  static const size_t   BUCKETS = 10;
+  static const uint32_t BUCKET_MS = 1000;
+
+  struct Totals {
+    uint32_t transactions = 0;
+    uint32_t timeouts     = 0;
+    uint32_t reqBytes     = 0;
+    uint32_t respBytes    = 0;
+    uint64_t wireUs       = 0;   // tegn + frame-pauser
+    uint64_t turnaroundUs = 0;   // request sendt til svar modtaget, minus ledningstid (kun besvarede)
+    uint64_t busyUs       = 0;   // hele transaktionen inkl. timeouts
+  };
+
+  explicit BusMeter(uint32_t baud) { setBaud(baud); }
+
+  void setBaud(uint32_t baud) {
+    if (!baud) baud = 9600;
+    charUs_ = (10u * 1000000u + baud / 2) / baud;           // 8N1
+    gapUs_ = baud > 19200 ? 1750 : (35 * charUs_ + 5) / 10; // t3.5, fast over 19200 baud (Modbus RTU)
+  }
+
+  // Ledningstid for én frame på bytes tegn, inkl. pausen før næste frame
+  uint32_t frameUs(uint32_t bytes) const { return bytes ? bytes * charUs_ + gapUs_ : 0; }
+
+  /**
+   * @param respBytes  0 ved timeout
+   * @param elapsedUs  fra request startes til svaret er læst (eller timeout)
+   */
+  void record(uint32_t nowMs, uint32_t reqBytes, uint32_t respBytes, uint32_t elapsedUs, bool timedOut) {
+    uint32_t wire = frameUs(reqBytes) + frameUs(respBytes);
+    uint32_t busy = elapsedUs > wire ? elapsedUs : wire;
+    totals_.transactions++;
+    totals_.reqBytes += reqBytes;
+    totals_.respBytes += respBytes;
+    totals_.wireUs += wire;
+    totals_.busyUs += busy;
+    if (timedOut) totals_.timeouts++;
+    else totals_.turnaroundUs += busy - wire;
+
+    advance(nowMs);
+    bucketUs_[bucketIndex(nowMs)] += busy;
+  }
+
+  /**
+   * @brief Udnyttelse i promille over de sidste BUCKETS hele spande
+   */
+  uint32_t utilizationPermille(uint32_t nowMs) {
+    advance(nowMs);
+    uint64_t busy = 0;
+    size_t current = bucketIndex(nowMs);
+    for (size_t i = 0; i < BUCKETS + 1; i++) {
+      if (i != current) busy += bucketUs_[i];
+    }
+    uint64_t permille = busy / (uint64_t(BUCKETS) * BUCKET_MS);   // us optaget / ms i vinduet = promille
+    return permille > 1000 ? 1000 : uint32_t(permille);
+  }
+
+  /**
+   * @brief Kopierer tællerne og nulstiller dem
+   */
+  Totals takeTotals() {
+    Totals t = totals_;
+    totals_ = Totals();
+    return t;
+  }
+
+private:
+  // BUCKETS hele spande + den igangværende
+  size_t bucketIndex(uint32_t nowMs) const { return (nowMs / BUCKET_MS) % (BUCKETS + 1); }
+
+  // Nulstil spande der er ældre end vinduet
+  void advance(uint32_t nowMs) {
+    uint32_t epoch = nowMs / BUCKET_MS;
+    if (!started_) {
+      started_ = true;
+      epoch_ = epoch;
+      return;
+    }
+    uint32_t steps = epoch - epoch_;
+    if (steps > BUCKETS + 1) steps = BUCKETS + 1;
+    for (uint32_t s = 1; s <= steps; s++) bucketUs_[(epoch_ + s) % (BUCKETS + 1)] = 0;
+    epoch_ = epoch;
+  }
+
+  uint32_t charUs_ = 0;
+  uint32_t gapUs_ = 0;
+  uint32_t epoch_ = 0;
+  bool     started_ = false;
+  uint32_t bucketUs_[BUCKETS + 1] = {};
+  Totals   totals_;
+};
+
+// ================= MODBUSMASTER MED BOGFØRING =================
+// Bytes pr. frame (RTU): slave + FC + data + CRC
+template <class Master>
+class MeteredMaster {
+public:
+  static const uint8_t ku8MBSuccess = Master::ku8MBSuccess;
+  static const uint8_t ku8MBIllegalFunction = Master::ku8MBIllegalFunction;
+  static const uint8_t ku8MBResponseTimedOut = Master::ku8MBResponseTimedOut;
+  typedef unsigned long (*Clock)();   // micros() / millis() på Arduino
+
+  MeteredMaster(Master& mb, BusMeter& meter, Clock microsFn, Clock millisFn)
+      : mb_(mb), meter_(meter), micros_(microsFn), millis_(millisFn) {}
+
+  uint8_t readInputRegisters(uint16_t start, uint16_t count) {
+    uint32_t t0 = uint32_t(micros_());
+    uint8_t res = mb_.readInputRegisters(start, count);
+    account(res, 8, 5 + 2u * count, t0);
+    return res;
+  }
+
+  uint8_t readHoldingRegisters(uint16_t start, uint16_t count) {
+    uint32_t t0 = uint32_t(micros_());
+    uint8_t res = mb_.readHoldingRegisters(start, count);
+    account(res, 8, 5 + 2u * count, t0);
+    return res;
+  }
+
+  uint8_t writeSingleRegister(uint16_t reg, uint16_t value) {
+    uint32_t t0 = uint32_t(micros_());
+    uint8_t res = mb_.writeSingleRegister(reg, value);
+    account(res, 8, 8, t0);
+    return res;
+  }
+
+  // FC23: request har 8 bytes adresser/antal + bytetal + data, svaret som FC03
+  uint8_t readWriteMultipleRegisters(uint16_t readStart, uint16_t readCount, uint16_t writeStart,
+                                     uint16_t writeCount) {
+    uint32_t t0 = uint32_t(micros_());
+    uint8_t res = mb_.readWriteMultipleRegisters(readStart, readCount, writeStart, writeCount);
+    account(res, 13 + 2u * writeCount, 5 + 2u * readCount, t0);
+    return res;
+  }
+
+  uint8_t setTransmitBuffer(uint8_t i, uint16_t value) { return mb_.setTransmitBuffer(i, value); }
+
+  uint16_t getResponseBuffer(uint8_t i) { return mb_.getResponseBuffer(i); }
+
+private:
+  void account(uint8_t res, uint32_t reqBytes, uint32_t okBytes, uint32_t t0) {
+    uint32_t elapsed = uint32_t(micros_()) - t0;
+    bool timedOut = res == Master::ku8MBResponseTimedOut;
+    uint32_t resp = res == Master::ku8MBSuccess ? okBytes
+                  : timedOut                    ? 0
+                  : res < 0xE0                  ? 5          // Modbus exception-svar
+                                                : okBytes;   // forkert CRC/ID: der kom et svar
+    meter_.record(uint32_t(millis_()), reqBytes, resp, elapsed, timedOut);
+  }
+
+  Master&   mb_;
+  BusMeter& meter_;
+  Clock     micros_;
+  Clock     millis_;
+};
+
+// ================= AUTOMATISK POLLRATE =================
+class PeriodTuner {
+public:
+  static const uint32_t UNITY = 1000;   // strækfaktor i promille (1000 = basisperiode)
+
+  /**
+   * @param targetPermille  ønsket udnyttelse, fx 700 = 70 %
+   * @param maxStretch      største faktor i promille, fx 8000 = 8 x basisperioden
+   */
+  PeriodTuner(uint32_t targetPermille, uint32_t maxStretch)
+      : target_(targetPermille ? targetPermille : 1), maxStretch_(maxStretch < UNITY ? UNITY : maxStretch) {}
+
+  /**
+   * @brief Ny faktor ud fra målt udnyttelse (kaldes én gang pr. målevindue)
+   * @return true hvis faktoren blev ændret
+   */
+  bool update(uint32_t utilPermille) {
+    uint32_t old = stretch_;
+    if (utilPermille > target_) {
+      // load er omvendt proportional med perioden: stræk med util/target
+      uint64_t want = uint64_t(stretch_) * utilPermille / target_;
+      uint64_t limit = uint64_t(stretch_) * 5 / 4;
+      stretch_ = uint32_t(want < limit ? want : limit);
+    } else if (utilPermille < target_ * 9 / 10) {   // dødbånd: 90-100 % af målet
+      uint64_t want = uint64_t(stretch_) * (utilPermille ? utilPermille : 1) / (target_ * 9 / 10);
+      uint64_t limit = uint64_t(stretch_) * 4 / 5;
+      stretch_ = uint32_t(want > limit ? want : limit);
+    }
+    if (stretch_ < UNITY) stretch_ = UNITY;
+    if (stretch_ > maxStretch_) stretch_ = maxStretch_;
+    return stretch_ != old;
+  }
+
+  uint32_t stretch() const { return stretch_; }
+  uint32_t target() const { return target_; }
+  uint32_t apply(uint32_t basePeriodMs) const { return uint32_t(uint64_t(basePeriodMs) * stretch_ / UNITY); }
+
+private:
+  uint32_t target_;
+  uint32_t maxStretch_;
+  uint32_t stretch_ = UNITY;
+};
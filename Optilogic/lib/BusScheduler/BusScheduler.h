@@ -0,0 +1,182 @@
+#pragma once
+// Fair deling af ét RS485-segment mellem flere Modbus-slaves
+//
+// Hver slave har en pollperiode og en vægt, og optjener bustid i forhold til
+// sin vægt efterhånden som tiden går (kredit). En transaktion trækker den
+// faktisk brugte bustid fra. En forfalden slave må kun polles når den ikke
+// står i gæld, eller når transaktionen (anslået ud fra den forrige) er
+// færdig før nogen anden slave bliver forfalden. Så kan en slave der timer
+// ud (op til 2 s pr. request) kun bruge sin egen andel og ikke
+// udsulte de andre, mens bussen stadig bruges når ingen andre venter.
+// Kreditten er loftet, så en ledig slave ikke sparer bustid op til en byge.
+//
+// Perioden holdes uden drift (næste frist = forrige + periode). Kommer en
+// slave mere end én periode bagud, springes de tabte polls over i stedet
+// for at blive indhentet.
+//
+// Med setPaced(true) bestemmer en ekstern takt (SampleClock.h) i stedet
+// hvornår slaves forfalder: releaseTick() frigiver hver slave på de ticks
+// hvor tick-nummeret går op i dens periode regnet i hele ticks, så enheder
+// med samme periode poller på de samme wall-clock grænser. En frigivet
+// slave der ikke nåede at blive pollet før næste frigivelse, tæller som
+// sprunget over. Kreditten fordeler stadig bussen mellem de frigivne.
+//
+// Tider er millis() og må gerne løbe rundt (uint32_t-aritmetik).
+
+#include <stddef.h>
+#include <stdint.h>
+
+template <size_t N>
+class BusScheduler {
+public:
+  struct Stats {
+    uint32_t polls   = 0;   // transaktioner siden takeStats()
+    uint32_t busMs   = 0;   // bustid brugt siden takeStats()
+    uint32_t skipped = 0;   // polls sprunget over (bussen optaget eller slaven parkeret)
+  };
+
+  /**
+   * @param weights  andel af bustiden pr. slave (nullptr = lige store)
+   */
+  void begin(uint32_t nowMs, uint32_t periodMs, const uint8_t* weights = nullptr) {
+    totalWeight_ = 0;
+    for (size_t i = 0; i < N; i++) {
+      period_[i] = periodMs ? periodMs : 1;
+      weight_[i] = weights && weights[i] ? weights[i] : 1;
+      nextDue_[i] = nowMs;
+      credit_[i] = 0;
+      lastCostMs_[i] = 0;
+      released_[i] = false;
+      stats_[i] = Stats();
+      totalWeight_ += weight_[i];
+    }
+    lastAccrualMs_ = nowMs;
+  }
+
+  /**
+   * @brief Slave der skal polles nu, eller -1 hvis ingen er forfalden og berettiget
+   *
+   * Af de berettigede vælges den med mest kredit (den der har fået mindst).
+   */
+  int next(uint32_t nowMs) {
+    accrue(nowMs);
+    int best = -1;
+    for (size_t i = 0; i < N; i++) {
+      if (!due(i, nowMs)) continue;
+      if (credit_[i] < 0 && !harmless(i, nowMs)) continue;   // i gæld og andre venter
+      if (best < 0 || credit_[i] > credit_[size_t(best)]) best = int(i);
+    }
+    return best;
+  }
+
+  /**
+   * @brief Registrerer en afsluttet transaktion (også fejlede) og planlægger næste
+   *
+   * @param busMs  tid bussen var optaget af transaktionen
+   */
+  void done(size_t i, uint32_t nowMs, uint32_t busMs) {
+    accrue(nowMs);
+    credit_[i] -= int64_t(busMs) * totalWeight_;
+    lastCostMs_[i] = busMs;
+    stats_[i].polls++;
+    stats_[i].busMs += busMs;
+    if (paced_) {
+      released_[i] = false;
+      return;
+    }
+
+    nextDue_[i] += period_[i];
+    if (int32_t(nowMs - nextDue_[i]) >= int32_t(period_[i])) {
+      uint32_t missed = uint32_t(nowMs - nextDue_[i]) / period_[i];
+      stats_[i].skipped += missed;
+      nextDue_[i] += missed * period_[i];
+    }
+  }
+
+  /**
+   * @brief Springer slavens tur over uden at bruge bussen (fx circuit breaker åben)
+   */
+  void skip(size_t i, uint32_t nowMs) {
+    stats_[i].skipped++;
+    if (paced_) {
+      released_[i] = false;
+      return;
+    }
+    nextDue_[i] += period_[i];
+    if (int32_t(nowMs - nextDue_[i]) >= 0) nextDue_[i] = nowMs + period_[i];
+  }
+
+  /**
+   * @brief Slår ekstern takt til eller fra; med takt forfalder slaves kun via releaseTick()
+   */
+  void setPaced(bool paced) {
+    paced_ = paced;
+    for (size_t i = 0; i < N; i++) released_[i] = false;
+  }
+
+  bool paced() const { return paced_; }
+
+  /**
+   * @brief Frigiver de slaves hvis periode (afrundet til hele ticks) går op i tick-nummeret
+   *
+   * @param tickMs  taktens periode; en slave med periode p frigives hver n'te tick, n = round(p / tickMs)
+   */
+  void releaseTick(uint64_t tickIndex, uint32_t tickMs) {
+    if (!tickMs) tickMs = 1;
+    for (size_t i = 0; i < N; i++) {
+      uint32_t stride = (period_[i] + tickMs / 2) / tickMs;
+      if (stride < 1) stride = 1;
+      if (tickIndex % stride) continue;
+      if (released_[i]) stats_[i].skipped++;   // forrige tur blev aldrig pollet
+      released_[i] = true;
+    }
+  }
+
+  uint32_t periodMs(size_t i) const { return period_[i]; }
+  void setPeriod(size_t i, uint32_t periodMs) { period_[i] = periodMs ? periodMs : 1; }
+
+  /**
+   * @brief Kopierer tællerne og nulstiller dem (fx én gang pr. aggregeringsvindue)
+   */
+  Stats takeStats(size_t i) {
+    Stats s = stats_[i];
+    stats_[i] = Stats();
+    return s;
+  }
+
+private:
+  // Kredit i ms * totalWeight_, så andelen w/W er et heltal pr. ms
+  void accrue(uint32_t nowMs) {
+    uint32_t elapsed = nowMs - lastAccrualMs_;
+    lastAccrualMs_ = nowMs;
+    for (size_t i = 0; i < N; i++) {
+      int64_t cap = int64_t(period_[i] > lastCostMs_[i] ? period_[i] : lastCostMs_[i]) * totalWeight_;
+      credit_[i] += int64_t(elapsed) * weight_[i];
+      if (credit_[i] > cap) credit_[i] = cap;
+    }
+  }
+
+  bool due(size_t i, uint32_t nowMs) const { return paced_ ? released_[i] : int32_t(nowMs - nextDue_[i]) >= 0; }
+
+  // Sandt hvis ingen anden slave bliver forfalden før i's transaktion er slut
+  // (med ekstern takt: ingen anden er frigivet og venter)
+  bool harmless(size_t i, uint32_t nowMs) const {
+    uint32_t end = nowMs + lastCostMs_[i];
+    for (size_t j = 0; j < N; j++) {
+      if (j == i) continue;
+      if (paced_ ? released_[j] : int32_t(end - nextDue_[j]) >= 0) return false;
+    }
+    return true;
+  }
+
+  uint32_t period_[N];
+  uint8_t  weight_[N];
+  uint32_t nextDue_[N];
+  int64_t  credit_[N];
+  uint32_t lastCostMs_[N];
+  uint32_t totalWeight_ = N;
+  uint32_t lastAccrualMs_ = 0;
+  bool     paced_ = false;
+  bool     released_[N];
+  Stats    stats_[N];
+};
@@ -0,0 +1,196 @@
+#include "ControlEngine.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace control {
+
+namespace {
+
+const float POW10[] = {1.0f, 10.0f, 100.0f, 1000.0f, 10000.0f, 100000.0f, 1000000.0f};
+
+struct Field {
+  const char* p;
+  size_t n;
+};
+
+bool equals(const Field& f, const char* s) {
+  size_t n = strlen(s);
+  return f.n == n && memcmp(f.p, s, n) == 0;
+}
+
+Field trim(const char* p, size_t n) {
+  while (n && (*p == ' ' || *p == '\t' || *p == '\r')) { p++; n--; }
+  while (n && (p[n - 1] == ' ' || p[n - 1] == '\t' || p[n - 1] == '\r')) n--;
+  return Field{p, n};
+}
+
+// Decimaltal som "-2.5"; false hvis feltet ikke er et tal
+bool real(const Field& f, float& out) {
+  char buf[24];
+  if (f.n == 0 || f.n >= sizeof(buf)) return false;
+  memcpy(buf, f.p, f.n);
+  buf[f.n] = '\0';
+  char* end;
+  out = strtof(buf, &end);
+  return *end == '\0' && isfinite(out);
+}
+
+bool integer(const Field& f, int32_t lo, int32_t hi, int32_t& out) {
+  float v;
+  if (!real(f, v) || v != floorf(v) || v < float(lo) || v > float(hi)) return false;
+  out = int32_t(v);
+  return true;
+}
+
+bool target(const Field& f, int runRegister, uint16_t& reg, const char*& err) {
+  int32_t v;
+  if (equals(f, "run")) {
+    if (runRegister < 0) { err = "profilen har intet run-register"; return false; }
+    reg = uint16_t(runRegister);
+    return true;
+  }
+  if (!integer(f, 0, 0xFFFF, v)) { err = "register skal være run eller 0-65535"; return false; }
+  reg = uint16_t(v);
+  return true;
+}
+
+}  // namespace
+
+// ================= PARSE =================
+bool Engine::load(const char* doc, size_t len, int runRegister, const char*& err) {
+  err = nullptr;
+  if (len > MAX_DOC) { err = "dokument for langt"; return false; }
+
+  Rule parsed[MAX_RULES];
+  size_t count = 0;
+  const char* end = doc + len;
+  const char* line = doc;
+  while (line < end) {
+    const char* eol = line;
+    while (eol < end && *eol != '\n' && *eol != ';') eol++;
+    Field l = trim(line, size_t(eol - line));
+    line = eol + 1;
+    if (l.n == 0 || l.p[0] == '#') continue;
+
+    Field f[9];
+    size_t nf = 0;
+    const char* s = l.p;
+    const char* lend = l.p + l.n;
+    while (s <= lend && nf < 9) {
+      const char* c = s;
+      while (c < lend && *c != ',') c++;
+      f[nf++] = trim(s, size_t(c - s));
+      s = c + 1;
+    }
+    if (s <= lend) { err = "for mange felter"; return false; }
+    if (count >= MAX_RULES) { err = "for mange regler"; return false; }
+
+    Rule& r = parsed[count];
+    if (nf < 2 || f[1].n == 0 || f[1].n >= regmap::MAX_NAME) { err = "ugyldigt metric-navn"; return false; }
+    memcpy(r.metric, f[1].p, f[1].n);
+    r.metric[f[1].n] = '\0';
+
+    if (equals(f[0], "if")) {
+      if (nf < 7 || nf > 8) { err = "forventer if,metric,<|>,grænse,hysterese,register,værdi[,ellers]"; return false; }
+      r.kind = IF;
+      if (equals(f[2], "<"))      r.below = true;
+      else if (equals(f[2], ">")) r.below = false;
+      else { err = "sammenligning skal være < eller >"; return false; }
+      if (!real(f[3], r.limit)) { err = "ugyldig grænse"; return false; }
+      if (!real(f[4], r.hyst) || r.hyst < 0) { err = "hysterese skal være et tal >= 0"; return false; }
+      if (!target(f[5], runRegister, r.reg, err)) return false;
+      if (!integer(f[6], 0, 0xFFFF, r.value)) { err = "værdi skal være 0-65535"; return false; }
+      r.hasElse = nf == 8;
+      if (r.hasElse && !integer(f[7], 0, 0xFFFF, r.elseValue)) { err = "ellers skal være 0-65535"; return false; }
+    } else if (equals(f[0], "pid")) {
+      if (nf != 9) { err = "forventer pid,metric,setpunkt,kp,ki,kd,register,min,max"; return false; }
+      r.kind = PID;
+      if (!real(f[2], r.setpoint) || !real(f[3], r.kp) || !real(f[4], r.ki) || !real(f[5], r.kd)) {
+        err = "setpunkt og forstærkninger skal være tal";
+        return false;
+      }
+      if (!target(f[6], runRegister, r.reg, err)) return false;
+      int32_t lo, hi;
+      if (!integer(f[7], 0, 0xFFFF, lo) || !integer(f[8], 0, 0xFFFF, hi) || lo > hi) {
+        err = "min og max skal være 0-65535 og min <= max";
+        return false;
+      }
+      r.outMin = float(lo);
+      r.outMax = float(hi);
+    } else {
+      err = "regel skal starte med if eller pid";
+      return false;
+    }
+    count++;
+  }
+
+  for (size_t i = 0; i < count; i++) rules_[i] = parsed[i];   // frisk tilstand: alt skrives ved første sample
+  count_ = count;
+  generation_++;
+  return true;
+}
+
+void Engine::bind(const regmap::CompiledMap& map) {
+  for (size_t i = 0; i < count_; i++) rules_[i].slot = map.slotOf(rules_[i].metric);
+}
+
+// ================= EVALUERING =================
+bool Engine::decide(Rule& r, float x, uint32_t nowMs, int32_t& value) {
+  if (r.kind == IF) {
+    bool was = r.active;
+    if (r.below) r.active = r.active ? x <= r.limit + r.hyst : x < r.limit;
+    else         r.active = r.active ? x >= r.limit - r.hyst : x > r.limit;
+    if (r.active != was) r.applied = UNKNOWN;   // skift: skriv selvom registeret var sat til værdien før (fx manuel run=)
+    if (!r.active && !r.hasElse) return false;   // intet at skrive når betingelsen ikke gælder
+    value = r.active ? r.value : r.elseValue;
+    return true;
+  }
+
+  float dt = r.primed ? float(uint32_t(nowMs - r.lastMs)) / 1000.0f : 0.0f;
+  float error = r.setpoint - x;
+  float p = r.kp * error;
+  float d = dt > 0 ? -r.kd * (x - r.lastInput) / dt : 0.0f;   // på målingen: intet spark ved nyt setpunkt
+  float integral = r.integral + r.ki * error * dt;
+  float out = p + integral + d;
+  if (out > r.outMax)      out = r.outMax;
+  else if (out < r.outMin) out = r.outMin;
+  else r.integral = integral;   // anti-windup: integralet opdateres kun når outputtet ikke er mættet
+  r.lastInput = x;
+  r.lastMs = nowMs;
+  r.primed = true;
+  value = int32_t(lroundf(out));
+  return r.applied == UNKNOWN || uint32_t(nowMs - r.lastWriteMs) >= PID_WRITE_MS;
+}
+
+size_t Engine::evaluate(const regmap::CompiledMap& map, const int32_t* raw, uint32_t okMask, uint32_t nowMs,
+                        Command* out, size_t cap) {
+  size_t n = 0;
+  for (size_t i = 0; i < count_; i++) {
+    Rule& r = rules_[i];
+    if (r.slot < 0 || !(okMask & (1u << r.slot))) continue;
+    float x = float(raw[r.slot]) / POW10[map.decimals(size_t(r.slot))];
+    int32_t value = r.output;   // uændret når en if-regel uden ellers ikke gælder
+    bool write = decide(r, x, nowMs, value);
+    r.output = value;
+    if (!write || value == r.applied || r.inFlight) continue;
+    if (r.backoff && int32_t(nowMs - r.retryAtMs) < 0) continue;   // venter efter en fejl
+    if (n >= cap) break;
+    out[n++] = Command{uint8_t(i), generation_, r.reg, uint16_t(value)};
+    r.inFlight = true;
+    r.lastWriteMs = nowMs;
+  }
+  return n;
+}
+
+void Engine::onResult(const Command& c, bool ok, uint32_t nowMs) {
+  if (c.generation != generation_ || c.rule >= count_) return;   // reglerne er skiftet mens kommandoen stod i kø
+  Rule& r = rules_[c.rule];
+  r.inFlight = false;
+  r.applied = ok ? int32_t(c.value) : UNKNOWN;   // outputtet kan have flyttet sig; næste evaluering retter op
+  r.backoff = !ok;
+  r.retryAtMs = nowMs + RETRY_MS;
+}
+
+}  // namespace control
@@ -0,0 +1,164 @@
+#pragma once
+// Lokal regulering: regler og PID evalueret på hvert friskt sample
+//
+// Et regel-dokument er én linje pr. regel, adskilt af linjeskift eller ';'
+// (samme opbygning som register-mappet, se RegisterMap.h):
+//   # if,metric,<|>,grænse,hysterese,register,værdi[,ellers]
+//   if,tryk,<,15.0,2.0,run,3,0      start ventilatoren når trykket falder under 15.0,
+//                                   stop igen når det er over 17.0
+//   # pid,metric,setpunkt,kp,ki,kd,register,min,max
+//   pid,temp,21.0,40,2,0,370,0,1000 skriv holding register 370 så temp holdes på 21.0
+// metric er et navn i slavens register-map, register er "run" (profilens
+// start/stop-register) eller et 0-baseret holding register.
+//
+// Reglerne evalueres i poll-løkken med slavens netop læste værdier og giver
+// Commands, som firmwaren lægger i sin kommandokø og skriver på bussen før
+// næste poll. Reaktionstiden er derfor en poll plus én skrivning.
+//
+//   if   Skriver ved hvert skift (værdi når betingelsen bliver sand, ellers når
+//        den slipper efter hysteresen), også hvis registeret allerede havde
+//        værdien fra sidst. En manuel "run=" står derfor til næste skift.
+//   pid  Positionsform med anti-windup (integralet fryses i mætning) og
+//        differentiering på målingen. Skriver når det afrundede output ændrer
+//        sig, højst hvert PID_WRITE_MS.
+//
+// En skrivning der fejler, prøves igen efter RETRY_MS. Hver regel har højst
+// én skrivning undervejs, så køen ikke kan løbe fuld af gentagelser.
+//
+// Engine'en bruges kun fra loop-tasken (poll og MQTT-callback) og har ingen låse.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "RegisterMap.h"
+
+namespace control {
+
+static const size_t   MAX_RULES = 8;
+static const size_t   MAX_DOC = 384;
+static const uint32_t RETRY_MS = 5000;       // efter en fejlet skrivning
+static const uint32_t PID_WRITE_MS = 1000;   // mindste tid mellem to PID-skrivninger
+static const int32_t  UNKNOWN = INT32_MIN;   // værdien i registeret er ikke kendt
+
+enum Kind : uint8_t { IF, PID };
+
+struct Rule {
+  Kind     kind = IF;
+  char     metric[regmap::MAX_NAME] = {};
+  int      slot = -1;        // i det aktive map, -1 = findes ikke (reglen står stille)
+  uint16_t reg = 0;
+
+  // if
+  bool    below = true;      // '<'
+  float   limit = 0, hyst = 0;
+  int32_t value = 0, elseValue = 0;
+  bool    hasElse = false;
+
+  // pid
+  float setpoint = 0, kp = 0, ki = 0, kd = 0, outMin = 0, outMax = 0;
+
+  // tilstand
+  bool     active = false;       // if: betingelsen er sand (med hysterese)
+  int32_t  output = UNKNOWN;     // seneste beslutning
+  int32_t  applied = UNKNOWN;    // bekræftet skrevet
+  bool     inFlight = false;
+  bool     backoff = false;      // seneste skrivning fejlede, vent til retryAtMs
+  uint32_t retryAtMs = 0;
+  uint32_t lastWriteMs = 0;
+  float    integral = 0, lastInput = 0;
+  uint32_t lastMs = 0;
+  bool     primed = false;       // pid: har et forrige sample
+};
+
+// Én skrivning som reglen beder om
+struct Command {
+  uint8_t  rule;
+  uint8_t  generation;   // se Engine::generation()
+  uint16_t reg;
+  uint16_t value;
+};
+
+class Engine {
+public:
+  /**
+   * @brief Parser et regel-dokument og erstatter de aktive regler
+   *
+   * @param runRegister  profilens start/stop-register ("run"), -1 hvis der ikke er et
+   * @param err sættes til en fejltekst hvis dokumentet afvises (reglerne er da uændrede)
+   */
+  bool load(const char* doc, size_t len, int runRegister, const char*& err);
+
+  void clear() { count_ = 0; }
+
+  size_t size() const { return count_; }
+  const Rule& rule(size_t i) const { return rules_[i]; }
+
+  // Tælles op ved hver load(), så resultater for de gamle regler kan kendes
+  uint8_t generation() const { return generation_; }
+
+  // Kaldes ved skift af register-map: slå metric-navnene op én gang, ikke pr. sample
+  void bind(const regmap::CompiledMap& map);
+
+  /**
+   * @brief Evaluerer reglerne mod et friskt sample
+   *
+   * @param raw     rå fast-komma værdi pr. slot (som fra CompiledMap::poll)
+   * @param okMask  slots der blev læst; regler på manglende metrics springes over
+   * @return antal Commands skrevet i out
+   */
+  size_t evaluate(const regmap::CompiledMap& map, const int32_t* raw, uint32_t okMask, uint32_t nowMs,
+                  Command* out, size_t cap);
+
+  /**
+   * @brief Resultatet af en Command fra evaluate()
+   *
+   * @param ok  skrivningen lykkedes og registeret blev læst tilbage med værdien
+   */
+  void onResult(const Command& c, bool ok, uint32_t nowMs);
+
+private:
+  bool decide(Rule& r, float x, uint32_t nowMs, int32_t& value);
+
+  Rule    rules_[MAX_RULES];
+  size_t  count_ = 0;
+  uint8_t generation_ = 0;
+};
+
+// ================= KOMMANDOKØ =================
+// FIFO af skrivninger til bussen. Fyldes fra MQTT-callbacken og reguleringen
+// og tømmes af loop mellem polls, så skrivninger og polls aldrig overlapper.
+enum Source : uint8_t { FROM_MQTT, FROM_CONTROL };
+
+struct QueuedCommand {
+  uint8_t  slave;
+  Source   source;
+  Command  command;    // rule og generation bruges kun af FROM_CONTROL
+  uint32_t sampleMs;   // hvornår samplet der udløste den blev læst (reaktionstid)
+};
+
+template <size_t N>
+class CommandQueue {
+public:
+  bool push(const QueuedCommand& c) {
+    if (count_ == N) return false;
+    items_[(head_ + count_) % N] = c;
+    count_++;
+    return true;
+  }
+
+  bool pop(QueuedCommand& c) {
+    if (!count_) return false;
+    c = items_[head_];
+    head_ = (head_ + 1) % N;
+    count_--;
+    return true;
+  }
+
+  size_t size() const { return count_; }
+
+private:
+  QueuedCommand items_[N];
+  size_t head_ = 0, count_ = 0;
+};
+
+}  // namespace control
@@ -0,0 +1,189 @@
+// Host-test af ControlEngine: regel-dokumenter, if-regler og PID
+//
+// Kører reglerne mod et register-map med temp/tryk/rpm og en simuleret
+// slave, hvor skrivninger lykkes med det samme (eller fejler på kommando).
+// Et brud stopper programmet med en fejllinje og exit-kode 1.
+//
+// Byg: g++ -std=c++17 -g -O1 -fsanitize=address,undefined -I. -I../RegisterMap control_engine_test.cpp ControlEngine.cpp ../RegisterMap/RegisterMap.cpp -o control_engine_test
+// Kør: ./control_engine_test
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ControlEngine.h"
+
+#define CHECK(cond)                                                        \
+  do {                                                                     \
+    if (!(cond)) {                                                         \
+      fprintf(stderr, "%s:%d: brud: %s\n", __FILE__, __LINE__, #cond);     \
+      exit(1);                                                             \
+    }                                                                      \
+  } while (0)
+
+static const int RUN_REGISTER = 367;
+static const char MAP_DOC[] = "temp,ir,19,1;tryk,ir,13,1;rpm,ir,15,0";   // slots 0, 1, 2
+
+// Slave med ét holding register pr. adresse; writes fejler så længe failWrites er sat
+struct Harness {
+  regmap::CompiledMap map;
+  control::Engine engine;
+  int32_t raw[3] = {215, 250, 1000};
+  uint32_t now = 0;
+  int32_t regs[2] = {-1, -1};   // run-register og register 370
+  bool failWrites = false;
+  int writes = 0;
+
+  explicit Harness(const char* rules) {
+    const char* err = nullptr;
+    CHECK(map.compile(MAP_DOC, strlen(MAP_DOC), err));
+    CHECK(engine.load(rules, strlen(rules), RUN_REGISTER, err));
+    engine.bind(map);
+  }
+
+  int32_t& reg(uint16_t r) { return regs[r == RUN_REGISTER ? 0 : 1]; }
+
+  // Ét poll: evaluér og udfør kommandoerne som firmwarens kommandokø
+  void poll(int32_t tryk, int32_t temp = 215) {
+    raw[0] = temp;
+    raw[1] = tryk;
+    control::Command cmds[control::MAX_RULES];
+    size_t n = engine.evaluate(map, raw, 0x7, now, cmds, control::MAX_RULES);
+    for (size_t i = 0; i < n; i++) {
+      if (!failWrites) reg(cmds[i].reg) = cmds[i].value;
+      writes++;
+      engine.onResult(cmds[i], !failWrites, now);
+    }
+    now += 250;
+  }
+};
+
+static void testDocuments() {
+  control::Engine e;
+  const char* err = nullptr;
+  const char* bad[] = {
+    "if,tryk,=,15,0,run,3",          // ukendt sammenligning
+    "if,tryk,<,x,0,run,3",           // grænse er ikke et tal
+    "if,tryk,<,15,-1,run,3",         // negativ hysterese
+    "if,tryk,<,15,0,run",            // mangler værdi
+    "if,tryk,<,15,0,run,70000",      // værdi uden for 16 bit
+    "if,tryk,<,15,0,run,3,0,9",      // for mange felter
+    "pid,temp,21,1,1,1,370,5,2",     // min > max
+    "foo,tryk",
+  };
+  for (const char* doc : bad) {
+    CHECK(!e.load(doc, strlen(doc), RUN_REGISTER, err));
+    CHECK(err != nullptr);
+  }
+  const char* noRun = "if,tryk,<,15,0,run,3";
+  CHECK(!e.load(noRun, strlen(noRun), -1, err));   // profil uden run-register
+  const char* ok = "# kommentar\nif,tryk,<,15.0,2.0,run,3,0;pid,temp,21.0,40,2,0,370,0,1000\n";
+  CHECK(e.load(ok, strlen(ok), RUN_REGISTER, err));
+  CHECK(e.size() == 2);
+  CHECK(e.rule(0).reg == RUN_REGISTER && e.rule(1).reg == 370);
+}
+
+static void testHysteresis() {
+  Harness h("if,tryk,<,15.0,2.0,run,3,0");
+  h.poll(250);
+  CHECK(h.reg(RUN_REGISTER) == 0 && h.writes == 1);   // første sample: ellers-værdien
+  h.poll(140);
+  CHECK(h.reg(RUN_REGISTER) == 3 && h.writes == 2);
+  h.poll(160);                                         // inden for hysteresen: ingen skrivning
+  h.poll(170);
+  CHECK(h.writes == 2);
+  h.poll(171);
+  CHECK(h.reg(RUN_REGISTER) == 0 && h.writes == 3);
+}
+
+// En if-regel uden ellers skal skrive ved hver ny aktivering, ikke kun den første
+static void testReactivation() {
+  Harness h("if,tryk,<,15.0,2.0,run,3");
+  h.poll(200);
+  CHECK(h.writes == 0);                                // betingelsen gælder ikke, intet at skrive
+  h.poll(140);
+  CHECK(h.reg(RUN_REGISTER) == 3 && h.writes == 1);
+  h.poll(200);
+  CHECK(h.writes == 1);
+  h.poll(140);
+  CHECK(h.reg(RUN_REGISTER) == 3 && h.writes == 2);
+}
+
+// Manuel run= står til næste skift, og næste skift skriver igen
+static void testManualOverride() {
+  Harness h("if,tryk,<,15.0,2.0,run,3,0");
+  h.poll(140);
+  CHECK(h.reg(RUN_REGISTER) == 3);
+  h.reg(RUN_REGISTER) = 0;                             // run=0 fra MQTT mens reglen gælder
+  for (int i = 0; i < 10; i++) h.poll(140);
+  CHECK(h.reg(RUN_REGISTER) == 0 && h.writes == 1);    // reglen overskriver ikke midt i et skift
+  h.poll(200);
+  CHECK(h.reg(RUN_REGISTER) == 0 && h.writes == 2);    // slipper: ellers skrives
+  h.poll(140);
+  CHECK(h.reg(RUN_REGISTER) == 3 && h.writes == 3);    // ny aktivering
+
+  Harness g("if,tryk,<,15.0,2.0,run,3");               // uden ellers
+  g.poll(140);
+  g.reg(RUN_REGISTER) = 0;
+  g.poll(200);
+  g.poll(140);
+  CHECK(g.reg(RUN_REGISTER) == 3 && g.writes == 2);
+}
+
+static void testRetry() {
+  Harness h("if,tryk,<,15.0,2.0,run,3,0");
+  h.failWrites = true;
+  h.poll(140);
+  CHECK(h.writes == 1);
+  h.failWrites = false;
+  while (h.now < control::RETRY_MS) h.poll(140);      // venter efter fejlen
+  CHECK(h.writes == 1);
+  h.poll(140);
+  CHECK(h.reg(RUN_REGISTER) == 3 && h.writes == 2);
+}
+
+static void testPid() {
+  Harness h("pid,temp,21.0,40,2,0,370,0,1000");
+  h.poll(250, 215);
+  CHECK(h.reg(370) == 0);                              // over setpunktet: mættet i min
+  int before = h.writes;
+  for (int i = 0; i < 3; i++) h.poll(250, 200);        // under setpunktet, men højst én skrivning pr. PID_WRITE_MS
+  CHECK(h.writes == before);
+  h.poll(250, 200);
+  CHECK(h.writes == before + 1 && h.reg(370) > 0);
+  int32_t out = h.reg(370);
+  for (int i = 0; i < 8; i++) h.poll(250, 200);        // integralet trækker outputtet op
+  CHECK(h.reg(370) > out);
+  for (int i = 0; i < 400; i++) h.poll(250, 100);      // langt under: mættet i max, integralet vokser ikke videre
+  CHECK(h.reg(370) == 1000);
+  h.poll(250, 215);                                    // tilbage over setpunktet: ud af mætning med det samme
+  for (int i = 0; i < 4; i++) h.poll(250, 215);
+  CHECK(h.reg(370) < 1000);
+}
+
+static void testReload() {
+  Harness h("if,tryk,<,15.0,2.0,run,3");
+  control::Command cmds[control::MAX_RULES];
+  h.raw[1] = 140;
+  CHECK(h.engine.evaluate(h.map, h.raw, 0x7, 0, cmds, control::MAX_RULES) == 1);
+  const char* err = nullptr;
+  const char* doc = "if,tryk,<,15.0,2.0,run,5";
+  CHECK(h.engine.load(doc, strlen(doc), RUN_REGISTER, err));
+  h.engine.bind(h.map);
+  h.engine.onResult(cmds[0], true, 0);                 // resultat for de gamle regler ignoreres
+  control::Command next[control::MAX_RULES];
+  CHECK(h.engine.evaluate(h.map, h.raw, 0x7, 250, next, control::MAX_RULES) == 1 && next[0].value == 5);
+}
+
+int main() {
+  testDocuments();
+  testHysteresis();
+  testReactivation();
+  testManualOverride();
+  testRetry();
+  testPid();
+  testReload();
+  printf("control_engine_test: ok\n");
+  return 0;
+}
@@ -0,0 +1,217 @@
+#include "DeferredLog.h"
+
+#include <stdio.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+namespace dlog {
+
+namespace {
+
+LogRing             g_ring;
+std::atomic<bool>   g_started{false};
+#ifdef ARDUINO
+uint32_t            g_idleMs = 10;
+#endif
+
+void write(const uint8_t* data, size_t len) {
+#ifdef ARDUINO
+  Serial.write(data, len);   // blokerer kun drain-tasken når TX-bufferen er fuld
+#else
+  fwrite(data, 1, len, stdout);
+#endif
+}
+
+#ifdef DLOG_BINARY
+// Frame: 0xD7, type, længde, payload (se dlog_decode.cpp)
+const uint8_t FRAME_MAGIC = 0xD7;
+uint16_t      g_nextId = 1;   // kun drain-tasken (eller setup før begin) tildeler
+
+void frame(char type, const uint8_t* payload, size_t len) {
+  uint8_t head[3] = {FRAME_MAGIC, uint8_t(type), uint8_t(len)};
+  write(head, sizeof(head));
+  write(payload, len);
+}
+
+void put16(uint8_t* p, uint16_t v) {
+  p[0] = uint8_t(v);
+  p[1] = uint8_t(v >> 8);
+}
+
+void put32(uint8_t* p, uint32_t v) {
+  for (int i = 0; i < 4; i++) p[i] = uint8_t(v >> (8 * i));
+}
+#endif
+
+}  // namespace
+
+LogRing& ring() { return g_ring; }
+
+bool started() { return g_started.load(std::memory_order_acquire); }
+
+uint32_t nowUs() {
+#ifdef ARDUINO
+  return uint32_t(micros());
+#else
+  static const auto t0 = std::chrono::steady_clock::now();
+  return uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count());
+#endif
+}
+
+// ================= FORMATERING =================
+size_t format(const char* fmt, const Word* args, size_t argc, char* out, size_t cap) {
+  if (!cap) return 0;
+  size_t n = 0;
+  size_t arg = 0;
+  auto put = [&](const char* s, size_t len) {
+    if (len > cap - 1 - n) len = cap - 1 - n;
+    memcpy(out + n, s, len);
+    n += len;
+  };
+  const char* p = fmt;
+  while (*p && n < cap - 1) {
+    if (*p != '%') {
+      const char* q = strchr(p, '%');
+      size_t len = q ? size_t(q - p) : strlen(p);
+      put(p, len);
+      p += len;
+      continue;
+    }
+    if (p[1] == '%') {
+      put("%", 1);
+      p += 2;
+      continue;
+    }
+    // %[flag][bredde][.præcision][længde]konvertering; længden smides væk
+    char spec[16] = "%";
+    size_t s = 1;
+    const char* q = p + 1;
+    while (*q && strchr("-+ #0123456789.", *q)) {
+      if (s < sizeof(spec) - 2) spec[s++] = *q;
+      q++;
+    }
+    while (*q && strchr("hlzjtL", *q)) q++;
+    char conv = *q;
+    if (!conv || !strchr("diuxXocsfFeEgGp", conv)) {   // ukendt eller afkortet: skriv som den står
+      put(p, size_t(q - p));
+      p = q;
+      continue;
+    }
+    spec[s++] = conv;
+    spec[s] = '\0';
+    p = q + 1;
+    if (arg >= argc) {
+      put("?", 1);
+      continue;
+    }
+    Word w = args[arg++];
+    int len = 0;
+    switch (conv) {
+      case 'd': case 'i': case 'c':
+        len = snprintf(out + n, cap - n, spec, int(int32_t(w)));
+        break;
+      case 'u': case 'x': case 'X': case 'o':
+        len = snprintf(out + n, cap - n, spec, unsigned(uint32_t(w)));
+        break;
+      case 's':
+        len = snprintf(out + n, cap - n, spec, w ? reinterpret_cast<const char*>(w) : "(null)");
+        break;
+      case 'p':
+        len = snprintf(out + n, cap - n, spec, reinterpret_cast<void*>(w));
+        break;
+      default:
+        len = snprintf(out + n, cap - n, spec, double(wordToFloat(w)));
+        break;
+    }
+    if (len > 0) n += size_t(len) < cap - 1 - n ? size_t(len) : cap - 1 - n;
+  }
+  out[n] = '\0';
+  return n;
+}
+
+// ================= OUTPUT =================
+#ifdef DLOG_BINARY
+void emit(const Record& r) {
+  Site& site = *r.site;
+  if (!site.id) {   // første gang: send formatet, så host kan slå id op
+    site.id = g_nextId++;
+    uint8_t def[255];
+    size_t len = strlen(site.fmt);
+    if (len > sizeof(def) - 2) len = sizeof(def) - 2;
+    put16(def, site.id);
+    memcpy(def + 2, site.fmt, len);
+    frame('F', def, 2 + len);
+  }
+  uint8_t rec[255];
+  put16(rec, site.id);
+  put32(rec + 2, r.tsUs);
+  size_t n = 6;
+  size_t arg = 0;
+  forEachConversion(site.fmt, [&](char conv) {
+    if (arg >= r.argc) return;
+    Word w = r.args[arg++];
+    if (conv == 's') {   // strengen sendes med, host kender ikke adressen
+      const char* str = w ? reinterpret_cast<const char*>(w) : "(null)";
+      size_t len = strlen(str);
+      size_t room = sizeof(rec) - n - 1;
+      if (len > room) len = room;
+      rec[n++] = uint8_t(len);
+      memcpy(rec + n, str, len);
+      n += len;
+    } else if (n + 4 <= sizeof(rec)) {
+      put32(rec + n, uint32_t(w));
+      n += 4;
+    }
+  });
+  frame('L', rec, n);
+}
+#else
+void emit(const Record& r) {
+  char line[192];
+  size_t n = format(r.site->fmt, r.args, r.argc, line, sizeof(line) - 1);
+  line[n++] = '\n';
+  write(reinterpret_cast<const uint8_t*>(line), n);
+}
+#endif
+
+// ================= DRAIN-TASK =================
+#ifdef ARDUINO
+static void emitDropped(uint32_t count) {
+#ifdef DLOG_BINARY
+  uint8_t payload[4];
+  put32(payload, count);
+  frame('X', payload, sizeof(payload));
+#else
+  char line[48];
+  int n = snprintf(line, sizeof(line), "[dlog] %u linjer tabt\n", unsigned(count));
+  if (n > 0) write(reinterpret_cast<const uint8_t*>(line), size_t(n));
+#endif
+}
+
+static void drainTask(void*) {
+  for (;;) {
+    bool any = false;
+    Record r;
+    while (g_ring.pop(r)) {
+      emit(r);
+      any = true;
+    }
+    uint32_t lost = g_ring.takeDropped();
+    if (lost) emitDropped(lost);
+    if (!any) vTaskDelay(pdMS_TO_TICKS(g_idleMs));
+  }
+}
+
+void begin(uint8_t priority, uint32_t idleMs) {
+  if (started()) return;
+  g_idleMs = idleMs ? idleMs : 1;
+  xTaskCreate(drainTask, "dlog", 4096, nullptr, priority, nullptr);   // snprintf med float bruger en del stak
+  g_started.store(true, std::memory_order_release);
+}
+#endif
+
+}  // namespace dlog
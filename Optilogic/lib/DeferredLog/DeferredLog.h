@@ -0,0 +1,202 @@
+#pragma once
+// Udskudt logning: printf-agtige linjer uden Serial på den varme sti
+//
+// DLOG("Modbus: %s svarer igen", id) formaterer ikke noget. Den gemmer en
+// pointer til logstedet (formatstrengen), et tidsstempel og de rå argumenter
+// som maskinord i en låsefri ring. En lavprioritets-task tømmer ringen og
+// står for formatering og UART; når TX-bufferen er fuld, er det den task der
+// venter, ikke poll-løkken. Prisen for kalderen er konstant: én CAS og en
+// håndfuld stores, uanset formatstreng og baudrate.
+//
+// Ringen er en begrænset MPSC-kø (én sekvenstæller pr. plads, Vyukov), så
+// loop, webserver og andre tasks kan logge samtidig. Er ringen fuld, tabes
+// linjen og tælles; drain-tasken skriver antallet når der er plads igen.
+//
+// Regler for argumenter (tjekkes så vidt muligt af compileren):
+//   - heltal højst et maskinord (32 bit på ESP32), bool, float/double (gemmes som float)
+//   - %s kun til strenge der lever mindst til linjen er skrevet: literals,
+//     profilnavne, deviceId. Ikke String::c_str() eller stak-buffere.
+//   - højst MAX_ARGS argumenter; længdemodifikatorer (l, h, z) ignoreres
+//
+// Før begin() skrives linjerne straks (synkront), så rækkefølgen under
+// opstart er den samme som med direkte Serial-kald.
+//
+// Output: tekst som før, eller med -DDLOG_BINARY kompakte binære frames
+// (format sendes én gang pr. logsted) som dlog_decode.cpp formaterer på host.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <type_traits>
+
+#ifndef DLOG_RING_SIZE
+#define DLOG_RING_SIZE 128   // poster á 40 bytes på ESP32; skal være en potens af 2
+#endif
+
+namespace dlog {
+
+typedef uintptr_t Word;   // ét argument: heltal, float-bits eller pointer
+static const size_t MAX_ARGS = 6;
+
+// Ét DLOG-kald i kildekoden; id tildeles af drain-tasken (binær mode)
+struct Site {
+  const char* fmt;
+  uint16_t    id;
+};
+
+struct Record {
+  Site*       site;
+  uint32_t    tsUs;
+  uint8_t     argc;
+  Word        args[MAX_ARGS];
+};
+
+// ================= ARGUMENTER =================
+template <class T>
+inline Word toWord(T v) {
+  static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "DLOG: ukendt argumenttype");
+  static_assert(sizeof(T) <= sizeof(Word), "DLOG: 64-bit heltal passer ikke i et argument");
+  return Word(v);
+}
+inline Word toWord(double v) {
+  float f = float(v);
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  return Word(bits);
+}
+inline Word toWord(float v) { return toWord(double(v)); }
+inline Word toWord(const char* s) { return Word(s); }
+inline Word toWord(char* s) { return Word(s); }
+
+inline float wordToFloat(Word w) {
+  uint32_t bits = uint32_t(w);
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+// ================= RING =================
+template <size_t N>
+class Ring {
+public:
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "ringens størrelse skal være en potens af 2");
+
+  Ring() {
+    for (size_t i = 0; i < N; i++) cells_[i].seq.store(uint32_t(i), std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Reserverer en plads og kopierer posten ind; false hvis ringen er fuld
+   *
+   * Må kaldes fra flere tasks samtidig.
+   */
+  bool push(const Record& r) {
+    uint32_t pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& c = cells_[pos & (N - 1)];
+      int32_t diff = int32_t(c.seq.load(std::memory_order_acquire) - pos);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          c.rec = r;
+          c.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * @brief Henter ældste færdigskrevne post; kun fra én task (drain)
+   */
+  bool pop(Record& out) {
+    Cell& c = cells_[tail_ & (N - 1)];
+    if (c.seq.load(std::memory_order_acquire) != tail_ + 1) return false;
+    out = c.rec;
+    c.seq.store(tail_ + uint32_t(N), std::memory_order_release);
+    tail_++;
+    return true;
+  }
+
+  // Tabte poster siden sidst (nulstilles)
+  uint32_t takeDropped() { return dropped_.exchange(0, std::memory_order_relaxed); }
+
+private:
+  struct Cell {
+    std::atomic<uint32_t> seq;
+    Record                rec;
+  };
+
+  Cell                  cells_[N];
+  std::atomic<uint32_t> head_{0};
+  uint32_t              tail_ = 0;
+  std::atomic<uint32_t> dropped_{0};
+};
+
+// ================= FORMATERING =================
+/**
+ * @brief Formaterer en post som printf ville have gjort
+ * @return længden uden '\0' (afkortes til cap - 1)
+ */
+size_t format(const char* fmt, const Word* args, size_t argc, char* out, size_t cap);
+
+// Kaldes for hvert formatspecifikation i rækkefølge; conv er konverteringstegnet
+template <class Fn>
+void forEachConversion(const char* fmt, Fn&& fn) {
+  for (const char* p = fmt; *p; p++) {
+    if (*p != '%') continue;
+    if (p[1] == '%') {
+      p++;
+      continue;
+    }
+    const char* q = p + 1;
+    while (*q && !strchr("diuxXocsfFeEgGp", *q)) q++;
+    if (!*q) return;
+    fn(*q);
+    p = q;
+  }
+}
+
+// ================= GLOBAL LOG =================
+typedef Ring<DLOG_RING_SIZE> LogRing;
+LogRing& ring();
+
+uint32_t nowUs();   // micros() på ESP32
+bool started();
+
+// Skriver posten straks (før begin(), og fra drain-tasken)
+void emit(const Record& r);
+
+template <class... A>
+inline void log(Site& site, A... a) {
+  static_assert(sizeof...(A) <= MAX_ARGS, "DLOG: for mange argumenter");
+  Record r;
+  r.site = &site;
+  r.tsUs = nowUs();
+  r.argc = uint8_t(sizeof...(A));
+  Word words[] = {toWord(a)..., 0};
+  for (size_t i = 0; i < sizeof...(A); i++) r.args[i] = words[i];
+  if (started()) ring().push(r);
+  else emit(r);
+}
+
+#ifdef ARDUINO
+/**
+ * @brief Starter drain-tasken; indtil da skrives linjerne synkront
+ */
+void begin(uint8_t priority = 1, uint32_t idleMs = 10);
+#endif
+
+}  // namespace dlog
+
+#define DLOG(fmt, ...)                                 \
+  do {                                                 \
+    static dlog::Site dlogSite_{fmt, 0};               \
+    dlog::log(dlogSite_, ##__VA_ARGS__);               \
+  } while (0)
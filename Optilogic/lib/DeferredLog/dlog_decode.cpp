@@ -0,0 +1,111 @@
+// Host-dekoder til DeferredLog i binær mode (-DDLOG_BINARY)
+//
+// Læser den rå seriel-strøm, slår formatstrenge op efter id og formaterer
+// linjerne med samme kode som firmwaren (dlog::format). Bytes uden for en
+// frame (boot-tekst, direkte Serial.printf) skrives uændret igennem.
+//
+// Frames: 0xD7, type, længde, payload
+//   'F'  id(2) + formatstreng                – sendes første gang et logsted bruges
+//   'L'  id(2) + tid µs(4) + argumenter      – %s som længde(1) + bytes, resten 4 bytes LE
+//   'X'  antal(4)                            – linjer tabt fordi ringen var fuld
+//
+// Byg: g++ -std=c++17 -O2 -I. dlog_decode.cpp DeferredLog.cpp -o dlog_decode
+// Kør: pio device monitor --raw | ./dlog_decode      eller  ./dlog_decode capture.bin
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "DeferredLog.h"
+
+static const int FRAME_MAGIC = 0xD7;
+
+static std::map<uint16_t, std::string> formats;
+
+static uint16_t get16(const uint8_t* p) { return uint16_t(p[0] | (p[1] << 8)); }
+static uint32_t get32(const uint8_t* p) { return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24; }
+
+static void printLine(const uint8_t* p, size_t len) {
+  if (len < 6) return;
+  uint16_t id = get16(p);
+  uint32_t tsUs = get32(p + 2);
+  auto it = formats.find(id);
+  if (it == formats.end()) {   // startede midt i strømmen: formatet er ikke set
+    printf("[%5u.%06u] <ukendt logsted %u>\n", unsigned(tsUs / 1000000), unsigned(tsUs % 1000000), unsigned(id));
+    return;
+  }
+  const char* fmt = it->second.c_str();
+
+  std::vector<std::string> strings;   // ejer %s-argumenterne mens linjen formateres
+  strings.reserve(dlog::MAX_ARGS);
+  dlog::Word args[dlog::MAX_ARGS];
+  size_t argc = 0;
+  size_t n = 6;
+  bool ok = true;
+  dlog::forEachConversion(fmt, [&](char conv) {
+    if (!ok || argc >= dlog::MAX_ARGS || n >= len) return;
+    if (conv == 's') {
+      size_t sl = p[n++];
+      if (n + sl > len) { ok = false; return; }
+      strings.emplace_back(reinterpret_cast<const char*>(p + n), sl);
+      args[argc++] = dlog::toWord(strings.back().c_str());
+      n += sl;
+    } else {
+      if (n + 4 > len) { ok = false; return; }
+      args[argc++] = dlog::Word(get32(p + n));
+      n += 4;
+    }
+  });
+
+  char line[512];
+  dlog::format(fmt, args, argc, line, sizeof(line));
+  printf("[%5u.%06u] %s%s\n", unsigned(tsUs / 1000000), unsigned(tsUs % 1000000), line, ok ? "" : " <afkortet>");
+}
+
+static void handleFrame(int type, const uint8_t* p, size_t len) {
+  switch (type) {
+    case 'F':
+      if (len >= 2) formats[get16(p)] = std::string(reinterpret_cast<const char*>(p + 2), len - 2);
+      break;
+    case 'L':
+      printLine(p, len);
+      break;
+    case 'X':
+      if (len >= 4) printf("[dlog] %u linjer tabt\n", unsigned(get32(p)));
+      break;
+    default:   // ikke en frame alligevel; skriv bytes som tekst
+      putchar(FRAME_MAGIC);
+      putchar(type);
+      fwrite(p, 1, len, stdout);
+      break;
+  }
+}
+
+int main(int argc, char** argv) {
+  FILE* in = argc > 1 ? fopen(argv[1], "rb") : stdin;
+  if (!in) {
+    perror(argv[1]);
+    return 1;
+  }
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+
+  int c;
+  uint8_t payload[255];
+  while ((c = fgetc(in)) != EOF) {
+    if (c != FRAME_MAGIC) {
+      putchar(c);
+      continue;
+    }
+    int type = fgetc(in);
+    int len = fgetc(in);
+    if (type == EOF || len == EOF) break;
+    size_t got = fread(payload, 1, size_t(len), in);
+    if (got < size_t(len)) break;   // strømmen sluttede midt i en frame
+    handleFrame(type, payload, got);
+  }
+  if (in != stdin) fclose(in);
+  return 0;
+}
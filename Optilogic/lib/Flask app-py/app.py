@@ -74,7 +74,7 @@ def dashboard():
     labels = [datetime.fromisoformat(row.get("timestamp")).strftime("%d-%m-%Y %H:%M") for row in data]
     values = [row.get("temperature") for row in data]
 
-    return render_template("dashboard.html", data=data, user=session["user"])
+    return render_template("dashboard.html", data=data, user=session["user"], esp32_url=ESP32_IP)
 
 # -----------------------
 # LOGOUT
@@ -138,6 +138,22 @@ def sensor_data():
         return jsonify({"error": str(e)}), 500
 
 
+# -----------------------
+# LIVE DATA – direkte fra ESP32'ens RAM-ring (ingen QuestDB-forespørgsel)
+# -----------------------
+@app.route("/live-data")
+def live_data():
+    if "user" not in session:
+        return jsonify({"error": "unauthorized"}), 401
+    params = {"last": request.args.get("last", 100)}
+    try:
+        r = requests.get(f"{ESP32_IP}/api/samples", params=params, timeout=2)
+        r.raise_for_status()
+        return jsonify(r.json())
+    except Exception as e:
+        return jsonify({"error": str(e)}), 502
+
+
 # -----------------------
 # HEALTH DASHBOARD
 # -----------------------
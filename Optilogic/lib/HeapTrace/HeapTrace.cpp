@@ -0,0 +1,199 @@
+#ifdef HEAP_TRACE
+
+#include "HeapTrace.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+
+#if defined(ESP_PLATFORM) || defined(ARDUINO)
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#define HEAP_TRACE_ESP 1
+static size_t blockSize(void* p) { return p ? heap_caps_get_allocated_size(p) : 0; }
+#else
+#include <malloc.h>
+static size_t blockSize(void* p) { return p ? malloc_usable_size(p) : 0; }
+#endif
+
+namespace heaptrace {
+
+namespace {
+
+struct Site {
+  std::atomic<uintptr_t> key{0};     // label-pointer eller pc; 0 = ledig
+  std::atomic<bool>      isLabel{false};
+  std::atomic<uint32_t>  allocs{0};
+  std::atomic<uint64_t>  bytes{0};
+};
+
+Site sites[MAX_SITES];
+std::atomic<uint32_t> allocCount{0}, freeCount{0}, failedCount{0}, droppedCount{0};
+std::atomic<int64_t>  liveBytes{0}, peakBytes{0};
+
+thread_local const char* currentLabel = nullptr;
+
+// Åben adressering; et site indsættes med CAS og flyttes aldrig
+Site* lookup(uintptr_t key, bool isLabel) {
+  size_t h = size_t((key >> 2) * 2654435761u) % MAX_SITES;
+  for (size_t i = 0; i < MAX_SITES; i++) {
+    Site& s = sites[(h + i) % MAX_SITES];
+    uintptr_t k = s.key.load(std::memory_order_acquire);
+    if (k == key) return &s;
+    if (k == 0) {
+      uintptr_t expected = 0;
+      if (s.key.compare_exchange_strong(expected, key, std::memory_order_acq_rel)) {
+        s.isLabel.store(isLabel, std::memory_order_relaxed);
+        return &s;
+      }
+      if (expected == key) return &s;   // en anden task indsatte samme key
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+void onAlloc(uintptr_t pc, size_t requested, size_t block, bool ok) {
+  if (!ok) {
+    failedCount.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  allocCount.fetch_add(1, std::memory_order_relaxed);
+  int64_t live = liveBytes.fetch_add(int64_t(block), std::memory_order_relaxed) + int64_t(block);
+  int64_t peak = peakBytes.load(std::memory_order_relaxed);
+  while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+
+  const char* label = currentLabel;
+  Site* s = lookup(label ? uintptr_t(label) : pc, label != nullptr);
+  if (!s) {
+    droppedCount.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  s->allocs.fetch_add(1, std::memory_order_relaxed);
+  s->bytes.fetch_add(requested, std::memory_order_relaxed);
+}
+
+void onFree(size_t block) {
+  freeCount.fetch_add(1, std::memory_order_relaxed);
+  liveBytes.fetch_sub(int64_t(block), std::memory_order_relaxed);
+}
+
+size_t snapshot(SiteStats* out, size_t max) {
+  size_t n = 0;
+  for (Site& s : sites) {
+    uintptr_t key = s.key.load(std::memory_order_acquire);
+    if (!key) continue;
+    SiteStats st;
+    bool isLabel = s.isLabel.load(std::memory_order_relaxed);
+    st.pc = isLabel ? 0 : key;
+    st.label = isLabel ? reinterpret_cast<const char*>(key) : nullptr;
+    st.allocs = s.allocs.load(std::memory_order_relaxed);
+    st.bytes = s.bytes.load(std::memory_order_relaxed);
+    // indsættelsessortering i out, største bytes først; kun de max største beholdes
+    size_t i = n < max ? n++ : max;
+    while (i > 0 && out[i - 1].bytes < st.bytes) {
+      if (i < max) out[i] = out[i - 1];
+      i--;
+    }
+    if (i < max) out[i] = st;
+  }
+  return n;
+}
+
+Totals totals() {
+  Totals t;
+  t.allocs = allocCount.load(std::memory_order_relaxed);
+  t.frees = freeCount.load(std::memory_order_relaxed);
+  t.failed = failedCount.load(std::memory_order_relaxed);
+  t.dropped = droppedCount.load(std::memory_order_relaxed);
+  t.liveBytes = liveBytes.load(std::memory_order_relaxed);
+  t.peakBytes = peakBytes.load(std::memory_order_relaxed);
+  return t;
+}
+
+// Nulstiller tællerne; sites og levende bytes bevares
+void reset() {
+  for (Site& s : sites) {
+    s.allocs.store(0, std::memory_order_relaxed);
+    s.bytes.store(0, std::memory_order_relaxed);
+  }
+  allocCount.store(0);
+  freeCount.store(0);
+  failedCount.store(0);
+  droppedCount.store(0);
+  peakBytes.store(liveBytes.load());
+}
+
+#ifdef HEAP_TRACE_ESP
+HeapStats heapStats() {
+  HeapStats h;
+  h.freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  h.largestFree = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  h.minFree = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+  return h;
+}
+
+int32_t stackHighWater(const char* task) {
+  TaskHandle_t t = xTaskGetHandle(task);
+  if (!t) return -1;
+  return int32_t(uxTaskGetStackHighWaterMark(t));   // bytes på ESP32 (StackType_t = uint8_t)
+}
+#else
+HeapStats heapStats() { return HeapStats{}; }   // host: brug totals() i stedet
+
+int32_t stackHighWater(const char*) { return -1; }
+#endif
+
+Scope::Scope(const char* label) : prev_(currentLabel) { currentLabel = label; }
+Scope::~Scope() { currentLabel = prev_; }
+
+}  // namespace heaptrace
+
+// ================= WRAPPERE (-Wl,--wrap=...) =================
+extern "C" {
+void* __real_malloc(size_t n);
+void* __real_calloc(size_t count, size_t n);
+void* __real_realloc(void* p, size_t n);
+void  __real_free(void* p);
+
+#define CALLER_PC uintptr_t(__builtin_return_address(0))
+
+void* __wrap_malloc(size_t n) {
+  void* p = __real_malloc(n);
+  heaptrace::onAlloc(CALLER_PC, n, blockSize(p), p != nullptr);
+  return p;
+}
+
+void* __wrap_calloc(size_t count, size_t n) {
+  void* p = __real_calloc(count, n);
+  heaptrace::onAlloc(CALLER_PC, count * n, blockSize(p), p != nullptr);
+  return p;
+}
+
+// realloc tælles som free af den gamle blok + allokering af den nye
+void* __wrap_realloc(void* old, size_t n) {
+  size_t oldBlock = blockSize(old);
+  void* p = __real_realloc(old, n);
+  if (n == 0 && old) {   // virker som free
+    heaptrace::onFree(oldBlock);
+    return p;
+  }
+  if (!p) {
+    heaptrace::onAlloc(CALLER_PC, n, 0, false);
+    return p;
+  }
+  if (old) heaptrace::onFree(oldBlock);
+  heaptrace::onAlloc(CALLER_PC, n, blockSize(p), true);
+  return p;
+}
+
+void __wrap_free(void* p) {
+  if (!p) return;
+  heaptrace::onFree(blockSize(p));
+  __real_free(p);
+}
+}
+
+#endif  // HEAP_TRACE
@@ -0,0 +1,91 @@
+#pragma once
+// Opt-in heap-instrumentering: hvem allokerer, hvor meget og hvor tit
+//
+// Slås til med -DHEAP_TRACE og linker-wrapping af allokeringsfunktionerne:
+//   -DHEAP_TRACE -Wl,--wrap=malloc -Wl,--wrap=free -Wl,--wrap=calloc -Wl,--wrap=realloc
+// Uden HEAP_TRACE er HEAP_TRACE_SCOPE tom og intet wrappes.
+//
+// Hver allokering henføres til et "site": den inderste HEAP_TRACE_SCOPE på
+// den aktuelle task, ellers kalderens adresse (return address). Adresser
+// slås op med addr2line -e .pio/build/<env>/firmware.elf 0x400d1234.
+// Tabellen er lock-free (atomics), så wrapperne kan kaldes fra alle tasks
+// og selv allokerer aldrig.
+//
+// Per-site tælles antal og bytes (akkumuleret), dvs. allokerings-hot spots.
+// Levende bytes følges kun samlet, ud fra blokstørrelsen ved free().
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace heaptrace {
+
+static const size_t MAX_SITES = 64;
+
+struct SiteStats {
+  uintptr_t   pc;      // 0 hvis sitet er et scope
+  const char* label;   // nullptr hvis sitet er en adresse
+  uint32_t    allocs;
+  uint64_t    bytes;   // forespurgte bytes i alt
+};
+
+struct Totals {
+  uint32_t allocs;
+  uint32_t frees;
+  uint32_t failed;     // malloc returnerede NULL
+  uint32_t dropped;    // allokeringer uden plads i site-tabellen
+  int64_t  liveBytes;  // blokstørrelser i brug (inkl. allokatorens afrunding)
+  int64_t  peakBytes;
+};
+
+// Allokatorens tilstand (ESP32: 8-bit heap; host: kun det der spores)
+struct HeapStats {
+  uint32_t freeBytes;
+  uint32_t largestFree;   // største sammenhængende blok; lav i forhold til free = fragmentering
+  uint32_t minFree;       // laveste free siden boot
+};
+
+#ifdef HEAP_TRACE
+
+HeapStats heapStats();
+
+/**
+ * @brief Stakkens high-water mark (ubrugte bytes) for en navngiven task
+ * @return -1 hvis tasken ikke findes (eller på host)
+ */
+int32_t stackHighWater(const char* task);
+
+// Kaldes af wrapperne
+void onAlloc(uintptr_t pc, size_t requested, size_t blockSize, bool ok);
+void onFree(size_t blockSize);
+
+/**
+ * @brief Kopierer sites sorteret efter bytes (største først)
+ * @return antal sites i out
+ */
+size_t snapshot(SiteStats* out, size_t max);
+Totals totals();
+void reset();
+
+// Inderste scope på denne task; allokeringer i scopet henføres til label
+class Scope {
+public:
+  explicit Scope(const char* label);
+  ~Scope();
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+private:
+  const char* prev_;
+};
+
+#define HEAP_TRACE_CONCAT2(a, b) a##b
+#define HEAP_TRACE_CONCAT(a, b) HEAP_TRACE_CONCAT2(a, b)
+#define HEAP_TRACE_SCOPE(label) heaptrace::Scope HEAP_TRACE_CONCAT(heapTraceScope_, __LINE__)(label)
+
+#else
+
+#define HEAP_TRACE_SCOPE(label) ((void)0)
+
+#endif
+
+}  // namespace heaptrace
@@ -0,0 +1,147 @@
+// Host-simulering af poll-løkken med heap-sporing (samme HeapTrace som på ESP32)
+//
+// Kører de samme trin som firmwaren (payload, aggregat, RAM-ring) plus de gamle
+// varianter (String-sammensætning, DOM pr. publish) N gange og viser
+// allokeringer pr. iteration pr. trin. Trinene på firmwarens sti skal være
+// allokeringsfri; ellers afsluttes med exit-kode 1, så en regression fanges
+// før den når en enhed.
+//
+// Byg:  g++ -std=c++17 -O2 -DHEAP_TRACE -I. -I../SampleSerializer -I../SparkplugB
+//         -I../WindowAggregator -I../SampleRing heaptrace_sim.cpp HeapTrace.cpp
+//         -static-libstdc++ -Wl,--wrap=malloc,--wrap=free,--wrap=calloc,--wrap=realloc -o heaptrace_sim
+//       (-static-libstdc++ så operator new også går gennem wrapperne, som på ESP32)
+// Kør:  ./heaptrace_sim [iterationer]
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "CborSerializer.h"
+#include "FixedPoint.h"
+#include "HeapTrace.h"
+#include "JsonStreamSerializer.h"
+#include "SampleRing.h"
+#include "SparkplugSerializer.h"
+#include "WindowAggregator.h"
+#if __has_include(<nlohmann/json.hpp>)
+#include "JsonDomSerializer.h"
+#define HAVE_NLOHMANN 1
+#endif
+
+#ifndef HEAP_TRACE
+#error "heaptrace_sim skal bygges med -DHEAP_TRACE og --wrap (se toppen af filen)"
+#endif
+
+static uint8_t payload[1024];
+static volatile size_t sink;   // hindrer at compileren fjerner arbejdet
+
+// Trin og om de er på firmwarens sti (skal være allokeringsfri)
+struct Stage {
+  const char* label;
+  bool firmwarePath;
+};
+
+static const Stage STAGES[] = {
+  {"string-concat (gammel)", false},
+#ifdef HAVE_NLOHMANN
+  {"json-dom pr. publish (gammel)", false},
+#endif
+  {"json-stream", true},
+  {"sparkplug", true},
+  {"cbor", true},
+  {"aggregat", true},
+  {"ram-ring", true},
+};
+
+// Som det gamle makeJsonPayload: én streng pr. felt
+static size_t stringConcat(Deci t, Deci p, Whole rpm) {
+  std::string s = "{\"temp\":" + std::to_string(t.toFloat()) + ",\"tryk\":" +
+                  std::to_string(p.toFloat()) + ",\"rpm\":" + std::to_string(rpm.raw) + "}";
+  memcpy(payload, s.data(), s.size());
+  return s.size();
+}
+
+static size_t serialize(SampleSerializer& ser, Deci t, Deci p, Whole rpm) {
+  MetricValue m[3] = {t.metric("temp"), p.metric("tryk"), rpm.metric("rpm")};
+  Sample s;
+  s.metrics = m;
+  s.count = 3;
+  return ser.serialize(s, payload, sizeof(payload));
+}
+
+int main(int argc, char** argv) {
+  uint32_t iterations = argc > 1 ? uint32_t(strtoul(argv[1], nullptr, 10)) : 10000;
+  if (!iterations) iterations = 1;
+
+  JsonStreamSerializer json(false);
+  SparkplugSerializer spb;
+  CborSerializer cbor;
+#ifdef HAVE_NLOHMANN
+  JsonDomSerializer dom;
+#endif
+  static WindowAggregator<3> aggregator(10000);
+  static SampleRing<480, 3> ring;
+
+  heaptrace::reset();
+  int64_t liveBefore = heaptrace::totals().liveBytes;
+
+  for (uint32_t i = 0; i < iterations; i++) {
+    uint32_t now = i * 250;   // simuleret millis() ved 250 ms poll
+    Deci t(int32_t(180 + (i * 7) % 80));
+    Deci p(int32_t(200 + (i * 13) % 150));
+    Whole rpm(int32_t(900 + (i * 31) % 600));
+    int32_t values[3] = {t.raw, p.raw, rpm.raw};
+
+    { HEAP_TRACE_SCOPE("string-concat (gammel)"); sink = stringConcat(t, p, rpm); }
+#ifdef HAVE_NLOHMANN
+    { HEAP_TRACE_SCOPE("json-dom pr. publish (gammel)"); sink = serialize(dom, t, p, rpm); }
+#endif
+    { HEAP_TRACE_SCOPE("json-stream"); sink = serialize(json, t, p, rpm); }
+    { HEAP_TRACE_SCOPE("sparkplug"); sink = serialize(spb, t, p, rpm); }
+    { HEAP_TRACE_SCOPE("cbor"); sink = serialize(cbor, t, p, rpm); }
+    {
+      HEAP_TRACE_SCOPE("aggregat");
+      if (aggregator.due(now)) {
+        WindowStats w[3];
+        aggregator.close(now, w);
+        sink = w[0].count;
+      }
+      aggregator.add(now, values);
+    }
+    { HEAP_TRACE_SCOPE("ram-ring"); ring.push(now, values); }
+  }
+
+  // snapshot/printf efter løkken, så udskriften ikke tæller med
+  heaptrace::SiteStats sites[heaptrace::MAX_SITES];
+  size_t n = heaptrace::snapshot(sites, heaptrace::MAX_SITES);
+  heaptrace::Totals tot = heaptrace::totals();
+
+  bool regression = false;
+  printf("%u iterationer\n", (unsigned)iterations);
+  printf("%-32s %12s %14s\n", "trin", "allok/iter", "bytes/iter");
+  for (const Stage& st : STAGES) {
+    uint32_t allocs = 0;
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (sites[i].label && strcmp(sites[i].label, st.label) == 0) {
+        allocs = sites[i].allocs;
+        bytes = sites[i].bytes;
+      }
+    }
+    bool bad = st.firmwarePath && allocs > 0;
+    regression |= bad;
+    printf("%-32s %12.2f %14.1f%s\n", st.label, double(allocs) / iterations,
+           double(bytes) / iterations, bad ? "  <-- REGRESSION: firmware-sti allokerer" : "");
+  }
+  for (size_t i = 0; i < n; i++) {   // allokeringer udenfor et scope (bør ikke ske her)
+    if (!sites[i].label && sites[i].allocs) {
+      printf("pc 0x%" PRIxPTR "                   %8u allok %10" PRIu64 " bytes\n", sites[i].pc,
+             (unsigned)sites[i].allocs, sites[i].bytes);
+    }
+  }
+  printf("i alt: %u allok, %u free, peak %" PRId64 " bytes, lækket %" PRId64 " bytes\n",
+         (unsigned)tot.allocs, (unsigned)tot.frees, tot.peakBytes, tot.liveBytes - liveBefore);
+  return regression ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+#pragma once
+// Binært format for historik-loggen i flash (fælles for ESP32 og host-værktøj)
+//
+// Partitionen er en ring af sider på 4096 bytes (én flash-sektor). Hver side:
+//   PageHeader (64 bytes)  magic, sekvensnummer, tidsindeks, kanaler
+//   Record[]               uint32 dtMs + int32 værdi pr. kanal
+// Flash kan kun skrive 1 -> 0, så felter der ikke er skrevet endnu er 0xFF:
+//   - maxDt skrives når siden er fuld (forseglet); åben side har 0xFFFFFFFF
+//   - en record skrives med værdierne først og dtMs til sidst, så en record
+//     hvor dtMs stadig er 0xFFFFFFFF aldrig er gyldig (afbrudt skrivning)
+// Tidsindekset pr. side er [baseMs, baseMs + maxDt], så en intervalforespørgsel
+// kun skal kigge i sider der overlapper.
+//
+// Alle felter er little-endian (som ESP32 og x86/ARM hosts).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace history {
+
+static const uint32_t PAGE_SIZE    = 4096;
+static const uint32_t MAGIC        = 0x31474C48;  // "HLG1"
+static const uint32_t EMPTY32      = 0xFFFFFFFF;
+static const uint8_t  MAX_CHANNELS = 4;
+static const uint8_t  NAME_LEN     = 8;           // inkl. nul-terminering
+
+struct PageHeader {
+  uint32_t magic;
+  uint32_t seq;                           // stiger for hver ny side; højeste = nyeste
+  int64_t  baseMs;                        // unix-tid i ms for første record
+  uint32_t maxDt;                         // sidste records dtMs, EMPTY32 mens siden er åben
+  uint8_t  channels;                      // antal værdier pr. record
+  uint8_t  decimals[MAX_CHANNELS];        // fast-komma decimaler pr. kanal
+  uint8_t  reserved[7];
+  char     names[MAX_CHANNELS][NAME_LEN];
+};
+static_assert(sizeof(PageHeader) == 64, "PageHeader skal være 64 bytes");
+
+inline size_t recordSize(uint8_t channels) { return 4 + 4 * size_t(channels); }
+inline size_t recordsPerPage(uint8_t channels) {
+  return (PAGE_SIZE - sizeof(PageHeader)) / recordSize(channels);
+}
+
+// ================= LÆSNING =================
+// En record set gennem en side i flash/mmap; intet kopieres
+struct RecordView {
+  int64_t tsMs;
+  const PageHeader* page;
+  const uint8_t* data;   // channels * int32, ikke nødvendigvis 4-byte aligned
+
+  int32_t raw(uint8_t ch) const {
+    int32_t v;
+    memcpy(&v, data + 4 * ch, 4);
+    return v;
+  }
+  double value(uint8_t ch) const {
+    double v = raw(ch);
+    for (uint8_t i = 0; i < page->decimals[ch]; i++) v /= 10.0;
+    return v;
+  }
+};
+
+// Læser én side direkte fra en mappet adresse (spi_flash_mmap eller mmap af et image)
+class PageView {
+public:
+  explicit PageView(const uint8_t* page) : p_(page) { memcpy(&h_, page, sizeof(h_)); }
+
+  bool valid() const {
+    return h_.magic == MAGIC && h_.seq != EMPTY32 &&
+           h_.channels >= 1 && h_.channels <= MAX_CHANNELS;
+  }
+  const PageHeader& header() const { return h_; }
+  bool sealed() const { return h_.maxDt != EMPTY32; }
+  int64_t minMs() const { return h_.baseMs; }
+
+  // Forseglet side: fra headeren. Åben side: sidste gyldige record.
+  int64_t maxMs() const {
+    if (sealed()) return h_.baseMs + h_.maxDt;
+    uint32_t last = 0;
+    forEachDt([&](uint32_t dt, const uint8_t*) { last = dt; });
+    return h_.baseMs + last;
+  }
+
+  // Antal brugte pladser (inkl. afbrudte records); første ledige plads
+  size_t used() const {
+    size_t n = 0, rs = recordSize(h_.channels), max = recordsPerPage(h_.channels);
+    const uint8_t* r = p_ + sizeof(PageHeader);
+    while (n < max && !erased(r + n * rs, rs)) n++;
+    return n;
+  }
+
+  /**
+   * @brief Kalder fn(RecordView) for gyldige records i [fromMs, toMs]
+   * @return antal records der blev leveret
+   */
+  template <class Fn>
+  size_t forEach(int64_t fromMs, int64_t toMs, Fn&& fn) const {
+    size_t n = 0;
+    forEachDt([&](uint32_t dt, const uint8_t* values) {
+      int64_t ts = h_.baseMs + dt;
+      if (ts < fromMs || ts > toMs) return;
+      RecordView rv{ts, &h_, values};
+      fn(rv);
+      n++;
+    });
+    return n;
+  }
+
+  /**
+   * @brief Som forEach(), men fra plads first, og fn returnerer false for at stoppe
+   *
+   * Bruges når et svar streames i bidder: recorden fn afviste leveres igen
+   * ved næste kald fra den returnerede plads.
+   * @return pladsen der skal fortsættes fra, eller recordsPerPage() når siden er læst
+   */
+  template <class Fn>
+  size_t resume(size_t first, int64_t fromMs, int64_t toMs, Fn&& fn) const {
+    return walk(first, [&](uint32_t dt, const uint8_t* values) {
+      int64_t ts = h_.baseMs + dt;
+      if (ts < fromMs || ts > toMs) return true;
+      RecordView rv{ts, &h_, values};
+      return bool(fn(rv));
+    });
+  }
+
+private:
+  static bool erased(const uint8_t* p, size_t n) {
+    for (size_t i = 0; i < n; i++) if (p[i] != 0xFF) return false;
+    return true;
+  }
+
+  template <class Fn>
+  void forEachDt(Fn&& fn) const {
+    walk(0, [&](uint32_t dt, const uint8_t* values) { fn(dt, values); return true; });
+  }
+
+  // fn(dtMs, værdier) for gyldige records fra plads first; false stopper ved pladsen
+  template <class Fn>
+  size_t walk(size_t first, Fn&& fn) const {
+    size_t rs = recordSize(h_.channels), max = recordsPerPage(h_.channels);
+    const uint8_t* r = p_ + sizeof(PageHeader) + first * rs;
+    for (size_t i = first; i < max; i++, r += rs) {
+      uint32_t dt;
+      memcpy(&dt, r, 4);
+      if (dt == EMPTY32) {
+        if (erased(r, rs)) break;   // slutningen af skrevne records
+        continue;                   // afbrudt skrivning, spring over
+      }
+      if (!fn(dt, r + 4)) return i;
+    }
+    return max;
+  }
+
+  const uint8_t* p_;
+  PageHeader h_;
+};
+
+}  // namespace history
@@ -0,0 +1,224 @@
+#include "HistoryLog.h"
+
+#include <stddef.h>
+#include <string.h>
+
+using namespace history;
+
+static const uint32_t MMU_BLOCK = SPI_FLASH_MMU_PAGE_SIZE;   // 64 kB, mmap-granularitet
+
+HistoryLog::~HistoryLog() {
+  unmap();
+  delete[] index_;
+}
+
+// ================= OPSTART =================
+bool HistoryLog::begin(const char* label) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  part_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  if (!part_ || part_->size < 2 * PAGE_SIZE || part_->address % MMU_BLOCK != 0) {
+    part_ = nullptr;
+    return false;
+  }
+  pageCount_ = part_->size / PAGE_SIZE;
+  spare_ = -1;
+  delete[] index_;
+  index_ = new PageIndex[pageCount_];
+
+  // kun headers læses (64 bytes pr. side); head = side med højeste seq
+  uint32_t headSeq = 0;
+  head_ = -1;
+  for (uint32_t i = 0; i < pageCount_; i++) {
+    PageHeader h;
+    PageIndex& ix = index_[i];
+    ix.seq = EMPTY32;
+    if (esp_partition_read(part_, i * PAGE_SIZE, &h, sizeof(h)) != ESP_OK) continue;
+    if (h.magic != MAGIC || h.seq == EMPTY32 || h.channels < 1 || h.channels > MAX_CHANNELS) continue;
+    ix.seq = h.seq;
+    ix.baseMs = h.baseMs;
+    ix.maxDt = h.maxDt == EMPTY32 ? 0 : h.maxDt;
+    if (head_ < 0 || h.seq > headSeq) {
+      head_ = int32_t(i);
+      headSeq = h.seq;
+    }
+  }
+
+  // den åbne side: find første ledige plads og sidste tidsstempel
+  if (head_ >= 0) {
+    const uint8_t* page = mapPage(uint32_t(head_));
+    if (page) {
+      PageView v(page);
+      layout_ = v.header();
+      headUsed_ = uint32_t(v.used());
+      headSealed_ = v.sealed() || headUsed_ >= recordsPerPage(layout_.channels);
+      index_[head_].maxDt = uint32_t(v.maxMs() - v.minMs());
+    } else {
+      headSealed_ = true;   // kan ikke læses: start forfra på næste side
+    }
+    unmap();
+  }
+  return true;
+}
+
+void HistoryLog::setChannels(uint8_t count, const char* const* names, const uint8_t* decimals) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (count < 1) count = 1;
+  if (count > MAX_CHANNELS) count = MAX_CHANNELS;
+  PageHeader l = {};
+  l.channels = count;
+  for (uint8_t i = 0; i < count; i++) {
+    l.decimals[i] = decimals[i];
+    strncpy(l.names[i], names[i], NAME_LEN - 1);
+  }
+  if (memcmp(l.decimals, layout_.decimals, sizeof(l.decimals)) != 0 ||
+      memcmp(l.names, layout_.names, sizeof(l.names)) != 0 || l.channels != layout_.channels) {
+    layout_ = l;
+    layoutChanged_ = true;
+  }
+}
+
+// ================= SKRIVNING =================
+bool HistoryLog::append(int64_t tsMs, const int32_t* values) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (!part_ || layout_.channels == 0) return false;
+
+  bool newPage = head_ < 0 || headSealed_ || layoutChanged_;
+  if (!newPage) {
+    int64_t dt = tsMs - index_[head_].baseMs;
+    newPage = dt < int64_t(index_[head_].maxDt) || dt >= int64_t(EMPTY32);   // tiden gik baglæns / for langt
+  }
+  if (newPage) {
+    if (head_ >= 0 && !headSealed_ && !sealHead()) return false;
+    if (!startPage(tsMs)) return false;
+  }
+
+  uint32_t dt = uint32_t(tsMs - index_[head_].baseMs);
+  size_t rs = recordSize(layout_.channels);
+  size_t off = size_t(head_) * PAGE_SIZE + sizeof(PageHeader) + headUsed_ * rs;
+  headUsed_++;   // pladsen er brugt, også hvis skrivningen fejler halvvejs
+
+  // værdier først, dtMs sidst: først da er recorden gyldig
+  if (esp_partition_write(part_, off + 4, values, 4 * size_t(layout_.channels)) != ESP_OK) return false;
+  if (esp_partition_write(part_, off, &dt, 4) != ESP_OK) return false;
+  index_[head_].maxDt = dt;
+
+  if (headUsed_ >= recordsPerPage(layout_.channels)) sealHead();
+  return true;
+}
+
+// Skriver maxDt i headeren (0xFF -> værdi, ingen sletning nødvendig)
+bool HistoryLog::sealHead() {
+  headSealed_ = true;
+  if (headUsed_ == 0) return true;   // tom side: maxDt kan udledes (= base)
+  uint32_t maxDt = index_[head_].maxDt;
+  return esp_partition_write(part_, size_t(head_) * PAGE_SIZE + offsetof(PageHeader, maxDt),
+                             &maxDt, sizeof(maxDt)) == ESP_OK;
+}
+
+bool HistoryLog::startPage(int64_t tsMs) {
+  uint32_t seq = head_ < 0 ? 0 : index_[head_].seq + 1;
+  uint32_t next = nextPage();
+
+  if (spare_ == int32_t(next)) {
+    spare_ = -1;   // slettet på forhånd af prepare()
+  } else {
+    // prepare() er midt i at slette siden: denne record går tabt, næste venter ikke
+    if (erasing_ == int32_t(next)) return false;
+    // ældste side overskrives; indekset markeres tomt før sletningen
+    index_[next].seq = EMPTY32;
+    if (esp_partition_erase_range(part_, size_t(next) * PAGE_SIZE, PAGE_SIZE) != ESP_OK) return false;
+  }
+
+  PageHeader h = layout_;
+  h.magic = MAGIC;
+  h.seq = seq;
+  h.baseMs = tsMs;
+  h.maxDt = EMPTY32;
+  memset(h.reserved, 0xFF, sizeof(h.reserved));
+  if (esp_partition_write(part_, size_t(next) * PAGE_SIZE, &h, sizeof(h)) != ESP_OK) return false;
+
+  index_[next] = PageIndex{seq, 0, tsMs};
+  head_ = int32_t(next);
+  headUsed_ = 0;
+  headSealed_ = false;
+  layoutChanged_ = false;
+  return true;
+}
+
+// ================= RESERVESIDE =================
+// Sletningen sker uden lås, så append() og query() ikke venter på den;
+// siden er markeret tom i indekset og erasing_, så ingen af dem rører den.
+bool HistoryLog::prepare() {
+  uint32_t next;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!part_) return false;
+    next = nextPage();
+    if (spare_ == int32_t(next)) return true;
+    index_[next].seq = EMPTY32;   // ældste side forsvinder en side tidligere
+    erasing_ = int32_t(next);
+  }
+  bool ok = esp_partition_erase_range(part_, size_t(next) * PAGE_SIZE, PAGE_SIZE) == ESP_OK;
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  erasing_ = -1;
+  if (ok) spare_ = int32_t(next);   // head kan ikke flytte til next mens den slettes
+  return ok;
+}
+
+bool HistoryLog::spareNeeded() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return part_ && spare_ != int32_t(nextPage());
+}
+
+// ================= MMAP =================
+// spi_flash_mmap mapper i blokke á 64 kB (16 sider); samme blok genbruges
+// så længe forespørgslen bliver i den
+const uint8_t* HistoryLog::mapPage(uint32_t page) {
+  uint32_t offset = page * PAGE_SIZE;
+  int32_t block = int32_t(offset / MMU_BLOCK);
+  if (block != mappedBlock_) {
+    unmap();
+    uint32_t start = uint32_t(block) * MMU_BLOCK;
+    uint32_t len = part_->size - start < MMU_BLOCK ? part_->size - start : MMU_BLOCK;
+    const void* ptr = nullptr;
+    if (spi_flash_mmap(part_->address + start, len, SPI_FLASH_MMAP_DATA, &ptr, &mapHandle_) != ESP_OK) {
+      return nullptr;
+    }
+    mappedBase_ = static_cast<const uint8_t*>(ptr);
+    mappedBlock_ = block;
+  }
+  return mappedBase_ + (offset - uint32_t(block) * MMU_BLOCK);
+}
+
+// Mapningen frigives efter hver forespørgsel, så cachen aldrig viser
+// data fra før en senere skrivning
+void HistoryLog::unmap() {
+  if (mappedBlock_ < 0) return;
+  spi_flash_munmap(mapHandle_);
+  mappedBlock_ = -1;
+  mappedBase_ = nullptr;
+}
+
+// ================= STATUS =================
+uint32_t HistoryLog::usedPages() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < pageCount_; i++) n += index_[i].seq != EMPTY32;
+  return n;
+}
+
+int64_t HistoryLog::oldestMs() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (head_ < 0) return 0;
+  for (uint32_t k = 1; k <= pageCount_; k++) {
+    const PageIndex& ix = index_[(uint32_t(head_) + k) % pageCount_];
+    if (ix.seq != EMPTY32) return ix.baseMs;
+  }
+  return 0;
+}
+
+int64_t HistoryLog::newestMs() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return head_ < 0 ? 0 : index_[head_].baseMs + index_[head_].maxDt;
+}
@@ -0,0 +1,175 @@
+#pragma once
+// Append-only historik i en dedikeret flash-partition (ESP32)
+//
+// Samples skrives som faste records i sider á 4096 bytes (se HistoryFormat.h).
+// Siderne bruges i ring: når partitionen er fuld slettes den ældste side, så
+// alle sektorer slettes lige ofte (wear-leveling uden ekstra metadata).
+// Ved 3 kanaler er der 252 records pr. side; med 250 ms poll og en partition
+// på 1.375 MB (352 sider) rækker loggen ca. 6 timer tilbage, og hver sektor
+// slettes ca. 4 gange i døgnet (langt under flashens ~100k cyklusser).
+//
+// Læsning sker gennem spi_flash_mmap: kun sider hvis tidsindeks overlapper
+// forespørgslen mappes, og records leveres direkte fra flash uden kopi.
+//
+// Partitionen skal findes i partitions.csv (type data, label "history").
+// append() kaldes fra poll-løkken, query() fra HTTP-serverens task og
+// prepare() fra en baggrundstask; en mutex beskytter indekset og mapningen.
+// Sletningen af næste side (op til flere titals ms) sker i prepare(), så
+// append() kun skriver. Er reservesiden ikke klar, slettes inline som før.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+
+#include <mutex>
+
+#include "HistoryFormat.h"
+
+class HistoryLog {
+public:
+  // Position i en forespørgsel der læses i bidder (se query(Cursor&, fn))
+  struct Cursor {
+    int64_t  fromMs;
+    int64_t  toMs;
+    uint32_t seq = 0;      // første side (sekvensnummer) der ikke er læst færdig
+    size_t   record = 0;   // næste plads i siden seq
+    bool     done = false;
+
+    Cursor(int64_t from, int64_t to) : fromMs(from), toMs(to) {}
+  };
+
+  ~HistoryLog();
+
+  /**
+   * @brief Finder partitionen og genopbygger tidsindekset fra sidernes headers
+   *
+   * @return false hvis partitionen ikke findes (append/query gør da intet)
+   */
+  bool begin(const char* label = "history");
+
+  /**
+   * @brief Sætter kanalernes navne og decimaler
+   *
+   * Ændres opsætningen, startes en ny side ved næste append(), så hver side
+   * altid beskriver sine egne records.
+   */
+  void setChannels(uint8_t count, const char* const* names, const uint8_t* decimals);
+
+  /**
+   * @brief Tilføjer én record (værdi * 10^decimaler pr. kanal)
+   *
+   * @param tsMs unix-tid i ms; går tiden baglæns startes en ny side
+   * @return false ved flash-fejl eller hvis loggen ikke er startet
+   */
+  bool append(int64_t tsMs, const int32_t* values);
+
+  /**
+   * @brief Kalder fn(const history::RecordView&) for alle records i [fromMs, toMs]
+   *
+   * Ældste først. RecordView peger ind i mappet flash og er kun gyldig under kaldet.
+   * @return antal records
+   */
+  template <class Fn>
+  size_t query(int64_t fromMs, int64_t toMs, Fn&& fn) {
+    Cursor c(fromMs, toMs);
+    return query(c, [&](const history::RecordView& r) { fn(r); return true; });
+  }
+
+  /**
+   * @brief Fortsætter en forespørgsel fra cursoren; fn returnerer false for at stoppe
+   *
+   * Recorden fn afviste leveres igen ved næste kald, så et svar kan streames
+   * i bidder uden at holde låsen mellem dem. Sider der overskrives undervejs
+   * springes over. c.done sættes når intervallet er læst.
+   * @return antal records der blev leveret i dette kald
+   */
+  template <class Fn>
+  size_t query(Cursor& c, Fn&& fn) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    size_t n = 0;
+    if (!part_ || head_ < 0) {
+      c.done = true;
+      return 0;
+    }
+    for (uint32_t k = 1; k <= pageCount_; k++) {
+      uint32_t i = (uint32_t(head_) + k) % pageCount_;   // ældste side efter head
+      const PageIndex& ix = index_[i];
+      if (ix.seq == history::EMPTY32 || ix.seq < c.seq) continue;
+      if (ix.baseMs > c.toMs || ix.baseMs + int64_t(ix.maxDt) < c.fromMs) continue;
+      if (ix.seq != c.seq) {
+        c.seq = ix.seq;
+        c.record = 0;
+      }
+      const uint8_t* page = mapPage(i);
+      if (!page) break;
+      history::PageView v(page);
+      size_t next = v.resume(c.record, c.fromMs, c.toMs, [&](const history::RecordView& r) {
+        if (!fn(r)) return false;
+        n++;
+        return true;
+      });
+      if (next < history::recordsPerPage(v.header().channels)) {   // fn stoppede
+        c.record = next;
+        unmap();
+        return n;
+      }
+      c.seq = ix.seq + 1;
+      c.record = 0;
+    }
+    c.done = true;
+    unmap();
+    return n;
+  }
+
+  /**
+   * @brief Sletter siden efter head, så næste append() der starter en side ikke venter
+   *
+   * Kaldes fra en baggrundstask, helst lige efter et poll: sletningen stopper
+   * flash-cachen på begge kerner, og der er da længst til næste poll.
+   * @return true hvis der er en slettet reserveside klar
+   */
+  bool prepare();
+
+  // true når prepare() har noget at lave
+  bool spareNeeded() const;
+
+  // Tidsinterval der findes i loggen (0/0 hvis tom)
+  int64_t oldestMs() const;
+  int64_t newestMs() const;
+  uint32_t pageCount() const { return pageCount_; }
+  uint32_t usedPages() const;
+
+private:
+  // RAM-indeks pr. side: 16 bytes, dvs. ca. 5.6 kB for 352 sider
+  struct PageIndex {
+    uint32_t seq;      // EMPTY32 = slettet/ubrugt
+    uint32_t maxDt;    // sidste records dtMs (også for den åbne side)
+    int64_t  baseMs;
+  };
+
+  uint32_t nextPage() const { return head_ < 0 ? 0 : (uint32_t(head_) + 1) % pageCount_; }
+  bool startPage(int64_t tsMs);
+  bool sealHead();
+  const uint8_t* mapPage(uint32_t page);
+  void unmap();
+
+  const esp_partition_t* part_ = nullptr;
+  PageIndex* index_ = nullptr;
+  uint32_t pageCount_ = 0;
+  int32_t  head_ = -1;            // side der skrives i, -1 = ingen
+  uint32_t headUsed_ = 0;         // records i head-siden (inkl. afbrudte)
+  bool     headSealed_ = false;
+
+  history::PageHeader layout_ = {};   // kanal-opsætning til nye sider
+  bool layoutChanged_ = false;
+
+  spi_flash_mmap_handle_t mapHandle_ = 0;
+  const uint8_t* mappedBase_ = nullptr;
+  int32_t mappedBlock_ = -1;      // 64 kB MMU-blok der er mappet nu
+
+  int32_t spare_ = -1;            // slettet side klar til næste startPage(), -1 = ingen
+  int32_t erasing_ = -1;          // side prepare() sletter uden lås lige nu
+  mutable std::mutex mtx_;
+};
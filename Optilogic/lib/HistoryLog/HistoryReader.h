@@ -0,0 +1,96 @@
+#pragma once
+// Udlæsning af et tidsinterval fra HistoryLog i bidder (GET /api/history)
+//
+// Samme JSON som SampleRingReader, så dashboardet kan læse begge:
+//   {"synced":true,"cols":["ts","temp",...],"rows":[[ts,21.5,...],...]}
+// ts er altid unix-tid i ms (historikken logger først når uret er sat).
+// Kolonnerne er den aktuelle kanal-opsætning; hver række bruger decimalerne
+// fra sin egen side. Låsen i HistoryLog holdes kun under ét fill().
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "HistoryLog.h"
+#include "SampleSerializer.h"
+
+class HistoryReader {
+public:
+  HistoryReader(HistoryLog& log, int64_t fromMs, int64_t toMs,
+                const char* const* names, uint8_t channels)
+      : log_(log), cursor_(fromMs, toMs), names_(names), channels_(channels) {}
+
+  /**
+   * @brief Skriver næste bid af svaret i buf
+   * @return antal bytes; 0 når svaret er færdigt, eller hvis ikke engang én
+   *         række er plads i buf (se done())
+   */
+  size_t fill(uint8_t* buf, size_t cap) {
+    size_t pos = 0;
+    if (state_ == HEADER) {
+      uint8_t tmp[160];
+      ByteWriter w(tmp, sizeof(tmp));
+      header(w);
+      if (!w.ok() || w.size() > cap) return 0;
+      memcpy(buf, tmp, w.size());
+      pos = w.size();
+      state_ = ROWS;
+    }
+    if (state_ == ROWS) {
+      log_.query(cursor_, [&](const history::RecordView& r) {
+        uint8_t tmp[24 + 12 * history::MAX_CHANNELS];
+        ByteWriter w(tmp, sizeof(tmp));
+        row(w, r);
+        if (pos + w.size() > cap) return false;   // resten i næste bid
+        memcpy(buf + pos, tmp, w.size());
+        pos += w.size();
+        rows_++;
+        return true;
+      });
+      if (!cursor_.done) return pos;
+      state_ = FOOTER;
+    }
+    if (state_ == FOOTER) {
+      if (pos + 2 > cap) return pos;
+      memcpy(buf + pos, "]}", 2);
+      pos += 2;
+      state_ = DONE;
+    }
+    return pos;
+  }
+
+  bool done() const { return state_ == DONE; }
+  uint32_t rows() const { return rows_; }
+
+private:
+  enum State { HEADER, ROWS, FOOTER, DONE };
+
+  void header(ByteWriter& w) const {
+    w.str("{\"synced\":true,\"cols\":[\"ts\"");
+    for (uint8_t c = 0; c < channels_; c++) {
+      w.str(",\"");
+      w.str(names_[c]);
+      w.put('"');
+    }
+    w.str("],\"rows\":[");
+  }
+
+  void row(ByteWriter& w, const history::RecordView& r) const {
+    if (rows_) w.put(',');
+    w.put('[');
+    w.decimal(r.tsMs);
+    uint8_t n = r.page->channels < channels_ ? r.page->channels : channels_;
+    for (uint8_t c = 0; c < n; c++) {
+      w.put(',');
+      w.fixedPoint(r.raw(c), r.page->decimals[c]);
+    }
+    w.put(']');
+  }
+
+  HistoryLog& log_;
+  HistoryLog::Cursor cursor_;
+  const char* const* names_;
+  uint8_t channels_;
+  State state_ = HEADER;
+  uint32_t rows_ = 0;
+};
@@ -0,0 +1,120 @@
+// Læser historik-loggen fra et dump af flash-partitionen (samme format som HistoryLog)
+//
+// Dump partitionen (offset/størrelse fra partitions.csv):
+//   esptool.py read_flash 0x290000 0x160000 history.bin
+// Byg:  g++ -std=c++17 -O2 history_dump.cpp -o history_dump
+// Kør:  ./history_dump history.bin                      alle records som CSV
+//       ./history_dump history.bin --from MS --to MS    kun et tidsinterval (unix ms)
+//       ./history_dump history.bin --index              kun sideindekset
+//
+// Imaget mappes med mmap, og kun sider hvis [min, max] overlapper intervallet
+// bliver læst, ligesom på enheden.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "HistoryFormat.h"
+
+using namespace history;
+
+static void usage() {
+  fprintf(stderr, "brug: history_dump <image> [--from MS] [--to MS] [--index]\n");
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    usage();
+    return 2;
+  }
+  int64_t fromMs = INT64_MIN, toMs = INT64_MAX;
+  bool indexOnly = false;
+  for (int i = 2; i < argc; i++) {
+    if (!strcmp(argv[i], "--from") && i + 1 < argc) fromMs = strtoll(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--to") && i + 1 < argc) toMs = strtoll(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--index")) indexOnly = true;
+    else {
+      usage();
+      return 2;
+    }
+  }
+
+  int fd = open(argv[1], O_RDONLY);
+  if (fd < 0) {
+    perror(argv[1]);
+    return 1;
+  }
+  struct stat st;
+  fstat(fd, &st);
+  size_t size = size_t(st.st_size);
+  if (size < PAGE_SIZE) {
+    fprintf(stderr, "%s: for lille til en historik-partition\n", argv[1]);
+    return 1;
+  }
+  auto* base = static_cast<const uint8_t*>(mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+  if (base == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+
+  // gyldige sider i skriverækkefølge (seq), uanset hvor ringen står
+  struct Page {
+    uint32_t seq;
+    size_t index;
+  };
+  std::vector<Page> pages;
+  size_t pageCount = size / PAGE_SIZE;
+  for (size_t i = 0; i < pageCount; i++) {
+    PageView v(base + i * PAGE_SIZE);
+    if (v.valid()) pages.push_back({v.header().seq, i});
+  }
+  std::sort(pages.begin(), pages.end(), [](const Page& a, const Page& b) { return a.seq < b.seq; });
+
+  if (indexOnly) {
+    printf("side,seq,min_ms,max_ms,records,forseglet\n");
+    for (const Page& p : pages) {
+      PageView v(base + p.index * PAGE_SIZE);
+      printf("%zu,%" PRIu32 ",%" PRId64 ",%" PRId64 ",%zu,%d\n", p.index, p.seq, v.minMs(),
+             v.maxMs(), v.used(), v.sealed() ? 1 : 0);
+    }
+    fprintf(stderr, "%zu af %zu sider i brug\n", pages.size(), pageCount);
+    return 0;
+  }
+
+  // CSV; kolonne-headeren gentages når kanal-opsætningen skifter mellem sider
+  PageHeader layout = {};
+  size_t total = 0, scanned = 0;
+  for (const Page& p : pages) {
+    PageView v(base + p.index * PAGE_SIZE);
+    if (v.minMs() > toMs || v.maxMs() < fromMs) continue;
+    scanned++;
+    const PageHeader& h = v.header();
+    if (h.channels != layout.channels || memcmp(h.names, layout.names, sizeof(h.names)) != 0 ||
+        memcmp(h.decimals, layout.decimals, sizeof(h.decimals)) != 0) {
+      layout = h;
+      printf("ts_ms");
+      for (uint8_t c = 0; c < h.channels; c++) printf(",%.*s", int(NAME_LEN), h.names[c]);
+      printf("\n");
+    }
+    total += v.forEach(fromMs, toMs, [](const RecordView& r) {
+      printf("%" PRId64, r.tsMs);
+      for (uint8_t c = 0; c < r.page->channels; c++) {
+        printf(",%.*f", int(r.page->decimals[c]), r.value(c));
+      }
+      printf("\n");
+    });
+  }
+  fprintf(stderr, "%zu records fra %zu af %zu sider\n", total, scanned, pages.size());
+
+  munmap(const_cast<uint8_t*>(base), size);
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,508 @@
+// Modbus RTU slave-emulator til Linux (pseudo-terminal)
+//
+// Emulerer ventilationsanlæggets registre over en pty, så firmware og
+// host-værktøjer kan testes uden RS485-hardware:
+//   - input registre 10–20   (blokken som Olimex-Publisher læser: tryk=13, airflow=15, temp=19)
+//   - input registre 25–38   (AI-værdier 25–29, AI-typer 33–37, jf. TestSebastian2.cpp)
+//   - holding register 367   (start/stop af ventilation, 0 = sluk, 3 = start)
+//
+// Understøtter FC03, FC04, FC06, FC16 og FC23, flere slave-ID'er samt injektion af
+// svartid, jitter, CRC-fejl og timeouts.
+//
+// Byg:   g++ -std=c++17 -O2 -Wall -I../RtuCodec -o modbus_emulater modbus_emulater.cpp
+// Kør:   ./modbus_emulater --slave 1 --slave 2 --latency-ms 20 --jitter-ms 10 --link /tmp/ttyVENT0
+//        (tilslut master til /tmp/ttyVENT0, fx mbpoll -m rtu -a 1 -r 11 -c 11 -t 3 /tmp/ttyVENT0)
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RtuCodec.h"
+
+// ================= KONFIGURATION =================
+struct EmulatorConfig {
+  std::vector<uint8_t> slaveIds;       // slave-ID'er der svarer
+  std::vector<uint8_t> deadIds;        // slave-ID'er der aldrig svarer (slukket anlæg)
+  std::vector<uint8_t> noFc23Ids;      // slave-ID'er der svarer FC23 med illegal function
+  uint32_t baud         = 9600;        // bruges til t3.5 og simuleret linjetid (0 = ingen linjetid)
+  double   latencyMs    = 5.0;         // fast svartid før svar sendes
+  double   jitterMs     = 0.0;         // +/- tilfældig variation på svartid
+  double   crcErrorRate = 0.0;         // andel af svar med ødelagt CRC
+  double   timeoutRate  = 0.0;         // andel af forespørgsler der ikke besvares
+  uint32_t seed         = 0;           // 0 = tilfældig
+  std::string linkPath;                // symlink til pty-slave (valgfri)
+  bool     verbose      = false;
+};
+
+// ================= MODBUS KONSTANTER =================
+// Funktionskoder, framing og CRC fra RtuCodec.h
+enum : uint8_t {
+  EX_ILLEGAL_FUNCTION = 0x01,
+  EX_ILLEGAL_ADDRESS  = 0x02,
+  EX_ILLEGAL_VALUE    = 0x03,
+};
+
+static const uint16_t REG_FAN_COMMAND = 367;   // holding register, start/stop
+
+static void appendCrc(std::vector<uint8_t>& frame) {
+  uint16_t crc = rtu::crc16(frame.data(), frame.size());
+  frame.push_back(crc & 0xFF);          // CRC sendes low byte først
+  frame.push_back(crc >> 8);
+}
+
+// ================= REGISTERMODEL FOR ÉT ANLÆG =================
+// Værdierne driver langsomt som i SimModbusDataSource (lib/no/Main.cpp), men
+// her bag en rigtig Modbus-grænseflade.
+class VentilationUnit {
+public:
+  explicit VentilationUnit(uint32_t seed) : rng(seed) {
+    // blok 10–20
+    input[10] = 55;     // udetemp  /10 °C
+    input[11] = 0;
+    input[12] = 0;
+    input[13] = 250;    // tryk (regs[3] i Olimex-Publisher)
+    input[14] = 0;
+    input[15] = 1000;   // airflow / rpm (regs[5])
+    input[16] = 0;
+    input[17] = 0;
+    input[18] = 228;    // extract temp /10 °C
+    input[19] = 215;    // supply temp /10 °C (regs[9])
+    input[20] = 0;
+
+    // AI-værdier 25–29 og reserverede 30–32
+    for (uint16_t a = 25; a <= 38; a++) input[a] = 0;
+    // AI-typer 33–37 (koder fra signalName() i TestSebastian2.cpp)
+    input[33] = 2;      // AI1 = Supplytemp
+    input[34] = 9;      // AI2 = EAF pressure
+    input[35] = 1;      // AI3 = Outdoortemp
+    input[36] = 0;      // AI4 = Not used
+    input[37] = 13;     // UAI1 = Humidity room
+    syncAiValues();
+
+    holding[REG_FAN_COMMAND] = 3;   // anlægget kører fra start
+    lastTick = std::chrono::steady_clock::now();
+  }
+
+  bool readInput(uint16_t addr, uint16_t qty, std::vector<uint16_t>& out) {
+    tick();
+    return readFrom(input, addr, qty, out);
+  }
+
+  bool readHolding(uint16_t addr, uint16_t qty, std::vector<uint16_t>& out) {
+    tick();
+    return readFrom(holding, addr, qty, out);
+  }
+
+  bool writeHolding(uint16_t addr, const uint16_t* values, uint16_t qty) {
+    for (uint16_t i = 0; i < qty; i++) {
+      if (!holding.count(addr + i)) return false;
+    }
+    for (uint16_t i = 0; i < qty; i++) holding[addr + i] = values[i];
+    return true;
+  }
+
+  bool fanRunning() const { return holding.at(REG_FAN_COMMAND) != 0; }
+
+private:
+  static bool readFrom(const std::map<uint16_t, uint16_t>& regs, uint16_t addr,
+                       uint16_t qty, std::vector<uint16_t>& out) {
+    out.clear();
+    for (uint32_t a = addr; a < uint32_t(addr) + qty; a++) {
+      auto it = regs.find(uint16_t(a));
+      if (it == regs.end()) return false;   // hele området skal være mappet
+      out.push_back(it->second);
+    }
+    return true;
+  }
+
+  // Opdater værdier ca. hvert sekund (random walk med grænser)
+  void tick() {
+    auto now = std::chrono::steady_clock::now();
+    while (now - lastTick >= std::chrono::seconds(1)) {
+      lastTick += std::chrono::seconds(1);
+      walk(input[19], 3, 180, 260);
+      walk(input[18], 3, 190, 260);
+      walk(input[10], 2, -100, 300);
+      if (fanRunning()) {
+        walk(input[13], 8, 150, 350);
+        walk(input[15], 30, 800, 1800);
+      } else {
+        // ventilator stoppet: tryk og flow falder mod 0
+        input[13] = uint16_t(input[13] * 0.5);
+        input[15] = uint16_t(input[15] * 0.5);
+      }
+      syncAiValues();
+    }
+  }
+
+  void walk(uint16_t& reg, int range, int lo, int hi) {
+    std::uniform_int_distribution<int> d(-range, range);
+    int v = int(int16_t(reg)) + d(rng);
+    reg = uint16_t(int16_t(std::clamp(v, lo, hi)));
+  }
+
+  // AI-værdierne følger de direkte registre ud fra kanalens type
+  void syncAiValues() {
+    for (uint16_t ch = 0; ch < 5; ch++) {
+      uint16_t& value = input[25 + ch];
+      switch (input[33 + ch]) {
+        case 1:  value = input[10]; break;       // Outdoortemp
+        case 2:  value = input[19]; break;       // Supplytemp
+        case 3:  value = input[18]; break;       // Extracttemp
+        case 9:  value = input[13]; break;       // EAF pressure (Pa)
+        case 13: value = 45; break;              // Humidity room (%RH)
+        default: value = 0; break;
+      }
+    }
+  }
+
+  std::map<uint16_t, uint16_t> input;
+  std::map<uint16_t, uint16_t> holding;
+  std::mt19937 rng;
+  std::chrono::steady_clock::time_point lastTick;
+};
+
+// ================= STATISTIK =================
+struct EmulatorStats {
+  uint64_t framesIn       = 0;
+  uint64_t badCrcIn       = 0;
+  uint64_t notForUs       = 0;
+  uint64_t replies        = 0;
+  uint64_t exceptions     = 0;
+  uint64_t injectedCrc    = 0;
+  uint64_t injectedSilent = 0;
+};
+
+static volatile sig_atomic_t running = 1;
+static void onSignal(int) { running = 0; }
+
+// ================= EMULATOR =================
+class RtuEmulator {
+public:
+  explicit RtuEmulator(const EmulatorConfig& cfg)
+      : cfg(cfg), rng(cfg.seed ? cfg.seed : std::random_device{}()) {
+    for (uint8_t id : cfg.slaveIds) units.emplace(id, VentilationUnit(rng()));
+  }
+
+  ~RtuEmulator() {
+    if (!cfg.linkPath.empty()) unlink(cfg.linkPath.c_str());
+    if (slaveFd >= 0) close(slaveFd);
+    if (masterFd >= 0) close(masterFd);
+  }
+
+  bool openPty() {
+    masterFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (masterFd < 0 || grantpt(masterFd) != 0 || unlockpt(masterFd) != 0) {
+      perror("posix_openpt");
+      return false;
+    }
+    const char* name = ptsname(masterFd);
+    if (!name) {
+      perror("ptsname");
+      return false;
+    }
+    slavePath = name;
+
+    // Hold selv slave-siden åben i raw mode, så linjedisciplinen ikke
+    // ændrer bytes, og master-fd ikke giver EIO når ingen klient er tilsluttet
+    slaveFd = open(name, O_RDWR | O_NOCTTY);
+    if (slaveFd < 0) {
+      perror("open pty slave");
+      return false;
+    }
+    termios tio{};
+    tcgetattr(slaveFd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slaveFd, TCSANOW, &tio);
+
+    if (!cfg.linkPath.empty()) {
+      unlink(cfg.linkPath.c_str());
+      if (symlink(name, cfg.linkPath.c_str()) != 0) {
+        perror("symlink");
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const std::string& path() const { return slavePath; }
+
+  void run() {
+    std::vector<uint8_t> frame;
+    uint8_t buf[256];
+    const int gapMs = frameGapMs();
+
+    while (running) {
+      pollfd pfd{masterFd, POLLIN, 0};
+      // Uden data i bufferen ventes frit; midt i en frame afsluttes den af t3.5-pausen
+      int rc = poll(&pfd, 1, frame.empty() ? 200 : gapMs);
+      if (rc < 0) {
+        if (errno == EINTR) continue;
+        perror("poll");
+        break;
+      }
+      if (rc == 0) {
+        if (!frame.empty()) {
+          handleFrame(frame);
+          frame.clear();
+        }
+        continue;
+      }
+      ssize_t n = read(masterFd, buf, sizeof(buf));
+      if (n <= 0) {
+        if (n < 0 && errno != EAGAIN && errno != EIO) perror("read");
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        continue;
+      }
+      frame.insert(frame.end(), buf, buf + n);
+      if (frame.size() > 256) frame.clear();    // over max RTU-størrelse: støj
+    }
+  }
+
+  void printStats() const {
+    std::printf("frames=%llu badcrc=%llu andre_id=%llu svar=%llu exceptions=%llu "
+                "injiceret_crc=%llu injiceret_timeout=%llu\n",
+                (unsigned long long)stats.framesIn, (unsigned long long)stats.badCrcIn,
+                (unsigned long long)stats.notForUs, (unsigned long long)stats.replies,
+                (unsigned long long)stats.exceptions, (unsigned long long)stats.injectedCrc,
+                (unsigned long long)stats.injectedSilent);
+  }
+
+private:
+  // t3.5 i ms; over 19200 baud bruges fast 1.75 ms (Modbus over serial line, 2.5.1.1)
+  int frameGapMs() const {
+    if (cfg.baud == 0 || cfg.baud > 19200) return 2;
+    double ms = 3.5 * 11.0 * 1000.0 / cfg.baud;
+    return std::max(2, int(std::ceil(ms)));
+  }
+
+  void handleFrame(const std::vector<uint8_t>& f) {
+    stats.framesIn++;
+    rtu::Request req;
+    rtu::Status st = rtu::parseRequest(f.data(), f.size(), req);
+    if (st == rtu::Status::Incomplete) return;
+    if (st == rtu::Status::BadCrc) {
+      stats.badCrcIn++;           // en rigtig slave tier ved CRC-fejl
+      if (cfg.verbose) std::printf("RX: CRC-fejl (%zu bytes)\n", f.size());
+      return;
+    }
+
+    uint8_t id = req.slave;
+    bool broadcast = (id == 0);
+    if (!broadcast && (!units.count(id) ||
+        std::find(cfg.deadIds.begin(), cfg.deadIds.end(), id) != cfg.deadIds.end())) {
+      stats.notForUs++;
+      return;
+    }
+
+    if (broadcast) {
+      // broadcast-skrivninger udføres på alle slaver uden svar
+      for (auto& u : units) {
+        std::vector<uint8_t> ignored;
+        process(u.second, req, st, ignored);
+      }
+      return;
+    }
+
+    std::vector<uint8_t> reply{id};
+    process(units.at(id), req, st, reply);
+    if (reply.size() < 2) return;
+    appendCrc(reply);
+    sendReply(reply);
+  }
+
+  // Bygger PDU'en (funktionskode + data) efter slave-ID i reply
+  void process(VentilationUnit& unit, const rtu::Request& req, rtu::Status st,
+               std::vector<uint8_t>& reply) {
+    uint8_t fc = req.fc;
+    std::vector<uint16_t> regs;
+
+    auto exception = [&](uint8_t code) {
+      reply.push_back(fc | 0x80);
+      reply.push_back(code);
+      stats.exceptions++;
+    };
+    auto appendRegs = [&]() {
+      reply.push_back(fc);
+      reply.push_back(uint8_t(regs.size() * 2));
+      for (uint16_t v : regs) {
+        reply.push_back(v >> 8);
+        reply.push_back(v & 0xFF);
+      }
+    };
+
+    if (fc == rtu::FC_READ_WRITE &&
+        std::find(cfg.noFc23Ids.begin(), cfg.noFc23Ids.end(), req.slave) != cfg.noFc23Ids.end()) {
+      return exception(EX_ILLEGAL_FUNCTION);
+    }
+    if (st == rtu::Status::UnknownFunction) return exception(EX_ILLEGAL_FUNCTION);
+    if (st != rtu::Status::Ok) return exception(EX_ILLEGAL_VALUE);   // længde/antal
+
+    regs.resize(req.values.size());
+    req.values.copyTo(regs.data(), regs.size());
+    switch (fc) {
+      case rtu::FC_READ_HOLDING:
+      case rtu::FC_READ_INPUT: {
+        bool ok = (fc == rtu::FC_READ_INPUT) ? unit.readInput(req.address, req.count, regs)
+                                             : unit.readHolding(req.address, req.count, regs);
+        if (!ok) return exception(EX_ILLEGAL_ADDRESS);
+        return appendRegs();
+      }
+      case rtu::FC_WRITE_SINGLE: {
+        if (!unit.writeHolding(req.address, regs.data(), 1)) return exception(EX_ILLEGAL_ADDRESS);
+        if (cfg.verbose) std::printf("Holding[%u] = %u\n", req.address, regs[0]);
+        reply.push_back(fc);   // ekko af forespørgslen
+        reply.push_back(req.address >> 8);
+        reply.push_back(req.address & 0xFF);
+        reply.push_back(regs[0] >> 8);
+        reply.push_back(regs[0] & 0xFF);
+        return;
+      }
+      case rtu::FC_WRITE_MULTIPLE: {
+        if (!unit.writeHolding(req.address, regs.data(), req.count)) return exception(EX_ILLEGAL_ADDRESS);
+        reply.push_back(fc);
+        reply.push_back(req.address >> 8);
+        reply.push_back(req.address & 0xFF);
+        reply.push_back(req.count >> 8);
+        reply.push_back(req.count & 0xFF);
+        return;
+      }
+      case rtu::FC_READ_WRITE: {
+        // skriv før læs
+        if (!unit.writeHolding(req.writeAddress, regs.data(), uint16_t(regs.size()))) return exception(EX_ILLEGAL_ADDRESS);
+        if (cfg.verbose) std::printf("Holding[%u..] = %u (FC23)\n", req.writeAddress, regs[0]);
+        regs.clear();
+        if (!unit.readHolding(req.address, req.count, regs)) return exception(EX_ILLEGAL_ADDRESS);
+        return appendRegs();
+      }
+      default:
+        return exception(EX_ILLEGAL_FUNCTION);
+    }
+  }
+
+  void sendReply(std::vector<uint8_t>& reply) {
+    std::uniform_real_distribution<double> u01(0.0, 1.0);
+    if (u01(rng) < cfg.timeoutRate) {
+      stats.injectedSilent++;
+      if (cfg.verbose) std::printf("TX: injiceret timeout\n");
+      return;
+    }
+    if (u01(rng) < cfg.crcErrorRate) {
+      reply.back() ^= 0x5A;
+      stats.injectedCrc++;
+      if (cfg.verbose) std::printf("TX: injiceret CRC-fejl\n");
+    }
+
+    // svartid = latency +/- jitter + linjetid for svaret ved den valgte baudrate
+    std::uniform_real_distribution<double> jit(-cfg.jitterMs, cfg.jitterMs);
+    double delayMs = std::max(0.0, cfg.latencyMs + (cfg.jitterMs > 0 ? jit(rng) : 0.0));
+    if (cfg.baud > 0) delayMs += reply.size() * 10.0 * 1000.0 / cfg.baud;
+    std::this_thread::sleep_for(std::chrono::microseconds(int64_t(delayMs * 1000.0)));
+
+    // tøm evt. bytes som masteren nåede at sende imens (ligesom en halv-duplex bus)
+    tcflush(masterFd, TCIFLUSH);
+    if (write(masterFd, reply.data(), reply.size()) < 0) perror("write");
+    stats.replies++;
+    if (cfg.verbose) std::printf("TX: slave %u fc 0x%02X, %zu bytes efter %.1f ms\n",
+                                 reply[0], reply[1], reply.size(), delayMs);
+  }
+
+  EmulatorConfig cfg;
+  std::mt19937 rng;
+  std::map<uint8_t, VentilationUnit> units;
+  EmulatorStats stats;
+  int masterFd = -1;
+  int slaveFd = -1;
+  std::string slavePath;
+};
+
+// ================= KOMMANDOLINJE =================
+static void usage(const char* prog) {
+  std::fprintf(stderr,
+      "Brug: %s [valg]\n"
+      "  --slave ID          slave-ID der svarer (kan gentages, standard 1)\n"
+      "  --dead ID           slave-ID der aldrig svarer (kan gentages)\n"
+      "  --no-fc23 ID        slave-ID uden FC23, svarer illegal function (kan gentages)\n"
+      "  --baud N            baudrate til t3.5 og linjetid (0 = ingen linjetid, standard 9600)\n"
+      "  --latency-ms MS     svartid før svar (standard 5)\n"
+      "  --jitter-ms MS      +/- variation på svartid (standard 0)\n"
+      "  --crc-error-rate R  andel af svar med forkert CRC, 0..1\n"
+      "  --timeout-rate R    andel af forespørgsler uden svar, 0..1\n"
+      "  --link PATH         opret symlink til pty-slaven\n"
+      "  --seed N            fast seed til tilfældige tal\n"
+      "  -v, --verbose       log hver frame\n", prog);
+}
+
+static bool parseArgs(int argc, char** argv, EmulatorConfig& cfg) {
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    auto next = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        std::fprintf(stderr, "Mangler værdi til %s\n", a.c_str());
+        std::exit(2);
+      }
+      return argv[++i];
+    };
+    if (a == "--slave")               cfg.slaveIds.push_back(uint8_t(std::atoi(next())));
+    else if (a == "--dead")           cfg.deadIds.push_back(uint8_t(std::atoi(next())));
+    else if (a == "--no-fc23")        cfg.noFc23Ids.push_back(uint8_t(std::atoi(next())));
+    else if (a == "--baud")           cfg.baud = uint32_t(std::strtoul(next(), nullptr, 10));
+    else if (a == "--latency-ms")     cfg.latencyMs = std::atof(next());
+    else if (a == "--jitter-ms")      cfg.jitterMs = std::atof(next());
+    else if (a == "--crc-error-rate") cfg.crcErrorRate = std::atof(next());
+    else if (a == "--timeout-rate")   cfg.timeoutRate = std::atof(next());
+    else if (a == "--link")           cfg.linkPath = next();
+    else if (a == "--seed")           cfg.seed = uint32_t(std::strtoul(next(), nullptr, 10));
+    else if (a == "-v" || a == "--verbose") cfg.verbose = true;
+    else return false;
+  }
+  if (cfg.slaveIds.empty()) cfg.slaveIds.push_back(1);
+  // døde slaver skal også have en model, så de kan "tændes" igen ved genstart
+  for (uint8_t id : cfg.deadIds) {
+    if (std::find(cfg.slaveIds.begin(), cfg.slaveIds.end(), id) == cfg.slaveIds.end()) {
+      cfg.slaveIds.push_back(id);
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  EmulatorConfig cfg;
+  if (!parseArgs(argc, argv, cfg)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  RtuEmulator emu(cfg);
+  if (!emu.openPty()) return 1;
+
+  std::printf("Modbus RTU emulator klar på %s", emu.path().c_str());
+  if (!cfg.linkPath.empty()) std::printf(" (link: %s)", cfg.linkPath.c_str());
+  std::printf("\nSlaver:");
+  for (uint8_t id : cfg.slaveIds) std::printf(" %u", id);
+  std::printf("  baud=%u latency=%.1fms jitter=%.1fms crc=%.3f timeout=%.3f\n",
+              cfg.baud, cfg.latencyMs, cfg.jitterMs, cfg.crcErrorRate, cfg.timeoutRate);
+  std::fflush(stdout);
+
+  emu.run();
+  emu.printStats();
+  return 0;
+}
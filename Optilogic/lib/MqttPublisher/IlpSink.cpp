@@ -0,0 +1,363 @@
+#include "IlpSink.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Tag-værdier: komma, mellemrum og lighedstegn escapes; linjeskift er ikke tilladt
+std::string escapeTag(const std::string& s) {
+  std::string out;
+  out.reserve(s.size());
+  for (char c : s) {
+    if (c == ',' || c == ' ' || c == '=') out += '\\';
+    out += (c == '\n' || c == '\r') ? '_' : c;
+  }
+  return out;
+}
+
+template <class T>
+void appendNumber(std::string& out, T v) {
+  char buf[32];
+  auto res = std::to_chars(buf, buf + sizeof(buf), v);
+  out.append(buf, res.ptr);
+}
+
+// Groft estimat af linjestørrelse, bruges til maxBytes før rendering
+constexpr size_t BYTES_PER_ROW_BASE = 48;
+constexpr size_t BYTES_PER_FIELD = 24;
+
+}  // namespace
+
+// ================= KOLONNE-STAGING =================
+void IlpColumns::setDouble(size_t col, double v) {
+  if (col >= columns_ || std::isnan(v)) return;
+  uint64_t bits;
+  std::memcpy(&bits, &v, sizeof(bits));
+  values_[(rows() - 1) * columns_ + col] = bits;
+  present_.back() |= 1u << col;
+}
+
+void IlpColumns::setLong(size_t col, int64_t v) {
+  if (col >= columns_) return;
+  values_[(rows() - 1) * columns_ + col] = uint64_t(v);
+  present_.back() |= 1u << col;
+}
+
+// ================= SINK =================
+IlpSink::IlpSink(IlpSinkConfig cfg)
+    : cfg_(std::move(cfg)),
+      staging_(cfg_.columns.size()),
+      sending_(cfg_.columns.size()),
+      backoff_(cfg_.reconnectMin) {
+  if (cfg_.columns.size() > 32) cfg_.columns.resize(32);   // present er en 32-bit maske
+  deviceTags_.reserve(cfg_.maxDevices);
+  measurement_ = cfg_.table + "," + cfg_.tagName + "=";
+  httpRequestHead_ = "POST /write?precision=n HTTP/1.1\r\nHost: " + cfg_.host +
+                     "\r\nContent-Type: text/plain\r\nContent-Length: ";
+}
+
+IlpSink::~IlpSink() {
+  stop(std::chrono::milliseconds(0));
+}
+
+void IlpSink::start() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (running_) return;
+  running_ = true;
+  flusher_ = std::thread(&IlpSink::flusherLoop, this);
+}
+
+void IlpSink::stop(std::chrono::milliseconds timeout) {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!running_ || stopping_) return;
+    stopping_ = true;
+    stopDeadline_ = std::chrono::steady_clock::now() + timeout;
+  }
+  cv_.notify_all();
+  cvSpace_.notify_all();
+  if (flusher_.joinable()) flusher_.join();
+  disconnect();
+}
+
+IlpSinkStats IlpSink::stats() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return stats_;
+}
+
+uint32_t IlpSink::internDevice(const std::string& device) {
+  auto it = deviceIds_.find(device);
+  if (it != deviceIds_.end()) return it->second;
+  if (deviceTags_.size() >= cfg_.maxDevices) return UINT32_MAX;
+  // reserve() i konstruktøren gør at flusher-tråden kan læse ældre tags uden lås
+  uint32_t id = uint32_t(deviceTags_.size());
+  deviceTags_.push_back(escapeTag(device));
+  deviceIds_.emplace(device, id);
+  return id;
+}
+
+bool IlpSink::add(const std::string& device, uint64_t tsNs, const double* values) {
+  bool wake = false;
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    // fuld staging-buffer mens forrige batch sendes: vent (begrænset hukommelse)
+    if (staging_.rows() >= cfg_.maxRows || stagedBytes_ >= cfg_.maxBytes) {
+      cv_.notify_one();
+      cvSpace_.wait(lock, [&] {
+        return stopping_ || (staging_.rows() < cfg_.maxRows && stagedBytes_ < cfg_.maxBytes);
+      });
+    }
+    if (stopping_) return false;
+    stats_.rowsIn++;
+    uint32_t id = internDevice(device);
+    if (id == UINT32_MAX) {
+      stats_.rowsDropped++;
+      return false;
+    }
+    if (staging_.rows() == 0) oldestRow_ = std::chrono::steady_clock::now();
+    staging_.beginRow(id, tsNs);
+    size_t fields = 0;
+    for (size_t c = 0; c < cfg_.columns.size(); c++) {
+      if (std::isnan(values[c])) continue;
+      if (cfg_.columns[c].type == IlpType::Long) staging_.setLong(c, int64_t(std::llround(values[c])));
+      else                                       staging_.setDouble(c, values[c]);
+      fields++;
+    }
+    stagedBytes_ += BYTES_PER_ROW_BASE + deviceTags_[id].size() + fields * BYTES_PER_FIELD;
+    wake = staging_.rows() >= cfg_.maxRows || stagedBytes_ >= cfg_.maxBytes;
+  }
+  if (wake) cv_.notify_one();
+  return true;
+}
+
+// ================= RENDERING =================
+void IlpSink::render(const IlpColumns& batch, std::string& out) const {
+  out.clear();
+  const size_t cols = cfg_.columns.size();
+  for (size_t r = 0; r < batch.rows(); r++) {
+    uint32_t present = batch.present_[r];
+    if (!present) continue;   // ILP kræver mindst ét felt
+    out += measurement_;
+    out += deviceTags_[batch.device_[r]];
+    char sep = ' ';
+    for (size_t c = 0; c < cols; c++) {
+      if (!(present & (1u << c))) continue;
+      out += sep;
+      sep = ',';
+      out += cfg_.columns[c].name;
+      out += '=';
+      uint64_t raw = batch.values_[r * cols + c];
+      if (cfg_.columns[c].type == IlpType::Long) {
+        appendNumber(out, int64_t(raw));
+        out += 'i';
+      } else {
+        double d;
+        std::memcpy(&d, &raw, sizeof(d));
+        appendNumber(out, d);
+      }
+    }
+    out += ' ';
+    appendNumber(out, batch.tsNs_[r]);
+    out += '\n';
+  }
+}
+
+// ================= FLUSHER =================
+void IlpSink::flusherLoop() {
+  std::unique_lock<std::mutex> lock(mtx_);
+  for (;;) {
+    bool due = cv_.wait_for(lock, cfg_.maxAge, [&] {
+      if (stopping_) return true;
+      if (staging_.rows() == 0) return false;
+      return staging_.rows() >= cfg_.maxRows || stagedBytes_ >= cfg_.maxBytes ||
+             std::chrono::steady_clock::now() - oldestRow_ >= cfg_.maxAge;
+    });
+    if (!due) continue;
+    if (staging_.rows() == 0) break;   // stopping_ og intet tilbage
+
+    // byt buffere; add() fortsætter i den tomme mens vi sender
+    std::swap(staging_, sending_);
+    staging_.clear();
+    stagedBytes_ = 0;
+    size_t rows = sending_.rows();
+    lock.unlock();
+    cvSpace_.notify_all();
+
+    render(sending_, wire_);
+    bool ok = send(wire_, rows);
+
+    lock.lock();
+    if (!ok) stats_.rowsDropped += rows;
+  }
+}
+
+// Sender én batch indtil den er bekræftet, afvist eller stop-fristen udløber
+bool IlpSink::send(const std::string& wire, size_t rows) {
+  if (wire.empty()) return true;
+  for (;;) {
+    bool rejected = false;
+    if (sendOnce(wire, rejected)) {
+      backoff_ = cfg_.reconnectMin;
+      std::lock_guard<std::mutex> lock(mtx_);
+      stats_.rowsSent += rows;
+      stats_.batches++;
+      stats_.bytesSent += wire.size();
+      return true;
+    }
+    if (rejected) return false;   // serveren vil aldrig tage imod disse data
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    stats_.retries++;
+    if (stopping_ && std::chrono::steady_clock::now() >= stopDeadline_) return false;
+    // backoff, men stop() vækker os så fristen kan tjekkes
+    cv_.wait_for(lock, backoff_, [&] { return stopping_ && std::chrono::steady_clock::now() >= stopDeadline_; });
+    backoff_ = std::min(backoff_ * 2, cfg_.reconnectMax);
+  }
+}
+
+bool IlpSink::sendOnce(const std::string& wire, bool& rejected) {
+  if (!ensureConnected()) return false;
+
+  if (cfg_.http) {
+    std::string head = httpRequestHead_;
+    appendNumber(head, wire.size());
+    head += "\r\n\r\n";
+    int status = 0;
+    if (!writeAll(head.data(), head.size()) || !writeAll(wire.data(), wire.size()) ||
+        !readHttpStatus(status)) {
+      disconnect();
+      return false;
+    }
+    if (status == 204 || status == 200) return true;
+    std::fprintf(stderr, "IlpSink: server svarede %d\n", status);
+    if (status >= 400 && status < 500) rejected = true;
+    disconnect();
+    return false;
+  }
+
+  // TCP har ingen ack: skrevet helt og forbindelsen stadig åben er det bedste bevis
+  if (!writeAll(wire.data(), wire.size()) || peerClosed()) {
+    disconnect();
+    return false;
+  }
+  return true;
+}
+
+// ================= SOCKET =================
+bool IlpSink::ensureConnected() {
+  if (fd_ >= 0) {
+    if (!peerClosed()) return true;
+    disconnect();   // QuestDB lukker TCP-forbindelsen ved en ugyldig linje
+  }
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* res = nullptr;
+  char port[8];
+  std::snprintf(port, sizeof(port), "%u", unsigned(cfg_.port));
+  if (getaddrinfo(cfg_.host.c_str(), port, &hints, &res) != 0) return false;
+
+  for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+    int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) continue;
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      timeval tv{};
+      tv.tv_sec = long(cfg_.ioTimeout.count() / 1000);
+      tv.tv_usec = long(cfg_.ioTimeout.count() % 1000) * 1000;
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+      fd_ = fd;
+      break;
+    }
+    close(fd);
+  }
+  freeaddrinfo(res);
+  if (fd_ < 0) return false;
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  stats_.reconnects++;
+  return true;
+}
+
+void IlpSink::disconnect() {
+  if (fd_ >= 0) close(fd_);
+  fd_ = -1;
+}
+
+bool IlpSink::writeAll(const char* data, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::send(fd_, data, len, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += n;
+    len -= size_t(n);
+  }
+  return true;
+}
+
+// Lukket eller fejlet forbindelse uden at blokere (TCP-ILP sender aldrig noget tilbage)
+bool IlpSink::peerClosed() {
+  pollfd pfd{fd_, POLLIN, 0};
+  if (poll(&pfd, 1, 0) <= 0) return false;
+  if (pfd.revents & (POLLERR | POLLHUP)) return true;
+  char c;
+  ssize_t n = recv(fd_, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+// Læser statuslinje og headers og dræner body (keep-alive)
+bool IlpSink::readHttpStatus(int& status) {
+  std::string buf;
+  size_t headerEnd;
+  char chunk[1024];
+  while ((headerEnd = buf.find("\r\n\r\n")) == std::string::npos) {
+    ssize_t n = recv(fd_, chunk, sizeof(chunk), 0);
+    if (n <= 0) return false;
+    buf.append(chunk, size_t(n));
+    if (buf.size() > 64 * 1024) return false;
+  }
+  if (buf.compare(0, 5, "HTTP/") != 0) return false;
+  size_t sp = buf.find(' ');
+  if (sp == std::string::npos) return false;
+  status = std::atoi(buf.c_str() + sp + 1);
+
+  size_t contentLength = 0;
+  size_t pos = buf.find("\r\n");
+  while (pos < headerEnd) {
+    size_t next = buf.find("\r\n", pos + 2);
+    std::string line = buf.substr(pos + 2, next - pos - 2);
+    std::transform(line.begin(), line.end(), line.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    if (line.compare(0, 15, "content-length:") == 0) contentLength = size_t(std::atol(line.c_str() + 15));
+    pos = next;
+  }
+
+  size_t have = buf.size() - (headerEnd + 4);
+  if (status >= 400 && have > 0) {
+    std::fprintf(stderr, "IlpSink: %.*s\n", int(std::min<size_t>(have, 200)), buf.c_str() + headerEnd + 4);
+  }
+  while (have < contentLength) {
+    ssize_t n = recv(fd_, chunk, std::min(sizeof(chunk), contentLength - have), 0);
+    if (n <= 0) return false;
+    have += size_t(n);
+  }
+  return true;
+}
@@ -0,0 +1,158 @@
+#pragma once
+// Batchet InfluxDB Line Protocol (ILP) output til QuestDB
+//
+// Erstatter én INSERT pr. MQTT-besked over PostgreSQL-porten (8812) med
+// ILP i batches, enten over TCP (port 9009) eller HTTP (port 9000, /write).
+// Rækker samles i en kolonneopdelt staging-buffer, som byttes med en
+// reservebuffer ved flush, så hverken rækker eller linjer allokeres pr. besked.
+//
+// En batch flushes når den når maxRows/maxBytes eller er maxAge gammel, og
+// holdes indtil den er bekræftet:
+//   http – serveren svarer 204 (rigtig ack); 4xx betyder ugyldige data og batchen droppes
+//   tcp  – alt er skrevet og serveren har ikke lukket forbindelsen (QuestDB lukker ved fejl)
+// Fejler afsendelsen, genforbindes der med backoff, og hele batchen sendes igen.
+//
+// Byg med: -pthread
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+enum class IlpType : uint8_t { Double, Long };
+
+struct IlpColumn {
+  std::string name;
+  IlpType     type = IlpType::Double;
+};
+
+struct IlpSinkConfig {
+  std::string host = "localhost";
+  uint16_t    port = 9009;
+  bool        http = false;             // true = POST /write med ack, false = rå TCP
+  std::string table = "sensor_data";
+  std::string tagName = "device";
+  std::vector<IlpColumn> columns = {
+    {"temp", IlpType::Double}, {"tryk", IlpType::Double}, {"rpm", IlpType::Long},
+  };
+  size_t maxRows    = 5000;             // også loft for staging-bufferen
+  size_t maxBytes   = 512 * 1024;       // anslået linjestørrelse
+  size_t maxDevices = 65536;            // tag-tabellen allokeres fast (stabile referencer)
+  std::chrono::milliseconds maxAge{250};
+  std::chrono::milliseconds reconnectMin{100};
+  std::chrono::milliseconds reconnectMax{5000};
+  std::chrono::milliseconds ioTimeout{5000};
+};
+
+struct IlpSinkStats {
+  uint64_t rowsIn      = 0;
+  uint64_t rowsSent    = 0;   // bekræftede rækker
+  uint64_t rowsDropped = 0;   // afvist af server (http 4xx) eller for mange devices
+  uint64_t batches     = 0;
+  uint64_t retries     = 0;
+  uint64_t bytesSent   = 0;
+  uint64_t reconnects  = 0;
+};
+
+// ================= KOLONNE-STAGING =================
+// Én post pr. række i device/ts/present og rows*columns pladser i values.
+// Heltalskolonner gemmes bitvis i values, så der kun er én array.
+class IlpColumns {
+public:
+  explicit IlpColumns(size_t columns) : columns_(columns) {}
+
+  size_t rows() const { return device_.size(); }
+
+  void beginRow(uint32_t device, uint64_t tsNs) {
+    device_.push_back(device);
+    tsNs_.push_back(tsNs);
+    present_.push_back(0);
+    values_.resize(values_.size() + columns_);
+  }
+  void setDouble(size_t col, double v);
+  void setLong(size_t col, int64_t v);
+
+  void clear() {
+    device_.clear();
+    tsNs_.clear();
+    present_.clear();
+    values_.clear();
+  }
+
+private:
+  friend class IlpSink;
+  size_t columns_;
+  std::vector<uint32_t> device_;
+  std::vector<uint64_t> tsNs_;
+  std::vector<uint32_t> present_;   // bitmaske over kolonner (max 32)
+  std::vector<uint64_t> values_;
+};
+
+// ================= SINK =================
+class IlpSink {
+public:
+  explicit IlpSink(IlpSinkConfig cfg);
+  ~IlpSink();
+
+  IlpSink(const IlpSink&) = delete;
+  IlpSink& operator=(const IlpSink&) = delete;
+
+  void start();
+
+  /**
+   * @brief Flusher resten og stopper; venter højst timeout på afsendelse
+   */
+  void stop(std::chrono::milliseconds timeout = std::chrono::milliseconds(5000));
+
+  /**
+   * @brief Tilføjer én række
+   *
+   * @param values en værdi pr. kolonne i cfg.columns; NaN = feltet mangler
+   * Blokerer hvis staging-bufferen er fuld og forrige batch stadig sendes.
+   * @return false hvis device-tabellen er fuld eller sinken er stoppet
+   */
+  bool add(const std::string& device, uint64_t tsNs, const double* values);
+
+  IlpSinkStats stats() const;
+
+private:
+  uint32_t internDevice(const std::string& device);   // kaldes med mtx_ låst
+  void flusherLoop();
+  void render(const IlpColumns& batch, std::string& out) const;
+  bool send(const std::string& wire, size_t rows);
+  bool sendOnce(const std::string& wire, bool& rejected);
+  bool ensureConnected();
+  void disconnect();
+  bool writeAll(const char* data, size_t len);
+  bool peerClosed();
+  bool readHttpStatus(int& status);
+
+  IlpSinkConfig cfg_;
+
+  mutable std::mutex mtx_;
+  std::condition_variable cv_;        // flusher: batch klar eller stop
+  std::condition_variable cvSpace_;   // add(): staging-buffer byttet
+  IlpColumns staging_;
+  IlpColumns sending_;
+  size_t stagedBytes_ = 0;
+  std::chrono::steady_clock::time_point oldestRow_;
+  std::vector<std::string> deviceTags_;    // escapet tag-værdi; reserveret til maxDevices
+  std::unordered_map<std::string, uint32_t> deviceIds_;
+  IlpSinkStats stats_;
+  bool running_ = false;
+  bool stopping_ = false;
+  std::chrono::steady_clock::time_point stopDeadline_;
+
+  // kun flusher-tråden
+  std::string wire_;
+  std::string measurement_;   // "table,device="
+  std::string httpRequestHead_;
+  int fd_ = -1;
+  std::chrono::milliseconds backoff_;
+
+  std::thread flusher_;
+};
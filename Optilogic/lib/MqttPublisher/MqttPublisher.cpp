@@ -0,0 +1,244 @@
+#include "MqttPublisher.h"
+
+#include <algorithm>
+#include <cstdio>
+
+MqttPublisher::MqttPublisher(PublisherConfig cfg)
+    : cfg_(std::move(cfg)), client_(cfg_.serverUri, cfg_.clientId) {
+  // slot-index pakkes i 16 bit af user context, se packContext()
+  cfg_.maxInflight = std::clamp<size_t>(cfg_.maxInflight, 1, 0xFFFF);
+  slots_.resize(cfg_.maxInflight);
+  for (size_t i = cfg_.maxInflight; i-- > 0;) freeSlots_.push_back(i);
+  client_.set_callback(*this);
+}
+
+MqttPublisher::~MqttPublisher() {
+  stop(std::chrono::milliseconds(0));
+}
+
+// ================= START / STOP =================
+bool MqttPublisher::start() {
+  bool ok = connectOnce();
+  sender_ = std::thread(&MqttPublisher::senderLoop, this);
+  return ok;
+}
+
+void MqttPublisher::stop(std::chrono::milliseconds drainTimeout) {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (stopping_) return;
+  }
+  flush(drainTimeout);
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stopping_ = true;
+  }
+  cvSend_.notify_all();
+  cvSpace_.notify_all();
+  if (sender_.joinable()) sender_.join();
+  try {
+    if (client_.is_connected()) client_.disconnect()->wait();
+  } catch (const mqtt::exception& exc) {
+    std::fprintf(stderr, "MqttPublisher: disconnect fejlede: %s\n", exc.what());
+  }
+}
+
+// ================= KØ =================
+bool MqttPublisher::publish(std::string topic, std::string payload, int qos, bool retained) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  if (stopping_) return false;
+
+  if (queue_.size() >= cfg_.queueCapacity) {
+    switch (cfg_.overflow) {
+      case OverflowPolicy::Reject:
+        stats_.dropped++;
+        return false;
+      case OverflowPolicy::DropOldest:
+        queue_.pop_front();
+        stats_.dropped++;
+        break;
+      case OverflowPolicy::Block:
+        if (!cvSpace_.wait_for(lock, cfg_.enqueueTimeout, [&] {
+              return stopping_ || queue_.size() < cfg_.queueCapacity;
+            }) || stopping_) {
+          stats_.dropped++;
+          return false;
+        }
+        break;
+    }
+  }
+
+  Outbound msg;
+  msg.topic = std::move(topic);
+  msg.payload = std::move(payload);
+  msg.qos = qos < 0 ? cfg_.defaultQos : qos;
+  msg.retained = retained;
+  queue_.push_back(std::move(msg));
+  stats_.enqueued++;
+  lock.unlock();
+  cvSend_.notify_one();
+  return true;
+}
+
+bool MqttPublisher::flush(std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  return cvSpace_.wait_for(lock, timeout, [&] {
+    return queue_.empty() && freeSlots_.size() == slots_.size();
+  });
+}
+
+PublisherStats MqttPublisher::stats() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  PublisherStats s = stats_;
+  s.queued = queue_.size();
+  s.inflight = slots_.size() - freeSlots_.size();
+  s.connected = connected_;
+  return s;
+}
+
+// ================= FORBINDELSE =================
+bool MqttPublisher::connectOnce() {
+  mqtt::connect_options opts;
+  opts.set_clean_session(cfg_.cleanSession);
+  opts.set_keep_alive_interval(cfg_.keepAliveS);
+  opts.set_max_inflight(int(cfg_.maxInflight));
+  if (!cfg_.willTopic.empty()) {
+    opts.set_will(mqtt::will_options(cfg_.willTopic, cfg_.willPayload, 1, false));
+  }
+  try {
+    client_.connect(opts)->wait();
+  } catch (const mqtt::exception& exc) {
+    std::fprintf(stderr, "MqttPublisher: forbindelse til %s fejlede: %s\n",
+                 cfg_.serverUri.c_str(), exc.what());
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    connected_ = true;
+  }
+  cvSend_.notify_all();
+  return true;
+}
+
+void MqttPublisher::connection_lost(const std::string& cause) {
+  std::fprintf(stderr, "MqttPublisher: forbindelse tabt (%s)\n", cause.c_str());
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    connected_ = false;
+    requeueInflight();
+  }
+  cvSend_.notify_all();
+}
+
+// Lægger alt ubekræftet forrest i køen igen i den oprindelige rækkefølge.
+// Kaldes med mtx_ låst.
+void MqttPublisher::requeueInflight() {
+  std::vector<size_t> busy;
+  for (size_t i = 0; i < slots_.size(); i++) {
+    if (slots_[i].busy) busy.push_back(i);
+  }
+  std::sort(busy.begin(), busy.end(), [&](size_t a, size_t b) {
+    return slots_[a].order < slots_[b].order;
+  });
+  for (auto it = busy.rbegin(); it != busy.rend(); ++it) {
+    InflightSlot& slot = slots_[*it];
+    slot.msg.attempts = 0;   // forbindelsestab tæller ikke som fejlforsøg
+    releaseSlot(*it, true);
+  }
+}
+
+// Frigiver en inflight-plads og lægger evt. beskeden forrest i køen igen.
+// Kaldes med mtx_ låst.
+void MqttPublisher::releaseSlot(size_t idx, bool requeue) {
+  InflightSlot& slot = slots_[idx];
+  if (requeue) {
+    if (cfg_.maxAttempts > 0 && slot.msg.attempts >= cfg_.maxAttempts) {
+      stats_.dropped++;
+    } else {
+      queue_.push_front(std::move(slot.msg));
+      stats_.resent++;
+    }
+  }
+  slot.busy = false;
+  freeSlots_.push_back(idx);
+}
+
+// ================= SENDER =================
+void* MqttPublisher::packContext(size_t slot, uint32_t generation) {
+  return reinterpret_cast<void*>((uintptr_t(generation) << 16) | uintptr_t(slot));
+}
+
+void MqttPublisher::unpackContext(void* ctx, size_t& slot, uint32_t& generation) {
+  uintptr_t v = reinterpret_cast<uintptr_t>(ctx);
+  slot = size_t(v & 0xFFFF);
+  generation = uint32_t(v >> 16);
+}
+
+void MqttPublisher::senderLoop() {
+  auto backoff = cfg_.reconnectMin;
+
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (!stopping_) {
+    if (!connected_) {
+      lock.unlock();
+      bool ok = connectOnce();
+      lock.lock();
+      if (ok) {
+        stats_.reconnects++;
+        backoff = cfg_.reconnectMin;
+      } else {
+        // eksponentiel backoff, men stop() afbryder ventetiden
+        cvSend_.wait_for(lock, backoff, [&] { return stopping_; });
+        backoff = std::min(backoff * 2, cfg_.reconnectMax);
+      }
+      continue;
+    }
+
+    cvSend_.wait(lock, [&] {
+      return stopping_ || !connected_ || (!queue_.empty() && !freeSlots_.empty());
+    });
+    if (stopping_ || !connected_) continue;
+
+    size_t idx = freeSlots_.back();
+    freeSlots_.pop_back();
+    InflightSlot& slot = slots_[idx];
+    slot.msg = std::move(queue_.front());
+    queue_.pop_front();
+    slot.msg.attempts++;
+    slot.busy = true;
+    slot.order = sendOrder_++;
+    slot.generation = generation_;
+    generation_ = (generation_ % 0xFFFF) + 1;   // 1..65535, pakkes i user context
+    uint32_t gen = slot.generation;
+    auto msg = mqtt::make_message(slot.msg.topic, slot.msg.payload.data(),
+                                  slot.msg.payload.size(), slot.msg.qos, slot.msg.retained);
+    lock.unlock();
+    cvSpace_.notify_all();   // plads i køen
+
+    try {
+      client_.publish(msg, packContext(idx, gen), *this);
+    } catch (const mqtt::exception&) {
+      lock.lock();
+      if (slot.busy && slot.generation == gen) releaseSlot(idx, true);
+      connected_ = client_.is_connected();
+      continue;
+    }
+    lock.lock();
+  }
+}
+
+void MqttPublisher::finish(const mqtt::token& tok, bool ok) {
+  size_t idx;
+  uint32_t gen;
+  unpackContext(tok.get_user_context(), idx, gen);
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (idx >= slots_.size()) return;
+    InflightSlot& slot = slots_[idx];
+    if (!slot.busy || slot.generation != gen) return;   // allerede lagt i kø igen
+    if (ok) stats_.acked++;
+    releaseSlot(idx, !ok);
+  }
+  cvSend_.notify_one();
+  cvSpace_.notify_all();
+}
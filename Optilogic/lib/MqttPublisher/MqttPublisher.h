@@ -0,0 +1,143 @@
+#pragma once
+// Vedvarende MQTT-publisher til host-side gateways (paho.mqtt.cpp)
+//
+// Én langlivet mqtt::async_client i stedet for connect/publish/disconnect pr.
+// besked som i den gamle paho-pubcopy.cpp. Beskeder lægges i en begrænset kø,
+// en sender-tråd holder højst maxInflight beskeder ude ad gangen, og ved
+// forbindelsestab genforbindes der med backoff, og alt der ikke er bekræftet
+// sendes igen.
+//
+// Byg med: -lpaho-mqttpp3 -lpaho-mqtt3as -pthread
+
+#include <mqtt/async_client.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Hvad publish() gør når køen er fuld
+enum class OverflowPolicy {
+  Block,        // vent på plads (op til enqueueTimeout)
+  DropOldest,   // smid ældste besked i køen
+  Reject,       // afvis den nye besked
+};
+
+struct PublisherConfig {
+  std::string serverUri = "tcp://localhost:1883";
+  std::string clientId  = "optilogic-publisher";
+  size_t   queueCapacity = 10000;   // beskeder der venter på at blive sendt
+  size_t   maxInflight   = 64;      // ubekræftede beskeder ude ad gangen
+  int      defaultQos    = 1;
+  bool     cleanSession  = true;
+  int      keepAliveS    = 30;
+  int      maxAttempts   = 5;       // afsendelsesforsøg pr. besked mens forbundet (0 = uendeligt)
+  OverflowPolicy overflow = OverflowPolicy::Block;
+  std::chrono::milliseconds enqueueTimeout{1000};
+  std::chrono::milliseconds reconnectMin{250};
+  std::chrono::milliseconds reconnectMax{10000};
+  std::string willTopic;            // tom = ingen will (fx NDEATH-topic)
+  std::string willPayload;
+};
+
+struct PublisherStats {
+  uint64_t enqueued   = 0;
+  uint64_t acked      = 0;
+  uint64_t resent     = 0;   // sendt igen efter fejl eller forbindelsestab
+  uint64_t dropped    = 0;   // smidt pga. fuld kø eller for mange forsøg
+  uint64_t reconnects = 0;
+  size_t   queued     = 0;
+  size_t   inflight   = 0;
+  bool     connected  = false;
+};
+
+class MqttPublisher : private mqtt::callback, private mqtt::iaction_listener {
+public:
+  explicit MqttPublisher(PublisherConfig cfg);
+  ~MqttPublisher() override;
+
+  MqttPublisher(const MqttPublisher&) = delete;
+  MqttPublisher& operator=(const MqttPublisher&) = delete;
+
+  /**
+   * @brief Forbinder og starter sender-tråden
+   *
+   * @return false hvis første forbindelse fejler (der forsøges dog igen i baggrunden)
+   */
+  bool start();
+
+  /**
+   * @brief Venter op til drainTimeout på at køen tømmes og afbryder derefter
+   */
+  void stop(std::chrono::milliseconds drainTimeout = std::chrono::milliseconds(5000));
+
+  /**
+   * @brief Lægger en besked i udgående kø
+   *
+   * @param qos -1 = defaultQos
+   * @return false hvis beskeden blev afvist (fuld kø eller stoppet)
+   */
+  bool publish(std::string topic, std::string payload, int qos = -1, bool retained = false);
+
+  /**
+   * @brief Venter til kø og inflight er tomme
+   *
+   * @return false ved timeout
+   */
+  bool flush(std::chrono::milliseconds timeout);
+
+  PublisherStats stats() const;
+
+private:
+  struct Outbound {
+    std::string topic;
+    std::string payload;
+    int  qos = 1;
+    bool retained = false;
+    int  attempts = 0;
+  };
+
+  // Én plads pr. inflight-besked; generation gør sene callbacks fra en
+  // tidligere forbindelse ufarlige efter de er lagt tilbage i køen
+  struct InflightSlot {
+    Outbound msg;
+    uint64_t order = 0;        // afsendelsesrækkefølge, bruges ved requeue
+    uint32_t generation = 0;
+    bool     busy = false;
+  };
+
+  void senderLoop();
+  bool connectOnce();
+  void requeueInflight();
+  void releaseSlot(size_t idx, bool requeue);
+  void finish(const mqtt::token& tok, bool ok);
+  static void* packContext(size_t slot, uint32_t generation);
+  static void unpackContext(void* ctx, size_t& slot, uint32_t& generation);
+
+  // mqtt::callback
+  void connection_lost(const std::string& cause) override;
+  // mqtt::iaction_listener
+  void on_success(const mqtt::token& tok) override { finish(tok, true); }
+  void on_failure(const mqtt::token& tok) override { finish(tok, false); }
+
+  PublisherConfig cfg_;
+  mqtt::async_client client_;
+
+  mutable std::mutex mtx_;
+  std::condition_variable cvSend_;    // sender-tråden: ny besked, ledig plads, forbindelse
+  std::condition_variable cvSpace_;   // publish()/flush(): plads i kø, færdig inflight
+  std::deque<Outbound> queue_;
+  std::vector<InflightSlot> slots_;
+  std::vector<size_t> freeSlots_;
+  uint32_t generation_ = 1;
+  uint64_t sendOrder_ = 0;
+  bool connected_ = false;
+  bool stopping_ = false;
+  PublisherStats stats_;
+
+  std::thread sender_;
+};
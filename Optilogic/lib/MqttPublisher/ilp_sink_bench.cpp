@@ -0,0 +1,65 @@
+// Throughput-benchmark for IlpSink mod ilp_standin (eller en rigtig QuestDB)
+//
+// Skubber samme antal rækker igennem med forskellige batchstørrelser;
+// max-rows 1 svarer til én skrivning pr. MQTT-besked som i SPB_ingester.py.
+//
+// Byg:   g++ -std=c++17 -O2 -pthread IlpSink.cpp ilp_sink_bench.cpp -o ilp_sink_bench
+// Kør:   ./ilp_standin --port 9009 &
+//        ./ilp_sink_bench tcp localhost 9009 200000 100
+//        (tcp|http, host, port, rækker, devices)
+
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "IlpSink.h"
+
+using Clock = std::chrono::steady_clock;
+
+static void run(const IlpSinkConfig& base, size_t maxRows, size_t rows, size_t devices) {
+  IlpSinkConfig cfg = base;
+  cfg.maxRows = maxRows;
+  cfg.maxAge = std::chrono::milliseconds(50);
+
+  std::vector<std::string> names;
+  for (size_t d = 0; d < devices; d++) names.push_back("dev-" + std::to_string(d));
+
+  IlpSink sink(cfg);
+  sink.start();
+  auto start = Clock::now();
+  uint64_t ts = 1700000000000000000ull;
+  for (size_t i = 0; i < rows; i++) {
+    double values[3] = {20.0 + (i % 100) * 0.1, 2.0 + (i % 7) * 0.01, double(900 + i % 300)};
+    if (i % 50 == 0) values[1] = NAN;   // manglende felt skal springes over
+    sink.add(names[i % devices], ts + i * 1000, values);
+  }
+  sink.stop(std::chrono::milliseconds(30000));
+  double s = std::chrono::duration<double>(Clock::now() - start).count();
+
+  IlpSinkStats st = sink.stats();
+  std::printf("max-rows %-6zu %8" PRIu64 " rækker  %6" PRIu64 " batches  %8.3f s  %10.0f rækker/s"
+              "  %6.1f MB/s  retries %" PRIu64 "  droppet %" PRIu64 "\n",
+              maxRows, st.rowsSent, st.batches, s, st.rowsSent / s, st.bytesSent / s / 1e6,
+              st.retries, st.rowsDropped);
+}
+
+int main(int argc, char** argv) {
+  IlpSinkConfig cfg;
+  cfg.http       = argc > 1 && std::string(argv[1]) == "http";
+  cfg.host       = argc > 2 ? argv[2] : "localhost";
+  cfg.port       = uint16_t(argc > 3 ? std::atoi(argv[3]) : 9009);
+  size_t rows    = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 200000;
+  size_t devices = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 100;
+  if (devices == 0) devices = 1;
+
+  std::printf("ILP over %s til %s:%u, %zu rækker fordelt på %zu devices\n",
+              cfg.http ? "HTTP" : "TCP", cfg.host.c_str(), unsigned(cfg.port), rows, devices);
+  // én række pr. skrivning er langsom, så den får færre rækker
+  run(cfg, 1, std::min<size_t>(rows, 20000), devices);
+  for (size_t maxRows : {100, 1000, 5000, 20000}) run(cfg, maxRows, rows, devices);
+  return 0;
+}
@@ -0,0 +1,187 @@
+// Lokal ILP stand-in for QuestDB: tæller linjer over TCP (9009) og HTTP (/write)
+//
+// Bruges til at måle IlpSink/spb_bridge uden en rigtig QuestDB. Protokollen
+// gættes pr. forbindelse: starter den med "POST " svares der 204 pr. request,
+// ellers læses rå TCP-ILP. --fail-every lukker forbindelsen efter hver N'te
+// læsning/request, så retry efter genforbindelse kan afprøves.
+//
+// Byg:   g++ -std=c++17 -O2 -pthread ilp_standin.cpp -o ilp_standin
+// Kør:   ./ilp_standin --port 9009 --fail-every 0 --dump 0
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+static std::atomic<bool> running{true};
+static void onSignal(int) { running = false; }
+
+static std::atomic<uint64_t> totalLines{0};
+static std::atomic<uint64_t> totalBytes{0};
+static std::atomic<uint64_t> totalRequests{0};
+static std::atomic<uint64_t> totalDropped{0};   // forbindelser lukket med vilje
+
+struct StandinConfig {
+  uint16_t port      = 9009;
+  int      failEvery = 0;   // 0 = aldrig
+  int      dump      = 0;   // skriv de første N linjer til stdout
+};
+
+static std::atomic<int> dumped{0};
+
+static void countLines(const char* p, size_t n, const StandinConfig& cfg) {
+  uint64_t lines = 0;
+  const char* end = p + n;
+  const char* line = p;
+  for (const char* c = p; c < end; c++) {
+    if (*c != '\n') continue;
+    lines++;
+    if (cfg.dump > 0 && dumped.fetch_add(1) < cfg.dump) {
+      std::printf("%.*s\n", int(c - line), line);
+    }
+    line = c + 1;
+  }
+  totalLines += lines;
+  totalBytes += n;
+}
+
+static bool sendAll(int fd, const char* p, size_t n) {
+  while (n > 0) {
+    ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+    if (w <= 0) return false;
+    p += w;
+    n -= size_t(w);
+  }
+  return true;
+}
+
+// ================= HTTP /write =================
+static void serveHttp(int fd, std::string buf, const StandinConfig& cfg) {
+  static const char RESPONSE[] = "HTTP/1.1 204 No Content\r\nContent-Length: 0\r\n\r\n";
+  char chunk[64 * 1024];
+  int requests = 0;
+  while (running) {
+    size_t headerEnd;
+    while ((headerEnd = buf.find("\r\n\r\n")) == std::string::npos) {
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if (n <= 0) return;
+      buf.append(chunk, size_t(n));
+    }
+    size_t contentLength = 0;
+    const char* cl = strcasestr(buf.c_str(), "content-length:");
+    if (cl && size_t(cl - buf.c_str()) < headerEnd) contentLength = std::strtoul(cl + 15, nullptr, 10);
+    size_t bodyStart = headerEnd + 4;
+    while (buf.size() < bodyStart + contentLength) {
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if (n <= 0) return;
+      buf.append(chunk, size_t(n));
+    }
+    if (cfg.failEvery > 0 && ++requests % cfg.failEvery == 0) {
+      totalDropped++;
+      return;   // ingen ack: klienten skal sende batchen igen
+    }
+    countLines(buf.data() + bodyStart, contentLength, cfg);
+    totalRequests++;
+    if (!sendAll(fd, RESPONSE, sizeof(RESPONSE) - 1)) return;
+    buf.erase(0, bodyStart + contentLength);
+  }
+}
+
+// ================= TCP ILP =================
+static void serveTcp(int fd, const std::string& first, const StandinConfig& cfg) {
+  char chunk[64 * 1024];
+  int reads = 0;
+  countLines(first.data(), first.size(), cfg);
+  while (running) {
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) return;
+    // QuestDB lukker også bare forbindelsen ved fejl; det der er læst er tabt
+    if (cfg.failEvery > 0 && ++reads % cfg.failEvery == 0) {
+      totalDropped++;
+      return;
+    }
+    countLines(chunk, size_t(n), cfg);
+  }
+}
+
+static void serveClient(int fd, StandinConfig cfg) {
+  char chunk[4096];
+  ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+  if (n > 0) {
+    std::string first(chunk, size_t(n));
+    if (first.compare(0, 5, "POST ") == 0) serveHttp(fd, std::move(first), cfg);
+    else                                   serveTcp(fd, first, cfg);
+  }
+  close(fd);
+}
+
+// ================= MAIN =================
+static bool parseArgs(int argc, char** argv, StandinConfig& cfg) {
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) return false;
+    const char* v = argv[++i];
+    if (a == "--port")            cfg.port = uint16_t(std::atoi(v));
+    else if (a == "--fail-every") cfg.failEvery = std::max(0, std::atoi(v));
+    else if (a == "--dump")       cfg.dump = std::max(0, std::atoi(v));
+    else return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  StandinConfig cfg;
+  if (!parseArgs(argc, argv, cfg)) {
+    std::fprintf(stderr, "Brug: %s [--port N] [--fail-every N] [--dump N]\n", argv[0]);
+    return 1;
+  }
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(cfg.port);
+  if (bind(lfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(lfd, 64) < 0) {
+    std::perror("ilp_standin: bind/listen");
+    return 1;
+  }
+  std::printf("ilp_standin: lytter på port %u\n", unsigned(cfg.port));
+  std::fflush(stdout);
+
+  std::thread acceptor([&] {
+    while (running) {
+      int fd = accept(lfd, nullptr, nullptr);
+      if (fd < 0) continue;
+      std::thread(serveClient, fd, cfg).detach();
+    }
+  });
+  acceptor.detach();
+
+  uint64_t last = 0;
+  while (running) {
+    sleep(1);
+    uint64_t lines = totalLines.load();
+    if (lines != last) {
+      std::printf("[1s] %8" PRIu64 " linjer/s  i alt %" PRIu64 " linjer, %" PRIu64 " bytes, %" PRIu64
+                  " requests, %" PRIu64 " lukket\n",
+                  lines - last, lines, totalBytes.load(), totalRequests.load(), totalDropped.load());
+      std::fflush(stdout);
+    }
+    last = lines;
+  }
+  std::printf("ilp_standin: %" PRIu64 " linjer modtaget\n", totalLines.load());
+  return 0;
+}
@@ -0,0 +1,104 @@
+// Throughput-benchmark: connect pr. besked vs. vedvarende klient vs. MqttPublisher
+//
+// Byg:   g++ -std=c++17 -O2 -pthread MqttPublisher.cpp mqtt_publisher_bench.cpp
+//            -o mqtt_publisher_bench -lpaho-mqttpp3 -lpaho-mqtt3as
+// Kør:   ./mqtt_publisher_bench tcp://localhost:1883 20000 64 1
+//        (broker, antal beskeder, payload-bytes, QoS)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "MqttPublisher.h"
+
+using Clock = std::chrono::steady_clock;
+
+static const char* TOPIC = "spBv1.0/bench/DDATA/publisher";
+
+static double seconds(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void result(const char* name, size_t count, double s) {
+  std::printf("%-28s %8zu msg  %8.3f s  %10.0f msg/s\n", name, count, s, count / s);
+}
+
+// Som den gamle paho-pubcopy.cpp: ny forbindelse for hver besked
+static void benchConnectPerMessage(const std::string& uri, size_t count,
+                                   const std::string& payload, int qos) {
+  auto start = Clock::now();
+  for (size_t i = 0; i < count; i++) {
+    mqtt::async_client client(uri, "bench-connect-per-msg");
+    mqtt::connect_options opts;
+    opts.set_clean_session(true);
+    client.connect(opts)->wait();
+    client.publish(TOPIC, payload.data(), payload.size(), qos, false)->wait();
+    client.disconnect()->wait();
+  }
+  result("connect pr. besked", count, seconds(start));
+}
+
+// Én forbindelse, men der ventes på hver besked før den næste sendes
+static void benchPersistentSync(const std::string& uri, size_t count,
+                                const std::string& payload, int qos) {
+  mqtt::async_client client(uri, "bench-persistent-sync");
+  mqtt::connect_options opts;
+  opts.set_clean_session(true);
+  client.connect(opts)->wait();
+  auto start = Clock::now();
+  for (size_t i = 0; i < count; i++) {
+    client.publish(TOPIC, payload.data(), payload.size(), qos, false)->wait();
+  }
+  result("vedvarende, synkron", count, seconds(start));
+  client.disconnect()->wait();
+}
+
+static void benchPublisher(const std::string& uri, size_t count, const std::string& payload,
+                           int qos, size_t window) {
+  PublisherConfig cfg;
+  cfg.serverUri = uri;
+  cfg.clientId = "bench-publisher";
+  cfg.maxInflight = window;
+  cfg.defaultQos = qos;
+  MqttPublisher pub(cfg);
+  if (!pub.start()) return;
+
+  auto start = Clock::now();
+  for (size_t i = 0; i < count; i++) pub.publish(TOPIC, payload);
+  bool done = pub.flush(std::chrono::seconds(60));
+  double s = seconds(start);
+
+  char name[64];
+  std::snprintf(name, sizeof(name), "MqttPublisher vindue=%zu", window);
+  result(name, count, s);
+  PublisherStats st = pub.stats();
+  if (!done || st.acked != count) {
+    std::printf("  advarsel: acked=%llu dropped=%llu resent=%llu\n",
+                (unsigned long long)st.acked, (unsigned long long)st.dropped,
+                (unsigned long long)st.resent);
+  }
+  pub.stop();
+}
+
+int main(int argc, char** argv) {
+  std::string uri = argc > 1 ? argv[1] : "tcp://localhost:1883";
+  size_t count    = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+  size_t bytes    = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 64;
+  int qos         = argc > 4 ? std::atoi(argv[4]) : 1;
+
+  std::string payload(bytes, 'x');
+  std::printf("Broker %s, %zu beskeder a %zu bytes, QoS %d\n\n", uri.c_str(), count, bytes, qos);
+
+  try {
+    // connect pr. besked er så langsom at den kun køres på en brøkdel
+    benchConnectPerMessage(uri, std::max<size_t>(1, count / 100), payload, qos);
+    benchPersistentSync(uri, count, payload, qos);
+    for (size_t window : {1, 16, 64, 256}) benchPublisher(uri, count, payload, qos, window);
+  } catch (const mqtt::exception& exc) {
+    std::fprintf(stderr, "Fejl: %s\n", exc.what());
+    return 1;
+  }
+  return 0;
+}
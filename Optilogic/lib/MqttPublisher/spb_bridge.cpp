@@ -0,0 +1,284 @@
+// Sparkplug B -> QuestDB bridge: abonnerer på spBv1.0/<group>/# og skriver ILP i batches
+//
+// C++-udgaven af SPB_ingester.py uden én INSERT pr. besked. DBIRTH/DDATA
+// dekodes zero-copy med spb::Decoder (aliaser læres pr. edge node fra BIRTH),
+// text- og flad JSON-payload (temp=..,tryk=..,rpm=.. / {"temp":..}) understøttes
+// som i ingestorerne, og rækkerne går til IlpSink. Uplink-batches (0xFF 'B',
+// se UplinkBatch.h) pakkes ud til én række pr. sample med samplets tidsstempel.
+//
+// Byg:   g++ -std=c++17 -O2 -pthread -I../SparkplugB -I../UplinkBatch IlpSink.cpp spb_bridge.cpp
+//            -o spb_bridge -lpaho-mqttpp3 -lpaho-mqtt3as
+// Kør:   ./spb_bridge --broker tcp://localhost:1883 --group plantA
+//            --ilp tcp://localhost:9009 --max-rows 5000 --max-age-ms 250
+
+#include <mqtt/async_client.h>
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "IlpSink.h"
+#include "SparkplugDecoder.h"
+#include "UplinkBatch.h"
+
+static std::atomic<bool> running{true};
+static void onSignal(int) { running = false; }
+
+static const char* COLUMN_NAMES[] = {"temp", "tryk", "rpm"};
+static const size_t NUM_COLUMNS = 3;
+
+static uint64_t epochNs() {
+  using namespace std::chrono;
+  return uint64_t(duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count());
+}
+
+// ================= KONFIGURATION =================
+struct BridgeConfig {
+  std::string broker   = "tcp://localhost:1883";
+  std::string clientId = "spb-bridge";
+  std::string group    = "plantA";
+  int         qos      = 1;
+  IlpSinkConfig ilp;
+};
+
+// "tcp://host:9009" eller "http://host:9000"
+static bool parseIlpUri(const std::string& uri, IlpSinkConfig& cfg) {
+  size_t sep = uri.find("://");
+  if (sep == std::string::npos) return false;
+  std::string scheme = uri.substr(0, sep);
+  std::string rest = uri.substr(sep + 3);
+  if (scheme == "tcp")       { cfg.http = false; cfg.port = 9009; }
+  else if (scheme == "http") { cfg.http = true;  cfg.port = 9000; }
+  else return false;
+  size_t colon = rest.rfind(':');
+  if (colon != std::string::npos) {
+    cfg.port = uint16_t(std::atoi(rest.c_str() + colon + 1));
+    rest.resize(colon);
+  }
+  if (!rest.empty()) cfg.host = rest;
+  return true;
+}
+
+// ================= FALLBACK-PAYLOADS =================
+static int columnIndex(const char* name, size_t len) {
+  for (size_t i = 0; i < NUM_COLUMNS; i++) {
+    if (std::strlen(COLUMN_NAMES[i]) == len && std::memcmp(COLUMN_NAMES[i], name, len) == 0) return int(i);
+  }
+  return -1;
+}
+
+// temp=21.5,tryk=2.2,rpm=1000 eller {"temp":21.5,"tryk":2.2,"rpm":1000}
+static bool parseFlat(const std::string& s, double* values) {
+  bool any = false;
+  size_t i = 0;
+  const size_t n = s.size();
+  while (i < n) {
+    while (i < n && (s[i] == '{' || s[i] == ',' || s[i] == ' ' || s[i] == '"' || s[i] == '\n')) i++;
+    size_t keyStart = i;
+    while (i < n && s[i] != '=' && s[i] != ':' && s[i] != '"') i++;
+    size_t keyEnd = i;
+    while (i < n && (s[i] == '"' || s[i] == ' ')) i++;
+    if (i >= n || (s[i] != '=' && s[i] != ':')) break;
+    i++;
+    char* end = nullptr;
+    double v = std::strtod(s.c_str() + i, &end);
+    if (end == s.c_str() + i) {
+      while (i < n && s[i] != ',') i++;   // ikke et tal, spring over
+      continue;
+    }
+    i = size_t(end - s.c_str());
+    int col = columnIndex(s.data() + keyStart, keyEnd - keyStart);
+    if (col >= 0) {
+      values[col] = v;
+      any = true;
+    }
+  }
+  return any;
+}
+
+// ================= BRIDGE =================
+class Bridge : public mqtt::callback {
+public:
+  Bridge(const BridgeConfig& cfg, IlpSink& sink)
+      : cfg_(cfg), sink_(sink), client_(cfg.broker, cfg.clientId) {
+    client_.set_callback(*this);
+    batch_.reserve(16);
+    scratch_.resize(lzss::MAX_INPUT);
+  }
+
+  bool connect() {
+    mqtt::connect_options opts;
+    opts.set_clean_session(true);
+    opts.set_keep_alive_interval(30);
+    opts.set_automatic_reconnect(std::chrono::seconds(1), std::chrono::seconds(30));
+    try {
+      client_.connect(opts)->wait();
+    } catch (const mqtt::exception& exc) {
+      std::fprintf(stderr, "spb_bridge: forbindelse til %s fejlede: %s\n", cfg_.broker.c_str(), exc.what());
+      return false;
+    }
+    return true;
+  }
+
+  void disconnect() {
+    try {
+      client_.disconnect()->wait();
+    } catch (const mqtt::exception&) {
+    }
+  }
+
+  uint64_t messages() const { return messages_.load(); }
+  uint64_t undecodable() const { return undecodable_.load(); }
+
+private:
+  // (gen)abonnér ved hver forbindelse, også efter automatic reconnect
+  void connected(const std::string&) override {
+    std::string filter = "spBv1.0/" + cfg_.group + "/#";
+    client_.subscribe(filter, cfg_.qos);
+    std::printf("spb_bridge: abonnerer på %s\n", filter.c_str());
+  }
+
+  void connection_lost(const std::string& cause) override {
+    std::fprintf(stderr, "spb_bridge: forbindelse tabt (%s)\n", cause.c_str());
+  }
+
+  // spBv1.0/<group>/<type>/<node>[/<device>]
+  void message_arrived(mqtt::const_message_ptr msg) override {
+    const std::string& topic = msg->get_topic();
+    size_t p1 = topic.find('/');
+    size_t p2 = p1 == std::string::npos ? p1 : topic.find('/', p1 + 1);
+    size_t p3 = p2 == std::string::npos ? p2 : topic.find('/', p2 + 1);
+    if (p3 == std::string::npos) return;
+    std::string type = topic.substr(p2 + 1, p3 - p2 - 1);
+    if (type != "DDATA" && type != "DBIRTH" && type != "NDATA") return;
+    size_t p4 = topic.find('/', p3 + 1);
+    std::string node = topic.substr(p3 + 1, p4 == std::string::npos ? std::string::npos : p4 - p3 - 1);
+    // firmwaren publicerer uden device-led, så noden bruges som device
+    std::string device = p4 == std::string::npos ? node : topic.substr(p4 + 1);
+    messages_++;
+
+    const std::string& payload = msg->get_payload();
+    auto it = decoders_.find(node);
+    if (it == decoders_.end()) {
+      it = decoders_.emplace(node, spb::Decoder({COLUMN_NAMES, COLUMN_NAMES + NUM_COLUMNS})).first;
+    }
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(payload.data());
+    if (!uplink::isBatch(data, payload.size())) {
+      addSample(device, it->second, payload, 0);
+      return;
+    }
+    int n = uplink::forEach(data, payload.size(), scratch_.data(), scratch_.size(), [&](const uplink::Entry& e) {
+      addSample(device, it->second, std::string(reinterpret_cast<const char*>(e.payload), e.len),
+                e.tsMs > 0 ? uint64_t(e.tsMs) * 1000000ull : 0);   // ms -> ns
+    });
+    if (n < 0) undecodable_++;   // ødelagt envelope; samples før fejlen er allerede skrevet
+  }
+
+  // Én række fra ét payload; tsNs er envelopens tid (0 = ukendt), Sparkplug-tidsstemplet går forud
+  void addSample(const std::string& device, spb::Decoder& decoder, const std::string& payload, uint64_t tsNs) {
+    double values[NUM_COLUMNS];
+    for (double& v : values) v = NAN;
+
+    batch_.clear();
+    if (decoder.decode(reinterpret_cast<const uint8_t*>(payload.data()), payload.size(), batch_) &&
+        batch_.size() > 0) {
+      bool stamped = false;
+      for (size_t i = 0; i < batch_.size(); i++) {
+        values[batch_.column[i]] = batch_.isInteger[i] ? double(batch_.intValue[i]) : batch_.value[i];
+        if (!stamped && batch_.timestamp[i]) {
+          tsNs = batch_.timestamp[i] * 1000000ull;   // ms -> ns
+          stamped = true;
+        }
+      }
+    } else if (!parseFlat(payload, values)) {
+      undecodable_++;
+      return;
+    }
+    sink_.add(device, tsNs ? tsNs : epochNs(), values);
+  }
+
+  const BridgeConfig& cfg_;
+  IlpSink& sink_;
+  mqtt::async_client client_;
+  // kun paho's callback-tråd rører disse
+  std::unordered_map<std::string, spb::Decoder> decoders_;
+  spb::MetricBatch batch_;
+  std::vector<uint8_t> scratch_;   // udpakket batch-body (højst lzss::MAX_INPUT)
+  std::atomic<uint64_t> messages_{0};
+  std::atomic<uint64_t> undecodable_{0};
+};
+
+// ================= MAIN =================
+static void usage(const char* prog) {
+  std::fprintf(stderr,
+               "Brug: %s [options]\n"
+               "  --broker URI       MQTT broker (default tcp://localhost:1883)\n"
+               "  --group NAME       Sparkplug group id (default plantA)\n"
+               "  --qos N            abonnements-QoS (default 1)\n"
+               "  --ilp URI          tcp://host:9009 (ILP/TCP) eller http://host:9000 (ILP/HTTP med ack)\n"
+               "  --table NAME       QuestDB-tabel (default sensor_data)\n"
+               "  --max-rows N       flush ved N rækker (default 5000)\n"
+               "  --max-bytes N      flush ved ca. N bytes (default 524288)\n"
+               "  --max-age-ms N     flush senest efter N ms (default 250)\n",
+               prog);
+}
+
+static bool parseArgs(int argc, char** argv, BridgeConfig& cfg) {
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) return false;
+    const char* v = argv[++i];
+    if (a == "--broker")          cfg.broker = v;
+    else if (a == "--group")      cfg.group = v;
+    else if (a == "--qos")        cfg.qos = std::atoi(v);
+    else if (a == "--ilp")        { if (!parseIlpUri(v, cfg.ilp)) return false; }
+    else if (a == "--table")      cfg.ilp.table = v;
+    else if (a == "--max-rows")   cfg.ilp.maxRows = std::strtoul(v, nullptr, 10);
+    else if (a == "--max-bytes")  cfg.ilp.maxBytes = std::strtoul(v, nullptr, 10);
+    else if (a == "--max-age-ms") cfg.ilp.maxAge = std::chrono::milliseconds(std::atoi(v));
+    else return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  BridgeConfig cfg;
+  cfg.ilp.port = 9009;
+  if (!parseArgs(argc, argv, cfg)) {
+    usage(argv[0]);
+    return 1;
+  }
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+
+  IlpSink sink(cfg.ilp);
+  sink.start();
+  Bridge bridge(cfg, sink);
+  if (!bridge.connect()) return 1;
+
+  uint64_t lastRows = 0;
+  while (running) {
+    std::this_thread::sleep_for(std::chrono::seconds(5));
+    IlpSinkStats s = sink.stats();
+    std::printf("[5s] beskeder %" PRIu64 "  rækker %" PRIu64 " (%.0f/s)  batches %" PRIu64
+                "  retries %" PRIu64 "  droppet %" PRIu64 "  ukendt payload %" PRIu64 "\n",
+                bridge.messages(), s.rowsSent, (s.rowsSent - lastRows) / 5.0, s.batches,
+                s.retries, s.rowsDropped, bridge.undecodable());
+    lastRows = s.rowsSent;
+  }
+
+  bridge.disconnect();
+  sink.stop();
+  IlpSinkStats s = sink.stats();
+  std::printf("spb_bridge: %" PRIu64 " rækker sendt, %" PRIu64 " droppet\n", s.rowsSent, s.rowsDropped);
+  return 0;
+}
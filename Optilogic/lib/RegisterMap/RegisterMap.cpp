@@ -0,0 +1,225 @@
+#include "RegisterMap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace regmap {
+
+namespace {
+
+struct Field {
+  const char* p;
+  size_t n;
+};
+
+bool equals(const Field& f, const char* s) {
+  size_t n = strlen(s);
+  return f.n == n && memcmp(f.p, s, n) == 0;
+}
+
+Field trim(const char* p, size_t n) {
+  while (n && (*p == ' ' || *p == '\t' || *p == '\r')) { p++; n--; }
+  while (n && (p[n - 1] == ' ' || p[n - 1] == '\t' || p[n - 1] == '\r')) n--;
+  return Field{p, n};
+}
+
+// Ikke-negativt heltal; false ved andet end cifre eller over max
+bool number(const Field& f, uint32_t max, uint32_t& out) {
+  if (f.n == 0 || f.n > 5) return false;
+  uint32_t v = 0;
+  for (size_t i = 0; i < f.n; i++) {
+    if (f.p[i] < '0' || f.p[i] > '9') return false;
+    v = v * 10 + uint32_t(f.p[i] - '0');
+  }
+  if (v > max) return false;
+  out = v;
+  return true;
+}
+
+// Navne går ukvoteret i JSON-nøgler, Sparkplug-births, ILP-kolonner og
+// /api/regmap, så kun [A-Za-z0-9_] tillades
+bool validName(const char* p, size_t n) {
+  if (n == 0 || n >= MAX_NAME) return false;
+  for (size_t i = 0; i < n; i++) {
+    char c = p[i];
+    if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_')) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+// ================= OPSLAG =================
+int CompiledMap::slotOf(const char* name) const {
+  for (size_t i = 0; i < entryCount_; i++) {
+    if (strcmp(names_[i], name) == 0) return int(i);
+  }
+  return -1;
+}
+
+// ================= PARSE =================
+bool CompiledMap::compile(const char* doc, size_t len, const char*& err) {
+  clear();
+  err = nullptr;
+  if (len > MAX_DOC) { err = "dokument for langt"; return false; }
+
+  // linjer i dokumentets rækkefølge (slot = linjenummer blandt metrics)
+  Definition defs[MAX_ENTRIES];
+  char names[MAX_ENTRIES][MAX_NAME];
+  size_t count = 0;
+  const char* end = doc + len;
+  const char* line = doc;
+  while (line < end) {
+    const char* eol = line;
+    while (eol < end && *eol != '\n' && *eol != ';') eol++;
+    Field l = trim(line, size_t(eol - line));
+    line = eol + 1;
+    if (l.n == 0 || l.p[0] == '#') continue;
+
+    Field f[5];
+    size_t nf = 0;
+    const char* s = l.p;
+    const char* lend = l.p + l.n;
+    while (s <= lend && nf < 5) {
+      const char* c = s;
+      while (c < lend && *c != ',') c++;
+      f[nf++] = trim(s, size_t(c - s));
+      s = c + 1;
+    }
+    if (s <= lend) { err = "for mange felter"; return false; }
+    if (nf < 4) { err = "forventer navn,tabel,register,decimaler[,s]"; return false; }
+    if (count >= MAX_ENTRIES) { err = "for mange metrics"; return false; }
+
+    if (!validName(f[0].p, f[0].n)) { err = "navn skal være 1-15 tegn af A-Z, a-z, 0-9 og _"; return false; }
+    Definition& d = defs[count];
+    if (equals(f[1], "ir") || equals(f[1], "input"))        d.table = INPUT_REG;
+    else if (equals(f[1], "hr") || equals(f[1], "holding")) d.table = HOLDING_REG;
+    else { err = "tabel skal være ir eller hr"; return false; }
+    uint32_t reg, dec;
+    if (!number(f[2], 0xFFFF, reg)) { err = "ugyldigt register"; return false; }
+    if (!number(f[3], 6, dec))      { err = "decimaler skal være 0-6"; return false; }
+    d.reg = uint16_t(reg);
+    d.decimals = uint8_t(dec);
+    d.isSigned = false;
+    if (nf == 5) {
+      if (equals(f[4], "s"))      d.isSigned = true;
+      else if (!equals(f[4], "u")) { err = "femte felt skal være s eller u"; return false; }
+    }
+    memcpy(names[count], f[0].p, f[0].n);
+    names[count][f[0].n] = '\0';
+    d.name = names[count];
+    count++;
+  }
+  return build(defs, count, err);
+}
+
+// ================= KOMPILERING =================
+bool CompiledMap::build(const Definition* defs, size_t count, const char*& err) {
+  clear();
+  err = nullptr;
+  if (count == 0) { err = "ingen metrics"; return false; }
+  if (count > MAX_ENTRIES) { err = "for mange metrics"; return false; }
+
+  // 1) validér og kopiér navne (slot = index i defs)
+  Entry parsed[MAX_ENTRIES];
+  for (size_t i = 0; i < count; i++) {
+    const Definition& d = defs[i];
+    size_t n = d.name ? strlen(d.name) : 0;
+    if (!validName(d.name, n)) { err = "navn skal være 1-15 tegn af A-Z, a-z, 0-9 og _"; return false; }
+    if (d.decimals > 6) { err = "decimaler skal være 0-6"; return false; }
+    if (d.table != INPUT_REG && d.table != HOLDING_REG) { err = "tabel skal være ir eller hr"; return false; }
+    memcpy(names_[i], d.name, n + 1);
+    for (size_t j = 0; j < i; j++) {
+      if (strcmp(names_[j], names_[i]) == 0) { err = "navn findes allerede"; return false; }
+    }
+    Entry& e = parsed[i];
+    e.reg = d.reg;
+    e.table = d.table;
+    e.decimals = d.decimals;
+    e.isSigned = d.isSigned ? 1 : 0;
+    e.slot = uint8_t(i);
+    e.offset = 0;
+    slotDecimals_[i] = d.decimals;
+  }
+
+  // 2) sortér efter (tabel, register); højst 32 entries, så indsættelsessortering
+  for (size_t i = 1; i < count; i++) {
+    Entry e = parsed[i];
+    size_t j = i;
+    while (j > 0 && (parsed[j - 1].table > e.table ||
+                     (parsed[j - 1].table == e.table && parsed[j - 1].reg > e.reg))) {
+      parsed[j] = parsed[j - 1];
+      j--;
+    }
+    parsed[j] = e;
+  }
+
+  // 3) læseplan: slå registre i samme tabel sammen når hullet er lille
+  size_t reads = 0;
+  for (size_t i = 0; i < count; i++) {
+    Entry& e = parsed[i];
+    ReadOp* op = reads ? &reads_[reads - 1] : nullptr;
+    bool extend = op && op->table == e.table &&
+                  uint32_t(e.reg) + 1 - op->start <= MAX_BLOCK &&
+                  uint32_t(e.reg) <= uint32_t(op->start) + op->count + MAX_GAP;
+    if (!extend) {
+      if (reads >= MAX_READS) { err = "for mange læseblokke"; return false; }
+      op = &reads_[reads++];
+      op->table = e.table;
+      op->start = e.reg;
+      op->count = 1;
+      op->firstEntry = uint8_t(i);
+      op->entryCount = 0;
+    }
+    if (e.reg + 1u - op->start > op->count) op->count = uint16_t(e.reg + 1u - op->start);
+    e.offset = uint16_t(e.reg - op->start);
+    op->entryCount++;
+  }
+
+  memcpy(entries_, parsed, count * sizeof(Entry));
+  entryCount_ = count;
+  readCount_ = reads;
+  return true;
+}
+
+// ================= DOBBELTBUFFER =================
+template <class Compile>
+bool RegisterMap::loadWith(Compile&& compile, const char*& err,
+                           const char* const* required, size_t requiredCount) {
+  if (loading_.exchange(true, std::memory_order_acquire)) {
+    err = "et andet map indlæses";
+    return false;
+  }
+  // Først efter loading_ er taget: ellers kan en anden load nå at markere
+  // reservebufferen klar, og poll-løkken skifte den ind mens der kompileres i den
+  if (pending_.load(std::memory_order_acquire)) {
+    loading_.store(false, std::memory_order_release);
+    err = "forrige map er ikke skiftet ind endnu";
+    return false;
+  }
+  uint8_t spare = uint8_t(1 - active_.load(std::memory_order_acquire));
+  bool ok = compile(maps_[spare]);
+  for (size_t i = 0; ok && i < requiredCount; i++) {
+    if (maps_[spare].slotOf(required[i]) < 0) {
+      err = "mangler en påkrævet metric";
+      ok = false;
+    }
+  }
+  if (ok) pending_.store(true, std::memory_order_release);
+  loading_.store(false, std::memory_order_release);
+  return ok;
+}
+
+bool RegisterMap::load(const char* doc, size_t len, const char*& err,
+                       const char* const* required, size_t requiredCount) {
+  return loadWith([&](CompiledMap& m) { return m.compile(doc, len, err); },
+                  err, required, requiredCount);
+}
+
+bool RegisterMap::load(const Definition* defs, size_t count, const char*& err,
+                       const char* const* required, size_t requiredCount) {
+  return loadWith([&](CompiledMap& m) { return m.build(defs, count, err); },
+                  err, required, requiredCount);
+}
+
+}  // namespace regmap
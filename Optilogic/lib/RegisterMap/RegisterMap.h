@@ -0,0 +1,179 @@
+#pragma once
+// Register-map der kan skiftes under drift (MQTT, gemt i NVS)
+//
+// Et map-dokument er én linje pr. metric, adskilt af linjeskift eller ';':
+//   # navn,tabel,register,decimaler[,s]
+//   temp,ir,19,1        input register 19, én decimal
+//   tryk,ir,13,1
+//   rpm,ir,15,0
+//   ai1,ir,25,1,s       s = signed (int16)
+// tabel er ir (input, FC04) eller hr (holding, FC03); registre er 0-baserede
+// som i koden (dokumentets nummer - 1). Navne er 1-15 tegn af A-Z, a-z, 0-9
+// og _, da de skrives uændret i JSON, Sparkplug og ILP.
+//
+// Dokumentet parses kun ved load og kompileres til en flad tabel sorteret
+// efter (tabel, register) plus en læseplan hvor nærliggende registre slås
+// sammen til én request. Poll-løkken rører hverken tekst eller navne.
+//
+// Nye maps kompileres i en reservebuffer og skiftes ind af poll-løkken med
+// beginCycle(), så et poll aldrig ser et halvt opdateret map.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+namespace regmap {
+
+static const size_t MAX_ENTRIES  = 32;
+static const size_t MAX_READS    = 16;
+static const size_t MAX_NAME     = 16;   // inkl. nul-terminering
+static const size_t MAX_DOC      = 768;  // længste dokument der accepteres
+static const uint16_t MAX_BLOCK  = 64;   // ModbusMaster's responsbuffer (ord)
+static const uint16_t MAX_GAP    = 4;    // ulæste registre der tåles for at undgå en ekstra request
+
+enum Table : uint8_t { INPUT_REG = 0, HOLDING_REG = 1 };
+
+// Én metric som den står i dokumentet (eller i en compile-time profil, se include/DeviceProfile.h)
+struct Definition {
+  const char* name;
+  Table       table;
+  uint16_t    reg;
+  uint8_t     decimals;
+  bool        isSigned;
+};
+
+// Varm data: 8 bytes pr. entry, sorteret efter (table, reg)
+struct Entry {
+  uint16_t reg;
+  uint8_t  table;
+  uint8_t  decimals;
+  uint8_t  slot;       // plads i output (dokumentets rækkefølge)
+  uint8_t  isSigned;
+  uint16_t offset;     // reg - blokkens start
+};
+
+struct ReadOp {
+  uint8_t  table;
+  uint16_t start;
+  uint16_t count;
+  uint8_t  firstEntry;
+  uint8_t  entryCount;
+};
+
+// ================= KOMPILERET MAP =================
+class CompiledMap {
+public:
+  size_t size() const       { return entryCount_; }
+  size_t readCount() const  { return readCount_; }
+  const ReadOp& read(size_t i) const { return reads_[i]; }
+  const Entry& entry(size_t i) const { return entries_[i]; }
+
+  // Navn og decimaler pr. slot (kold data, bruges ved payload-bygning)
+  const char* name(size_t slot) const  { return names_[slot]; }
+  uint8_t decimals(size_t slot) const  { return slotDecimals_[slot]; }
+
+  /**
+   * @brief Slot for et navn, eller -1
+   */
+  int slotOf(const char* name) const;
+
+  /**
+   * @brief Parser og kompilerer et dokument
+   *
+   * @param err sættes til en fejltekst hvis dokumentet afvises
+   * @return false ved fejl (mappet er da tomt)
+   */
+  bool compile(const char* doc, size_t len, const char*& err);
+
+  /**
+   * @brief Kompilerer færdige definitioner (slot = index i defs)
+   *
+   * Samme validering, sortering og læseplan som compile(); navnene kopieres.
+   */
+  bool build(const Definition* defs, size_t count, const char*& err);
+
+  /**
+   * @brief Udfører læseplanen
+   *
+   * Master skal have ModbusMaster's interface (readInputRegisters,
+   * readHoldingRegisters, getResponseBuffer, ku8MBSuccess,
+   * ku8MBResponseTimedOut). Efter en timeout springes resten af planen
+   * over, da en slave der ikke svarer heller ikke svarer på næste blok.
+   * @param out  rå fast-komma værdi pr. slot
+   * @return bitmaske over slots der blev læst
+   */
+  template <class Master>
+  uint32_t poll(Master& mb, int32_t* out) const {
+    uint32_t ok = 0;
+    for (size_t r = 0; r < readCount_; r++) {
+      const ReadOp& op = reads_[r];
+      uint8_t res = op.table == HOLDING_REG ? mb.readHoldingRegisters(op.start, op.count)
+                                            : mb.readInputRegisters(op.start, op.count);
+      if (res == mb.ku8MBResponseTimedOut) break;
+      if (res != mb.ku8MBSuccess) continue;
+      for (size_t i = op.firstEntry; i < size_t(op.firstEntry) + op.entryCount; i++) {
+        const Entry& e = entries_[i];
+        uint16_t raw = mb.getResponseBuffer(e.offset);
+        out[e.slot] = e.isSigned ? int32_t(int16_t(raw)) : int32_t(raw);
+        ok |= 1u << e.slot;
+      }
+    }
+    return ok;
+  }
+
+private:
+  void clear() { entryCount_ = 0; readCount_ = 0; }
+
+  Entry   entries_[MAX_ENTRIES];
+  ReadOp  reads_[MAX_READS];
+  char    names_[MAX_ENTRIES][MAX_NAME];
+  uint8_t slotDecimals_[MAX_ENTRIES];
+  size_t  entryCount_ = 0;
+  size_t  readCount_ = 0;
+};
+
+// ================= DOBBELTBUFFER =================
+// load() kan kaldes fra en anden task (MQTT-callback, HTTP); poll-løkken
+// kalder beginCycle() før hvert poll og bruger active() resten af cyklussen.
+class RegisterMap {
+public:
+  /**
+   * @brief Kompilerer doc i reservebufferen og markerer den klar til skift
+   *
+   * @param required navne der skal findes i mappet (fx dem firmwaren aggregerer)
+   * @return false hvis dokumentet er ugyldigt, eller et tidligere map endnu
+   *         ikke er skiftet ind (prøv igen efter næste poll)
+   */
+  bool load(const char* doc, size_t len, const char*& err,
+            const char* const* required = nullptr, size_t requiredCount = 0);
+
+  // Som load(), men fra definitioner (fx profilens standard-map)
+  bool load(const Definition* defs, size_t count, const char*& err,
+            const char* const* required = nullptr, size_t requiredCount = 0);
+
+  /**
+   * @brief Skifter et nyt map ind; kaldes kun mellem poll-cyklusser
+   *
+   * @return true hvis der blev skiftet
+   */
+  bool beginCycle() {
+    if (!pending_.load(std::memory_order_acquire)) return false;
+    active_.store(uint8_t(1 - active_.load(std::memory_order_relaxed)), std::memory_order_release);
+    pending_.store(false, std::memory_order_release);
+    return true;
+  }
+
+  const CompiledMap& active() const { return maps_[active_.load(std::memory_order_acquire)]; }
+
+private:
+  template <class Compile>
+  bool loadWith(Compile&& compile, const char*& err, const char* const* required, size_t requiredCount);
+
+  CompiledMap maps_[2];
+  std::atomic<uint8_t> active_{0};
+  std::atomic<bool> pending_{false};
+  std::atomic<bool> loading_{false};
+};
+
+}  // namespace regmap
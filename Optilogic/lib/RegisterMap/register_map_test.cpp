@@ -0,0 +1,98 @@
+// Host-test af RegisterMap: dokumenter, navne, læseplan og dobbeltbufferen
+//
+// Et brud stopper programmet med en fejllinje og exit-kode 1.
+//
+// Byg: g++ -std=c++17 -g -O1 -fsanitize=address,undefined -I. register_map_test.cpp RegisterMap.cpp -o register_map_test
+// Kør: ./register_map_test
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "RegisterMap.h"
+
+#define CHECK(cond)                                                        \
+  do {                                                                     \
+    if (!(cond)) {                                                         \
+      fprintf(stderr, "%s:%d: brud: %s\n", __FILE__, __LINE__, #cond);     \
+      exit(1);                                                             \
+    }                                                                      \
+  } while (0)
+
+static bool compiles(const char* doc, size_t len) {
+  regmap::CompiledMap m;
+  const char* err = nullptr;
+  bool ok = m.compile(doc, len, err);
+  CHECK(ok == (err == nullptr));
+  return ok;
+}
+
+static bool compiles(const char* doc) { return compiles(doc, strlen(doc)); }
+
+static void testDocuments() {
+  regmap::CompiledMap m;
+  const char* err = nullptr;
+  const char* doc = "# kommentar\ntemp,ir,19,1\n tryk , ir , 13 , 1 ;rpm,ir,15,0;ai1,hr,25,1,s";
+  CHECK(m.compile(doc, strlen(doc), err));
+  CHECK(m.size() == 4);
+  CHECK(m.slotOf("temp") == 0 && m.slotOf("tryk") == 1 && m.slotOf("rpm") == 2 && m.slotOf("ai1") == 3);
+  CHECK(m.slotOf("foo") == -1);
+  CHECK(m.readCount() == 2);                      // ir 13-19 i én blok, hr 25 for sig
+  CHECK(m.read(0).start == 13 && m.read(0).count == 7);
+
+  CHECK(!compiles(""));
+  CHECK(!compiles("temp,xx,19,1"));
+  CHECK(!compiles("temp,ir,70000,1"));
+  CHECK(!compiles("temp,ir,19,7"));
+  CHECK(!compiles("temp,ir,19,1,x"));
+  CHECK(!compiles("temp,ir,19,1,s,9"));
+  CHECK(!compiles("temp,ir,19;"));
+  CHECK(!compiles("temp,ir,19,1;temp,ir,20,1"));  // samme navn to gange
+}
+
+// Navne skrives ukvoteret i JSON, Sparkplug og ILP: kun [A-Za-z0-9_]
+static void testNames() {
+  CHECK(compiles("Temp_2,ir,19,1"));
+  CHECK(compiles("abcdefghijklmno,ir,19,1"));     // 15 tegn
+  CHECK(!compiles("abcdefghijklmnop,ir,19,1"));   // 16 tegn
+  const char* bad[] = {"te\"mp,ir,19,1", "te\\mp,ir,19,1", "te mp,ir,19,1", "temp=1,ir,19,1",
+                       "tæmp,ir,19,1",   "te\tmp,ir,19,1", "te-mp,ir,19,1", "te{mp,ir,19,1"};
+  for (const char* doc : bad) CHECK(!compiles(doc));
+  const char nul[] = "te\0mp,ir,19,1";
+  CHECK(!compiles(nul, sizeof(nul) - 1));          // NUL midt i et navn
+  const char ctl[] = "te\x01mp,ir,19,1";
+  CHECK(!compiles(ctl));
+
+  regmap::CompiledMap m;
+  const char* err = nullptr;
+  regmap::Definition defs[] = {{"ok", regmap::INPUT_REG, 1, 0, false}, {"ik ke", regmap::INPUT_REG, 2, 0, false}};
+  CHECK(m.build(defs, 1, err));
+  CHECK(!m.build(defs, 2, err) && err != nullptr);
+}
+
+static void testDoubleBuffer() {
+  regmap::RegisterMap rm;
+  const char* err = nullptr;
+  const char* required[] = {"temp"};
+  const char* a = "temp,ir,19,1";
+  const char* b = "temp,ir,19,1;tryk,ir,13,1";
+  CHECK(!rm.load("tryk,ir,13,1", 12, err, required, 1));   // mangler temp
+  CHECK(rm.load(a, strlen(a), err, required, 1));
+  CHECK(!rm.load(b, strlen(b), err));                       // forrige er ikke skiftet ind
+  CHECK(rm.active().size() == 0);
+  CHECK(rm.beginCycle());
+  CHECK(rm.active().size() == 1);
+  CHECK(!rm.beginCycle());
+  CHECK(rm.load(b, strlen(b), err));
+  CHECK(rm.active().size() == 1);                           // først ved næste cyklus
+  CHECK(rm.beginCycle() && rm.active().size() == 2);
+}
+
+int main() {
+  testDocuments();
+  testNames();
+  testDoubleBuffer();
+  printf("register_map_test: ok\n");
+  return 0;
+}
@@ -0,0 +1,332 @@
+#pragma once
+// Modbus RTU frames uden I/O: CRC, request-byggere og parsere
+//
+// Header-only og uden Arduino-afhængigheder, så samme kode bruges af
+// firmwaren (RtuMaster), pty-emulatoren og host-værktøjer. Intet
+// allokeres: byggerne skriver i en buffer kalderen ejer, og parserne
+// returnerer views (RegisterView) direkte over den modtagne frame. Views
+// er kun gyldige så længe bufferen er det.
+//
+// Registre ligger big-endian på ledningen; RegisterView byte-swapper ved
+// læsning, så der ikke skal kopieres til et uint16_t-array først.
+//
+// CRC16 er tabelbaseret (256 x uint16_t, beregnet af compileren): ét
+// opslag pr. byte i stedet for otte skift. Se rtu_codec_bench.cpp.
+//
+// Parserne tjekker altid længden før de læser, også på vilkårlige bytes
+// fra bussen (se rtu_codec_fuzz.cpp og fuzz_corpus/).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace rtu {
+
+enum : uint8_t {
+  FC_READ_HOLDING   = 0x03,
+  FC_READ_INPUT     = 0x04,
+  FC_WRITE_SINGLE   = 0x06,
+  FC_WRITE_MULTIPLE = 0x10,
+  FC_READ_WRITE     = 0x17,
+};
+
+// Grænser fra Modbus-specifikationen (frame højst 256 bytes)
+static const size_t   MAX_FRAME       = 256;
+static const uint16_t MAX_READ        = 125;
+static const uint16_t MAX_WRITE       = 123;
+static const uint16_t MAX_READ_WRITE  = 121;   // skrivedelen af FC23
+
+enum class Status : uint8_t {
+  Ok,
+  Incomplete,        // for få bytes til en hel frame
+  BadCrc,
+  WrongSlave,        // svar fra en anden slave end requesten gik til
+  WrongFunction,     // svar på en anden funktionskode
+  BadLength,         // bytetal, antal eller ekko passer ikke
+  Exception,         // Modbus-exception; koden ligger i Response::exception
+  UnknownFunction,   // request med en funktionskode codec'en ikke kender
+};
+
+// ================= CRC =================
+namespace detail {
+struct CrcTable {
+  uint16_t v[256];
+  constexpr CrcTable() : v() {
+    for (unsigned i = 0; i < 256; i++) {
+      uint16_t c = uint16_t(i);
+      for (int b = 0; b < 8; b++) c = (c & 1) ? uint16_t((c >> 1) ^ 0xA001) : uint16_t(c >> 1);
+      v[i] = c;
+    }
+  }
+};
+inline constexpr CrcTable CRC_TABLE{};
+
+inline uint16_t be16(const uint8_t* p) { return uint16_t(p[0] << 8 | p[1]); }
+inline void putBe16(uint8_t* p, uint16_t v) {
+  p[0] = uint8_t(v >> 8);
+  p[1] = uint8_t(v);
+}
+}  // namespace detail
+
+// CRC16 (Modbus, polynomium 0xA001); crc kan føres videre mellem dele af en frame
+inline uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF) {
+  while (len--) crc = uint16_t((crc >> 8) ^ detail::CRC_TABLE.v[(crc ^ *data++) & 0xFF]);
+  return crc;
+}
+
+// Bitvis reference, kun til bench og fuzz
+inline uint16_t crc16Bitwise(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) crc = (crc & 1) ? uint16_t((crc >> 1) ^ 0xA001) : uint16_t(crc >> 1);
+  }
+  return crc;
+}
+
+// Skriver CRC efter len bytes (low byte først) og returnerer den nye længde
+inline size_t appendCrc(uint8_t* frame, size_t len) {
+  uint16_t crc = crc16(frame, len);
+  frame[len] = uint8_t(crc);
+  frame[len + 1] = uint8_t(crc >> 8);
+  return len + 2;
+}
+
+// len inkl. de to CRC-bytes
+inline bool crcOk(const uint8_t* frame, size_t len) {
+  if (len < 4) return false;
+  uint16_t crc = crc16(frame, len - 2);
+  return frame[len - 2] == uint8_t(crc) && frame[len - 1] == uint8_t(crc >> 8);
+}
+
+// ================= REGISTER-VIEW =================
+// Big-endian registre i en frame, læst som værtens uint16_t
+struct RegisterView {
+  const uint8_t* data = nullptr;
+  size_t         count = 0;
+
+  size_t size() const { return count; }
+  uint16_t operator[](size_t i) const { return detail::be16(data + 2 * i); }
+
+  // 32-bit værdi over to registre; de fleste enheder sender det høje ord først
+  uint32_t u32(size_t i) const { return uint32_t((*this)[i]) << 16 | (*this)[i + 1]; }
+  uint32_t u32LowFirst(size_t i) const { return uint32_t((*this)[i + 1]) << 16 | (*this)[i]; }
+
+  // Kopierer højst max registre og returnerer antallet
+  size_t copyTo(uint16_t* out, size_t max) const {
+    size_t n = count < max ? count : max;
+    for (size_t i = 0; i < n; i++) out[i] = (*this)[i];
+    return n;
+  }
+};
+
+// ================= REQUESTS (MASTER) =================
+// Alle byggere returnerer framens længde inkl. CRC, eller 0 hvis antallet er
+// uden for specifikationen eller cap er for lille.
+
+inline size_t readRequest(uint8_t* out, size_t cap, uint8_t slave, uint8_t fc, uint16_t start, uint16_t count) {
+  if (cap < 8 || count == 0 || count > MAX_READ) return 0;
+  out[0] = slave;
+  out[1] = fc;
+  detail::putBe16(out + 2, start);
+  detail::putBe16(out + 4, count);
+  return appendCrc(out, 6);
+}
+
+inline size_t writeSingleRequest(uint8_t* out, size_t cap, uint8_t slave, uint16_t reg, uint16_t value) {
+  if (cap < 8) return 0;
+  out[0] = slave;
+  out[1] = FC_WRITE_SINGLE;
+  detail::putBe16(out + 2, reg);
+  detail::putBe16(out + 4, value);
+  return appendCrc(out, 6);
+}
+
+inline size_t writeMultipleRequest(uint8_t* out, size_t cap, uint8_t slave, uint16_t start,
+                                   const uint16_t* values, uint16_t count) {
+  if (count == 0 || count > MAX_WRITE || cap < 9 + 2 * size_t(count)) return 0;
+  out[0] = slave;
+  out[1] = FC_WRITE_MULTIPLE;
+  detail::putBe16(out + 2, start);
+  detail::putBe16(out + 4, count);
+  out[6] = uint8_t(2 * count);
+  for (uint16_t i = 0; i < count; i++) detail::putBe16(out + 7 + 2 * i, values[i]);
+  return appendCrc(out, 7 + 2 * size_t(count));
+}
+
+// FC23: slaven skriver først og læser derefter
+inline size_t readWriteRequest(uint8_t* out, size_t cap, uint8_t slave, uint16_t readStart, uint16_t readCount,
+                               uint16_t writeStart, const uint16_t* values, uint16_t writeCount) {
+  if (readCount == 0 || readCount > MAX_READ || writeCount == 0 || writeCount > MAX_READ_WRITE ||
+      cap < 13 + 2 * size_t(writeCount)) {
+    return 0;
+  }
+  out[0] = slave;
+  out[1] = FC_READ_WRITE;
+  detail::putBe16(out + 2, readStart);
+  detail::putBe16(out + 4, readCount);
+  detail::putBe16(out + 6, writeStart);
+  detail::putBe16(out + 8, writeCount);
+  out[10] = uint8_t(2 * writeCount);
+  for (uint16_t i = 0; i < writeCount; i++) detail::putBe16(out + 11 + 2 * i, values[i]);
+  return appendCrc(out, 11 + 2 * size_t(writeCount));
+}
+
+// ================= SVAR (MASTER) =================
+struct Response {
+  uint8_t      slave = 0;
+  uint8_t      fc = 0;          // uden exception-bit
+  uint8_t      exception = 0;   // 1-4 ved Status::Exception
+  RegisterView regs;            // FC03/04/23: læste registre; FC06: den skrevne værdi
+  uint16_t     address = 0;     // FC06/16: ekko af adressen
+  size_t       frameLen = 0;    // inkl. CRC
+};
+
+/**
+ * @brief Svarets samlede længde inkl. CRC ud fra de første bytes
+ * @return 0 hvis det ikke kan afgøres endnu (eller funktionskoden er ukendt)
+ */
+inline size_t responseLength(const uint8_t* buf, size_t have) {
+  if (have < 2) return 0;
+  if (buf[1] & 0x80) return 5;   // slave, fc, kode, CRC
+  switch (buf[1]) {
+    case FC_READ_HOLDING:
+    case FC_READ_INPUT:
+    case FC_READ_WRITE:
+      return have < 3 ? 0 : size_t(5) + buf[2];
+    case FC_WRITE_SINGLE:
+    case FC_WRITE_MULTIPLE:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Parser et svar og tjekker det mod requesten der blev sendt
+ *
+ * @param req  request-framen (som fra byggerne ovenfor)
+ * @param buf  de modtagne bytes; bytes efter svaret ignoreres
+ */
+inline Status parseResponse(const uint8_t* req, const uint8_t* buf, size_t len, Response& out) {
+  size_t want = responseLength(buf, len);
+  size_t n = want ? want : len;   // ukendt fc: hele bufferen må være framen
+  if (n < 4 || len < n) return Status::Incomplete;
+  if (!crcOk(buf, n)) return Status::BadCrc;
+  out = Response();
+  out.slave = buf[0];
+  out.fc = buf[1] & 0x7F;
+  out.frameLen = n;
+  if (buf[0] != req[0]) return Status::WrongSlave;
+  if (out.fc != req[1]) return Status::WrongFunction;
+  if (buf[1] & 0x80) {
+    out.exception = buf[2];
+    return Status::Exception;
+  }
+  switch (out.fc) {
+    case FC_READ_HOLDING:
+    case FC_READ_INPUT:
+    case FC_READ_WRITE:   // antal der læses står samme sted i alle tre requests
+      if (buf[2] != 2 * detail::be16(req + 4)) return Status::BadLength;
+      out.regs.data = buf + 3;
+      out.regs.count = buf[2] / 2;
+      return Status::Ok;
+    case FC_WRITE_SINGLE:   // ekko af hele requesten
+      if (memcmp(buf + 2, req + 2, 4) != 0) return Status::BadLength;
+      out.address = detail::be16(buf + 2);
+      out.regs.data = buf + 4;
+      out.regs.count = 1;
+      return Status::Ok;
+    case FC_WRITE_MULTIPLE:   // ekko af adresse og antal
+      if (memcmp(buf + 2, req + 2, 4) != 0) return Status::BadLength;
+      out.address = detail::be16(buf + 2);
+      return Status::Ok;
+    default:
+      return Status::WrongFunction;
+  }
+}
+
+// ================= REQUESTS (SLAVE/SNIFFER) =================
+struct Request {
+  uint8_t      slave = 0;
+  uint8_t      fc = 0;
+  uint16_t     address = 0;        // læse- eller skriveadresse (FC23: læseadressen)
+  uint16_t     count = 0;          // antal registre der læses eller skrives
+  uint16_t     writeAddress = 0;   // kun FC23
+  RegisterView values;             // FC06/16/23: registre der skrives
+  size_t       frameLen = 0;
+};
+
+// Requestens samlede længde inkl. CRC, 0 hvis den ikke kan afgøres endnu
+inline size_t requestLength(const uint8_t* buf, size_t have) {
+  if (have < 2) return 0;
+  switch (buf[1]) {
+    case FC_READ_HOLDING:
+    case FC_READ_INPUT:
+    case FC_WRITE_SINGLE:
+      return 8;
+    case FC_WRITE_MULTIPLE:
+      return have < 7 ? 0 : size_t(9) + buf[6];
+    case FC_READ_WRITE:
+      return have < 11 ? 0 : size_t(13) + buf[10];
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Parser én hel request-frame (fx afgrænset af t3.5-pausen)
+ *
+ * CRC tjekkes først; en slave skal tie ved CRC-fejl. BadLength svarer til
+ * exception 03 (illegal data value), UnknownFunction til exception 01.
+ */
+inline Status parseRequest(const uint8_t* buf, size_t len, Request& out) {
+  if (len < 4) return Status::Incomplete;
+  if (!crcOk(buf, len)) return Status::BadCrc;
+  out = Request();
+  out.slave = buf[0];
+  out.fc = buf[1];
+  out.frameLen = len;
+  size_t want = requestLength(buf, len);
+  switch (buf[1]) {
+    case FC_READ_HOLDING:
+    case FC_READ_INPUT:
+      if (len != want) return Status::BadLength;
+      out.address = detail::be16(buf + 2);
+      out.count = detail::be16(buf + 4);
+      return out.count >= 1 && out.count <= MAX_READ ? Status::Ok : Status::BadLength;
+    case FC_WRITE_SINGLE:
+      if (len != want) return Status::BadLength;
+      out.address = detail::be16(buf + 2);
+      out.count = 1;
+      out.values.data = buf + 4;
+      out.values.count = 1;
+      return Status::Ok;
+    case FC_WRITE_MULTIPLE:
+      if (len != want) return Status::BadLength;
+      out.address = detail::be16(buf + 2);
+      out.count = detail::be16(buf + 4);
+      if (out.count < 1 || out.count > MAX_WRITE || buf[6] != 2 * out.count) return Status::BadLength;
+      out.values.data = buf + 7;
+      out.values.count = out.count;
+      return Status::Ok;
+    case FC_READ_WRITE: {
+      if (len != want) return Status::BadLength;
+      out.address = detail::be16(buf + 2);
+      out.count = detail::be16(buf + 4);
+      out.writeAddress = detail::be16(buf + 6);
+      uint16_t writeCount = detail::be16(buf + 8);
+      if (out.count < 1 || out.count > MAX_READ || writeCount < 1 || writeCount > MAX_READ_WRITE ||
+          buf[10] != 2 * writeCount) {
+        return Status::BadLength;
+      }
+      out.values.data = buf + 11;
+      out.values.count = writeCount;
+      return Status::Ok;
+    }
+    default:
+      return Status::UnknownFunction;
+  }
+}
+
+}  // namespace rtu
@@ -0,0 +1,290 @@
+// Fuzz-harness for RtuCodec.h
+//
+// Hver input behandles både som request (slave-siden) og som svar (master-
+// siden), og følgende skal altid gælde:
+//   - tabel-CRC == bitvis CRC
+//   - en request der parses Ok, bygges byte for byte ens af byggerne igen
+//   - et læsesvar med gyldig CRC og passende bytetal parses Ok
+//   - views og frameLen ligger inden for input-bufferen
+//   - responseLength()/requestLength() ændrer sig ikke når flere bytes kommer til
+// Brud stopper programmet med abort(), så ASan/libFuzzer gemmer inputtet.
+//
+// libFuzzer: clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -DLIBFUZZER -I. rtu_codec_fuzz.cpp -o rtu_codec_fuzz
+//            ./rtu_codec_fuzz fuzz_corpus/
+// Uden clang: g++ -std=c++17 -g -O1 -fsanitize=address,undefined -I. rtu_codec_fuzz.cpp -o rtu_codec_fuzz
+//            ./rtu_codec_fuzz fuzz_corpus/ [mutationer pr. fil]   (afspiller og muterer korpusset)
+//            ./rtu_codec_fuzz --write-corpus fuzz_corpus/         (genskaber seed-filerne)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "RtuCodec.h"
+
+#define CHECK(cond)                                                        \
+  do {                                                                     \
+    if (!(cond)) {                                                         \
+      fprintf(stderr, "%s:%d: brud: %s\n", __FILE__, __LINE__, #cond);     \
+      abort();                                                             \
+    }                                                                      \
+  } while (0)
+
+static void checkView(const rtu::RegisterView& v, const uint8_t* buf, size_t len) {
+  if (!v.count) return;
+  CHECK(v.data >= buf && v.data + 2 * v.count <= buf + len);
+  uint32_t sum = 0;
+  for (size_t i = 0; i < v.size(); i++) sum += v[i];   // læser hele viewet (ASan)
+  (void)sum;
+}
+
+static void checkRequest(const uint8_t* data, size_t len) {
+  rtu::Request q;
+  rtu::Status st = rtu::parseRequest(data, len, q);
+  if (st != rtu::Status::Ok) return;
+  CHECK(q.frameLen == len);
+  CHECK(rtu::requestLength(data, len) == len);
+  checkView(q.values, data, len);
+
+  uint16_t values[rtu::MAX_WRITE];
+  size_t nv = q.values.copyTo(values, rtu::MAX_WRITE);
+  uint8_t again[rtu::MAX_FRAME + 16];
+  size_t n = 0;
+  switch (q.fc) {
+    case rtu::FC_READ_HOLDING:
+    case rtu::FC_READ_INPUT:
+      n = rtu::readRequest(again, sizeof(again), q.slave, q.fc, q.address, q.count);
+      break;
+    case rtu::FC_WRITE_SINGLE:
+      CHECK(nv == 1);
+      n = rtu::writeSingleRequest(again, sizeof(again), q.slave, q.address, values[0]);
+      break;
+    case rtu::FC_WRITE_MULTIPLE:
+      n = rtu::writeMultipleRequest(again, sizeof(again), q.slave, q.address, values, uint16_t(nv));
+      break;
+    case rtu::FC_READ_WRITE:
+      n = rtu::readWriteRequest(again, sizeof(again), q.slave, q.address, q.count, q.writeAddress, values,
+                                uint16_t(nv));
+      break;
+    default:
+      CHECK(false);
+  }
+  CHECK(n == len && memcmp(again, data, len) == 0);
+}
+
+// Svaret tjekkes mod en request der passer til dets første bytes
+static void checkResponse(const uint8_t* data, size_t len) {
+  if (len < 3) return;
+  uint8_t req[rtu::MAX_FRAME];
+  uint8_t fc = data[1] & 0x7F;
+  uint16_t one = 0;
+  size_t n = 0;
+  switch (fc) {
+    case rtu::FC_READ_HOLDING:
+    case rtu::FC_READ_INPUT:
+      n = rtu::readRequest(req, sizeof(req), data[0], fc, 0, uint16_t(data[2] / 2));
+      break;
+    case rtu::FC_READ_WRITE:
+      n = rtu::readWriteRequest(req, sizeof(req), data[0], 0, uint16_t(data[2] / 2), 0, &one, 1);
+      break;
+    case rtu::FC_WRITE_SINGLE:
+      n = len >= 6 ? rtu::writeSingleRequest(req, sizeof(req), data[0], rtu::detail::be16(data + 2),
+                                             rtu::detail::be16(data + 4))
+                   : 0;
+      break;
+    default:
+      n = rtu::readRequest(req, sizeof(req), data[0], fc, 0, 1);
+      break;
+  }
+  if (!n) return;
+
+  rtu::Response r;
+  rtu::Status st = rtu::parseResponse(req, data, len, r);
+  if (st == rtu::Status::Ok || st == rtu::Status::Exception) {
+    CHECK(r.frameLen >= 4 && r.frameLen <= len);
+    CHECK(rtu::crcOk(data, r.frameLen));
+    checkView(r.regs, data, r.frameLen);
+  }
+  bool read = fc == rtu::FC_READ_HOLDING || fc == rtu::FC_READ_INPUT || fc == rtu::FC_READ_WRITE;
+  if (st == rtu::Status::Ok && read) CHECK(size_t(data[2]) == 2 * r.regs.count && r.frameLen == size_t(data[2]) + 5);
+  if (read && !(data[1] & 0x80) && data[2] % 2 == 0 && size_t(data[2]) + 5 == len && rtu::crcOk(data, len)) {
+    CHECK(st == rtu::Status::Ok);
+    CHECK(r.regs.count == rtu::detail::be16(req + 4));
+  }
+}
+
+static void checkLengths(const uint8_t* data, size_t len) {
+  size_t resp = 0, reqLen = 0;
+  for (size_t k = 0; k <= len; k++) {
+    size_t a = rtu::responseLength(data, k);
+    size_t b = rtu::requestLength(data, k);
+    if (resp) CHECK(a == resp);
+    if (reqLen) CHECK(b == reqLen);
+    resp = a;
+    reqLen = b;
+  }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  CHECK(rtu::crc16(data, size) == rtu::crc16Bitwise(data, size));
+  checkRequest(data, size);
+  checkResponse(data, size);
+  checkLengths(data, size);
+  return 0;
+}
+
+#ifndef LIBFUZZER
+#include <dirent.h>
+
+#include <string>
+#include <vector>
+
+static std::vector<uint8_t> readFile(const std::string& path) {
+  std::vector<uint8_t> buf;
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) return buf;
+  uint8_t chunk[512];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) buf.insert(buf.end(), chunk, chunk + n);
+  fclose(f);
+  return buf;
+}
+
+static std::vector<std::string> listInputs(const char* path) {
+  std::vector<std::string> files;
+  DIR* dir = opendir(path);
+  if (!dir) {
+    files.push_back(path);
+    return files;
+  }
+  while (dirent* e = readdir(dir)) {
+    if (e->d_name[0] != '.') files.push_back(std::string(path) + "/" + e->d_name);
+  }
+  closedir(dir);
+  return files;
+}
+
+// ================= SEED-KORPUS =================
+static void writeSeed(const std::string& dir, const char* name, const uint8_t* data, size_t len) {
+  std::string path = dir + "/" + name;
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) {
+    fprintf(stderr, "Kan ikke skrive %s\n", path.c_str());
+    exit(1);
+  }
+  fwrite(data, 1, len, f);
+  fclose(f);
+}
+
+static void writeCorpus(const std::string& dir) {
+  uint8_t b[rtu::MAX_FRAME];
+  uint16_t values[rtu::MAX_WRITE];
+  for (uint16_t i = 0; i < rtu::MAX_WRITE; i++) values[i] = uint16_t(i * 257);
+  size_t n;
+
+  n = rtu::readRequest(b, sizeof(b), 1, rtu::FC_READ_INPUT, 10, 11);
+  writeSeed(dir, "req_fc04_poll", b, n);
+  n = rtu::readRequest(b, sizeof(b), 2, rtu::FC_READ_HOLDING, 367, 1);
+  writeSeed(dir, "req_fc03_run", b, n);
+  n = rtu::readRequest(b, sizeof(b), 1, rtu::FC_READ_HOLDING, 0, rtu::MAX_READ);
+  writeSeed(dir, "req_fc03_max", b, n);
+  n = rtu::writeSingleRequest(b, sizeof(b), 1, 367, 3);
+  writeSeed(dir, "req_fc06_start", b, n);
+  n = rtu::writeMultipleRequest(b, sizeof(b), 1, 367, values, 2);
+  writeSeed(dir, "req_fc16", b, n);
+  n = rtu::writeMultipleRequest(b, sizeof(b), 0, 100, values, rtu::MAX_WRITE);
+  writeSeed(dir, "req_fc16_max_broadcast", b, n);
+  n = rtu::readWriteRequest(b, sizeof(b), 1, 367, 1, 367, values + 3, 1);
+  writeSeed(dir, "req_fc23_run", b, n);
+
+  const uint8_t poll[] = {1, 4, 22, 0, 12, 0, 0, 0, 0, 0, 250, 0, 0, 3, 232, 0, 0, 0, 0, 0, 0, 0, 215, 0, 0};
+  memcpy(b, poll, sizeof(poll));
+  n = rtu::appendCrc(b, sizeof(poll));
+  writeSeed(dir, "resp_fc04_poll", b, n);
+  writeSeed(dir, "resp_fc04_truncated", b, n - 3);
+  b[5] ^= 0x10;
+  writeSeed(dir, "resp_fc04_badcrc", b, n);
+
+  const uint8_t run[] = {1, 0x17, 2, 0, 3};
+  memcpy(b, run, sizeof(run));
+  writeSeed(dir, "resp_fc23_run", b, rtu::appendCrc(b, sizeof(run)));
+  const uint8_t echo[] = {1, 6, 1, 0x6F, 0, 3};
+  memcpy(b, echo, sizeof(echo));
+  writeSeed(dir, "resp_fc06_echo", b, rtu::appendCrc(b, sizeof(echo)));
+  const uint8_t exc[] = {2, 0x97, 1};
+  memcpy(b, exc, sizeof(exc));
+  writeSeed(dir, "resp_fc23_illegal_function", b, rtu::appendCrc(b, sizeof(exc)));
+  const uint8_t big[] = {1, 3, 0xFF};   // bytetal der peger ud over framen
+  memcpy(b, big, sizeof(big));
+  writeSeed(dir, "resp_fc03_bytecount_ff", b, rtu::appendCrc(b, sizeof(big)));
+  const uint8_t unknown[] = {1, 0x2B, 0x0E, 1, 0};
+  memcpy(b, unknown, sizeof(unknown));
+  writeSeed(dir, "req_unknown_fc", b, rtu::appendCrc(b, sizeof(unknown)));
+  printf("Seed-korpus skrevet til %s\n", dir.c_str());
+}
+
+// ================= MUTATION UDEN LIBFUZZER =================
+static uint32_t rng = 2463534242u;
+static uint32_t nextRandom() {   // xorshift32, fast seed så kørsler kan gentages
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static void mutate(std::vector<uint8_t>& buf) {
+  switch (nextRandom() % 5) {
+    case 0:   // bitflip
+      if (!buf.empty()) buf[nextRandom() % buf.size()] ^= uint8_t(1u << (nextRandom() % 8));
+      break;
+    case 1:   // afkort
+      if (!buf.empty()) buf.resize(nextRandom() % buf.size());
+      break;
+    case 2:   // indsæt byte
+      if (buf.size() < rtu::MAX_FRAME + 8) buf.insert(buf.begin() + (buf.empty() ? 0 : nextRandom() % buf.size()), uint8_t(nextRandom()));
+      break;
+    case 3:   // tilfældig byte
+      if (!buf.empty()) buf[nextRandom() % buf.size()] = uint8_t(nextRandom());
+      break;
+    default:  // ret CRC, så mutationen når forbi CRC-tjekket
+      if (buf.size() >= 4) rtu::appendCrc(buf.data(), buf.size() - 2);
+      break;
+  }
+}
+
+// Kopi i en allokering af præcis den rigtige størrelse, så ASan fanger
+// læsning bare én byte forbi (vectorens kapacitet kan være større)
+static void runExact(const std::vector<uint8_t>& buf) {
+  uint8_t* copy = new uint8_t[buf.size()];
+  if (!buf.empty()) memcpy(copy, buf.data(), buf.size());
+  LLVMFuzzerTestOneInput(copy, buf.size());
+  delete[] copy;
+}
+
+int main(int argc, char** argv) {
+  if (argc == 3 && strcmp(argv[1], "--write-corpus") == 0) {
+    writeCorpus(argv[2]);
+    return 0;
+  }
+  if (argc < 2) {
+    fprintf(stderr, "Brug: %s <korpus-mappe|fil> [mutationer pr. fil]\n", argv[0]);
+    return 2;
+  }
+  unsigned long rounds = argc > 2 ? strtoul(argv[2], nullptr, 10) : 100000;
+  std::vector<std::string> files = listInputs(argv[1]);
+  unsigned long runs = 0;
+  for (const std::string& path : files) {
+    std::vector<uint8_t> seed = readFile(path);
+    runExact(seed);
+    std::vector<uint8_t> buf = seed;
+    for (unsigned long i = 0; i < rounds; i++) {
+      if (i % 16 == 0) buf = seed;   // start forfra så mutationer ikke driver helt væk
+      mutate(buf);
+      runExact(buf);
+      runs++;
+    }
+  }
+  printf("%zu filer, %lu mutationer, ingen brud\n", files.size(), runs);
+  return 0;
+}
+#endif
@@ -0,0 +1,72 @@
+#include "RtuMaster.h"
+
+uint8_t RtuMaster::readRegisters(uint8_t fc, uint16_t start, uint16_t count) {
+  if (count > MAX_REGISTERS) return lastResult_ = ku8MBIllegalDataValue;
+  uint8_t req[8];
+  size_t len = rtu::readRequest(req, sizeof(req), slave_, fc, start, count);
+  if (!len) return lastResult_ = ku8MBIllegalDataValue;
+  rtu::Response resp;
+  uint8_t res = transact(req, len, resp);
+  if (res == ku8MBSuccess) resp.regs.copyTo(response_, MAX_REGISTERS);
+  return res;
+}
+
+uint8_t RtuMaster::readWriteMultipleRegisters(uint16_t readStart, uint16_t readCount, uint16_t writeStart,
+                                              uint16_t writeCount) {
+  if (readCount > MAX_REGISTERS || writeCount > MAX_REGISTERS) return lastResult_ = ku8MBIllegalDataValue;
+  uint8_t req[13 + 2 * MAX_REGISTERS];
+  size_t len = rtu::readWriteRequest(req, sizeof(req), slave_, readStart, readCount, writeStart, transmit_, writeCount);
+  if (!len) return lastResult_ = ku8MBIllegalDataValue;
+  rtu::Response resp;
+  uint8_t res = transact(req, len, resp);
+  if (res == ku8MBSuccess) resp.regs.copyTo(response_, MAX_REGISTERS);
+  return res;
+}
+
+uint8_t RtuMaster::writeSingleRegister(uint16_t reg, uint16_t value) {
+  uint8_t req[8];
+  size_t len = rtu::writeSingleRequest(req, sizeof(req), slave_, reg, value);
+  rtu::Response resp;
+  return transact(req, len, resp);
+}
+
+uint8_t RtuMaster::transact(const uint8_t* req, size_t reqLen, rtu::Response& resp) {
+  while (serial_->available()) serial_->read();   // rester fra et tidligere, afkortet svar
+  if (pre_) pre_();
+  serial_->write(req, reqLen);
+  serial_->flush();                               // vent til sidste bit er ude før DE slås fra
+  if (post_) post_();
+
+  // Vent på første byte med slavens adaptive timeout, derefter kun korte pauser
+  uint32_t sentUs = micros();
+  uint32_t timeoutMs = rtt_.timeoutMs();
+  uint32_t lastByteMs = millis();
+  size_t have = 0;
+  size_t want = 0;
+  while (!want || have < want) {
+    if (serial_->available()) {
+      int b = serial_->read();
+      if (b < 0) continue;
+      if (have == 0) rtt_.add(micros() - sentUs);   // svartid til første byte
+      if (have < sizeof(rx_)) rx_[have] = uint8_t(b);
+      have++;
+      lastByteMs = millis();
+      if (!want) want = rtu::responseLength(rx_, have < sizeof(rx_) ? have : sizeof(rx_));
+      continue;
+    }
+    uint32_t idle = millis() - lastByteMs;
+    if (have == 0 ? idle >= timeoutMs : idle >= INTER_BYTE_MS) break;
+    yield();
+  }
+
+  if (have == 0) return lastResult_ = ku8MBResponseTimedOut;
+  if (!want || have < want || want > sizeof(rx_)) return lastResult_ = ku8MBInvalidCRC;   // afkortet eller for langt
+  switch (rtu::parseResponse(req, rx_, want, resp)) {
+    case rtu::Status::Ok:            return lastResult_ = ku8MBSuccess;
+    case rtu::Status::Exception:     return lastResult_ = resp.exception;   // Modbus exception (1-4)
+    case rtu::Status::WrongSlave:    return lastResult_ = ku8MBInvalidSlaveID;
+    case rtu::Status::WrongFunction:
+    case rtu::Status::BadLength:     return lastResult_ = ku8MBInvalidFunction;
+    default:                         return lastResult_ = ku8MBInvalidCRC;
+  }
+}
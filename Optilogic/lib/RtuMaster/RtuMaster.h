@@ -0,0 +1,91 @@
+#pragma once
+// Modbus RTU master med timeout pr. slave
+//
+// Samme interface som ModbusMaster (readInputRegisters, readHoldingRegisters,
+// writeSingleRegister, readWriteMultipleRegisters med setTransmitBuffer,
+// getResponseBuffer og ku8MB... resultatkoder), så
+// CompiledMap::poll() og MeteredMaster kan bruge den uændret. Forskellen er
+// timeouten: ModbusMaster venter altid 2000 ms på en slave der er slukket,
+// og den tid er bussen blokeret for alle andre. Her måles svartiden (request
+// sendt til første svarbyte) for hvert svar, og timeouten følger slavens
+// egen 95-percentil (se SlaveHealth.h).
+//
+// Én instans pr. slave; flere instanser kan dele samme Stream (RS485-segment).
+// Framing og CRC ligger i RtuCodec.h.
+
+#include <Arduino.h>
+#include <RtuCodec.h>
+
+#include "SlaveHealth.h"
+
+class RtuMaster {
+public:
+  // Resultatkoder som ModbusMaster
+  static const uint8_t ku8MBSuccess            = 0x00;
+  static const uint8_t ku8MBIllegalFunction    = 0x01;
+  static const uint8_t ku8MBIllegalDataAddress = 0x02;
+  static const uint8_t ku8MBIllegalDataValue   = 0x03;
+  static const uint8_t ku8MBSlaveDeviceFailure = 0x04;
+  static const uint8_t ku8MBInvalidSlaveID     = 0xE0;
+  static const uint8_t ku8MBInvalidFunction    = 0xE1;
+  static const uint8_t ku8MBResponseTimedOut   = 0xE2;
+  static const uint8_t ku8MBInvalidCRC         = 0xE3;
+
+  static const uint8_t MAX_REGISTERS = 64;       // som ModbusMaster's responsbuffer
+  static const uint32_t INTER_BYTE_MS = 10;      // stilhed midt i et svar = afkortet frame
+
+  void begin(uint8_t slave, Stream& serial) {
+    slave_ = slave;
+    serial_ = &serial;
+  }
+  void preTransmission(void (*fn)()) { pre_ = fn; }
+  void postTransmission(void (*fn)()) { post_ = fn; }
+
+  // Grænser for den adaptive timeout; før der er svartider bruges maxMs
+  void setTimeoutBounds(uint32_t minMs, uint32_t maxMs) { rtt_.setBounds(minMs, maxMs); }
+
+  // Tilbage til maxMs, fx før helbredstjek af en parkeret slave
+  void resetTimeout() { rtt_.reset(); }
+
+  uint8_t readHoldingRegisters(uint16_t start, uint16_t count) { return readRegisters(0x03, start, count); }
+  uint8_t readInputRegisters(uint16_t start, uint16_t count) { return readRegisters(0x04, start, count); }
+  uint8_t writeSingleRegister(uint16_t reg, uint16_t value);
+
+  /**
+   * @brief FC23: skriver writeCount registre fra transmit-bufferen og læser
+   *        readCount registre i samme transaktion (skrivningen sker først)
+   */
+  uint8_t readWriteMultipleRegisters(uint16_t readStart, uint16_t readCount, uint16_t writeStart,
+                                     uint16_t writeCount);
+
+  uint8_t setTransmitBuffer(uint8_t i, uint16_t value) {
+    if (i >= MAX_REGISTERS) return ku8MBIllegalDataAddress;
+    transmit_[i] = value;
+    return ku8MBSuccess;
+  }
+
+  uint16_t getResponseBuffer(uint8_t i) const { return i < MAX_REGISTERS ? response_[i] : 0; }
+
+  uint8_t lastResult() const { return lastResult_; }
+  uint32_t timeoutMs() const { return rtt_.timeoutMs(); }
+  const RttTracker& rtt() const { return rtt_; }
+
+private:
+  uint8_t readRegisters(uint8_t fc, uint16_t start, uint16_t count);
+
+  /**
+   * @brief Sender req (med CRC) og modtager svaret i rx_
+   * @return resultatkode; ved succes peger resp ind i rx_ indtil næste request
+   */
+  uint8_t transact(const uint8_t* req, size_t reqLen, rtu::Response& resp);
+
+  uint8_t    slave_ = 1;
+  Stream*    serial_ = nullptr;
+  void     (*pre_)() = nullptr;
+  void     (*post_)() = nullptr;
+  RttTracker rtt_;
+  uint8_t    lastResult_ = ku8MBSuccess;
+  uint16_t   response_[MAX_REGISTERS] = {};
+  uint16_t   transmit_[MAX_REGISTERS] = {};
+  uint8_t    rx_[rtu::MAX_FRAME];
+};
@@ -0,0 +1,142 @@
+#pragma once
+// Svartider og circuit breaker pr. Modbus-slave
+//
+// RttTracker husker de sidste WINDOW svartider (request sendt til første
+// svarbyte) og udleder timeouten fra 95-percentilen: to gange p95 plus en
+// margen, begrænset til [minMs, maxMs]. Før der er MIN_SAMPLES svar bruges
+// maxMs, så en slave aldrig dømmes for tidligt. reset() glemmer svartiderne,
+// fx når slaven er parkeret og kan være genstartet med andre svartider.
+//
+// CircuitBreaker holder en slave der ikke svarer væk fra bussen:
+//   Closed    polles normalt; failureThreshold timeouts i træk -> Open
+//   Open      springes over indtil backoff er gået -> HalfOpen
+//   HalfOpen  ét billigt helbredstjek (ét register); svar -> Closed,
+//             timeout -> Open med dobbelt backoff (op til maxBackoffMs)
+// Ethvert svar, også en Modbus-exception, tæller som livstegn.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ================= SVARTIDER =================
+class RttTracker {
+public:
+  static const size_t WINDOW = 32;
+  static const size_t MIN_SAMPLES = 8;
+  static const uint32_t MARGIN_MS = 20;   // UART-FIFO, task-skift og lignende
+
+  void setBounds(uint32_t minMs, uint32_t maxMs) {
+    minMs_ = minMs;
+    maxMs_ = maxMs < minMs ? minMs : maxMs;
+    recompute();
+  }
+
+  void add(uint32_t rttUs) {
+    samples_[next_] = rttUs;
+    next_ = (next_ + 1) % WINDOW;
+    if (count_ < WINDOW) count_++;
+    recompute();
+  }
+
+  // Glem svartiderne: timeouten er maxMs indtil der igen er MIN_SAMPLES svar
+  void reset() {
+    count_ = 0;
+    next_ = 0;
+    recompute();
+  }
+
+  /**
+   * @brief Percentil (0-100) af de gemte svartider i us, 0 hvis ingen
+   */
+  uint32_t percentileUs(uint32_t pct) const {
+    if (!count_) return 0;
+    uint32_t sorted[WINDOW];
+    for (size_t i = 0; i < count_; i++) {   // indsættelsessortering, højst 32 elementer
+      uint32_t v = samples_[i];
+      size_t j = i;
+      while (j > 0 && sorted[j - 1] > v) { sorted[j] = sorted[j - 1]; j--; }
+      sorted[j] = v;
+    }
+    size_t idx = (count_ * (pct > 100 ? 100 : pct) + 99) / 100;   // nearest-rank
+    return sorted[idx ? idx - 1 : 0];
+  }
+
+  size_t count() const { return count_; }
+  uint32_t timeoutMs() const { return timeoutMs_; }
+
+private:
+  void recompute() {
+    if (count_ < MIN_SAMPLES) {
+      timeoutMs_ = maxMs_;
+      return;
+    }
+    uint32_t t = (2 * percentileUs(95) + 999) / 1000 + MARGIN_MS;
+    timeoutMs_ = t < minMs_ ? minMs_ : t > maxMs_ ? maxMs_ : t;
+  }
+
+  uint32_t samples_[WINDOW];
+  size_t   next_ = 0;
+  size_t   count_ = 0;
+  uint32_t minMs_ = 50;
+  uint32_t maxMs_ = 2000;   // som ModbusMaster
+  uint32_t timeoutMs_ = 2000;
+};
+
+// ================= CIRCUIT BREAKER =================
+class CircuitBreaker {
+public:
+  enum State : uint8_t { Closed = 0, Open = 1, HalfOpen = 2 };
+  enum Action : uint8_t { Poll, Skip, Probe };
+
+  explicit CircuitBreaker(uint8_t failureThreshold = 3, uint32_t baseBackoffMs = 1000,
+                          uint32_t maxBackoffMs = 60000)
+      : threshold_(failureThreshold ? failureThreshold : 1), baseMs_(baseBackoffMs),
+        maxMs_(maxBackoffMs < baseBackoffMs ? baseBackoffMs : maxBackoffMs), backoffMs_(baseBackoffMs) {}
+
+  /**
+   * @brief Hvad der skal ske med slaven ved denne tur
+   */
+  Action check(uint32_t nowMs) {
+    if (state_ == Closed) return Poll;
+    if (state_ == Open) {
+      if (int32_t(nowMs - openUntil_) < 0) return Skip;
+      state_ = HalfOpen;
+    }
+    return Probe;
+  }
+
+  // Slaven svarede (normalt poll eller helbredstjek)
+  void onResponse() {
+    state_ = Closed;
+    failures_ = 0;
+    backoffMs_ = baseMs_;
+  }
+
+  void onTimeout(uint32_t nowMs) {
+    if (state_ == HalfOpen) {
+      backoffMs_ = backoffMs_ > maxMs_ / 2 ? maxMs_ : backoffMs_ * 2;
+      open(nowMs);
+      return;
+    }
+    if (++failures_ >= threshold_) open(nowMs);
+  }
+
+  State state() const { return state_; }
+  uint32_t backoffMs() const { return backoffMs_; }
+  uint32_t trips() const { return trips_; }   // antal gange Closed -> Open
+
+private:
+  void open(uint32_t nowMs) {
+    if (state_ == Closed) trips_++;
+    state_ = Open;
+    openUntil_ = nowMs + backoffMs_;
+  }
+
+  uint8_t  threshold_;
+  uint32_t baseMs_;
+  uint32_t maxMs_;
+  uint32_t backoffMs_;
+  State    state_ = Closed;
+  uint8_t  failures_ = 0;
+  uint32_t openUntil_ = 0;
+  uint32_t trips_ = 0;
+};
@@ -0,0 +1,39 @@
+#pragma once
+// Skriv et register og læs status tilbage i én Modbus-transaktion
+//
+// FC23 (Read/Write Multiple Registers) skriver først og læser derefter i
+// samme request, så en kommando og bekræftelsen af den koster én rundtur
+// på bussen i stedet for to plus en pollperiode. Ikke alle slaves kender
+// FC23; de svarer med exception 01 (illegal function). Det huskes pr.
+// slave, og derefter bruges FC06 + FC03 uden at prøve FC23 igen.
+//
+// Kun exception 01 afgør spørgsmålet. En timeout eller CRC-fejl siger intet
+// om FC23, så kommandoen gives op og detektionen prøves ved næste kald.
+//
+// Virker med alt der har ModbusMaster's interface (RtuMaster, MeteredMaster).
+
+#include <stdint.h>
+
+enum class Fc23Support : uint8_t { Unknown = 0, Supported = 1, Unsupported = 2 };
+
+/**
+ * @brief Skriver value til writeReg og læser readCount holding-registre fra readStart
+ *
+ * @param support  slavens FC23-kendskab; opdateres ud fra svaret
+ * @return ku8MBSuccess når begge dele lykkedes; de læste registre ligger
+ *         da i mb.getResponseBuffer()
+ */
+template <class Master>
+uint8_t writeThenRead(Master& mb, Fc23Support& support, uint16_t writeReg, uint16_t value,
+                      uint16_t readStart, uint16_t readCount) {
+  if (support != Fc23Support::Unsupported) {
+    mb.setTransmitBuffer(0, value);
+    uint8_t res = mb.readWriteMultipleRegisters(readStart, readCount, writeReg, 1);
+    if (res == Master::ku8MBSuccess) support = Fc23Support::Supported;
+    if (res != Master::ku8MBIllegalFunction) return res;
+    support = Fc23Support::Unsupported;
+  }
+  uint8_t res = mb.writeSingleRegister(writeReg, value);
+  if (res != Master::ku8MBSuccess) return res;
+  return mb.readHoldingRegisters(readStart, readCount);
+}
@@ -1,6 +1,6 @@
 import os
 import logging
-from typing import Dict, Any
+from typing import Dict, Any, Optional
 import threading
 from http.server import BaseHTTPRequestHandler, HTTPServer
 from datetime import datetime
@@ -9,6 +9,8 @@ import paho.mqtt.client as mqtt
 import psycopg2
 import json
 
+from uplink_batch import split_batch  # rå samples samlet i én besked (UplinkBatch.h)
+
 logging.basicConfig(level=logging.INFO, format="%(asctime)s %(levelname)s %(message)s")
 
 # ---------------------------------------------------------
@@ -64,7 +66,7 @@ def parse_topic(topic: str) -> Dict[str, str]:
 # ---------------------------------------------------------
 # Insert into QuestDB
 # ---------------------------------------------------------
-def ilp_send(device: str, fields: Dict[str, Any]) -> None:
+def ilp_send(device: str, fields: Dict[str, Any], ts_ms: Optional[int] = None) -> None:
     global _pg_conn
     if _pg_conn is None:
         init_pg_connection()
@@ -78,7 +80,7 @@ def ilp_send(device: str, fields: Dict[str, Any]) -> None:
             values.append(fields[k])
 
     columns.append("timestamp")
-    values.append(datetime.utcnow())
+    values.append(datetime.utcfromtimestamp(ts_ms / 1000) if ts_ms else datetime.utcnow())
 
     col_str = ",".join(columns)
     placeholders = ",".join(["%s"] * len(values))
@@ -179,12 +181,13 @@ def on_message(client, userdata, msg):
         return
 
     try:
-        metrics = decode_payload(msg.payload)
-        if metrics:
-            dev = meta["device"] or "device"
-            ilp_send(dev, metrics)
-        else:
-            logging.debug("No metrics decoded for %s", msg.topic)
+        for ts_ms, payload in split_batch(msg.payload):
+            metrics = decode_payload(payload)
+            if metrics:
+                dev = meta["device"] or "device"
+                ilp_send(dev, metrics, ts_ms)
+            else:
+                logging.debug("No metrics decoded for %s", msg.topic)
     except Exception as e:
         logging.warning("Decode/insert error: %s", e)
 
@@ -227,4 +230,3 @@ def main():
 
 if __name__ == "__main__":
     main()
-sk@Casaos:/DATA/AppData/spb_ingestor$
\ No newline at end of file
@@ -1,6 +1,6 @@
 import os
 import logging
-from typing import Dict, Any
+from typing import Dict, Any, Optional
 import threading
 from http.server import BaseHTTPRequestHandler, HTTPServer
 from datetime import datetime
@@ -8,6 +8,8 @@ from datetime import datetime
 import paho.mqtt.client as mqtt
 import psycopg2
 
+from uplink_batch import split_batch  # rå samples samlet i én besked (UplinkBatch.h)
+
 logging.basicConfig(level=logging.INFO, format="%(asctime)s %(levelname)s %(message)s")
 
 # ---------------------------------------------------------
@@ -25,6 +27,24 @@ except ImportError:
         "Will use fallback text decoder for payloads."
     )
 
+# ---------------------------------------------------------
+# Try to import the C++ zero-copy decoder (build: python3 setup.py build_ext --inplace)
+# ---------------------------------------------------------
+try:
+    import spb_fastdecode
+    logging.info("spb_fastdecode imported successfully, using C++ SPB decoder.")
+except ImportError:
+    spb_fastdecode = None  # type: ignore
+
+# Én decoder pr. edge node: aliaserne læres fra nodens BIRTH og gælder kun for den
+_fast_decoders: Dict[str, Any] = {}
+
+def fast_decoder(node: str):
+    dec = _fast_decoders.get(node)
+    if dec is None:
+        dec = _fast_decoders[node] = spb_fastdecode.Decoder(("temp", "tryk", "rpm"))
+    return dec
+
 # ---------------------------------------------------------
 # Environment variables
 # ---------------------------------------------------------
@@ -58,18 +78,19 @@ def init_pg_connection():
 # ---------------------------------------------------------
 def parse_topic(topic: str) -> Dict[str, str]:
     """
-    spBv1.0/<group>/<type>/<device>
+    spBv1.0/<group>/<type>/<node>[/<device>]
     """
     p = topic.split("/")
     return {
         "type":   p[2] if len(p) > 2 else "",
+        "node":   p[3] if len(p) > 3 else "",
         "device": p[4] if len(p) > 4 else "",
     }
 
 # ---------------------------------------------------------
 # Insert metrics into PostgreSQL with timestamp
 # ---------------------------------------------------------
-def ilp_send(device: str, fields: Dict[str, Any]) -> None:
+def ilp_send(device: str, fields: Dict[str, Any], ts_ms: Optional[int] = None) -> None:
     global _pg_conn
     if _pg_conn is None:
         init_pg_connection()
@@ -82,9 +103,9 @@ def ilp_send(device: str, fields: Dict[str, Any]) -> None:
             columns.append(k)
             values.append(fields[k])
 
-    # Add timestamp as the last column
+    # Add timestamp as the last column (samplets egen tid fra en batch, ellers nu)
     columns.append("timestamp")
-    values.append(datetime.utcnow())
+    values.append(datetime.utcfromtimestamp(ts_ms / 1000) if ts_ms else datetime.utcnow())
 
     col_str = ",".join(columns)
     val_placeholders = ",".join(["%s"] * len(values))
@@ -98,8 +119,24 @@ def ilp_send(device: str, fields: Dict[str, Any]) -> None:
 # ---------------------------------------------------------
 # Decode payload
 # ---------------------------------------------------------
-def decode_payload(b: bytes) -> Dict[str, Any]:
-    if SPB_AVAILABLE:
+def decode_payload(b: bytes, node: str = "") -> Dict[str, Any]:
+    if spb_fastdecode is not None:
+        # Parser direkte i bufferen uden at bygge protobuf-objekter
+        try:
+            decoded = fast_decoder(node).decode(b)
+        except spb_fastdecode.DecodeError:
+            decoded = None  # ikke protobuf (fx tekst-payload): prøv fallback nedenfor
+        if decoded is not None:
+            out: Dict[str, Any] = {}
+            for name, value in decoded.items():
+                if name == "rpm":
+                    if isinstance(value, int) and not isinstance(value, bool):
+                        out["rpm"] = value
+                else:
+                    out[name] = float(value)
+            return out
+
+    elif SPB_AVAILABLE:
         payload = spb.Payload()
         payload.ParseFromString(b)
         out: Dict[str, Any] = {}
@@ -163,12 +200,13 @@ def on_message(client, userdata, msg):
         return
 
     try:
-        metrics = decode_payload(msg.payload)
-        if metrics:
-            dev = meta["device"] or "device"
-            ilp_send(dev, metrics)
-        else:
-            logging.debug("No metrics decoded for topic=%s", msg.topic)
+        for ts_ms, payload in split_batch(msg.payload):
+            metrics = decode_payload(payload, meta["node"])
+            if metrics:
+                dev = meta["device"] or "device"
+                ilp_send(dev, metrics, ts_ms)
+            else:
+                logging.debug("No metrics decoded for topic=%s", msg.topic)
     except Exception as e:
         logging.warning("Decode/PG insert failed: %s (topic=%s)", e, msg.topic)
 
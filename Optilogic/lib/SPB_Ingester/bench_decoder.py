@@ -0,0 +1,83 @@
+"""
+Benchmark: spb_fastdecode (C++ zero-copy) mod sparkplug_b_pb2 (fuld protobuf-parse)
+
+Kræver sparkplug_b_pb2 (genereret fra sparkplug_b.proto) og at spb_fastdecode
+er bygget:  python3 setup.py build_ext --inplace
+Kør:        python3 bench_decoder.py [antal_beskeder]
+"""
+import random
+import sys
+import time
+
+import sparkplug_b_pb2 as spb
+import spb_fastdecode
+
+NAMES = ("temp", "tryk", "rpm")
+
+
+def make_payloads(n: int, extra_metrics: int = 0):
+    """Samme payloads som SPB_emulater.py, evt. med ekstra metrics der skal springes over."""
+    out = []
+    for seq in range(n):
+        p = spb.Payload()
+        p.timestamp = 1700000000000 + seq
+        p.seq = seq % 256
+        m = p.metrics.add(); m.name = "temp"; m.datatype = 10; m.double_value = 22.0 + random.random() * 3
+        m = p.metrics.add(); m.name = "tryk"; m.datatype = 10; m.double_value = 2.0 + random.random() * 0.5
+        m = p.metrics.add(); m.name = "rpm"; m.datatype = 4; m.long_value = 900 + random.randint(0, 300)
+        for i in range(extra_metrics):
+            m = p.metrics.add(); m.name = f"reg{i}"; m.datatype = 3; m.int_value = i
+        out.append(p.SerializeToString())
+    return out
+
+
+def decode_pb2(b: bytes):
+    """Som decode_payload() i SPB_ingester.py."""
+    payload = spb.Payload()
+    payload.ParseFromString(b)
+    out = {}
+    for m in payload.metrics:
+        if not m.name:
+            continue
+        if m.name in ("temp", "tryk"):
+            if m.HasField("float_value"):
+                out[m.name] = float(m.float_value)
+            elif m.HasField("double_value"):
+                out[m.name] = float(m.double_value)
+            elif m.HasField("int_value"):
+                out[m.name] = float(m.int_value)
+            elif m.HasField("long_value"):
+                out[m.name] = float(m.long_value)
+        elif m.name == "rpm":
+            if m.HasField("int_value"):
+                out["rpm"] = int(m.int_value)
+            elif m.HasField("long_value"):
+                out["rpm"] = int(m.long_value)
+    return out
+
+
+def timed(label: str, n: int, fn) -> float:
+    start = time.perf_counter()
+    fn()
+    us = (time.perf_counter() - start) * 1e6 / n
+    print(f"{label:<38} {us:8.2f} µs/besked  {1e6 / us:12.0f} beskeder/s")
+    return us
+
+
+def main():
+    n = int(sys.argv[1]) if len(sys.argv) > 1 else 100000
+    dec = spb_fastdecode.Decoder(NAMES)
+
+    for extra in (0, 16):
+        payloads = make_payloads(n, extra)
+        assert dec.decode(payloads[0]) == decode_pb2(payloads[0])
+        print(f"\n{n} beskeder, {3 + extra} metrics pr. besked")
+        base = timed("sparkplug_b_pb2 + HasField", n, lambda: [decode_pb2(b) for b in payloads])
+        fast = timed("spb_fastdecode.decode", n, lambda: [dec.decode(b) for b in payloads])
+        batch = timed("spb_fastdecode.decode_batch (1000)", n,
+                      lambda: [dec.decode_batch(payloads[i:i + 1000]) for i in range(0, n, 1000)])
+        print(f"speedup: decode {base / fast:.1f}x, decode_batch {base / batch:.1f}x")
+
+
+if __name__ == "__main__":
+    main()
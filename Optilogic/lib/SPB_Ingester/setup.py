@@ -0,0 +1,17 @@
+# Bygger spb_fastdecode (zero-copy Sparkplug B dekoder) til SPB_ingester.py
+#   python3 setup.py build_ext --inplace
+from setuptools import Extension, setup
+
+setup(
+    name="spb_fastdecode",
+    version="0.1.0",
+    ext_modules=[
+        Extension(
+            "spb_fastdecode",
+            sources=["spb_fastdecode.cpp"],
+            include_dirs=["../SparkplugB"],
+            extra_compile_args=["-std=c++17", "-O2"],
+            language="c++",
+        )
+    ],
+)
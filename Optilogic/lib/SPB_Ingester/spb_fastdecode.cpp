@@ -0,0 +1,219 @@
+// spb_fastdecode – Python-extension omkring den zero-copy Sparkplug B dekoder
+// (lib/SparkplugB/SparkplugDecoder.h). Bruges af SPB_ingester.py når den er bygget.
+//
+// Byg:   python3 setup.py build_ext --inplace
+//
+//   dec = spb_fastdecode.Decoder(("temp", "tryk", "rpm"))
+//   dec.decode(payload)          -> {"temp": 22.5, "tryk": 2.2, "rpm": 1000}
+//   dec.decode_batch([p1, p2])   -> dict med array.array-kolonner (struct-of-arrays)
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <string>
+#include <vector>
+
+#include "SparkplugDecoder.h"
+
+static PyObject* arrayType = nullptr;   // array.array
+static PyObject* DecodeError = nullptr;
+
+typedef struct {
+  PyObject_HEAD
+  spb::Decoder* decoder;
+  spb::MetricBatch* batch;   // genbruges mellem kald
+} DecoderObject;
+
+// ================= HJÆLPERE =================
+static PyObject* makeArray(const char* typecode, const void* data, size_t bytes) {
+  return PyObject_CallFunction(arrayType, "sy#", typecode,
+                               static_cast<const char*>(data), Py_ssize_t(bytes));
+}
+
+template <class T>
+static PyObject* makeArray(const char* typecode, const std::vector<T>& v) {
+  return makeArray(typecode, v.data(), v.size() * sizeof(T));
+}
+
+// Navne kan i princippet indeholde ugyldig UTF-8 eller '\0': dekod med
+// længde og erstatningstegn, så det aldrig giver NULL uden en exception
+static PyObject* nameObject(const std::string& name) {
+  return PyUnicode_DecodeUTF8(name.data(), Py_ssize_t(name.size()), "replace");
+}
+
+static PyObject* valueObject(const spb::MetricBatch& b, size_t i) {
+  if (b.isInteger[i]) return PyLong_FromLongLong(b.intValue[i]);
+  return PyFloat_FromDouble(b.value[i]);
+}
+
+// ================= Decoder TYPE =================
+static int Decoder_init(DecoderObject* self, PyObject* args, PyObject*) {
+  PyObject* namesArg;
+  if (!PyArg_ParseTuple(args, "O", &namesArg)) return -1;
+  PyObject* seq = PySequence_Fast(namesArg, "names skal være en sekvens af str");
+  if (!seq) return -1;
+
+  std::vector<std::string> names;
+  Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+  if (n > 0xFFFF) {
+    Py_DECREF(seq);
+    PyErr_SetString(PyExc_ValueError, "for mange navne");
+    return -1;
+  }
+  for (Py_ssize_t i = 0; i < n; i++) {
+    Py_ssize_t len;
+    const char* s = PyUnicode_AsUTF8AndSize(PySequence_Fast_GET_ITEM(seq, i), &len);
+    if (!s) {
+      Py_DECREF(seq);
+      return -1;
+    }
+    names.emplace_back(s, size_t(len));
+  }
+  Py_DECREF(seq);
+
+  delete self->decoder;
+  delete self->batch;
+  self->decoder = new spb::Decoder(names);
+  self->batch = new spb::MetricBatch();
+  return 0;
+}
+
+static void Decoder_dealloc(DecoderObject* self) {
+  delete self->decoder;
+  delete self->batch;
+  Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+static bool ready(DecoderObject* self) {
+  if (!self->decoder) {
+    PyErr_SetString(PyExc_RuntimeError, "Decoder ikke initialiseret");
+    return false;
+  }
+  return true;
+}
+
+// decode(payload) -> dict med de udvalgte metrics
+static PyObject* Decoder_decode(DecoderObject* self, PyObject* arg) {
+  if (!ready(self)) return nullptr;
+  Py_buffer view;
+  if (PyObject_GetBuffer(arg, &view, PyBUF_SIMPLE) != 0) return nullptr;
+
+  spb::MetricBatch& b = *self->batch;
+  b.clear();
+  bool ok = self->decoder->decode(static_cast<const uint8_t*>(view.buf), size_t(view.len), b);
+  PyBuffer_Release(&view);
+  if (!ok) {
+    PyErr_SetString(DecodeError, "ugyldig Sparkplug B payload");
+    return nullptr;
+  }
+
+  PyObject* out = PyDict_New();
+  if (!out) return nullptr;
+  const std::vector<std::string>& names = self->decoder->names();
+  for (size_t i = 0; i < b.size(); i++) {
+    PyObject* k = nameObject(names[b.column[i]]);
+    PyObject* v = k ? valueObject(b, i) : nullptr;
+    if (!v || PyDict_SetItem(out, k, v) != 0) {
+      Py_XDECREF(k);
+      Py_XDECREF(v);
+      Py_DECREF(out);
+      return nullptr;
+    }
+    Py_DECREF(k);
+    Py_DECREF(v);
+  }
+  return out;
+}
+
+// decode_batch(payloads) -> dict med kolonner; row er index i payloads
+static PyObject* Decoder_decode_batch(DecoderObject* self, PyObject* arg) {
+  if (!ready(self)) return nullptr;
+  PyObject* seq = PySequence_Fast(arg, "payloads skal være en sekvens");
+  if (!seq) return nullptr;
+
+  spb::MetricBatch& b = *self->batch;
+  b.clear();
+  Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+  b.reserve(size_t(n) * self->decoder->names().size());
+  std::vector<uint32_t> errors;
+
+  for (Py_ssize_t i = 0; i < n; i++) {
+    Py_buffer view;
+    if (PyObject_GetBuffer(PySequence_Fast_GET_ITEM(seq, i), &view, PyBUF_SIMPLE) != 0) {
+      Py_DECREF(seq);
+      return nullptr;
+    }
+    if (!self->decoder->decode(static_cast<const uint8_t*>(view.buf), size_t(view.len), b)) {
+      errors.push_back(uint32_t(i));
+      b.messages++;   // behold row = index i input
+    }
+    PyBuffer_Release(&view);
+  }
+  Py_DECREF(seq);
+
+  PyObject* names = PyTuple_New(Py_ssize_t(self->decoder->names().size()));
+  if (!names) return nullptr;
+  for (size_t i = 0; i < self->decoder->names().size(); i++) {
+    PyObject* name = nameObject(self->decoder->names()[i]);
+    if (!name) {
+      Py_DECREF(names);
+      return nullptr;
+    }
+    PyTuple_SET_ITEM(names, Py_ssize_t(i), name);
+  }
+
+  return Py_BuildValue("{s:N,s:N,s:N,s:N,s:N,s:N,s:N,s:I}",
+                       "names", names,
+                       "row", makeArray("I", b.row),
+                       "column", makeArray("H", b.column),
+                       "value", makeArray("d", b.value),
+                       "int_value", makeArray("q", b.intValue),
+                       "is_int", makeArray("B", b.isInteger),
+                       "timestamp", makeArray("Q", b.timestamp),
+                       "errors", unsigned(errors.size()));
+}
+
+static PyMethodDef Decoder_methods[] = {
+  {"decode", reinterpret_cast<PyCFunction>(Decoder_decode), METH_O,
+   "decode(payload) -> dict med udvalgte metrics"},
+  {"decode_batch", reinterpret_cast<PyCFunction>(Decoder_decode_batch), METH_O,
+   "decode_batch(payloads) -> dict med struct-of-arrays kolonner"},
+  {nullptr, nullptr, 0, nullptr},
+};
+
+static PyTypeObject DecoderType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+// ================= MODUL =================
+static PyModuleDef moduledef = {
+  PyModuleDef_HEAD_INIT, "spb_fastdecode",
+  "Zero-copy Sparkplug B dekoder", -1, nullptr,
+};
+
+PyMODINIT_FUNC PyInit_spb_fastdecode(void) {
+  DecoderType.tp_name = "spb_fastdecode.Decoder";
+  DecoderType.tp_basicsize = sizeof(DecoderObject);
+  DecoderType.tp_flags = Py_TPFLAGS_DEFAULT;
+  DecoderType.tp_doc = "Decoder(names) – dekoder udvalgte metrics efter navn eller alias";
+  DecoderType.tp_new = PyType_GenericNew;
+  DecoderType.tp_init = reinterpret_cast<initproc>(Decoder_init);
+  DecoderType.tp_dealloc = reinterpret_cast<destructor>(Decoder_dealloc);
+  DecoderType.tp_methods = Decoder_methods;
+  if (PyType_Ready(&DecoderType) < 0) return nullptr;
+
+  PyObject* arrayModule = PyImport_ImportModule("array");
+  if (!arrayModule) return nullptr;
+  arrayType = PyObject_GetAttrString(arrayModule, "array");
+  Py_DECREF(arrayModule);
+  if (!arrayType) return nullptr;
+
+  PyObject* m = PyModule_Create(&moduledef);
+  if (!m) return nullptr;
+  DecodeError = PyErr_NewException("spb_fastdecode.DecodeError", PyExc_ValueError, nullptr);
+  Py_INCREF(&DecoderType);
+  if (PyModule_AddObject(m, "Decoder", reinterpret_cast<PyObject*>(&DecoderType)) < 0 ||
+      PyModule_AddObject(m, "DecodeError", DecodeError) < 0) {
+    Py_DECREF(m);
+    return nullptr;
+  }
+  return m;
+}
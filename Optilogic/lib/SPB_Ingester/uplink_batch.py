@@ -0,0 +1,91 @@
+"""
+Udpakning af uplink-batches (lib/UplinkBatch/UplinkBatch.h), fælles for
+SPB_ingester.py og Ingestor-json.py.
+
+Rå samples kan komme samlet i én MQTT-besked:
+    0xFF 'B' encoding antal base_ts(8, LE ms) rawLen(2, LE) body
+body (encoding 1 = LZSS, se Lzss.h) = varint(zigzag(ts - base_ts)) varint(længde) payload pr. sample.
+"""
+from typing import List, Optional, Tuple
+
+HEADER_SIZE = 14
+ENC_NONE = 0
+ENC_LZSS = 1
+
+
+def _lzss_decompress(data: bytes, raw_len: int) -> bytes:
+    out = bytearray()
+    bits = int.from_bytes(data, "big")
+    left = len(data) * 8
+
+    def get(n: int) -> int:
+        nonlocal left
+        if n > left:
+            raise ValueError("LZSS-strømmen slutter for tidligt")
+        left -= n
+        return (bits >> left) & ((1 << n) - 1)
+
+    while len(out) < raw_len:
+        if get(1):
+            out.append(get(8))
+            continue
+        dist = get(10) + 1
+        length = get(5) + 3
+        if dist > len(out):
+            raise ValueError("LZSS-afstand uden for outputtet")
+        for _ in range(length):
+            out.append(out[-dist])
+    return bytes(out[:raw_len])
+
+
+def _varint(b: bytes, pos: int) -> Tuple[int, int]:
+    value = shift = 0
+    while True:
+        if pos >= len(b):
+            raise ValueError("varint slutter for tidligt")
+        byte = b[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, pos
+        shift += 7
+
+
+def _unzigzag(v: int) -> int:
+    return (v >> 1) ^ -(v & 1)
+
+
+def is_batch(b: bytes) -> bool:
+    return len(b) >= HEADER_SIZE and b[0] == 0xFF and b[1] == ord("B")
+
+
+def split_batch(b: bytes) -> List[Tuple[Optional[int], bytes]]:
+    """
+    (tidsstempel i unix ms, payload) pr. sample i en batch, eller [(None, b)]
+    hvis beskeden ikke er en batch. Tidsstemplet er None når enhedens ur
+    ikke var sat (0), så modtageren stempler ved indsættelse som uden batch.
+    """
+    if not is_batch(b):
+        return [(None, b)]
+    base = int.from_bytes(b[4:12], "little", signed=True)
+    raw_len = int.from_bytes(b[12:14], "little")
+    if b[2] == ENC_LZSS:
+        body = _lzss_decompress(b[HEADER_SIZE:], raw_len)
+    elif b[2] == ENC_NONE and len(b) - HEADER_SIZE == raw_len:
+        body = b[HEADER_SIZE:]
+    else:
+        raise ValueError("ukendt encoding eller forkert længde i batch")
+
+    out: List[Tuple[Optional[int], bytes]] = []
+    pos = 0
+    while pos < len(body):
+        dt, pos = _varint(body, pos)
+        n, pos = _varint(body, pos)
+        if pos + n > len(body):
+            raise ValueError("payload længere end batchen")
+        ts = base + _unzigzag(dt)
+        out.append((ts if ts > 0 else None, body[pos:pos + n]))
+        pos += n
+    if len(out) != b[3]:
+        raise ValueError("antal samples passer ikke med headeren")
+    return out
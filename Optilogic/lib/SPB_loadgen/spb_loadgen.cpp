@@ -0,0 +1,480 @@
+// Sparkplug B load-generator: mange simulerede devices mod MQTT -> ingestor -> QuestDB
+//
+// Bygger videre på paho async-klienten fra lib/no/paho-pubcopy.cpp. Hver
+// edge node er én MQTT-klient med NBIRTH/NDEATH (will), og hver device under
+// noden kører sit eget DBIRTH -> DDATA... -> DDEATH forløb. Med --format spb
+// er hele forløbet Sparkplug B: NBIRTH har seq 0 og samme bdSeq som NDEATH-
+// will'en, og seq tælles kun op for beskeder der faktisk sendes.
+//
+// Byg:   g++ -std=c++17 -O2 -pthread -I../SparkplugB spb_loadgen.cpp -o spb_loadgen
+//            -lpaho-mqttpp3 -lpaho-mqtt3as
+// Kør:   ./spb_loadgen --broker tcp://localhost:1883 --nodes 20 --devices 2000
+//            --threads 4 --rate 1 --qos 1 --format spb --duration 60
+
+#include <mqtt/async_client.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SparkplugB.h"
+
+using Clock = std::chrono::steady_clock;
+
+// ================= KONFIGURATION =================
+enum class PayloadFormat { Text, Json, Spb };
+
+struct LoadConfig {
+  std::string broker   = "tcp://localhost:1883";
+  std::string group    = "plantA";
+  int      nodes       = 10;       // MQTT-klienter (edge nodes)
+  int      devices     = 1000;     // devices i alt, fordelt på noderne
+  int      threads     = 4;        // worker-tråde, noderne fordeles på dem
+  double   rate        = 0.2;      // DDATA pr. device pr. sekund (0.2 = hvert 5. sek som emulatoren)
+  int      qos         = 1;
+  int      durationS   = 30;
+  int      lifetimeS   = 0;        // >0: device dør og genfødes efter så mange sekunder
+  int      maxInflight = 1000;     // pr. node, før der springes over
+  PayloadFormat format = PayloadFormat::Spb;
+};
+
+static std::atomic<bool> running{true};
+static void onSignal(int) { running = false; }
+
+static uint64_t epochMs() {
+  return uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+static uint64_t nowNs() {
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      Clock::now().time_since_epoch()).count());
+}
+
+// ================= LATENS-HISTOGRAM =================
+// Log-lineært histogram i µs (16 under-spande pr. 2-potens, ~6% opløsning).
+// Lock-free, så paho's callback-tråde kan skrive samtidig.
+class LatencyHistogram {
+public:
+  static constexpr int SUB = 16;
+  static constexpr int BUCKETS = 61 * SUB;
+
+  void record(uint64_t us) {
+    buckets_[index(us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t prev = max_.load(std::memory_order_relaxed);
+    while (us > prev && !max_.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {}
+  }
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+  uint64_t percentile(double q) const {
+    uint64_t total = count();
+    if (total == 0) return 0;
+    uint64_t target = std::max<uint64_t>(1, uint64_t(q * total + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+      seen += buckets_[i].load(std::memory_order_relaxed);
+      if (seen >= target) return std::min(midpoint(i), max());
+    }
+    return max();
+  }
+
+private:
+  static int index(uint64_t v) {
+    if (v < SUB) return int(v);
+    int msb = 63 - __builtin_clzll(v);
+    return (msb - 3) * SUB + int((v >> (msb - 4)) & (SUB - 1));
+  }
+
+  static uint64_t midpoint(int i) {
+    if (i < SUB) return uint64_t(i);
+    int msb = i / SUB + 3;
+    uint64_t lo = uint64_t(SUB + i % SUB) << (msb - 4);
+    return lo + ((uint64_t(1) << (msb - 4)) >> 1);
+  }
+
+  std::array<std::atomic<uint64_t>, BUCKETS> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> max_{0};
+};
+
+// ================= FÆLLES TÆLLERE =================
+struct LoadStats {
+  std::atomic<uint64_t> published{0};   // afleveret til paho
+  std::atomic<uint64_t> acked{0};       // bekræftet (PUBACK for QoS1, socket-skrivning for QoS0)
+  std::atomic<uint64_t> failed{0};      // on_failure eller exception ved publish
+  std::atomic<uint64_t> skipped{0};     // sprunget over (inflight-vindue fuldt / bagud)
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> births{0};
+  std::atomic<uint64_t> deaths{0};
+  LatencyHistogram latency;
+};
+
+// Sendetidspunktet sendes med som user context, så der ikke skal allokeres pr. besked
+class AckListener : public mqtt::iaction_listener {
+public:
+  AckListener(LoadStats& stats, std::atomic<int>& inflight) : stats_(stats), inflight_(inflight) {}
+
+  void on_success(const mqtt::token& tok) override {
+    uint64_t sentNs = uint64_t(reinterpret_cast<uintptr_t>(tok.get_user_context()));
+    stats_.latency.record((nowNs() - sentNs) / 1000);
+    stats_.acked.fetch_add(1, std::memory_order_relaxed);
+    inflight_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void on_failure(const mqtt::token&) override {
+    stats_.failed.fetch_add(1, std::memory_order_relaxed);
+    inflight_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+private:
+  LoadStats& stats_;
+  std::atomic<int>& inflight_;
+};
+
+// ================= DEVICE / NODE =================
+struct SimDevice {
+  std::string topBirth, topData, topDeath;
+  double   temp = 22.0, tryk = 2.2;
+  int64_t  rpm  = 1000;
+  bool     alive = false;
+  Clock::time_point bornAt;
+};
+
+class SimNode {
+public:
+  SimNode(const LoadConfig& cfg, LoadStats& stats, int index, int deviceCount, uint32_t seed)
+      : cfg_(cfg), stats_(stats), rng_(seed), listener_(stats, inflight_) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "loadgen-node-%04d", index);
+    nodeId_ = name;
+    std::string base = "spBv1.0/" + cfg.group + "/";
+    topNBirth_ = base + "NBIRTH/" + nodeId_;
+    topNDeath_ = base + "NDEATH/" + nodeId_;
+    for (int d = 0; d < deviceCount; d++) {
+      SimDevice dev;
+      std::string id = nodeId_ + "/dev-" + std::to_string(d);
+      dev.topBirth = base + "DBIRTH/" + id;
+      dev.topData  = base + "DDATA/"  + id;
+      dev.topDeath = base + "DDEATH/" + id;
+      devices_.push_back(std::move(dev));
+    }
+    client_ = std::make_unique<mqtt::async_client>(cfg.broker, nodeId_);
+  }
+
+  bool connect() {
+    mqtt::connect_options opts;
+    opts.set_clean_session(true);
+    opts.set_keep_alive_interval(30);
+    opts.set_max_inflight(cfg_.maxInflight);
+    bdSeq_ = bdSeq_ % 255 + 1;   // ny session: NBIRTH og will'en deler bdSeq
+    size_t willLen = encodeNodeDeath(buf_, sizeof(buf_));
+    opts.set_will(mqtt::will_options(topNDeath_, buf_, willLen, 1, false));
+    try {
+      client_->connect(opts)->wait();
+    } catch (const mqtt::exception& exc) {
+      std::fprintf(stderr, "%s: connect fejlede: %s\n", nodeId_.c_str(), exc.what());
+      return false;
+    }
+    seq_ = 0;   // NBIRTH har altid seq 0
+    size_t len = encodeNodeBirth(buf_, sizeof(buf_));
+    if (!publishSeq(topNBirth_, len, 1)) {
+      std::fprintf(stderr, "%s: NBIRTH kunne ikke sendes\n", nodeId_.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  void disconnect() {
+    for (auto& dev : devices_) {
+      if (dev.alive) death(dev);
+    }
+    try {
+      size_t len = encodeNodeDeath(buf_, sizeof(buf_));
+      publish(topNDeath_, buf_, len, 1);
+      client_->disconnect()->wait();
+    } catch (const mqtt::exception&) {}
+  }
+
+  size_t deviceCount() const { return devices_.size(); }
+
+  // Ét DDATA for device i; fødsel/død håndteres her, så forløbet er pr. device
+  void step(size_t i, Clock::time_point now) {
+    SimDevice& dev = devices_[i];
+    if (cfg_.lifetimeS > 0 && dev.alive && now - dev.bornAt >= std::chrono::seconds(cfg_.lifetimeS)) {
+      death(dev);
+    }
+    if (!dev.alive && !birth(dev, now)) return;   // ingen DDATA før DBIRTH er sendt
+
+    std::uniform_real_distribution<double> dt(-0.05, 0.05);
+    std::uniform_int_distribution<int> dr(-10, 10);
+    dev.temp = std::clamp(dev.temp + dt(rng_), 18.0, 28.0);
+    dev.tryk = std::clamp(dev.tryk + dt(rng_) / 10, 1.8, 2.6);
+    dev.rpm  = std::clamp<int64_t>(dev.rpm + dr(rng_), 800, 1800);
+
+    size_t len = encode(dev, buf_, sizeof(buf_));
+    publishSeq(dev.topData, len, cfg_.qos);
+  }
+
+private:
+  // Tilstanden skifter kun når beskeden faktisk er sendt (vinduet kan være fuldt)
+  bool birth(SimDevice& dev, Clock::time_point now) {
+    size_t len = encode(dev, buf_, sizeof(buf_));
+    if (!publishSeq(dev.topBirth, len, 1)) return false;
+    dev.alive = true;
+    dev.bornAt = now;
+    stats_.births.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  void death(SimDevice& dev) {
+    size_t len = encodeDeviceDeath(buf_, sizeof(buf_));
+    if (!publishSeq(dev.topDeath, len, 1)) return;   // prøves igen ved næste step
+    dev.alive = false;
+    stats_.deaths.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // ---- livscyklus: Sparkplug B i spb, ellers tekst/flad JSON som før ----
+  size_t encodeNodeBirth(uint8_t* out, size_t cap) {
+    if (cfg_.format == PayloadFormat::Spb) {
+      spb::Metric m = spb::Metric::ofLong("bdSeq", int64_t(bdSeq_));
+      return spb::encodePayload(epochMs(), seq_, &m, 1, out, cap);
+    }
+    return text(out, cap, cfg_.format == PayloadFormat::Json ? "{\"bdSeq\":%u}" : "NBIRTH bdSeq=%u", bdSeq_);
+  }
+
+  size_t encodeNodeDeath(uint8_t* out, size_t cap) {
+    if (cfg_.format == PayloadFormat::Spb) return spb::encodeDeathPayload(bdSeq_, out, cap);
+    return text(out, cap, cfg_.format == PayloadFormat::Json ? "{\"bdSeq\":%u}" : "NDEATH bdSeq=%u", bdSeq_);
+  }
+
+  size_t encodeDeviceDeath(uint8_t* out, size_t cap) {
+    if (cfg_.format == PayloadFormat::Spb) return spb::encodePayload(epochMs(), seq_, nullptr, 0, out, cap);
+    return text(out, cap, cfg_.format == PayloadFormat::Json ? "{}" : "DDEATH", 0);
+  }
+
+  static size_t text(uint8_t* out, size_t cap, const char* fmt, unsigned v) {
+    int n = std::snprintf(reinterpret_cast<char*>(out), cap, fmt, v);
+    return n > 0 ? std::min(size_t(n), cap) : 0;
+  }
+
+  size_t encode(const SimDevice& dev, uint8_t* out, size_t cap) {
+    uint64_t ts = epochMs();
+    int n = 0;
+    switch (cfg_.format) {
+      case PayloadFormat::Text:   // samme format som fallback-dekoderen i SPB_ingester.py
+        n = std::snprintf(reinterpret_cast<char*>(out), cap, "temp=%.2f,tryk=%.2f,rpm=%" PRId64,
+                          dev.temp, dev.tryk, dev.rpm);
+        break;
+      case PayloadFormat::Json:   // flad JSON som firmwaren sender (læses af Ingestor-json.py)
+        n = std::snprintf(reinterpret_cast<char*>(out), cap,
+                          "{\"temp\":%.2f,\"tryk\":%.2f,\"rpm\":%" PRId64 "}", dev.temp, dev.tryk, dev.rpm);
+        break;
+      case PayloadFormat::Spb: {
+        spb::Metric m[3] = {
+          spb::Metric::ofDouble("temp", dev.temp),
+          spb::Metric::ofDouble("tryk", dev.tryk),
+          spb::Metric::ofLong("rpm", dev.rpm),
+        };
+        n = int(spb::encodePayload(ts, seq_, m, 3, out, cap));
+        break;
+      }
+    }
+    return n > 0 ? std::min(size_t(n), cap) : 0;
+  }
+
+  // Besked med seq fra buf_: seq tælles kun op når den er sendt, så en
+  // oversprunget besked ikke giver et hul i Sparkplug-sekvensen
+  bool publishSeq(const std::string& topic, size_t len, int qos) {
+    if (!publish(topic, buf_, len, qos)) return false;
+    seq_ = (seq_ + 1) % 256;   // Sparkplug seq er 0..255 pr. node
+    return true;
+  }
+
+  // false hvis beskeden ikke blev afleveret til paho (vindue fuldt eller fejl)
+  bool publish(const std::string& topic, const void* data, size_t len, int qos) {
+    if (!len) return false;
+    if (inflight_.load(std::memory_order_relaxed) >= cfg_.maxInflight) {
+      stats_.skipped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    inflight_.fetch_add(1, std::memory_order_relaxed);
+    try {
+      auto msg = mqtt::make_message(topic, data, len, qos, false);
+      void* sentAt = reinterpret_cast<void*>(uintptr_t(nowNs()));
+      client_->publish(msg, sentAt, listener_);
+      stats_.published.fetch_add(1, std::memory_order_relaxed);
+      stats_.bytes.fetch_add(len, std::memory_order_relaxed);
+      return true;
+    } catch (const mqtt::exception&) {
+      inflight_.fetch_sub(1, std::memory_order_relaxed);
+      stats_.failed.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+
+  const LoadConfig& cfg_;
+  LoadStats& stats_;
+  std::mt19937 rng_;
+  std::string nodeId_, topNBirth_, topNDeath_;
+  std::vector<SimDevice> devices_;
+  std::unique_ptr<mqtt::async_client> client_;
+  std::atomic<int> inflight_{0};
+  AckListener listener_;
+  uint64_t seq_ = 0;
+  unsigned bdSeq_ = 0;   // 1-255 efter connect (ingen 0-bytes i will'en, som firmwaren)
+  uint8_t buf_[512];
+};
+
+// ================= WORKER =================
+// Hver tråd ejer et sæt noder og sender DDATA jævnt fordelt over perioden
+// på absolutte deadlines. Er tråden bagud, springes sendinger over i stedet
+// for at komme i burst, så raten ikke overskydes efter en pause.
+static void worker(std::vector<SimNode*> nodes, const LoadConfig& cfg, LoadStats& stats) {
+  std::vector<std::pair<SimNode*, size_t>> slots;
+  for (SimNode* n : nodes) {
+    for (size_t i = 0; i < n->deviceCount(); i++) slots.emplace_back(n, i);
+  }
+  if (slots.empty() || cfg.rate <= 0) return;
+
+  auto interval = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / (cfg.rate * slots.size())));
+  auto next = Clock::now();
+  size_t k = 0;
+
+  while (running) {
+    auto now = Clock::now();
+    if (now < next) {
+      std::this_thread::sleep_until(std::min(next, now + std::chrono::milliseconds(50)));
+      continue;
+    }
+    slots[k].first->step(slots[k].second, now);
+    k = (k + 1) % slots.size();
+    next += interval;
+    if (now - next > std::chrono::seconds(1)) {
+      // mere end 1 s bagud: drop det manglende og fortsæt fra nu
+      auto behind = (now - next) / interval;
+      stats.skipped.fetch_add(uint64_t(behind), std::memory_order_relaxed);
+      next = now;
+    }
+  }
+}
+
+// ================= RAPPORT =================
+static void report(const char* label, LoadStats& s, double seconds,
+                   uint64_t pubDelta, uint64_t ackDelta) {
+  std::printf("%s pub/s=%.0f ack/s=%.0f total_pub=%" PRIu64 " ack=%" PRIu64
+              " fejl=%" PRIu64 " skip=%" PRIu64 " ack_us p50=%" PRIu64 " p90=%" PRIu64
+              " p99=%" PRIu64 " p99.9=%" PRIu64 " max=%" PRIu64 "\n",
+              label, pubDelta / seconds, ackDelta / seconds,
+              s.published.load(), s.acked.load(), s.failed.load(), s.skipped.load(),
+              s.latency.percentile(0.50), s.latency.percentile(0.90),
+              s.latency.percentile(0.99), s.latency.percentile(0.999), s.latency.max());
+  std::fflush(stdout);
+}
+
+static void usage(const char* prog) {
+  std::fprintf(stderr,
+      "Brug: %s [valg]\n"
+      "  --broker URI        (standard tcp://localhost:1883)\n"
+      "  --group NAVN        Sparkplug group id (standard plantA)\n"
+      "  --nodes N           antal edge nodes / MQTT-klienter (standard 10)\n"
+      "  --devices N         antal devices i alt (standard 1000)\n"
+      "  --threads N         worker-tråde (standard 4)\n"
+      "  --rate R            DDATA pr. device pr. sekund (standard 0.2)\n"
+      "  --qos 0|1|2         QoS for DDATA (standard 1)\n"
+      "  --format F          text | json | spb (standard spb)\n"
+      "  --duration S        varighed i sekunder (standard 30)\n"
+      "  --lifetime S        device dør og genfødes efter S sekunder (standard 0 = aldrig)\n"
+      "  --max-inflight N    pr. node (standard 1000)\n", prog);
+}
+
+static bool parseArgs(int argc, char** argv, LoadConfig& cfg) {
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) return false;
+    const char* v = argv[++i];
+    if (a == "--broker")             cfg.broker = v;
+    else if (a == "--group")         cfg.group = v;
+    else if (a == "--nodes")         cfg.nodes = std::max(1, std::atoi(v));
+    else if (a == "--devices")       cfg.devices = std::max(0, std::atoi(v));
+    else if (a == "--threads")       cfg.threads = std::max(1, std::atoi(v));
+    else if (a == "--rate")          cfg.rate = std::atof(v);
+    else if (a == "--qos")           cfg.qos = std::clamp(std::atoi(v), 0, 2);
+    else if (a == "--duration")      cfg.durationS = std::atoi(v);
+    else if (a == "--lifetime")      cfg.lifetimeS = std::atoi(v);
+    else if (a == "--max-inflight")  cfg.maxInflight = std::max(1, std::atoi(v));
+    else if (a == "--format") {
+      std::string f = v;
+      if (f == "text")      cfg.format = PayloadFormat::Text;
+      else if (f == "json") cfg.format = PayloadFormat::Json;
+      else if (f == "spb")  cfg.format = PayloadFormat::Spb;
+      else return false;
+    }
+    else return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  LoadConfig cfg;
+  if (!parseArgs(argc, argv, cfg)) {
+    usage(argv[0]);
+    return 2;
+  }
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+
+  LoadStats stats;
+  std::vector<std::unique_ptr<SimNode>> nodes;
+  for (int n = 0; n < cfg.nodes; n++) {
+    int count = cfg.devices / cfg.nodes + (n < cfg.devices % cfg.nodes ? 1 : 0);
+    nodes.push_back(std::make_unique<SimNode>(cfg, stats, n, count, 1000u + n));
+  }
+
+  std::printf("Forbinder %d noder til %s...\n", cfg.nodes, cfg.broker.c_str());
+  for (auto& n : nodes) {
+    if (!n->connect()) return 1;
+  }
+
+  std::vector<std::vector<SimNode*>> perThread(cfg.threads);
+  for (size_t n = 0; n < nodes.size(); n++) perThread[n % cfg.threads].push_back(nodes[n].get());
+
+  std::printf("Starter %d devices på %d tråde, %.2f msg/s pr. device (forventet %.0f msg/s)\n",
+              cfg.devices, cfg.threads, cfg.rate, cfg.rate * cfg.devices);
+  auto start = Clock::now();
+  std::vector<std::thread> threads;
+  for (auto& group : perThread) threads.emplace_back(worker, group, std::cref(cfg), std::ref(stats));
+
+  uint64_t lastPub = 0, lastAck = 0;
+  while (running && (cfg.durationS <= 0 || Clock::now() - start < std::chrono::seconds(cfg.durationS))) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    uint64_t pub = stats.published.load(), ack = stats.acked.load();
+    report("[1s]", stats, 1.0, pub - lastPub, ack - lastAck);
+    lastPub = pub;
+    lastAck = ack;
+  }
+  running = false;
+  for (auto& t : threads) t.join();
+
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  for (auto& n : nodes) n->disconnect();
+
+  std::printf("\n=== Resultat (%.1f s, %" PRIu64 " bytes, %" PRIu64 " DBIRTH, %" PRIu64 " DDEATH) ===\n",
+              elapsed, stats.bytes.load(), stats.births.load(), stats.deaths.load());
+  report("[total]", stats, elapsed, stats.published.load(), stats.acked.load());
+  return 0;
+}
@@ -0,0 +1,40 @@
+#include "SampleClock.h"
+
+#ifdef ARDUINO
+#include <esp_timer.h>
+#include <sys/time.h>
+
+// Wall-clock hvis SNTP har sat uret, ellers monoton tid siden boot
+static int64_t readClock(int64_t validAfterUs, bool& wall) {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  int64_t wallUs = int64_t(tv.tv_sec) * 1000000 + tv.tv_usec;
+  wall = wallUs >= validAfterUs;
+  return wall ? wallUs : esp_timer_get_time();
+}
+
+// Kører i esp_timer-tasken (høj prioritet): kun bogføring og næste frist
+void SampleClock::onTimer(void* arg) {
+  SampleClock& clock = *static_cast<SampleClock*>(arg);
+  bool wall;
+  int64_t nowUs = readClock(clock.validAfterUs_, wall);
+  uint32_t delayUs = clock.fire(nowUs, wall);
+  esp_timer_start_once(static_cast<esp_timer_handle_t>(clock.timer_), delayUs ? delayUs : 1);
+}
+
+bool SampleClock::start(int64_t validAfterSec) {
+  if (timer_) return true;
+  validAfterUs_ = validAfterSec * 1000000;
+  esp_timer_create_args_t args = {};
+  args.callback = &SampleClock::onTimer;
+  args.arg = this;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "sampleclk";
+  esp_timer_handle_t handle;
+  if (esp_timer_create(&args, &handle) != ESP_OK) return false;
+  timer_ = handle;
+  bool wall;
+  uint32_t delayUs = delayToNext(readClock(validAfterUs_, wall));
+  return esp_timer_start_once(handle, delayUs ? delayUs : 1) == ESP_OK;
+}
+#endif
@@ -0,0 +1,142 @@
+#pragma once
+// Fast samplingstakt låst til wall-clock grænser
+//
+// Hver tick ligger på et helt multiplum af perioden regnet fra unix-epoch
+// (fx hvert 250. ms: ...:00.000, ...:00.250, ...), så alle enheder med
+// samme periode sampler på de samme tidsstempler og kan joines direkte.
+// Næste frist beregnes altid ud fra uret og tick-nummeret, aldrig som
+// "forrige + periode" på en lokal timer, så der er ingen drift, og
+// SNTP-justeringer slår igennem ved næste tick.
+//
+// En timer (esp_timer på ESP32, se SampleClock.cpp) kalder fire() ved hver
+// grænse og stiller den næste. Loop henter ticks med take(). Bogføring:
+//   skipped   grænser timeren ikke nåede (uret sprang frem, timer-tasken var optaget)
+//   overruns  ticks der blev overhalet af den næste før loop hentede dem
+//   resyncs   uret blev stillet mere end RESYNC_TICKS perioder, eller SNTP blev sat
+//   maxLateUs største forsinkelse fra grænse til fire()
+//
+// Før SNTP har sat uret tælles på den monotone tid (esp_timer_get_time),
+// og ticks har wallMs = 0. Skiftet til wall-clock tæller som et resync.
+//
+// fire() og take() må kaldes fra hver sin task.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+struct SampleTick {
+  uint64_t index  = 0;   // grænsens nummer siden epoch (eller siden boot før SNTP)
+  int64_t  wallMs = 0;   // unix-tid for grænsen, 0 hvis uret ikke er sat
+  uint32_t lateUs = 0;   // fra grænsen til timeren fyrede
+};
+
+class SampleClock {
+public:
+  static const uint32_t EARLY_US = 1000;     // fyrer timeren så tidligt, tæller det som grænsen
+  static const uint32_t RESYNC_TICKS = 16;   // større spring end dette er et stillet ur, ikke tabte ticks
+
+  struct Stats {
+    uint32_t ticks     = 0;
+    uint32_t skipped   = 0;
+    uint32_t overruns  = 0;
+    uint32_t resyncs   = 0;
+    uint32_t maxLateUs = 0;
+  };
+
+  explicit SampleClock(uint32_t periodMs) : periodUs_(int64_t(periodMs ? periodMs : 1) * 1000) {}
+
+  uint32_t periodMs() const { return uint32_t(periodUs_ / 1000); }
+
+  // µs fra nowUs til første grænse efter nowUs (til at stille timeren første gang)
+  uint32_t delayToNext(int64_t nowUs) const { return delayTo(uint64_t(nowUs / periodUs_) + 1, nowUs); }
+
+  /**
+   * @brief Registrerer at timeren har fyret
+   *
+   * @param nowUs  wall-clock (unix µs) hvis wall er sand, ellers monoton tid
+   * @return µs til næste grænse, til at stille timeren
+   */
+  uint32_t fire(int64_t nowUs, bool wall) {
+    uint64_t index = uint64_t((nowUs + EARLY_US) / periodUs_);
+    if (!started_ || wall != wall_) {   // første tick, eller skift fra monoton tid til wall-clock
+      if (started_) resyncs_.fetch_add(1, std::memory_order_relaxed);
+      started_ = true;
+      wall_ = wall;
+    } else if (index <= last_) {
+      if (last_ - index <= RESYNC_TICKS) return delayTo(last_ + 1, nowUs);   // for tidligt; vent på næste
+      resyncs_.fetch_add(1, std::memory_order_relaxed);                      // uret er stillet tilbage
+    } else {
+      uint64_t gap = index - last_ - 1;
+      if (gap > RESYNC_TICKS) resyncs_.fetch_add(1, std::memory_order_relaxed);
+      else if (gap) skipped_.fetch_add(uint32_t(gap), std::memory_order_relaxed);
+    }
+    last_ = index;
+
+    int64_t late = nowUs - int64_t(index) * periodUs_;
+    uint32_t lateUs = late > 0 ? uint32_t(late) : 0;
+    if (lateUs > maxLateUs_.load(std::memory_order_relaxed)) maxLateUs_.store(lateUs, std::memory_order_relaxed);
+    lateUs_.store(lateUs, std::memory_order_relaxed);
+    ticks_.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t tagged = (index << 1) | (wall ? 1 : 0);
+    if (pending_.exchange(tagged + 2, std::memory_order_acq_rel)) overruns_.fetch_add(1, std::memory_order_relaxed);
+    return delayTo(index + 1, nowUs);
+  }
+
+  /**
+   * @brief Henter seneste tick; false hvis der ikke er kommet en ny siden sidst
+   */
+  bool take(SampleTick& t) {
+    uint64_t tagged = pending_.exchange(0, std::memory_order_acq_rel);
+    if (!tagged) return false;
+    tagged -= 2;
+    t.index = tagged >> 1;
+    t.wallMs = (tagged & 1) ? int64_t(t.index) * (periodUs_ / 1000) : 0;
+    t.lateUs = lateUs_.load(std::memory_order_relaxed);
+    return true;
+  }
+
+  /**
+   * @brief Kopierer tællerne og nulstiller dem
+   */
+  Stats takeStats() {
+    Stats s;
+    s.ticks = ticks_.exchange(0, std::memory_order_relaxed);
+    s.skipped = skipped_.exchange(0, std::memory_order_relaxed);
+    s.overruns = overruns_.exchange(0, std::memory_order_relaxed);
+    s.resyncs = resyncs_.exchange(0, std::memory_order_relaxed);
+    s.maxLateUs = maxLateUs_.exchange(0, std::memory_order_relaxed);
+    return s;
+  }
+
+#ifdef ARDUINO
+  /**
+   * @brief Starter esp_timer; false hvis timeren ikke kunne oprettes
+   *
+   * @param validAfterSec  wall-clock før dette regnes som ikke sat (SNTP mangler)
+   */
+  bool start(int64_t validAfterSec);
+#endif
+
+private:
+  uint32_t delayTo(uint64_t index, int64_t nowUs) const {
+    int64_t d = int64_t(index) * periodUs_ - nowUs;
+    return d > 0 ? uint32_t(d) : 0;
+  }
+
+  int64_t  periodUs_;
+  uint64_t last_ = 0;   // kun timerens task
+  bool     started_ = false;
+  bool     wall_ = false;
+
+  std::atomic<uint64_t> pending_{0};   // (index << 1 | wall) + 2, 0 = ingen ny tick
+  std::atomic<uint32_t> lateUs_{0};
+  std::atomic<uint32_t> ticks_{0}, skipped_{0}, overruns_{0}, resyncs_{0}, maxLateUs_{0};
+
+#ifdef ARDUINO
+  static void onTimer(void* arg);
+  void*   timer_ = nullptr;   // esp_timer_handle_t
+  int64_t validAfterUs_ = 0;
+#endif
+};
@@ -0,0 +1,209 @@
+#pragma once
+// De seneste N samples i RAM, til live-visninger direkte fra enheden
+//
+// Poll-løkken skriver (én skriver), og HTTP-serverens task læser samtidig.
+// Der bruges ingen lås: læseren kopierer en plads og tjekker bagefter at
+// skriveren ikke har nået at overskrive den (seqlock-princippet). En læser
+// der er for langsom springer blot frem til ældste gyldige sample.
+//
+// Data ligger pr. metric (én kolonne pr. metric + én for tid), og tider er
+// millis(), så rækkefølgen er monoton selv hvis wall-clock justeres.
+// Omregning til unix-tid sker først ved udlæsning.
+//
+// SampleRingReader skriver et interval som kompakt JSON eller binært i
+// bidder, så svaret kan streames (chunked) uden at bygge det hele i RAM:
+//   JSON:   {"synced":true,"cols":["ts","temp",...],"rows":[[ts,21.5,...],...]}
+//   binært: "SRB1", uint8 M, uint8 decimaler[M], uint8 synced,
+//           derefter records: int64 ts, int32 værdi[M] (little-endian)
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "SampleSerializer.h"
+
+template <size_t N, size_t M>
+class SampleRing {
+public:
+  static_assert(N >= 1, "ringen skal have mindst 1 plads");
+
+  /**
+   * @brief Tilføjer én sample (rå fast-komma værdi pr. metric); kun fra én task
+   */
+  void push(uint32_t nowMs, const int32_t (&values)[M]) {
+    uint32_t w = written_.load(std::memory_order_relaxed);
+    size_t slot = w % SLOTS;
+    ts_[slot] = nowMs;
+    for (size_t m = 0; m < M; m++) values_[m][slot] = values[m];
+    written_.store(w + 1, std::memory_order_release);
+  }
+
+  // Samlet antal samples nogensinde skrevet; sekvensnummer for næste sample
+  uint32_t written() const { return written_.load(std::memory_order_acquire); }
+
+  // Ældste sekvensnummer der stadig ligger i ringen
+  uint32_t oldest() const {
+    uint32_t w = written();
+    return w > N ? w - uint32_t(N) : 0;
+  }
+
+  /**
+   * @brief Kopierer sample seq; false hvis den er overskrevet eller ikke findes
+   */
+  bool read(uint32_t seq, uint32_t& tsMs, int32_t (&values)[M]) const {
+    uint32_t w = written();
+    if (seq >= w || w - seq > N) return false;
+    size_t slot = seq % SLOTS;
+    tsMs = ts_[slot];
+    for (size_t m = 0; m < M; m++) values[m] = values_[m][slot];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // skriveren går i gang med pladsen når written() == seq + SLOTS
+    return written_.load(std::memory_order_relaxed) - seq < SLOTS;
+  }
+
+  /**
+   * @brief Første sekvensnummer hvis alder (nowMs - ts) er højst maxAgeMs
+   *
+   * Binær søgning; alder falder monotont fra ældste til nyeste sample.
+   */
+  uint32_t firstNewerThan(uint32_t nowMs, uint32_t maxAgeMs) const {
+    uint32_t lo = oldest(), hi = written();
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      uint32_t ts;
+      int32_t v[M];
+      if (!read(mid, ts, v)) { lo = mid + 1; continue; }   // overskrevet: er under alle omstændigheder ældre
+      if (uint32_t(nowMs - ts) > maxAgeMs) lo = mid + 1;
+      else hi = mid;
+    }
+    return lo;
+  }
+
+private:
+  // én ekstra plads, så alle N seneste kan læses mens den næste skrives
+  static const size_t SLOTS = N + 1;
+
+  uint32_t ts_[SLOTS] = {};
+  int32_t  values_[M][SLOTS] = {};
+  std::atomic<uint32_t> written_{0};
+};
+
+// ================= UDLÆSNING =================
+template <size_t N, size_t M>
+class SampleRingReader {
+public:
+  enum Format { JSON, BINARY };
+
+  /**
+   * @param from,to  sekvensinterval [from, to) fra SampleRing
+   * @param nowMs    millis() ved forespørgslen
+   * @param wallMs   unix-tid i ms ved nowMs, 0 hvis uret ikke er sat (ts er da millis())
+   */
+  SampleRingReader(const SampleRing<N, M>& ring, uint32_t from, uint32_t to, Format format,
+                   const char* const* names, const uint8_t* decimals, uint32_t nowMs, int64_t wallMs)
+      : ring_(ring), next_(from), end_(to), format_(format), names_(names),
+        decimals_(decimals), nowMs_(nowMs), wallMs_(wallMs) {}
+
+  /**
+   * @brief Skriver næste bid af svaret i buf
+   * @return antal bytes; 0 når svaret er færdigt, eller hvis ikke engang én
+   *         række er plads i buf (se done())
+   */
+  size_t fill(uint8_t* buf, size_t cap) {
+    size_t pos = 0;
+    if (state_ == HEADER) {
+      uint8_t tmp[160];
+      ByteWriter w(tmp, sizeof(tmp));
+      format_ == JSON ? jsonHeader(w) : binaryHeader(w);
+      if (!w.ok() || w.size() > cap) return 0;
+      memcpy(buf, tmp, w.size());
+      pos = w.size();
+      state_ = ROWS;
+    }
+    while (state_ == ROWS) {
+      if (next_ >= end_) { state_ = FOOTER; break; }
+      uint32_t ts;
+      int32_t v[M];
+      if (!ring_.read(next_, ts, v)) {
+        uint32_t oldest = ring_.oldest();        // for langsom: spring frem
+        if (next_ < oldest) { next_ = oldest; continue; }
+        state_ = FOOTER;                         // ikke skrevet endnu
+        break;
+      }
+      uint8_t tmp[16 + 12 * M];
+      ByteWriter w(tmp, sizeof(tmp));
+      format_ == JSON ? jsonRow(w, ts, v) : binaryRow(w, ts, v);
+      if (pos + w.size() > cap) return pos;      // resten i næste bid
+      memcpy(buf + pos, tmp, w.size());
+      pos += w.size();
+      next_++;
+      rows_++;
+    }
+    if (state_ == FOOTER) {
+      if (format_ == JSON) {
+        if (pos + 2 > cap) return pos;
+        memcpy(buf + pos, "]}", 2);
+        pos += 2;
+      }
+      state_ = DONE;
+    }
+    return pos;
+  }
+
+  bool done() const { return state_ == DONE; }
+  uint32_t rows() const { return rows_; }
+
+private:
+  enum State { HEADER, ROWS, FOOTER, DONE };
+
+  int64_t timestamp(uint32_t ts) const {
+    return wallMs_ ? wallMs_ - int64_t(uint32_t(nowMs_ - ts)) : int64_t(ts);
+  }
+
+  void jsonHeader(ByteWriter& w) const {
+    w.str(wallMs_ ? "{\"synced\":true,\"cols\":[\"ts\"" : "{\"synced\":false,\"cols\":[\"ts\"");
+    for (size_t m = 0; m < M; m++) {
+      w.str(",\"");
+      w.str(names_[m]);
+      w.put('"');
+    }
+    w.str("],\"rows\":[");
+  }
+
+  void jsonRow(ByteWriter& w, uint32_t ts, const int32_t (&v)[M]) const {
+    if (rows_) w.put(',');
+    w.put('[');
+    w.decimal(timestamp(ts));
+    for (size_t m = 0; m < M; m++) {
+      w.put(',');
+      w.fixedPoint(v[m], decimals_[m]);
+    }
+    w.put(']');
+  }
+
+  void binaryHeader(ByteWriter& w) const {
+    w.str("SRB1");
+    w.put(uint8_t(M));
+    w.put(decimals_, M);
+    w.put(uint8_t(wallMs_ ? 1 : 0));
+  }
+
+  void binaryRow(ByteWriter& w, uint32_t ts, const int32_t (&v)[M]) const {
+    int64_t t = timestamp(ts);
+    w.put(&t, sizeof(t));
+    w.put(v, sizeof(v));
+  }
+
+  const SampleRing<N, M>& ring_;
+  uint32_t next_;
+  uint32_t end_;
+  Format format_;
+  const char* const* names_;
+  const uint8_t* decimals_;
+  uint32_t nowMs_;
+  int64_t wallMs_;
+  State state_ = HEADER;
+  uint32_t rows_ = 0;
+};
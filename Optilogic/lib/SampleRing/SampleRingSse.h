@@ -0,0 +1,116 @@
+#pragma once
+// Server-Sent Events direkte fra en SampleRing
+//
+// Hver klient har kun en cursor (sekvensnummer) ind i ringen; selve data
+// ligger én gang i ringen, så en klients buffer er begrænset af maxLag
+// samples uanset hvor mange klienter der er. Poll-løkken skriver bare i
+// ringen og venter aldrig på en klient.
+//
+// Serveren henter næste bid med fill() når TCP-forbindelsen har plads.
+// Kommer klienten mere end maxLag samples bagud (eller bliver overhalet af
+// ringen), afsluttes strømmen; browserens EventSource genforbinder selv
+// efter "retry" og fortsætter fra nyeste sample eller fra Last-Event-ID.
+//
+//   retry: 2000
+//
+//   id: 1234
+//   event: sample
+//   data: {"ts":1700000000000,"temp":21.5,"tryk":3.2,"rpm":1200}
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "SampleRing.h"
+
+template <size_t N, size_t M>
+class SampleRingSse {
+public:
+  static const uint32_t KEEPALIVE_MS = 15000;   // kommentar-linje så proxies ikke lukker
+
+  /**
+   * @param start   første sekvensnummer der sendes (typisk ring.written())
+   * @param maxLag  højeste antal usendte samples før klienten droppes
+   */
+  SampleRingSse(const SampleRing<N, M>& ring, uint32_t start, const char* const* names,
+                const uint8_t* decimals, uint32_t maxLag)
+      : ring_(ring), next_(start), names_(names), decimals_(decimals),
+        maxLag_(maxLag < N ? maxLag : uint32_t(N)) {}
+
+  /**
+   * @brief Skriver ventende events i buf
+   *
+   * @param nowMs,wallMs  millis() og unix-tid i ms nu (wallMs 0 = ts er millis())
+   * @return antal bytes; 0 betyder enten "intet nyt" eller "afsluttet" (se done())
+   */
+  size_t fill(uint8_t* buf, size_t cap, uint32_t nowMs, int64_t wallMs) {
+    if (done_) return 0;
+    size_t pos = 0;
+    if (!started_) {
+      static const char RETRY[] = "retry: 2000\n\n";
+      if (cap < sizeof(RETRY) - 1) return 0;
+      memcpy(buf, RETRY, sizeof(RETRY) - 1);
+      pos = sizeof(RETRY) - 1;
+      started_ = true;
+      lastSendMs_ = nowMs;
+    }
+
+    uint32_t written = ring_.written();
+    while (next_ < written) {
+      uint32_t ts;
+      int32_t v[M];
+      if (written - next_ > maxLag_ || !ring_.read(next_, ts, v)) {
+        dropped_ = true;   // for langsom: luk i stedet for at bufre mere
+        done_ = true;
+        return pos;
+      }
+      uint8_t tmp[64 + 24 * M];
+      ByteWriter w(tmp, sizeof(tmp));
+      event(w, ts, v, nowMs, wallMs);
+      if (!w.ok() || pos + w.size() > cap) break;   // resten når der er plads igen
+      memcpy(buf + pos, tmp, w.size());
+      pos += w.size();
+      next_++;
+      sent_++;
+    }
+
+    if (pos) {
+      lastSendMs_ = nowMs;
+    } else if (uint32_t(nowMs - lastSendMs_) >= KEEPALIVE_MS && cap >= 3) {
+      memcpy(buf, ":\n\n", 3);
+      pos = 3;
+      lastSendMs_ = nowMs;
+    }
+    return pos;
+  }
+
+  bool done() const { return done_; }
+  bool dropped() const { return dropped_; }
+  uint32_t sent() const { return sent_; }
+
+private:
+  void event(ByteWriter& w, uint32_t ts, const int32_t (&v)[M], uint32_t nowMs, int64_t wallMs) const {
+    w.str("id: ");
+    w.decimal(uint64_t(next_));
+    w.str("\nevent: sample\ndata: {\"ts\":");
+    w.decimal(wallMs ? wallMs - int64_t(uint32_t(nowMs - ts)) : int64_t(ts));
+    for (size_t m = 0; m < M; m++) {
+      w.str(",\"");
+      w.str(names_[m]);
+      w.str("\":");
+      w.fixedPoint(v[m], decimals_[m]);
+    }
+    w.str("}\n\n");
+  }
+
+  const SampleRing<N, M>& ring_;
+  uint32_t next_;
+  const char* const* names_;
+  const uint8_t* decimals_;
+  uint32_t maxLag_;
+  uint32_t lastSendMs_ = 0;
+  uint32_t sent_ = 0;
+  bool started_ = false;
+  bool done_ = false;
+  bool dropped_ = false;
+};
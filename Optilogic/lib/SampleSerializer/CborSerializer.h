@@ -0,0 +1,93 @@
+#pragma once
+// CBOR (RFC 8949) med samme flade struktur som JsonStreamSerializer
+//
+// Kommatal skrives som float32 når det er tabsfrit, ellers float64.
+// Fast-komma værdier skrives som decimal fraction (tag 4, [-decimals, raw]),
+// så de går igennem uden at blive til float på enheden.
+
+#include "SampleSerializer.h"
+
+class CborSerializer : public SampleSerializer {
+public:
+  const char* name() const override { return "cbor"; }
+  const char* contentType() const override { return "application/cbor"; }
+
+  size_t serialize(const Sample& s, uint8_t* out, size_t cap) override {
+    ByteWriter w(out, cap);
+    head(w, 5, (s.timestamp ? 2 : 1) + s.count);   // map
+    if (s.timestamp) {
+      text(w, "timestamp");
+      head(w, 0, s.timestamp);
+    }
+    text(w, "seq");
+    head(w, 0, s.seq);
+    for (size_t i = 0; i < s.count; i++) {
+      const MetricValue& m = s.metrics[i];
+      text(w, m.name);
+      if (m.isNull) {
+        w.put(0xF6);   // null
+        continue;
+      }
+      switch (m.kind) {
+        case MetricKind::Int:    integer(w, m.i); break;
+        case MetricKind::Double: number(w, m.d); break;
+        case MetricKind::Bool:   w.put(m.b ? 0xF5 : 0xF4); break;
+        case MetricKind::Fixed:
+          if (m.decimals == 0) { integer(w, m.i); break; }
+          head(w, 6, 4);   // tag 4: decimal fraction
+          head(w, 4, 2);   // [exponent, mantissa]
+          integer(w, -int64_t(m.decimals));
+          integer(w, m.i);
+          break;
+      }
+    }
+    return w.ok() ? w.size() : 0;
+  }
+
+private:
+  // Major type + argument i korteste form
+  static void head(ByteWriter& w, uint8_t major, uint64_t v) {
+    uint8_t mt = uint8_t(major << 5);
+    if (v < 24) {
+      w.put(uint8_t(mt | v));
+    } else if (v <= 0xFF) {
+      w.put(uint8_t(mt | 24)); w.put(uint8_t(v));
+    } else if (v <= 0xFFFF) {
+      w.put(uint8_t(mt | 25)); be(w, v, 2);
+    } else if (v <= 0xFFFFFFFFull) {
+      w.put(uint8_t(mt | 26)); be(w, v, 4);
+    } else {
+      w.put(uint8_t(mt | 27)); be(w, v, 8);
+    }
+  }
+
+  static void integer(ByteWriter& w, int64_t v) {
+    if (v >= 0) head(w, 0, uint64_t(v));
+    else head(w, 1, uint64_t(-(v + 1)));
+  }
+
+  static void be(ByteWriter& w, uint64_t v, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) w.put(uint8_t(v >> (8 * i)));
+  }
+
+  static void text(ByteWriter& w, const char* s) {
+    size_t n = strlen(s);
+    head(w, 3, n);
+    w.put(s, n);
+  }
+
+  static void number(ByteWriter& w, double d) {
+    float f = float(d);
+    if (double(f) == d) {
+      uint32_t bits;
+      memcpy(&bits, &f, 4);
+      w.put(0xFA);
+      be(w, bits, 4);
+    } else {
+      uint64_t bits;
+      memcpy(&bits, &d, 8);
+      w.put(0xFB);
+      be(w, bits, 8);
+    }
+  }
+};
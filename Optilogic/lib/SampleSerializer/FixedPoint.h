@@ -0,0 +1,37 @@
+#pragma once
+// Fast-komma værdier fra Modbus-registre
+//
+// Registrene leverer allerede skalerede heltal (deci-grader, deci-Pa, rpm).
+// Fixed<D> bærer det rå heltal hele vejen fra register til encoder, og der
+// regnes kun om til float hvor det faktisk kræves (alarm-statistik, Sparkplug).
+
+#include <stdint.h>
+
+#include "SampleSerializer.h"
+
+template <uint8_t D>
+struct Fixed {
+  static_assert(D <= MAX_DECIMALS, "for mange decimaler");
+  static constexpr uint8_t decimals = D;
+
+  int32_t raw = 0;   // værdi * 10^D
+
+  constexpr Fixed() {}
+  explicit constexpr Fixed(int32_t r) : raw(r) {}
+
+  // Fra en værdi med et andet antal decimaler (fx fra et register-map), afrundet
+  static Fixed fromScaled(int32_t v, uint8_t decimals) {
+    if (decimals == D) return Fixed(v);
+    if (decimals < D) return Fixed(int32_t(v * POW10_I64[D - decimals]));
+    int32_t div = int32_t(POW10_I64[decimals - D]);
+    return Fixed(v >= 0 ? (v + div / 2) / div : (v - div / 2) / div);
+  }
+
+  // Multiplikation med konstant er billigere end division på ESP32'ens FPU
+  float toFloat() const { return float(raw) * (1.0f / float(POW10_I64[D])); }
+
+  MetricValue metric(const char* name) const { return MetricValue::ofFixed(name, raw, D); }
+};
+
+typedef Fixed<1> Deci;    // én decimal, fx 215 = 21.5 °C
+typedef Fixed<0> Whole;   // heltal, fx rpm
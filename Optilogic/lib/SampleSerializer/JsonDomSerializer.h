@@ -0,0 +1,43 @@
+#pragma once
+// JSON via nlohmann::json (DOM) – kun host, bruges som reference i benchmarket
+//
+// indent < 0 giver kompakt dump(); indent = 4 svarer til det gamle
+// dump(4) i paho-pubcopy.cpp.
+
+#include <nlohmann/json.hpp>
+
+#include "SampleSerializer.h"
+
+class JsonDomSerializer : public SampleSerializer {
+public:
+  explicit JsonDomSerializer(int indent = -1) : indent_(indent) {}
+
+  const char* name() const override { return indent_ < 0 ? "json-dom" : "json-dom-pretty"; }
+  const char* contentType() const override { return "application/json"; }
+
+  size_t serialize(const Sample& s, uint8_t* out, size_t cap) override {
+    nlohmann::json j;
+    if (s.timestamp) j["timestamp"] = s.timestamp;
+    j["seq"] = s.seq;
+    for (size_t i = 0; i < s.count; i++) {
+      const MetricValue& m = s.metrics[i];
+      if (m.isNull) {
+        j[m.name] = nullptr;
+        continue;
+      }
+      switch (m.kind) {
+        case MetricKind::Int:    j[m.name] = m.i; break;
+        case MetricKind::Double: j[m.name] = m.d; break;
+        case MetricKind::Bool:   j[m.name] = m.b; break;
+        case MetricKind::Fixed:  j[m.name] = m.toDouble(); break;
+      }
+    }
+    std::string text = j.dump(indent_);
+    if (text.size() > cap) return 0;
+    memcpy(out, text.data(), text.size());
+    return text.size();
+  }
+
+private:
+  int indent_;
+};
@@ -0,0 +1,59 @@
+#pragma once
+// Kompakt JSON skrevet token for token (SAX-stil), uden DOM og uden heap
+//
+// Format (fladt, som Ingestor-json.py læser):
+//   {"timestamp":1700000000000,"seq":7,"temp":21.5,"tryk":25.0,"rpm":1000}
+
+#include "SampleSerializer.h"
+
+class JsonStreamSerializer : public SampleSerializer {
+public:
+  // withHeader = false giver præcis det gamle makeJsonPayload()-format
+  explicit JsonStreamSerializer(bool withHeader = true) : withHeader_(withHeader) {}
+
+  const char* name() const override { return withHeader_ ? "json-stream" : "json-stream-flat"; }
+  const char* contentType() const override { return "application/json"; }
+
+  size_t serialize(const Sample& s, uint8_t* out, size_t cap) override {
+    ByteWriter w(out, cap);
+    bool first = true;
+    w.put('{');
+    if (withHeader_) {
+      if (s.timestamp) {
+        key(w, "timestamp", first);
+        w.decimal(s.timestamp);
+      }
+      key(w, "seq", first);
+      w.decimal(uint64_t(s.seq));
+    }
+    for (size_t i = 0; i < s.count; i++) {
+      const MetricValue& m = s.metrics[i];
+      key(w, m.name, first);
+      if (m.isNull) {
+        w.str("null");
+        continue;
+      }
+      switch (m.kind) {
+        case MetricKind::Int:    w.decimal(m.i); break;
+        case MetricKind::Double: w.fixed(m.d, m.decimals); break;
+        case MetricKind::Bool:   w.str(m.b ? "true" : "false"); break;
+        case MetricKind::Fixed:  w.fixedPoint(m.i, m.decimals); break;
+      }
+    }
+    w.put('}');
+    return w.ok() ? w.size() : 0;
+  }
+
+private:
+  // Metricnavne er konstanter i koden, så de escapes ikke
+  static void key(ByteWriter& w, const char* k, bool& first) {
+    if (!first) w.put(',');
+    first = false;
+    w.put('"');
+    w.str(k);
+    w.put('"');
+    w.put(':');
+  }
+
+  bool withHeader_;
+};
@@ -0,0 +1,146 @@
+#pragma once
+// Fælles interface for serialisering af samples (ESP32 og host)
+//
+// En Sample er et sæt målinger med fælles tidsstempel og sekvensnummer.
+// Hver backend skriver direkte i en buffer som kalderen ejer, så samme kode
+// kan bruges i firmware og i host-benchmarks (se serializer_bench.cpp):
+//   JsonStreamSerializer  – kompakt JSON skrevet direkte, uden DOM
+//   CborSerializer        – samme struktur som JSON, binært (RFC 8949)
+//   SparkplugSerializer   – Sparkplug B protobuf
+//   JsonDomSerializer     – nlohmann::json, kun host (reference)
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Fixed = heltal skaleret med 10^-decimals (fx deci-grader direkte fra et register)
+enum class MetricKind : uint8_t { Int, Double, Bool, Fixed };
+
+static constexpr int64_t POW10_I64[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+static constexpr uint8_t MAX_DECIMALS = 6;
+
+struct MetricValue {
+  const char* name     = nullptr;
+  uint32_t    alias    = 0;       // 0 = intet alias
+  MetricKind  kind     = MetricKind::Double;
+  uint8_t     decimals = 2;       // antal decimaler i tekstformater
+  bool        isNull   = false;   // typen uden værdi (birth før første måling)
+  union {
+    int64_t i;
+    double  d;
+    bool    b;
+  };
+
+  MetricValue() : i(0) {}
+
+  static MetricValue ofDouble(const char* n, double v, uint8_t dec = 2) {
+    MetricValue m; m.name = n; m.kind = MetricKind::Double; m.decimals = dec; m.d = v; return m;
+  }
+  static MetricValue ofInt(const char* n, int64_t v) {
+    MetricValue m; m.name = n; m.kind = MetricKind::Int; m.i = v; return m;
+  }
+  static MetricValue ofBool(const char* n, bool v) {
+    MetricValue m; m.name = n; m.kind = MetricKind::Bool; m.b = v; return m;
+  }
+  // raw = værdi * 10^dec, fx ofFixed("temp", 215, 1) = 21.5
+  static MetricValue ofFixed(const char* n, int64_t raw, uint8_t dec) {
+    MetricValue m; m.name = n; m.kind = MetricKind::Fixed;
+    m.decimals = dec > MAX_DECIMALS ? MAX_DECIMALS : dec; m.i = raw; return m;
+  }
+
+  // Samme navn og type, men null: ofInt("run_state", 0).asNull()
+  MetricValue asNull() const { MetricValue m = *this; m.isNull = true; return m; }
+
+  // Kun til formater der kræver kommatal (Sparkplug, DOM); tekst og CBOR skrives som heltal
+  double toDouble() const {
+    switch (kind) {
+      case MetricKind::Int:   return double(i);
+      case MetricKind::Bool:  return b ? 1.0 : 0.0;
+      case MetricKind::Fixed: return double(i) / double(POW10_I64[decimals]);
+      default:                return d;
+    }
+  }
+};
+
+struct Sample {
+  uint64_t           timestamp = 0;   // ms siden epoch, 0 = udelades
+  uint32_t           seq       = 0;
+  const MetricValue* metrics   = nullptr;
+  size_t             count     = 0;
+};
+
+class SampleSerializer {
+public:
+  virtual ~SampleSerializer() {}
+
+  virtual const char* name() const = 0;
+  virtual const char* contentType() const = 0;
+
+  /**
+   * @brief Serialiserer én sample til out
+   *
+   * @return antal bytes skrevet, eller 0 hvis bufferen er for lille
+   */
+  virtual size_t serialize(const Sample& s, uint8_t* out, size_t cap) = 0;
+};
+
+// ================= BUFFER-HJÆLPER =================
+// Fælles for tekst- og binærformaterne; sætter overflow i stedet for at skrive udenfor
+class ByteWriter {
+public:
+  ByteWriter(uint8_t* buf, size_t cap) : buf_(buf), cap_(cap) {}
+
+  void put(uint8_t b) {
+    if (pos_ >= cap_) { overflow_ = true; return; }
+    buf_[pos_++] = b;
+  }
+  void put(const void* p, size_t n) {
+    if (pos_ + n > cap_) { overflow_ = true; return; }
+    memcpy(buf_ + pos_, p, n);
+    pos_ += n;
+  }
+  void str(const char* s) { put(s, strlen(s)); }
+
+  // Heltal som decimaltekst uden snprintf
+  void decimal(uint64_t v) {
+    char tmp[20];
+    int n = 0;
+    do { tmp[n++] = char('0' + v % 10); v /= 10; } while (v);
+    while (n) put(uint8_t(tmp[--n]));
+  }
+  void decimal(int64_t v) {
+    if (v < 0) { put('-'); decimal(uint64_t(0) - uint64_t(v)); }
+    else decimal(uint64_t(v));
+  }
+
+  // Fast-komma tal (scaled = værdi * 10^decimals) kun med heltalsregning
+  void fixedPoint(int64_t scaled, uint8_t decimals) {
+    if (decimals > MAX_DECIMALS) decimals = MAX_DECIMALS;
+    uint64_t mag = scaled < 0 ? uint64_t(0) - uint64_t(scaled) : uint64_t(scaled);
+    if (scaled < 0) put('-');
+    uint64_t div = uint64_t(POW10_I64[decimals]);
+    decimal(mag / div);
+    if (decimals) {
+      put('.');
+      uint64_t frac = mag % div;
+      for (uint64_t d = div / 10; d; d /= 10) { put(uint8_t('0' + frac / d)); frac %= d; }
+    }
+  }
+
+  // Kommatal med fast antal decimaler: én skalering og afrunding, resten er heltal
+  void fixed(double v, uint8_t decimals) {
+    if (!isfinite(v)) { str("null"); return; }
+    if (decimals > MAX_DECIMALS) decimals = MAX_DECIMALS;
+    fixedPoint(llround(v * double(POW10_I64[decimals])), decimals);
+  }
+
+  size_t size() const { return pos_; }
+  bool   ok() const   { return !overflow_; }
+
+private:
+  uint8_t* buf_;
+  size_t   cap_;
+  size_t   pos_ = 0;
+  bool     overflow_ = false;
+};
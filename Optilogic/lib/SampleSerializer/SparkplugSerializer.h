@@ -0,0 +1,46 @@
+#pragma once
+// Sparkplug B protobuf via encoderen i lib/SparkplugB
+//
+// Med useAliases sendes kun alias i stedet for navn (DDATA efter en DBIRTH
+// der har annonceret alias'erne), hvilket sparer navnebytes pr. sample.
+
+#include "SampleSerializer.h"
+#include "SparkplugB.h"
+
+class SparkplugSerializer : public SampleSerializer {
+public:
+  explicit SparkplugSerializer(bool useAliases = false) : useAliases_(useAliases) {}
+
+  const char* name() const override { return useAliases_ ? "sparkplug-alias" : "sparkplug"; }
+  const char* contentType() const override { return "application/x-protobuf"; }
+
+  size_t serialize(const Sample& s, uint8_t* out, size_t cap) override {
+    return spb::encodePayloadWith(s.timestamp, s.seq, s.count,
+                                  [&](size_t i) { return metric(s.metrics[i]); }, out, cap);
+  }
+
+private:
+  spb::Metric metric(const MetricValue& v) const {
+    spb::Metric m;
+    switch (v.kind) {
+      case MetricKind::Int:    m = spb::Metric::ofLong(v.name, v.i); break;
+      case MetricKind::Double: m = spb::Metric::ofDouble(v.name, v.d); break;
+      case MetricKind::Bool:   m = spb::Metric::ofBool(v.name, v.b); break;
+      case MetricKind::Fixed:
+        // Sparkplug har ingen decimaltype; float32 rækker til 1-2 decimaler og
+        // er én heltalskonvertering og division på ESP32'ens single-precision FPU
+        if (v.decimals == 0) m = spb::Metric::ofLong(v.name, v.i);
+        else m = spb::Metric::ofFloat(v.name, float(v.i) / float(POW10_I64[v.decimals]));
+        break;
+    }
+    m.isNull = v.isNull;
+    if (v.alias) {
+      m.alias = v.alias;
+      m.hasAlias = true;
+      if (useAliases_) m.name = nullptr;
+    }
+    return m;
+  }
+
+  bool useAliases_;
+};
@@ -0,0 +1,156 @@
+// Benchmark: float-pipeline vs. fast-komma-pipeline fra register til payload
+//
+// Samme tre registre (temp, tryk, rpm) gøres til payload på fire måder:
+//   float + String/snprintf  – som den oprindelige makeJsonPayload() (String(t, 1))
+//   float + JsonStream       – regs / 10.0f og ByteWriter::fixed(double)
+//   fast-komma + JsonStream  – rå heltal og ByteWriter::fixedPoint (ingen float)
+//   float/fast-komma + Sparkplug
+// På ESP32 måles CPU-cykler pr. sample (ESP.getCycleCount), på host ns pr. sample.
+//
+// Host:  g++ -std=c++17 -O2 -I. -I../SparkplugB fixedpoint_bench.cpp -o fixedpoint_bench
+//        ./fixedpoint_bench [iterationer]
+// ESP32: pio run -e esp32-poe-bench -t upload && pio device monitor
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "FixedPoint.h"
+#include "JsonStreamSerializer.h"
+#include "SparkplugSerializer.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static uint32_t ticks() { return ESP.getCycleCount(); }
+static const char* TICK_UNIT = "cykler";
+#define BENCH_PRINTF Serial.printf
+#else
+#include <chrono>
+#include <cstdlib>
+#include <string>
+static uint64_t ticks() {
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+static const char* TICK_UNIT = "ns";
+#define BENCH_PRINTF printf
+#endif
+
+static uint8_t out[256];
+static volatile size_t sink;   // hindrer at compileren fjerner arbejdet
+
+// Registre der ændrer sig pr. iteration, så intet kan konstant-foldes
+static void nextRegs(uint16_t regs[11], uint32_t i) {
+  regs[9] = uint16_t(180 + (i * 7) % 80);     // 18.0 .. 25.9 °C
+  regs[3] = uint16_t(200 + (i * 13) % 150);   // tryk
+  regs[5] = uint16_t(900 + (i * 31) % 600);   // rpm
+}
+
+// ================= VARIANTER =================
+static size_t floatString(const uint16_t regs[11]) {
+  float t = regs[9] / 10.0f;
+  float p = regs[3] / 10.0f;
+  float af = regs[5];
+#ifdef ARDUINO
+  String s = "{";
+  s += "\"temp\":" + String(t, 1) + ",";
+  s += "\"tryk\":" + String(p, 1) + ",";
+  s += "\"rpm\":" + String((int)af);
+  s += "}";
+  size_t n = s.length();
+  memcpy(out, s.c_str(), n);
+#else
+  char num[32];
+  std::string s = "{";
+  snprintf(num, sizeof(num), "%.1f", t);
+  s += std::string("\"temp\":") + num + ",";
+  snprintf(num, sizeof(num), "%.1f", p);
+  s += std::string("\"tryk\":") + num + ",";
+  snprintf(num, sizeof(num), "%d", (int)af);
+  s += std::string("\"rpm\":") + num;
+  s += "}";
+  size_t n = s.size();
+  memcpy(out, s.data(), n);
+#endif
+  return n;
+}
+
+static size_t floatStream(SampleSerializer& ser, const uint16_t regs[11]) {
+  float t = regs[9] / 10.0f;
+  float p = regs[3] / 10.0f;
+  float af = regs[5];
+  MetricValue m[3] = {
+    MetricValue::ofDouble("temp", t, 1),
+    MetricValue::ofDouble("tryk", p, 1),
+    MetricValue::ofInt("rpm", (int)af),
+  };
+  Sample s;
+  s.metrics = m;
+  s.count = 3;
+  return ser.serialize(s, out, sizeof(out));
+}
+
+static size_t fixedStream(SampleSerializer& ser, const uint16_t regs[11]) {
+  Deci t(regs[9]);
+  Deci p(regs[3]);
+  Whole af(regs[5]);
+  MetricValue m[3] = {
+    t.metric("temp"),
+    p.metric("tryk"),
+    MetricValue::ofInt("rpm", af.raw),
+  };
+  Sample s;
+  s.metrics = m;
+  s.count = 3;
+  return ser.serialize(s, out, sizeof(out));
+}
+
+// ================= MÅLING =================
+template <class Fn>
+static void measure(const char* name, uint32_t iterations, Fn&& fn) {
+  uint16_t regs[11] = {0};
+  for (uint32_t i = 0; i < 100; i++) {   // opvarmning (cache/branch predictor)
+    nextRegs(regs, i);
+    sink = fn(regs);
+  }
+  size_t bytes = 0;
+  auto start = ticks();
+  for (uint32_t i = 0; i < iterations; i++) {
+    nextRegs(regs, i);
+    bytes = fn(regs);
+    sink = bytes;
+  }
+  auto elapsed = ticks() - start;
+  BENCH_PRINTF("%-28s %4u bytes  %10.1f %s/sample\n", name, (unsigned)bytes,
+               double(elapsed) / iterations, TICK_UNIT);
+}
+
+static void runAll(uint32_t iterations) {
+  JsonStreamSerializer json(false);
+  SparkplugSerializer spbSer;
+  BENCH_PRINTF("%u iterationer\n", (unsigned)iterations);
+  measure("float + String/snprintf", iterations, [](const uint16_t* r) { return floatString(r); });
+  measure("float + json-stream", iterations, [&](const uint16_t* r) { return floatStream(json, r); });
+  measure("fast-komma + json-stream", iterations, [&](const uint16_t* r) { return fixedStream(json, r); });
+  measure("float + sparkplug", iterations, [&](const uint16_t* r) { return floatStream(spbSer, r); });
+  measure("fast-komma + sparkplug", iterations, [&](const uint16_t* r) { return fixedStream(spbSer, r); });
+}
+
+#ifdef ARDUINO
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  BENCH_PRINTF("fixedpoint_bench @ %u MHz\n", (unsigned)getCpuFrequencyMhz());
+}
+
+void loop() {
+  runAll(20000);
+  delay(5000);
+}
+#else
+int main(int argc, char** argv) {
+  uint32_t iterations = argc > 1 ? uint32_t(strtoul(argv[1], nullptr, 10)) : 1000000;
+  runAll(iterations);
+  return 0;
+}
+#endif
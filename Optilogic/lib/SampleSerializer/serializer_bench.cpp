@@ -0,0 +1,111 @@
+// Benchmark-matrix for serializer-backends: bytes pr. sample og ns pr. sample
+//
+// Byg:   g++ -std=c++17 -O2 -I. -I../SparkplugB serializer_bench.cpp -o serializer_bench
+//        (JsonDomSerializer kommer med automatisk hvis nlohmann/json.hpp findes)
+// Kør:   ./serializer_bench [iterationer]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CborSerializer.h"
+#include "JsonStreamSerializer.h"
+#include "SparkplugSerializer.h"
+#if __has_include(<nlohmann/json.hpp>)
+#include "JsonDomSerializer.h"
+#define HAVE_NLOHMANN 1
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+// Reference: det gamle makeJsonPayload() med strengsammensætning pr. felt
+class StringConcatSerializer : public SampleSerializer {
+public:
+  const char* name() const override { return "string-concat (gammel)"; }
+  const char* contentType() const override { return "application/json"; }
+
+  size_t serialize(const Sample& s, uint8_t* out, size_t cap) override {
+    std::string json = "{";
+    char num[32];
+    for (size_t i = 0; i < s.count; i++) {
+      const MetricValue& m = s.metrics[i];
+      if (i) json += ",";
+      if (m.kind == MetricKind::Double) std::snprintf(num, sizeof(num), "%.*f", m.decimals, m.d);
+      else if (m.kind == MetricKind::Fixed) std::snprintf(num, sizeof(num), "%.*f", m.decimals, m.toDouble());
+      else std::snprintf(num, sizeof(num), "%lld", (long long)m.i);
+      json += std::string("\"") + m.name + "\":" + num;
+    }
+    json += "}";
+    if (json.size() > cap) return 0;
+    memcpy(out, json.data(), json.size());
+    return json.size();
+  }
+};
+
+struct Workload {
+  const char* name;
+  std::vector<MetricValue> metrics;
+};
+
+static std::vector<Workload> workloads() {
+  // Olimex-Publisher: temp/tryk med 1 decimal og rpm som heltal
+  Workload small{"3 metrics (temp/tryk/rpm)", {
+    MetricValue::ofDouble("temp", 21.5, 1),
+    MetricValue::ofDouble("tryk", 25.0, 1),
+    MetricValue::ofInt("rpm", 1000),
+  }};
+  // Fuld ventilationsblok: 11 input registre + AI1..AI5
+  Workload large{"16 metrics (reg 10-20 + AI)", {}};
+  static char names[16][16];
+  for (int i = 0; i < 16; i++) {
+    std::snprintf(names[i], sizeof(names[i]), i < 11 ? "reg%d" : "ai%d", i < 11 ? 10 + i : i - 10);
+    large.metrics.push_back(i % 3 == 2 ? MetricValue::ofInt(names[i], 1000 + i * 37)
+                                       : MetricValue::ofDouble(names[i], 20.0 + i * 0.7, 1));
+  }
+  for (size_t i = 0; i < small.metrics.size(); i++) small.metrics[i].alias = uint32_t(i + 1);
+  for (size_t i = 0; i < large.metrics.size(); i++) large.metrics[i].alias = uint32_t(i + 1);
+  return {small, large};
+}
+
+int main(int argc, char** argv) {
+  const size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+  std::vector<std::unique_ptr<SampleSerializer>> backends;
+  backends.emplace_back(new StringConcatSerializer());
+  backends.emplace_back(new JsonStreamSerializer(false));
+  backends.emplace_back(new JsonStreamSerializer(true));
+  backends.emplace_back(new CborSerializer());
+  backends.emplace_back(new SparkplugSerializer(false));
+  backends.emplace_back(new SparkplugSerializer(true));
+#ifdef HAVE_NLOHMANN
+  backends.emplace_back(new JsonDomSerializer(-1));
+  backends.emplace_back(new JsonDomSerializer(4));
+#endif
+
+  uint8_t buf[2048];
+  volatile size_t sink = 0;
+
+  for (const Workload& wl : workloads()) {
+    std::printf("\n%s, %zu iterationer\n", wl.name, iterations);
+    std::printf("%-26s %10s %12s\n", "backend", "bytes", "ns/sample");
+    for (auto& b : backends) {
+      Sample s;
+      s.timestamp = 1700000000000ULL;
+      s.metrics = wl.metrics.data();
+      s.count = wl.metrics.size();
+
+      size_t bytes = b->serialize(s, buf, sizeof(buf));
+      auto start = Clock::now();
+      for (size_t i = 0; i < iterations; i++) {
+        s.seq = uint32_t(i);
+        sink = sink + b->serialize(s, buf, sizeof(buf));
+      }
+      double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+      std::printf("%-26s %10zu %12.1f\n", b->name(), bytes, ns);
+    }
+  }
+  return 0;
+}
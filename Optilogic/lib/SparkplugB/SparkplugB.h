@@ -0,0 +1,214 @@
+#pragma once
+// Minimal Sparkplug B payload-encoder (protobuf wire format) uden genereret kode
+//
+// Skriver direkte i en buffer som kalderen ejer, så den kan bruges både på
+// ESP32 og i host-værktøjer. Kun de felter vi bruger er med:
+//   Payload: timestamp (1), metrics (2), seq (3)
+//   Metric:  name (1), alias (2), timestamp (3), datatype (4), is_null (7), værdi (10–15)
+// Feltnumrene følger sparkplug_b.proto (Eclipse Tahu).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace spb {
+
+// Sparkplug B datatyper (uddrag)
+enum DataType : uint32_t {
+  Int8 = 1, Int16 = 2, Int32 = 3, Int64 = 4,
+  UInt8 = 5, UInt16 = 6, UInt32 = 7, UInt64 = 8,
+  Float = 9, Double = 10, Boolean = 11, String = 12,
+};
+
+struct Metric {
+  const char* name     = nullptr;   // nullptr = kun alias (DDATA efter DBIRTH)
+  uint64_t    alias    = 0;
+  bool        hasAlias = false;
+  uint64_t    timestamp = 0;        // 0 = udelades
+  DataType    type     = Double;
+  union {
+    uint64_t u;                     // Int*/UInt* og Boolean
+    float    f;
+    double   d;
+  } value{};
+  const char* str      = nullptr;   // kun til String
+  bool        isNull   = false;     // kun type, ingen værdi (fx i en birth før første måling)
+
+  static Metric ofDouble(const char* n, double v) { Metric m; m.name = n; m.type = Double; m.value.d = v; return m; }
+  static Metric ofFloat(const char* n, float v)   { Metric m; m.name = n; m.type = Float;  m.value.f = v; return m; }
+  static Metric ofInt(const char* n, int32_t v)   { Metric m; m.name = n; m.type = Int32;  m.value.u = uint32_t(v); return m; }
+  static Metric ofLong(const char* n, int64_t v)  { Metric m; m.name = n; m.type = Int64;  m.value.u = uint64_t(v); return m; }
+  static Metric ofBool(const char* n, bool v)     { Metric m; m.name = n; m.type = Boolean; m.value.u = v ? 1 : 0; return m; }
+  static Metric ofString(const char* n, const char* v) { Metric m; m.name = n; m.type = String; m.str = v; return m; }
+};
+
+// ================= PROTOBUF PRIMITIVER =================
+enum WireType : uint8_t { WT_VARINT = 0, WT_FIXED64 = 1, WT_LEN = 2, WT_FIXED32 = 5 };
+
+inline size_t varintSize(uint64_t v) {
+  size_t n = 1;
+  while (v >= 0x80) { v >>= 7; n++; }
+  return n;
+}
+
+class Writer {
+public:
+  Writer(uint8_t* buf, size_t cap) : buf_(buf), cap_(cap) {}
+
+  void varint(uint64_t v) {
+    while (v >= 0x80) { put(uint8_t(v) | 0x80); v >>= 7; }
+    put(uint8_t(v));
+  }
+  void tag(uint32_t field, WireType wt) { varint((uint64_t(field) << 3) | wt); }
+  void fixed32(uint32_t v) { for (int i = 0; i < 4; i++) put(uint8_t(v >> (8 * i))); }
+  void fixed64(uint64_t v) { for (int i = 0; i < 8; i++) put(uint8_t(v >> (8 * i))); }
+  void bytes(const void* p, size_t n) {
+    if (pos_ + n > cap_) { overflow_ = true; return; }
+    memcpy(buf_ + pos_, p, n);
+    pos_ += n;
+  }
+
+  size_t size() const { return pos_; }
+  bool   ok() const   { return !overflow_; }
+
+private:
+  void put(uint8_t b) {
+    if (pos_ >= cap_) { overflow_ = true; return; }
+    buf_[pos_++] = b;
+  }
+
+  uint8_t* buf_;
+  size_t   cap_;
+  size_t   pos_ = 0;
+  bool     overflow_ = false;
+};
+
+// ================= METRIC =================
+inline uint32_t valueField(DataType t) {
+  switch (t) {
+    case Int64: case UInt64: return 11;   // long_value
+    case Float:              return 12;   // float_value
+    case Double:             return 13;   // double_value
+    case Boolean:            return 14;   // boolean_value
+    case String:             return 15;   // string_value
+    default:                 return 10;   // int_value (Int8..UInt32)
+  }
+}
+
+inline size_t metricBodySize(const Metric& m) {
+  size_t n = 0;
+  if (m.name) {
+    size_t len = strlen(m.name);
+    n += 1 + varintSize(len) + len;
+  }
+  if (m.hasAlias)  n += 1 + varintSize(m.alias);
+  if (m.timestamp) n += 1 + varintSize(m.timestamp);
+  n += 1 + varintSize(m.type);
+  if (m.isNull) return n + 2;
+  switch (valueField(m.type)) {
+    case 10: n += 1 + varintSize(uint32_t(m.value.u)); break;
+    case 11: n += 1 + varintSize(m.value.u); break;
+    case 12: n += 1 + 4; break;
+    case 13: n += 1 + 8; break;
+    case 14: n += 1 + 1; break;
+    case 15: {
+      size_t len = m.str ? strlen(m.str) : 0;
+      n += 1 + varintSize(len) + len;
+      break;
+    }
+  }
+  return n;
+}
+
+inline void writeMetric(Writer& w, const Metric& m) {
+  w.tag(2, WT_LEN);
+  w.varint(metricBodySize(m));
+  if (m.name) {
+    size_t len = strlen(m.name);
+    w.tag(1, WT_LEN);
+    w.varint(len);
+    w.bytes(m.name, len);
+  }
+  if (m.hasAlias)  { w.tag(2, WT_VARINT); w.varint(m.alias); }
+  if (m.timestamp) { w.tag(3, WT_VARINT); w.varint(m.timestamp); }
+  w.tag(4, WT_VARINT);
+  w.varint(m.type);
+  if (m.isNull) {
+    w.tag(7, WT_VARINT);
+    w.varint(1);
+    return;
+  }
+
+  uint32_t field = valueField(m.type);
+  switch (field) {
+    case 10: w.tag(field, WT_VARINT); w.varint(uint32_t(m.value.u)); break;
+    case 11: w.tag(field, WT_VARINT); w.varint(m.value.u); break;
+    case 12: {
+      uint32_t bits;
+      memcpy(&bits, &m.value.f, 4);
+      w.tag(field, WT_FIXED32);
+      w.fixed32(bits);
+      break;
+    }
+    case 13: {
+      uint64_t bits;
+      memcpy(&bits, &m.value.d, 8);
+      w.tag(field, WT_FIXED64);
+      w.fixed64(bits);
+      break;
+    }
+    case 14: w.tag(field, WT_VARINT); w.varint(m.value.u ? 1 : 0); break;
+    case 15: {
+      size_t len = m.str ? strlen(m.str) : 0;
+      w.tag(field, WT_LEN);
+      w.varint(len);
+      w.bytes(m.str, len);
+      break;
+    }
+  }
+}
+
+// ================= PAYLOAD =================
+/**
+ * @brief Koder en komplet Sparkplug B payload med metric(i) for i < count
+ *
+ * Metrics laves én ad gangen, så kalderen ikke skal have dem alle i et array
+ * (en birth kan have næsten hundrede).
+ * @return antal bytes skrevet, eller 0 hvis bufferen er for lille
+ */
+template <class MetricAt>
+size_t encodePayloadWith(uint64_t timestamp, uint64_t seq, size_t count, MetricAt&& metric,
+                         uint8_t* out, size_t cap) {
+  Writer w(out, cap);
+  if (timestamp) { w.tag(1, WT_VARINT); w.varint(timestamp); }
+  for (size_t i = 0; i < count; i++) writeMetric(w, metric(i));
+  w.tag(3, WT_VARINT);
+  w.varint(seq);
+  return w.ok() ? w.size() : 0;
+}
+
+/**
+ * @brief Koder en komplet Sparkplug B payload
+ *
+ * @return antal bytes skrevet, eller 0 hvis bufferen er for lille
+ */
+inline size_t encodePayload(uint64_t timestamp, uint64_t seq,
+                            const Metric* metrics, size_t count,
+                            uint8_t* out, size_t cap) {
+  return encodePayloadWith(timestamp, seq, count, [&](size_t i) -> const Metric& { return metrics[i]; },
+                           out, cap);
+}
+
+/**
+ * @brief NDEATH-payload til MQTT will: kun bdSeq, uden timestamp og seq
+ *
+ * Med bdSeq 1-255 indeholder den ingen 0-bytes, så den kan gives til
+ * klienter der tager will-beskeden som C-streng (PubSubClient).
+ */
+inline size_t encodeDeathPayload(uint64_t bdSeq, uint8_t* out, size_t cap) {
+  Writer w(out, cap);
+  writeMetric(w, Metric::ofLong("bdSeq", int64_t(bdSeq)));
+  return w.ok() ? w.size() : 0;
+}
+
+}  // namespace spb
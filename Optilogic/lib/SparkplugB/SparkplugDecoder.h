@@ -0,0 +1,344 @@
+#pragma once
+// Zero-copy Sparkplug B payload-dekoder
+//
+// Parser protobuf-bytes direkte i den modtagne buffer uden at bygge
+// message-objekter. Navne og strenge er views ind i bufferen, og udvalgte
+// metrics (efter navn eller alias) samles i en flad struct-of-arrays batch,
+// så mange beskeder kan dekodes i træk uden allokering pr. besked.
+// Bruges af spb_fastdecode (Python-extension til SPB_ingester.py) og af
+// host-bridgen.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "SparkplugB.h"
+
+namespace spb {
+
+// ================= PROTOBUF LÆSER =================
+class Reader {
+public:
+  Reader(const uint8_t* p, size_t len) : p_(p), end_(p + len) {}
+
+  bool atEnd() const { return p_ >= end_; }
+  bool ok() const    { return ok_; }
+
+  uint64_t varint() {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (p_ >= end_) return fail();
+      uint8_t b = *p_++;
+      v |= uint64_t(b & 0x7F) << shift;
+      if (!(b & 0x80)) return v;
+    }
+    return fail();
+  }
+
+  uint32_t fixed32() {
+    if (end_ - p_ < 4) return uint32_t(fail());
+    uint32_t v = uint32_t(p_[0]) | uint32_t(p_[1]) << 8 | uint32_t(p_[2]) << 16 | uint32_t(p_[3]) << 24;
+    p_ += 4;
+    return v;
+  }
+
+  uint64_t fixed64() {
+    uint64_t lo = fixed32();
+    uint64_t hi = fixed32();
+    return lo | (hi << 32);
+  }
+
+  // Længdepræfikseret felt som view; læseren står efter feltet
+  bool bytes(const uint8_t*& data, size_t& len) {
+    uint64_t n = varint();
+    if (!ok_ || n > uint64_t(end_ - p_)) { fail(); return false; }
+    data = p_;
+    len = size_t(n);
+    p_ += n;
+    return true;
+  }
+
+  void skip(uint8_t wireType) {
+    const uint8_t* d;
+    size_t n;
+    switch (wireType) {
+      case WT_VARINT:  varint(); break;
+      case WT_FIXED64: fixed64(); break;
+      case WT_LEN:     bytes(d, n); break;
+      case WT_FIXED32: fixed32(); break;
+      default:         fail(); break;   // groups bruges ikke i Sparkplug
+    }
+  }
+
+private:
+  uint64_t fail() { ok_ = false; p_ = end_; return 0; }
+
+  const uint8_t* p_;
+  const uint8_t* end_;
+  bool ok_ = true;
+};
+
+// ================= METRIC VIEW =================
+enum class ValueKind : uint8_t { None, Int, UInt, Real, Bool, Text };
+
+struct MetricView {
+  const char* name = nullptr;     // peger ind i payload, ikke nul-termineret
+  size_t   nameLen = 0;
+  uint64_t alias = 0;
+  bool     hasAlias = false;
+  uint64_t timestamp = 0;
+  uint32_t datatype = 0;
+  ValueKind kind = ValueKind::None;
+  union {
+    int64_t  i;
+    uint64_t u;
+    double   d;
+  };
+  const char* text = nullptr;
+  size_t   textLen = 0;
+
+  MetricView() : i(0) {}
+
+  bool isNumeric() const { return kind == ValueKind::Int || kind == ValueKind::UInt ||
+                                  kind == ValueKind::Real || kind == ValueKind::Bool; }
+  bool isInteger() const { return kind == ValueKind::Int || kind == ValueKind::UInt || kind == ValueKind::Bool; }
+
+  double asDouble() const {
+    switch (kind) {
+      case ValueKind::Int:  return double(i);
+      case ValueKind::UInt:
+      case ValueKind::Bool: return double(u);
+      case ValueKind::Real: return d;
+      default:              return 0.0;
+    }
+  }
+};
+
+// Fortolker int_value/long_value ud fra datatypen (fortegn og bredde)
+inline void setInteger(MetricView& m, uint64_t raw, bool isLong) {
+  switch (m.datatype) {
+    case Int8:   m.kind = ValueKind::Int; m.i = int8_t(raw); break;
+    case Int16:  m.kind = ValueKind::Int; m.i = int16_t(raw); break;
+    case Int32:  m.kind = ValueKind::Int; m.i = int32_t(raw); break;
+    case Int64:  m.kind = ValueKind::Int; m.i = int64_t(raw); break;
+    case UInt8: case UInt16: case UInt32: case UInt64:
+      m.kind = ValueKind::UInt; m.u = raw; break;
+    default:
+      // ukendt/manglende datatype: long som signed, int som unsigned 32 bit
+      if (isLong) { m.kind = ValueKind::Int; m.i = int64_t(raw); }
+      else        { m.kind = ValueKind::UInt; m.u = uint32_t(raw); }
+      break;
+  }
+}
+
+inline bool parseMetric(const uint8_t* data, size_t len, MetricView& m) {
+  Reader r(data, len);
+  uint64_t rawInt = 0;
+  int intField = 0;   // 10 eller 11 hvis der var en heltalsværdi
+  while (!r.atEnd()) {
+    uint64_t key = r.varint();
+    uint32_t field = uint32_t(key >> 3);
+    uint8_t wt = uint8_t(key & 7);
+    if (field == 0) return false;
+    const uint8_t* p;
+    size_t n;
+    switch (field) {
+      case 1:
+        if (wt != WT_LEN || !r.bytes(p, n)) return false;
+        m.name = reinterpret_cast<const char*>(p);
+        m.nameLen = n;
+        break;
+      case 2:  if (wt != WT_VARINT) return false; m.alias = r.varint(); m.hasAlias = true; break;
+      case 3:  if (wt != WT_VARINT) return false; m.timestamp = r.varint(); break;
+      case 4:  if (wt != WT_VARINT) return false; m.datatype = uint32_t(r.varint()); break;
+      case 7:  // is_null
+        if (wt != WT_VARINT) return false;
+        if (r.varint()) { m.kind = ValueKind::None; intField = 0; }
+        break;
+      case 10:
+      case 11:
+        if (wt != WT_VARINT) return false;
+        rawInt = r.varint();
+        intField = int(field);
+        break;
+      case 12: {
+        if (wt != WT_FIXED32) return false;
+        uint32_t bits = r.fixed32();
+        float f;
+        memcpy(&f, &bits, 4);
+        m.kind = ValueKind::Real;
+        m.d = f;
+        intField = 0;
+        break;
+      }
+      case 13: {
+        if (wt != WT_FIXED64) return false;
+        uint64_t bits = r.fixed64();
+        m.kind = ValueKind::Real;
+        memcpy(&m.d, &bits, 8);
+        intField = 0;
+        break;
+      }
+      case 14:
+        if (wt != WT_VARINT) return false;
+        m.kind = ValueKind::Bool;
+        m.u = r.varint() ? 1 : 0;
+        intField = 0;
+        break;
+      case 15:
+        if (wt != WT_LEN || !r.bytes(p, n)) return false;
+        m.kind = ValueKind::Text;
+        m.text = reinterpret_cast<const char*>(p);
+        m.textLen = n;
+        intField = 0;
+        break;
+      default:
+        r.skip(wt);   // metadata, properties, dataset, template m.m.
+        break;
+    }
+    if (!r.ok()) return false;
+  }
+  // datatype kan komme efter værdien, så heltal fortolkes til sidst
+  if (intField) setInteger(m, rawInt, intField == 11);
+  return r.ok();
+}
+
+/**
+ * @brief Går alle metrics i en payload igennem uden kopiering
+ *
+ * fn(const MetricView&) kaldes for hver metric. timestamp/seq sættes hvis
+ * de findes i payloaden.
+ * @return false hvis payloaden ikke er gyldig protobuf
+ */
+template <class Fn>
+bool forEachMetric(const uint8_t* data, size_t len, uint64_t& timestamp, uint64_t& seq, Fn&& fn) {
+  Reader r(data, len);
+  while (!r.atEnd()) {
+    uint64_t key = r.varint();
+    uint32_t field = uint32_t(key >> 3);
+    uint8_t wt = uint8_t(key & 7);
+    if (field == 0) return false;
+    if (field == 1 && wt == WT_VARINT) {
+      timestamp = r.varint();
+    } else if (field == 3 && wt == WT_VARINT) {
+      seq = r.varint();
+    } else if (field == 2 && wt == WT_LEN) {
+      const uint8_t* p;
+      size_t n;
+      if (!r.bytes(p, n)) return false;
+      MetricView m;
+      if (!parseMetric(p, n, m)) return false;
+      fn(static_cast<const MetricView&>(m));
+    } else {
+      r.skip(wt);
+    }
+    if (!r.ok()) return false;
+  }
+  return true;
+}
+
+// ================= STRUCT-OF-ARRAYS BATCH =================
+// Én række pr. udvalgt metric; row peger tilbage på beskedens nummer i batchen
+struct MetricBatch {
+  std::vector<uint32_t> row;
+  std::vector<uint16_t> column;      // index i Decoder::names()
+  std::vector<double>   value;
+  std::vector<int64_t>  intValue;    // præcis værdi for heltal (value er afrundet over 2^53)
+  std::vector<uint8_t>  isInteger;
+  std::vector<uint64_t> timestamp;   // metricens timestamp, ellers payloadens
+  uint32_t messages = 0;
+
+  void clear() {
+    row.clear(); column.clear(); value.clear();
+    intValue.clear(); isInteger.clear(); timestamp.clear();
+    messages = 0;
+  }
+
+  void reserve(size_t n) {
+    row.reserve(n); column.reserve(n); value.reserve(n);
+    intValue.reserve(n); isInteger.reserve(n); timestamp.reserve(n);
+  }
+
+  size_t size() const { return value.size(); }
+};
+
+// ================= DEKODER =================
+class Decoder {
+public:
+  static const int NO_COLUMN = -1;
+
+  explicit Decoder(const std::vector<std::string>& names) : names_(names) {}
+
+  const std::vector<std::string>& names() const { return names_; }
+
+  // Kolonne for en metric: navn hvis det findes, ellers et alias lært fra en BIRTH
+  int column(const MetricView& m) {
+    if (m.name) {
+      int col = lookupName(m.name, m.nameLen);
+      if (col != NO_COLUMN && m.hasAlias) aliases_[m.alias] = col;
+      return col;
+    }
+    if (m.hasAlias) {
+      auto it = aliases_.find(m.alias);
+      if (it != aliases_.end()) return it->second;
+    }
+    return NO_COLUMN;
+  }
+
+  /**
+   * @brief Dekoder én payload og tilføjer de udvalgte metrics til batch
+   *
+   * @return false hvis payloaden er ugyldig (batch er da uændret)
+   */
+  bool decode(const uint8_t* data, size_t len, MetricBatch& batch) {
+    uint64_t ts = 0, seq = 0;
+    uint32_t rowIndex = batch.messages;
+    pending_.clear();
+    bool ok = forEachMetric(data, len, ts, seq, [&](const MetricView& m) {
+      if (!m.isNumeric()) return;
+      int col = column(m);
+      if (col == NO_COLUMN) return;
+      int64_t exact = m.kind == ValueKind::Int ? m.i : m.isInteger() ? int64_t(m.u) : 0;
+      pending_.push_back(Pending{uint16_t(col), m.asDouble(), exact, m.isInteger(), m.timestamp});
+    });
+    if (!ok) return false;
+    for (const Pending& p : pending_) {
+      batch.row.push_back(rowIndex);
+      batch.column.push_back(p.column);
+      batch.value.push_back(p.value);
+      batch.intValue.push_back(p.intValue);
+      batch.isInteger.push_back(p.isInteger ? 1 : 0);
+      batch.timestamp.push_back(p.timestamp ? p.timestamp : ts);
+    }
+    batch.messages++;
+    return true;
+  }
+
+private:
+  struct Pending {
+    uint16_t column;
+    double   value;
+    int64_t  intValue;
+    bool     isInteger;
+    uint64_t timestamp;
+  };
+
+  // Få navne (typisk 3–20), så lineær søgning med længdetjek er hurtigst
+  int lookupName(const char* name, size_t len) const {
+    for (size_t i = 0; i < names_.size(); i++) {
+      const std::string& n = names_[i];
+      if (n.size() == len && memcmp(n.data(), name, len) == 0) return int(i);
+    }
+    return NO_COLUMN;
+  }
+
+  std::vector<std::string> names_;
+  std::unordered_map<uint64_t, int> aliases_;
+  std::vector<Pending> pending_;
+};
+
+}  // namespace spb
@@ -0,0 +1,167 @@
+#pragma once
+// LZSS-komprimering til små uplink-batches (samme idé som heatshrink)
+//
+// Bitstrøm, mest betydende bit først:
+//   1 + 8 bit                       literal
+//   0 + OFFSET_BITS + LENGTH_BITS   kopi: afstand-1 og længde-MIN_MATCH bagud i outputtet
+// Der er ingen slutmarkør; den ukomprimerede længde står i envelope-headeren
+// (se UplinkBatch.h), og dekoderen stopper når den er nået.
+//
+// Matcheren bruger hash-kæder over et vindue på WINDOW bytes. Tabellerne
+// ligger i et Workspace som kalderen ejer (statisk i firmwaren, ca. 3 KB),
+// så komprimeringen allokerer intet, og kædedybden er begrænset, så tiden
+// pr. byte er begrænset. Input op til 64 KB.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace lzss {
+
+static const unsigned OFFSET_BITS = 10;
+static const unsigned LENGTH_BITS = 5;
+static const size_t   WINDOW = size_t(1) << OFFSET_BITS;                    // 1024 bytes bagud
+static const size_t   MIN_MATCH = 3;                                         // kortere kopier er dyrere end literals
+static const size_t   MAX_MATCH = MIN_MATCH + (size_t(1) << LENGTH_BITS) - 1; // 34
+static const unsigned HASH_BITS = 9;
+static const unsigned MAX_CHAIN = 16;                                        // kandidater pr. position
+static const size_t   MAX_INPUT = 0xFFFF;
+
+// Hash-kæderne: head pr. hash, prev pr. position i vinduet (position + 1, 0 = tom)
+struct Workspace {
+  uint16_t head[size_t(1) << HASH_BITS];
+  uint16_t prev[WINDOW];
+};
+
+// Worst case: alt er literals (9 bit pr. byte)
+constexpr size_t maxCompressed(size_t n) { return n + (n + 7) / 8; }
+
+class BitWriter {
+public:
+  BitWriter(uint8_t* out, size_t cap) : out_(out), cap_(cap) {}
+
+  bool put(uint32_t value, unsigned bits) {
+    while (bits--) {
+      if (fill_ == 0) {
+        if (len_ >= cap_) return false;
+        out_[len_++] = 0;
+      }
+      if ((value >> bits) & 1) out_[len_ - 1] |= uint8_t(0x80 >> fill_);
+      fill_ = (fill_ + 1) & 7;
+    }
+    return true;
+  }
+
+  size_t length() const { return len_; }
+
+private:
+  uint8_t* out_;
+  size_t   cap_;
+  size_t   len_ = 0;
+  unsigned fill_ = 0;   // brugte bits i sidste byte
+};
+
+class BitReader {
+public:
+  BitReader(const uint8_t* in, size_t len) : in_(in), bitsLeft_(len * 8) {}
+
+  bool get(unsigned bits, uint32_t& value) {
+    if (bits > bitsLeft_) return false;
+    value = 0;
+    while (bits--) {
+      value = (value << 1) | ((in_[pos_ >> 3] >> (7 - (pos_ & 7))) & 1);
+      pos_++;
+      bitsLeft_--;
+    }
+    return true;
+  }
+
+private:
+  const uint8_t* in_;
+  size_t pos_ = 0;
+  size_t bitsLeft_;
+};
+
+inline unsigned hash3(const uint8_t* p) {
+  uint32_t v = uint32_t(p[0]) << 16 | uint32_t(p[1]) << 8 | p[2];
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/**
+ * @brief Komprimerer in til out
+ *
+ * @return antal bytes skrevet, eller 0 hvis out er for lille (eller input over MAX_INPUT)
+ */
+inline size_t compress(const uint8_t* in, size_t n, uint8_t* out, size_t cap, Workspace& ws) {
+  if (n > MAX_INPUT) return 0;
+  memset(ws.head, 0, sizeof(ws.head));
+  BitWriter w(out, cap);
+
+  size_t pos = 0;
+  auto insert = [&](size_t p) {
+    if (p + MIN_MATCH > n) return;
+    unsigned h = hash3(in + p);
+    ws.prev[p & (WINDOW - 1)] = ws.head[h];
+    ws.head[h] = uint16_t(p + 1);
+  };
+
+  while (pos < n) {
+    size_t bestLen = 0, bestDist = 0;
+    if (pos + MIN_MATCH <= n) {
+      size_t limit = n - pos < MAX_MATCH ? n - pos : MAX_MATCH;
+      uint16_t cand = ws.head[hash3(in + pos)];
+      for (unsigned chain = 0; cand && chain < MAX_CHAIN; chain++) {
+        size_t c = cand - 1u;
+        if (c >= pos || pos - c > WINDOW) break;   // uden for vinduet: resten af kæden er ældre
+        size_t len = 0;
+        while (len < limit && in[c + len] == in[pos + len]) len++;
+        if (len > bestLen) {
+          bestLen = len;
+          bestDist = pos - c;
+          if (len == limit) break;
+        }
+        cand = ws.prev[c & (WINDOW - 1)];
+      }
+    }
+
+    if (bestLen >= MIN_MATCH) {
+      if (!w.put(0, 1) || !w.put(uint32_t(bestDist - 1), OFFSET_BITS) ||
+          !w.put(uint32_t(bestLen - MIN_MATCH), LENGTH_BITS)) return 0;
+      for (size_t k = 0; k < bestLen; k++) insert(pos + k);
+      pos += bestLen;
+    } else {
+      if (!w.put(0x100u | in[pos], 9)) return 0;
+      insert(pos);
+      pos++;
+    }
+  }
+  return w.length();
+}
+
+/**
+ * @brief Pakker in ud til præcis rawLen bytes i out
+ *
+ * @return false hvis strømmen er ødelagt eller out er for lille
+ */
+inline bool decompress(const uint8_t* in, size_t n, uint8_t* out, size_t rawLen) {
+  BitReader r(in, n);
+  size_t pos = 0;
+  while (pos < rawLen) {
+    uint32_t flag, v;
+    if (!r.get(1, flag)) return false;
+    if (flag) {
+      if (!r.get(8, v)) return false;
+      out[pos++] = uint8_t(v);
+      continue;
+    }
+    uint32_t dist, len;
+    if (!r.get(OFFSET_BITS, dist) || !r.get(LENGTH_BITS, len)) return false;
+    dist += 1;
+    len += MIN_MATCH;
+    if (dist > pos || pos + len > rawLen) return false;
+    for (size_t k = 0; k < len; k++, pos++) out[pos] = out[pos - dist];   // må overlappe (gentagelser)
+  }
+  return true;
+}
+
+}  // namespace lzss
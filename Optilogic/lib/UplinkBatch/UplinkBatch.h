@@ -0,0 +1,181 @@
+#pragma once
+// Batch af rå samples i én MQTT-besked, valgfrit LZSS-komprimeret
+//
+// Rå samples (DCMD "raw=N") sendes normalt som én besked pr. poll. Med
+// batching samles de færdigt serialiserede payloads i en fast buffer og
+// sendes samlet i en envelope:
+//
+//   0xFF 'B' encoding antal  base_ts(8, LE ms)  rawLen(2, LE)  body
+//
+// body er (efter udpakning) pr. sample:  varint(zigzag(ts - base_ts))  varint(længde)  payload
+// encoding 0 = ukomprimeret, 1 = LZSS (se Lzss.h); rawLen er den udpakkede længde.
+// 0xFF kan ikke være første byte i JSON, CBOR-map eller Sparkplug protobuf,
+// så modtageren kan kende en batch på første byte og ellers dekode som før.
+//
+// Hvert payload er uændret (eget seq, Sparkplug-tidsstempel osv.), så en
+// batch pakkes ud til de samme beskeder som uden batching. Tidsstemplet i
+// envelopen giver også JSON-formatet tid pr. sample.
+//
+// Host: uplink_decode.cpp pakker ud, uplink_bench.cpp måler ratio og tid.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "Lzss.h"
+
+namespace uplink {
+
+static const uint8_t MAGIC = 0xFF;
+static const uint8_t KIND_BATCH = 'B';
+static const size_t  HEADER_SIZE = 14;
+
+enum Encoding : uint8_t { ENC_NONE = 0, ENC_LZSS = 1 };
+
+inline size_t putVarint(uint8_t* p, uint64_t v) {
+  size_t n = 0;
+  while (v >= 0x80) {
+    p[n++] = uint8_t(v) | 0x80;
+    v >>= 7;
+  }
+  p[n++] = uint8_t(v);
+  return n;
+}
+
+inline bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+  v = 0;
+  for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+    uint8_t b = *p++;
+    v |= uint64_t(b & 0x7F) << shift;
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+inline uint64_t zigzag(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+inline int64_t unzigzag(uint64_t v) { return int64_t(v >> 1) ^ -int64_t(v & 1); }
+
+inline bool isBatch(const uint8_t* p, size_t len) { return len >= HEADER_SIZE && p[0] == MAGIC && p[1] == KIND_BATCH; }
+
+/**
+ * @brief Samler payloads i en fast buffer på CAP bytes (body før komprimering)
+ *
+ * Kalderen sender batchen med finish() når den er fuld (add() returnerer
+ * false) eller når den skal sendes af andre grunde (antal, raw-mode slut).
+ */
+template <size_t CAP>
+class Batch {
+  static_assert(CAP <= lzss::MAX_INPUT, "rawLen er 16 bit");
+
+public:
+  static const size_t CAPACITY = CAP;
+
+  size_t count() const { return count_; }
+  size_t bytes() const { return len_; }
+  size_t room() const  { return CAP - len_; }
+  bool   empty() const { return count_ == 0; }
+
+  /**
+   * @brief Tilføjer et serialiseret payload; false hvis der ikke er plads
+   *
+   * @param tsMs  samplets tidsstempel (unix ms, 0 hvis uret ikke er sat)
+   */
+  bool add(int64_t tsMs, const uint8_t* payload, size_t len) {
+    if (count_ == 0) baseTs_ = tsMs;
+    uint8_t head[20];
+    size_t h = putVarint(head, zigzag(tsMs - baseTs_));
+    h += putVarint(head + h, len);
+    if (count_ == 255 || len_ + h + len > CAP) return false;
+    memcpy(body_ + len_, head, h);
+    memcpy(body_ + len_ + h, payload, len);
+    len_ += h + len;
+    count_++;
+    return true;
+  }
+
+  /**
+   * @brief Skriver envelopen i out og tømmer batchen
+   *
+   * Med ws komprimeres body med LZSS; bliver det ikke mindre, sendes den
+   * ukomprimeret.
+   *
+   * @return antal bytes skrevet, eller 0 hvis out er for lille (batchen tømmes alligevel)
+   */
+  size_t finish(uint8_t* out, size_t cap, lzss::Workspace* ws) {
+    size_t total = 0;
+    if (cap >= HEADER_SIZE) {
+      size_t bodyCap = cap - HEADER_SIZE;
+      size_t packed = 0;
+      if (ws && len_) packed = lzss::compress(body_, len_, out + HEADER_SIZE, bodyCap < len_ ? bodyCap : len_ - 1, *ws);
+      if (packed) {
+        total = HEADER_SIZE + packed;
+      } else if (len_ <= bodyCap) {
+        memcpy(out + HEADER_SIZE, body_, len_);
+        total = HEADER_SIZE + len_;
+      }
+      if (total) writeHeader(out, packed ? ENC_LZSS : ENC_NONE);
+    }
+    count_ = 0;
+    len_ = 0;
+    return total;
+  }
+
+private:
+  void writeHeader(uint8_t* out, Encoding enc) const {
+    out[0] = MAGIC;
+    out[1] = KIND_BATCH;
+    out[2] = enc;
+    out[3] = uint8_t(count_);
+    for (int i = 0; i < 8; i++) out[4 + i] = uint8_t(uint64_t(baseTs_) >> (8 * i));
+    out[12] = uint8_t(len_);
+    out[13] = uint8_t(len_ >> 8);
+  }
+
+  uint8_t body_[CAP];
+  size_t  len_ = 0;
+  size_t  count_ = 0;
+  int64_t baseTs_ = 0;
+};
+
+struct Entry {
+  int64_t        tsMs;
+  const uint8_t* payload;
+  size_t         len;
+};
+
+/**
+ * @brief Pakker en envelope ud og kalder fn(const Entry&) pr. sample
+ *
+ * @param scratch  plads til den udpakkede body (mindst rawLen bytes)
+ * @return antal samples, eller -1 hvis envelopen er ødelagt
+ */
+template <typename Fn>
+int forEach(const uint8_t* msg, size_t len, uint8_t* scratch, size_t scratchCap, Fn fn) {
+  if (!isBatch(msg, len)) return -1;
+  int64_t base = 0;
+  for (int i = 0; i < 8; i++) base |= int64_t(uint64_t(msg[4 + i]) << (8 * i));
+  size_t rawLen = size_t(msg[12]) | size_t(msg[13]) << 8;
+  const uint8_t* body = msg + HEADER_SIZE;
+  size_t bodyLen = len - HEADER_SIZE;
+
+  if (msg[2] == ENC_LZSS) {
+    if (rawLen > scratchCap || !lzss::decompress(body, bodyLen, scratch, rawLen)) return -1;
+    body = scratch;
+  } else if (msg[2] != ENC_NONE || bodyLen != rawLen) {
+    return -1;
+  }
+
+  const uint8_t* p = body;
+  const uint8_t* end = body + rawLen;
+  int n = 0;
+  while (p < end) {
+    uint64_t dt, plen;
+    if (!getVarint(p, end, dt) || !getVarint(p, end, plen) || plen > size_t(end - p)) return -1;
+    fn(Entry{base + unzigzag(dt), p, size_t(plen)});
+    p += plen;
+    n++;
+  }
+  return n == msg[3] ? n : -1;
+}
+
+}  // namespace uplink
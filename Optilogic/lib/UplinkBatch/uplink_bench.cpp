@@ -0,0 +1,197 @@
+// Benchmark: batching og LZSS-komprimering af rå samples (UplinkBatch.h)
+//
+// Samplene laves som firmwarens rå payloads (makePayload): hvert map-slot
+// som fast-komma værdi, pollet hvert 250. ms, med værdierne fra
+// modbus_emulater.cpp (random walk med samme skridt og grænser, opdateret
+// én gang i sekundet, så nabosamples ofte er ens). To maps: standardmappet
+// (temp/tryk/rpm) og hele læseblokken (input 10-20).
+//
+// Pr. format og batchstørrelse:
+//   enkelt   bytes hvis hvert sample sendes som egen besked (payload + MQTT-header og topic)
+//   batch    envelope uden komprimering
+//   lzss     envelope med LZSS, ratio = payload-bytes / lzss-body
+//   sparet   bytes sparet pr. sample i forhold til enkelt
+//   tid      komprimering og udpakning pr. batch (µs)
+//
+// Host:  g++ -std=c++17 -O2 -I. -I../SampleSerializer -I../SparkplugB uplink_bench.cpp -o uplink_bench
+//        ./uplink_bench [batches]
+// ESP32: pio run -e esp32-poe-uplinkbench -t upload && pio device monitor
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "CborSerializer.h"
+#include "JsonStreamSerializer.h"
+#include "SparkplugSerializer.h"
+#include "UplinkBatch.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static uint32_t micros32() { return micros(); }
+#define BENCH_PRINTF Serial.printf
+#else
+#include <chrono>
+#include <cstdlib>
+static uint32_t micros32() {
+  return uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+#define BENCH_PRINTF printf
+#endif
+
+static const size_t   BATCH_CAP = 1024 - uplink::HEADER_SIZE;   // som firmwarens payloadBuf
+static const size_t   MQTT_OVERHEAD = 2 + 2 + 36;               // fast header, topic-længde, "spBv1.0/plantA/DDATA/olimex-device"
+static const uint32_t POLL_MS = 250;
+static const int64_t  START_MS = 1760000000000LL;
+
+// ================= SAMPLES =================
+struct Walk {
+  const char* name;
+  int32_t value, step, lo, hi;
+  uint8_t decimals;
+};
+
+class SampleSource {
+public:
+  SampleSource(bool fullBlock) : count_(fullBlock ? 11 : 3) {
+    static const Walk small[] = {
+      {"temp", 215, 3, 180, 260, 1}, {"tryk", 250, 8, 150, 350, 1}, {"rpm", 1000, 30, 800, 1800, 0},
+    };
+    static const Walk block[] = {   // input 10-20
+      {"reg10", 55, 2, -100, 300, 1}, {"reg11", 0, 0, 0, 0, 0},         {"reg12", 0, 0, 0, 0, 0},
+      {"reg13", 250, 8, 150, 350, 1}, {"reg14", 0, 0, 0, 0, 0},         {"reg15", 1000, 30, 800, 1800, 0},
+      {"reg16", 0, 0, 0, 0, 0},       {"reg17", 0, 0, 0, 0, 0},         {"reg18", 228, 3, 190, 260, 1},
+      {"reg19", 215, 3, 180, 260, 1}, {"reg20", 0, 0, 0, 0, 0},
+    };
+    memcpy(walks_, fullBlock ? block : small, count_ * sizeof(Walk));
+  }
+
+  Sample next(uint32_t seq) {
+    if (tick_++ % 4 == 0) {   // emulatoren opdaterer én gang i sekundet
+      for (size_t i = 0; i < count_; i++) {
+        Walk& w = walks_[i];
+        if (!w.step) continue;
+        int32_t v = w.value + int32_t(rand() % uint32_t(2 * w.step + 1)) - w.step;
+        w.value = v < w.lo ? w.lo : v > w.hi ? w.hi : v;
+      }
+    }
+    for (size_t i = 0; i < count_; i++) metrics_[i] = MetricValue::ofFixed(walks_[i].name, walks_[i].value, walks_[i].decimals);
+    Sample s;
+    s.timestamp = uint64_t(START_MS + int64_t(tick_) * POLL_MS);
+    s.seq = seq & 0xFF;
+    s.metrics = metrics_;
+    s.count = count_;
+    return s;
+  }
+
+private:
+  uint32_t rand() { return rng_ = rng_ * 1664525u + 1013904223u, rng_ >> 8; }   // samme tal på host og ESP32
+
+  Walk        walks_[11];
+  MetricValue metrics_[11];
+  size_t      count_;
+  uint32_t    tick_ = 0;
+  uint32_t    rng_ = 12345;
+};
+
+// ================= MÅLING =================
+static uplink::Batch<BATCH_CAP> batch;
+static lzss::Workspace workspace;
+static uint8_t payload[256];
+static uint8_t envelope[1024];
+static uint8_t scratch[BATCH_CAP];
+
+static void measure(SampleSerializer& ser, bool fullBlock, size_t perBatch, uint32_t batches) {
+  SampleSource source(fullBlock);
+  uint32_t seq = 0;
+  uint64_t samples = 0, payloadBytes = 0, plainBytes = 0, packedBytes = 0, packUs = 0, unpackUs = 0;
+  size_t lastCount = 0;
+
+  Sample s = source.next(seq);
+  size_t len = ser.serialize(s, payload, sizeof(payload));
+  for (uint32_t b = 0; b < batches; b++) {
+    // fyld batchen; et sample der ikke er plads til, starter den næste
+    size_t n = 0, bytes = 0;
+    while (batch.add(int64_t(s.timestamp), payload, len)) {
+      n++;
+      bytes += len;
+      s = source.next(++seq);
+      len = ser.serialize(s, payload, sizeof(payload));
+      if (n == perBatch) break;
+    }
+
+    // samme batch to gange: envelopen uden komprimering, så body alene med LZSS
+    uint8_t body[BATCH_CAP];
+    size_t rawLen = batch.bytes();
+    size_t plain = batch.finish(envelope, sizeof(envelope), nullptr);
+    memcpy(body, envelope + uplink::HEADER_SIZE, rawLen);
+
+    uint32_t t0 = micros32();
+    size_t packed = lzss::compress(body, rawLen, envelope + uplink::HEADER_SIZE, rawLen - 1, workspace);
+    uint32_t t1 = micros32();
+    if (packed && !lzss::decompress(envelope + uplink::HEADER_SIZE, packed, scratch, rawLen)) {
+      BENCH_PRINTF("FEJL: udpakning fejlede\n");
+      return;
+    }
+    uint32_t t2 = micros32();
+    if (packed && memcmp(scratch, body, rawLen) != 0) {
+      BENCH_PRINTF("FEJL: udpakket batch er forskellig fra originalen\n");
+      return;
+    }
+
+    samples += n;
+    payloadBytes += bytes;
+    plainBytes += plain;
+    packedBytes += packed ? uplink::HEADER_SIZE + packed : plain;
+    packUs += t1 - t0;
+    unpackUs += t2 - t1;
+    lastCount = n;
+  }
+
+  double single = double(payloadBytes + samples * MQTT_OVERHEAD);
+  double sent = double(packedBytes + uint64_t(batches) * MQTT_OVERHEAD);
+  char label[16];
+  snprintf(label, sizeof(label), perBatch ? "%u" : "fuld (%u)", unsigned(perBatch ? perBatch : lastCount));
+  BENCH_PRINTF("%-16s %-8s %-9s %8.0f %8.0f %8.0f %6.2fx %7.1f %8.1f %8.1f\n", ser.name(),
+               fullBlock ? "11 reg" : "3 metric", label, single / batches,
+               double(plainBytes) / batches, double(packedBytes) / batches,
+               double(payloadBytes) / double(packedBytes - uint64_t(batches) * uplink::HEADER_SIZE),
+               (single - sent) / double(samples), double(packUs) / batches, double(unpackUs) / batches);
+}
+
+static void runAll(uint32_t batches) {
+  JsonStreamSerializer json(false);   // som firmwaren: uden timestamp/seq
+  CborSerializer cbor;
+  SparkplugSerializer sparkplug;
+  SampleSerializer* formats[] = {&json, &cbor, &sparkplug};
+  static const size_t SIZES[] = {4, 8, 16, 0};   // 0 = så mange som der er plads til
+
+  BENCH_PRINTF("%u batches pr. linje, bytes pr. batch, sparet = bytes pr. sample, tid i µs pr. batch\n", (unsigned)batches);
+  BENCH_PRINTF("%-16s %-8s %-9s %8s %8s %8s %7s %7s %8s %8s\n", "format", "map", "batch", "enkelt", "batch",
+               "lzss", "ratio", "sparet", "komp", "udpak");
+  for (SampleSerializer* f : formats) {
+    for (int full = 0; full < 2; full++) {
+      for (size_t size : SIZES) measure(*f, full, size, batches);
+    }
+  }
+}
+
+#ifdef ARDUINO
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  BENCH_PRINTF("uplink_bench @ %u MHz\n", (unsigned)getCpuFrequencyMhz());
+}
+
+void loop() {
+  runAll(200);
+  delay(5000);
+}
+#else
+int main(int argc, char** argv) {
+  uint32_t batches = argc > 1 ? uint32_t(strtoul(argv[1], nullptr, 10)) : 2000;
+  runAll(batches);
+  return 0;
+}
+#endif
@@ -0,0 +1,112 @@
+// Host-dekoder til uplink-batches (UplinkBatch.h)
+//
+// Læser én MQTT-besked pr. linje som hex (sidste ord på linjen, så topic
+// foran er tilladt), pakker batches ud og skriver hvert sample med sit
+// tidsstempel. JSON skrives som tekst, Sparkplug B som name=value, andet
+// (CBOR) som hex. Beskeder der ikke er batches, skrives på samme måde.
+//
+// Byg: g++ -std=c++17 -O2 -I. -I../SparkplugB uplink_decode.cpp -o uplink_decode
+// Kør: mosquitto_sub -t 'spBv1.0/plantA/DDATA/#' -F '%t %x' | ./uplink_decode
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include "SparkplugDecoder.h"
+#include "UplinkBatch.h"
+
+static bool parseHex(const std::string& hex, std::vector<uint8_t>& out) {
+  if (hex.size() % 2) return false;
+  out.clear();
+  for (size_t i = 0; i < hex.size(); i += 2) {
+    if (!isxdigit((unsigned char)hex[i]) || !isxdigit((unsigned char)hex[i + 1])) return false;
+    out.push_back(uint8_t(std::stoul(hex.substr(i, 2), nullptr, 16)));
+  }
+  return true;
+}
+
+static void printTime(int64_t tsMs) {
+  if (tsMs <= 0) {
+    printf("%-23s", "-");
+    return;
+  }
+  time_t sec = time_t(tsMs / 1000);
+  struct tm tm;
+  gmtime_r(&sec, &tm);
+  char buf[32];
+  strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+  printf("%s.%03d", buf, int(tsMs % 1000));
+}
+
+static void printPayload(const uint8_t* p, size_t len) {
+  if (len && p[0] == '{') {
+    printf("%.*s\n", int(len), reinterpret_cast<const char*>(p));
+    return;
+  }
+  uint64_t timestamp = 0, seq = 0;
+  std::string line;
+  bool ok = spb::forEachMetric(p, len, timestamp, seq, [&](const spb::MetricView& m) {
+    char value[48];
+    if (m.kind == spb::ValueKind::Real) snprintf(value, sizeof(value), "%g", m.d);
+    else if (m.kind == spb::ValueKind::Int) snprintf(value, sizeof(value), "%lld", (long long)m.i);
+    else if (m.isNumeric()) snprintf(value, sizeof(value), "%llu", (unsigned long long)m.u);
+    else snprintf(value, sizeof(value), "?");
+    line += " " + std::string(m.name, m.nameLen) + "=" + value;
+  });
+  if (ok && !line.empty()) {
+    printf("seq=%llu%s\n", (unsigned long long)seq, line.c_str());
+    return;
+  }
+  for (size_t i = 0; i < len; i++) printf("%02x", p[i]);
+  printf("\n");
+}
+
+int main() {
+  static uint8_t scratch[lzss::MAX_INPUT];
+  std::vector<uint8_t> msg;
+  char line[16384];
+  unsigned long messages = 0, batches = 0, samples = 0, sentBytes = 0, rawBytes = 0;
+
+  while (fgets(line, sizeof(line), stdin)) {
+    std::string s(line);
+    while (!s.empty() && isspace((unsigned char)s.back())) s.pop_back();
+    size_t sp = s.find_last_of(' ');
+    if (!parseHex(sp == std::string::npos ? s : s.substr(sp + 1), msg) || msg.empty()) continue;
+    messages++;
+
+    if (!uplink::isBatch(msg.data(), msg.size())) {
+      printTime(0);
+      printf("  ");
+      printPayload(msg.data(), msg.size());
+      continue;
+    }
+    batches++;
+    unsigned long raw = 0;
+    int n = uplink::forEach(msg.data(), msg.size(), scratch, sizeof(scratch), [&](const uplink::Entry& e) {
+      printTime(e.tsMs);
+      printf("  ");
+      printPayload(e.payload, e.len);
+      raw += e.len;
+    });
+    if (n < 0) {
+      printf("# ødelagt batch (%zu bytes)\n", msg.size());
+      continue;
+    }
+    samples += unsigned(n);
+    sentBytes += msg.size();
+    rawBytes += raw;
+    printf("# batch: %d samples, %s, %zu bytes sendt for %lu bytes payload\n", n,
+           msg[2] == uplink::ENC_LZSS ? "lzss" : "ukomprimeret", msg.size(), raw);
+  }
+
+  printf("# %lu beskeder, %lu batches med %lu samples", messages, batches, samples);
+  if (batches) printf(", %lu -> %lu bytes (%.0f%% sparet)", rawBytes, sentBytes,
+                      rawBytes ? 100.0 * (double(rawBytes) - double(sentBytes)) / double(rawBytes) : 0.0);
+  printf("\n");
+  return 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+// Streaming-aggregering over faste (tumbling) tidsvinduer
+//
+// Firmwaren kan polle Modbus hurtigt og kun sende ét aggregat pr. vindue
+// opstrøms. Hver metric holder min/max/sum/antal/sidste værdi, altså O(1)
+// hukommelse og arbejde pr. sample uanset vinduets længde eller pollraten.
+// Værdierne er rå fast-komma heltal (se FixedPoint.h), så aggregeringen
+// kun bruger heltalsregning. Tider er millis() og må gerne løbe rundt
+// (uint32_t-aritmetik).
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ================= ÉN METRIC =================
+struct WindowStats {
+  int32_t  min   = 0;
+  int32_t  max   = 0;
+  int32_t  last  = 0;
+  int64_t  sum   = 0;
+  uint32_t count = 0;
+
+  void add(int32_t v) {
+    if (count == 0 || v < min) min = v;
+    if (count == 0 || v > max) max = v;
+    last = v;
+    sum += v;
+    count++;
+  }
+
+  // Afrundet middelværdi i samme skala som samples
+  int32_t mean() const {
+    if (!count) return 0;
+    int64_t half = count / 2;
+    return int32_t(sum >= 0 ? (sum + half) / count : (sum - half) / int64_t(count));
+  }
+
+  void reset() { *this = WindowStats(); }
+};
+
+// ================= N METRICS, FÆLLES VINDUE =================
+template <size_t N>
+class WindowAggregator {
+public:
+  explicit WindowAggregator(uint32_t windowMs) : windowMs_(windowMs ? windowMs : 1) {}
+
+  uint32_t windowMs() const { return windowMs_; }
+
+  /**
+   * @brief Tilføjer én sample pr. metric; første sample starter vinduet
+   */
+  void add(uint32_t nowMs, const int32_t (&values)[N]) {
+    if (!started_) {
+      windowStart_ = nowMs;
+      started_ = true;
+    } else if (stats_[0].count == 0) {
+      // tomme vinduer (fx Modbus-udfald) springes over, grænserne bevares
+      uint32_t elapsed = uint32_t(nowMs - windowStart_);
+      windowStart_ += (elapsed / windowMs_) * windowMs_;
+    }
+    for (size_t i = 0; i < N; i++) stats_[i].add(values[i]);
+  }
+
+  /**
+   * @brief Sandt når vinduet er udløbet og indeholder mindst én sample
+   */
+  bool due(uint32_t nowMs) const {
+    return started_ && stats_[0].count > 0 && uint32_t(nowMs - windowStart_) >= windowMs_;
+  }
+
+  /**
+   * @brief Lukker vinduet: kopierer statistikken til out og nulstiller
+   *
+   * Vinduesstarten rykkes frem i hele vinduer, så grænserne ikke driver
+   * selvom close() kaldes lidt for sent.
+   * @return vinduets starttid (millis)
+   */
+  uint32_t close(uint32_t nowMs, WindowStats (&out)[N]) {
+    uint32_t start = windowStart_;
+    for (size_t i = 0; i < N; i++) {
+      out[i] = stats_[i];
+      stats_[i].reset();
+    }
+    uint32_t elapsed = uint32_t(nowMs - windowStart_);
+    windowStart_ += (elapsed / windowMs_) * windowMs_;
+    return start;
+  }
+
+  const WindowStats& current(size_t i) const { return stats_[i]; }
+
+private:
+  uint32_t    windowMs_;
+  uint32_t    windowStart_ = 0;
+  bool        started_ = false;
+  WindowStats stats_[N];
+};
@@ -1,66 +1,97 @@
 // https://cppscripts.com/paho-mqtt-cpp-cmake
+//
+// Eksempel på host-side publisher. Bruger MqttPublisher (lib/MqttPublisher),
+// så forbindelsen holdes åben og beskeder sendes gennem en kø i stedet for
+// connect/publish/disconnect pr. besked.
+//
+// Byg:   g++ -std=c++17 -O2 -pthread -I../MqttPublisher paho-pubcopy.cpp
+//            ../MqttPublisher/MqttPublisher.cpp -lpaho-mqttpp3 -lpaho-mqtt3as
 
+#include <chrono>
+#include <cmath>
+#include <ctime>
 #include <iostream>
-#include <nlohmann/json_fwd.hpp>
 #include <string>
-#include <ctime>
+#include <thread>
 #include <nlohmann/json.hpp>
 
+#include "MqttPublisher.h"
+
 using json = nlohmann::json;
 
 const std::string SERVER_ADDRESS("tcp://localhost:1883");
 const std::string CLIENT_ID("ExampleClient");
 
+/**
+ * @brief Tidsstempel for en måling i ms siden epoch (Sparkplug-format)
+ */
+uint64_t sampleTime() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Simuleret temperatur, da host-eksemplet ikke har en sensor
+ *
+ * @return temperatur i °C, svinger langsomt omkring 25.5
+ */
+double measureTemp() {
+  return 25.5 + std::sin(sampleTime() / 60000.0) * 0.5;
+}
+
 /**
  * @brief 
  *
  * @return 
  */
 int main() {
-  
-  mqtt::async_client client(SERVER_ADDRESS, CLIENT_ID);
+  PublisherConfig cfg;
+  cfg.serverUri = SERVER_ADDRESS;
+  cfg.clientId = CLIENT_ID;
+  cfg.defaultQos = 0;
+
+  MqttPublisher publisher(cfg);
+  if (!publisher.start()) {
+    std::cerr << "Kunne ikke forbinde, prøver igen i baggrunden" << std::endl;
+  } else {
+    std::cout << "Connected to the MQTT broker!" << std::endl;
+  }
 
-    mqtt::connect_options connOpts;
-    connOpts.set_clean_session(true);
+  // Follow topic structure of Sparkplug B version 1.0
+  const std::string topic("spBv1.0/officeb/DDATA/ventilationchamber2/olimextemp");
+  // Create JSON payload written in raw JSON
+  json jsonpayload = json::parse(R"(
+                             {
+                                "timestamp": 1486144502122,
+                                "metrics": [{
+                                "name": "temperature",
+                                "alias": 1,
+                                "timestamp": 1479123452194,
+                                "dataType": "integer",
+                                "value": "25.5"
+                             }],
+                                "seq": 2
+                             }
+                             )");
+  // Convert JSON payload to string
+  publisher.publish(topic, jsonpayload.dump(4));
+  std::cout << "Message queued!" << std::endl;
 
-    try {
-        client.connect(connOpts)->wait();
-        std::cout << "Connected to the MQTT broker!" << std::endl;
-        
-        // Follow topic structure of Sparkplug B version 1.0
-        const std::string topic("spBv1.0/officeb/DDATA/ventilationchamber2/olimextemp");
-        // const std::string payload("Hello, MQTT!");
-        // Create JSON payload written in raw JSON
-        json jsonpayload = json::parse(R"(
-                                   {
-                                      "timestamp": 1486144502122,
-                                      "metrics": [{
-                                      "name": "temperature",
-                                      "alias": 1,
-                                      "timestamp": 1479123452194,
-                                      "dataType": "integer",
-                                      "value": "25.5"
-                                   }],
-                                      "seq": 2
-                                   }
-                                   )");
-        // Convert JSON payload to string
-        std::string payload = jsonpayload.dump(4);
-        client.publish(topic, payload.data(), payload.size(), 0, false);
-        std::cout << "Message published!" << std::endl;
-        // You can also construct the JSON object sequentially
-        json altpayload; // empty JSON structure 
-        std::time_t timenow = std::time(nullptr);
-        altpayload["timestamp"] = timenow;
-        altpayload["metrics"]["timestamp"] = sampleTime(); // function to do
-        altpayload["metrics"]["name"] = "temperature";
-        altpayload["value"] = measureTemp(); // function do do
-        std::string publish_payload = altpayload.dump(4);
-        client.publish(topic, publish_payload.data(), publish_payload.size(), 0, false);
-        client.disconnect()->wait();
-    } catch (const mqtt::exception& exc) {
-        std::cerr << "Error: " << exc.what() << std::endl;
-    }
+  // You can also construct the JSON object sequentially
+  for (int seq = 0; seq < 10; seq++) {
+    json altpayload; // empty JSON structure
+    altpayload["timestamp"] = std::time(nullptr);
+    altpayload["metrics"]["timestamp"] = sampleTime();
+    altpayload["metrics"]["name"] = "temperature";
+    altpayload["value"] = measureTemp();
+    altpayload["seq"] = seq;
+    publisher.publish(topic, altpayload.dump(4));
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
 
-    return 0;
+  publisher.stop();
+  PublisherStats st = publisher.stats();
+  std::cout << "Sendt: " << st.acked << ", gensendt: " << st.resent
+            << ", tabt: " << st.dropped << std::endl;
+  return 0;
 }
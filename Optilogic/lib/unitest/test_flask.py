@@ -133,3 +133,18 @@ def test_sensor_data_requires_login(client):  # Tester at login kræves
     res = client.get("/sensor-data")  # Kalder endpoint uden login
     assert res.status_code == 401  # Forventer unauthorized
     assert "error" in res.json  # Tjekker fejlbesked
+
+# -----------------------
+# LIVE DATA (ESP32)
+# -----------------------
+@patch("app.requests.get")  # Mocker requests.get
+def test_live_data_from_device(mock_get, client):  # Tester live-data fra ESP32
+    mock_get.return_value.json.return_value = {"synced": True, "cols": ["ts", "temp"], "rows": [[1, 21.5]]}  # Fake ring-svar
+    mock_get.return_value.raise_for_status = lambda: None  # Ingen fejl
+
+    with client.session_transaction() as sess:  # Åbner session
+        sess["user"] = "admin"  # Simulerer login
+    res = client.get("/live-data?last=10")  # Kalder endpoint
+    assert res.status_code == 200  # Tjekker status
+    assert res.json["rows"] == [[1, 21.5]]  # Tjekker at rækkerne sendes videre
+    assert mock_get.call_args.kwargs["params"] == {"last": "10"}  # Tjekker at last sendes til enheden
@@ -1,18 +1,38 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <PubSubClient.h>
-#include <ModbusMaster.h>
+#include <ESPAsyncWebServer.h>
+#include <RtuMaster.h>
+#include <WriteThenRead.h>
+#include <Preferences.h>
+#include <sys/time.h>
+#include <JsonStreamSerializer.h>
+#include <CborSerializer.h>
+#include <SparkplugSerializer.h>
+#include <SparkplugDecoder.h>
+#include <FixedPoint.h>
+#include <WindowAggregator.h>
+#include <AlarmDetector.h>
+#include <RegisterMap.h>
+#include <HistoryLog.h>
+#include <HistoryReader.h>
+#include <SampleRing.h>
+#include <SampleRingSse.h>
+#include <HeapTrace.h>
+#include <BusScheduler.h>
+#include <BusMeter.h>
+#include <SampleClock.h>
+#include <DeferredLog.h>
+#include <UplinkBatch.h>
+#include <ControlEngine.h>
+#include <atomic>
+#include <DeviceProfile.h>
 
 // NOTE: Ensure PubSubClient library is installed (Arduino Library Manager or PlatformIO lib_deps).
 // ================= MODBUS / RS485 CONFIG =================
-#define RX_PIN 36     //kommunikations pin for modtagelse af data ESP32
-#define TX_PIN 4   //kommunikations pin afsendelse for ESP32
-#define MAX485_DE 5 //tænder reciever
-#define MAX485_RE_NEG 14 //slukker reciever 
-#define BAUD_RATE 9600 // Modbus standard baud rate
-#define MODBUS_SLAVE_ID 1 // Slave ID ventilatoren 
-
-ModbusMaster modbus;
+// Pins, baud og slave-id kommer fra enhedsprofilen (include/DeviceProfile.h),
+// valgt pr. env i platformio.ini med -DDEVICE_PROFILE=...
+constexpr profile::Rs485 BUS = Device::bus;
 
 // ================= WiFi + MQTT =================
 const char* WIFI_SSID = "FMS"; // wifi navn 
@@ -26,72 +46,1223 @@ PubSubClient mqtt(espClient); // MQTT client
 
 // Sparkplug topics (samme format som emulator)
 const char* GROUP  = "plantA"; //gruppe område topic
-const char* DEVICE = "olimex-device"; //device id topic 
+const char* DEVICE = "olimex-device"; //device id topic, i gateway-mode EoN node id
+
+// Device-topics (DBIRTH/DDATA/DDEATH/DCMD) ligger pr. slave, se deviceTopic().
+// Node-topics bruges kun i gateway-mode.
+String TOP_NBIRTH = String("spBv1.0/") + GROUP + "/NBIRTH/" + DEVICE; //nbirth topic
+String TOP_NDATA  = String("spBv1.0/") + GROUP + "/NDATA/"  + DEVICE; //ndata topic (busstatistik)
+String TOP_NDEATH = String("spBv1.0/") + GROUP + "/NDEATH/" + DEVICE; //ndeath topic (MQTT will)
+String TOP_NCMD   = String("spBv1.0/") + GROUP + "/NCMD/"   + DEVICE; //kommandoer til alle slaves
+
+// ================= SAMPLING / AGGREGERING =================
+// Modbus polles hurtigt lokalt, men opstrøms sendes kun ét aggregat pr. vindue.
+// Rå samples sendes kun efter anmodning på DCMD.
+// Polls starter på faste wall-clock grænser (hele multipla af POLL_INTERVAL_MS
+// fra epoch, se SampleClock.h), så alle enheder sampler på samme tidsstempler.
+#ifndef POLL_INTERVAL_MS
+#define POLL_INTERVAL_MS 250     // Modbus poll pr. slave (11 registre ved 9600 baud tager ca. 40 ms)
+#endif
+#ifndef AGG_WINDOW_MS
+#define AGG_WINDOW_MS 10000      // længde af aggregeringsvindue
+#endif
+#define RAW_MAX_S 3600           // rå streaming slår selv fra efter højst en time
+#ifndef RAW_BATCH
+#define RAW_BATCH 1              // rå samples pr. MQTT-besked; over 1 samles de i en envelope (UplinkBatch.h)
+#endif
+#ifndef RAW_COMPRESS
+#define RAW_COMPRESS 1           // LZSS-komprimér batches (kun med RAW_BATCH > 1)
+#endif
+typedef uplink::Batch<1024 - uplink::HEADER_SIZE> RawBatch; // ukomprimeret fylder den hele payloadBuf
+
+enum { M_TEMP, M_TRYK, M_RPM, M_COUNT }; // index i aggregatoren
+const char* METRIC_NAMES[M_COUNT] = {"temp", "tryk", "rpm"};
+
+// Pipelinens fast-komma typer får decimaler fra profilens metric-tabel
+// (gateway: den primære enheds tabel; de andre slaves omregnes til samme skala)
+static_assert(profile::metricIndex<PrimaryDevice>("temp") >= 0, "profilen mangler temp");
+static_assert(profile::metricIndex<PrimaryDevice>("tryk") >= 0, "profilen mangler tryk");
+static_assert(profile::metricIndex<PrimaryDevice>("rpm") >= 0, "profilen mangler rpm");
+typedef Fixed<profile::decimalsOf<PrimaryDevice>("temp")> TempValue;
+typedef Fixed<profile::decimalsOf<PrimaryDevice>("tryk")> TrykValue;
+typedef Fixed<profile::decimalsOf<PrimaryDevice>("rpm")>  RpmValue;
+const uint8_t METRIC_DECIMALS[M_COUNT] = {TempValue::decimals, TrykValue::decimals, RpmValue::decimals};
+
+// ================= ALARMER =================
+// Detektorerne køres på hver poll (O(1) pr. sample), og en alarm publiceres
+// straks i samme loop-gennemløb i stedet for at vente på næste aggregat.
+// Grænserne kan sættes pr. deployment med -D... i platformio.ini.
+#ifndef ALARM_TEMP_HIGH
+#define ALARM_TEMP_HIGH 35.0f    // °C
+#endif
+#ifndef ALARM_TEMP_LOW
+#define ALARM_TEMP_LOW 5.0f      // °C
+#endif
+#ifndef ALARM_TRYK_HIGH
+#define ALARM_TRYK_HIGH 250.0f   // samme enhed som "tryk" i register-mappet
+#endif
+#ifndef ALARM_RPM_RATE
+#define ALARM_RPM_RATE 400.0f    // rpm pr. sekund
+#endif
+
+ThresholdDetector alarmTempHigh("alarm_temp_high", ThresholdDetector::High, ALARM_TEMP_HIGH, 1.0f);
+ThresholdDetector alarmTempLow("alarm_temp_low", ThresholdDetector::Low, ALARM_TEMP_LOW, 1.0f);
+ThresholdDetector alarmTrykHigh("alarm_tryk_high", ThresholdDetector::High, ALARM_TRYK_HIGH, 10.0f);
+EwmaDetector alarmTrykEwma("alarm_tryk_ewma", 0.05f, 5.0f, 1.0f); // 5 sigma fra glidende middel
+RollingStdDetector<40> alarmTempStd("alarm_temp_std", 5.0f, 0.3f); // 40 samples = 10 s ved 250 ms poll
+RateDetector alarmRpmRate("alarm_rpm_rate", ALARM_RPM_RATE);
+
+struct AlarmBinding {
+  AlarmDetector* detector;
+  uint8_t        metric;   // M_TEMP, M_TRYK eller M_RPM
+};
+
+AlarmBinding alarms[] = {
+  {&alarmTempHigh, M_TEMP},
+  {&alarmTempLow,  M_TEMP},
+  {&alarmTempStd,  M_TEMP},
+  {&alarmTrykHigh, M_TRYK},
+  {&alarmTrykEwma, M_TRYK},
+  {&alarmRpmRate,  M_RPM},
+};
+
+
+// ================= HISTORIK =================
+// Hvert sample gemmes lokalt i flash-partitionen "history" (se HistoryLog.h),
+// så data fra et udfald af netværk/QuestDB kan hentes bagefter med
+// lib/HistoryLog/history_dump eller GET /api/history. Kræver wall-clock tid fra SNTP.
+// Næste side slettes af en baggrundstask lige efter et poll, så append() i
+// poll-løkken aldrig venter på en flash-sletning.
+const char* NTP_SERVER = "pool.ntp.org";
+#define TIME_VALID_AFTER 1600000000LL  // før dette er uret ikke sat endnu
+
+HistoryLog historyLog;
+TaskHandle_t historyTask = nullptr;
+
+// unix-tid i ms, eller 0 hvis SNTP ikke har sat uret endnu
+int64_t wallClockMs() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec < TIME_VALID_AFTER) return 0;
+  return int64_t(tv.tv_sec) * 1000 + tv.tv_usec / 1000;
+}
+
+void historyPrepareTask(void*) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // vækkes af poll-løkken
+    if (!historyLog.prepare()) DLOG("Historik: reserveside kunne ikke slettes");
+  }
+}
+
+void beginHistory() {
+  if (!historyLog.begin("history")) {
+    Serial.println("Historik: ingen \"history\" partition, logger ikke lokalt");
+    return;
+  }
+  historyLog.setChannels(M_COUNT, METRIC_NAMES, METRIC_DECIMALS);
+  Serial.printf("Historik: %u/%u sider i brug, %lld..%lld ms\n", (unsigned)historyLog.usedPages(),
+                (unsigned)historyLog.pageCount(), (long long)historyLog.oldestMs(),
+                (long long)historyLog.newestMs());
+  xTaskCreate(historyPrepareTask, "history", 2048, nullptr, 1, &historyTask); // lav prioritet
+}
+
+// ================= LIVE DATA (HTTP) =================
+// De seneste samples ligger i RAM, så dashboardet kan hente live-værdier
+// direkte fra enheden i stedet for at spørge QuestDB. Serveren er asynkron
+// (egen task), så en langsom klient aldrig forsinker poll-løkken.
+//   GET /api/samples?last=N | since=MS | from=UNIX_MS&to=UNIX_MS [&format=bin]
+//   GET /api/stream   Server-Sent Events, ét "sample" event pr. poll
+//   GET /api/history?from=UNIX_MS&to=UNIX_MS   fra flash-historikken (se HistoryReader.h)
+#ifndef LIVE_RING_N
+#define LIVE_RING_N 480          // 2 minutter ved 250 ms poll, ca. 8 kB
+#endif
+#ifndef SSE_MAX_CLIENTS
+#define SSE_MAX_CLIENTS 4        // samtidige browsere på /api/stream
+#endif
+#ifndef SSE_MAX_LAG
+#define SSE_MAX_LAG 40           // usendte samples (10 s) før en klient droppes
+#endif
+
+SampleRing<LIVE_RING_N, M_COUNT> liveRing;
+typedef SampleRingReader<LIVE_RING_N, M_COUNT> LiveReader;
+AsyncWebServer http(80);
+
+// Første sample med ts <= unixMs er før denne sekvens (alder omregnet til millis())
+uint32_t liveSeqAfter(int64_t unixMs, int64_t wallMs, uint32_t nowMs) {
+  int64_t age = wallMs - unixMs;
+  if (age <= 0) return liveRing.written();
+  return liveRing.firstNewerThan(nowMs, uint32_t(age - 1));
+}
+
+void handleSamples(AsyncWebServerRequest* req) {
+  HEAP_TRACE_SCOPE("http_samples");
+  uint32_t nowMs = millis();
+  int64_t wallMs = wallClockMs();
+  uint32_t to = liveRing.written();
+  uint32_t from = liveRing.oldest();
+
+  if (req->hasParam("last")) {
+    uint32_t n = (uint32_t)req->getParam("last")->value().toInt();
+    if (n < to - from) from = to - n;
+  }
+  if (req->hasParam("since")) { // relativt: de sidste MS millisekunder
+    uint32_t since = (uint32_t)req->getParam("since")->value().toInt();
+    uint32_t first = liveRing.firstNewerThan(nowMs, since);
+    if (first > from) from = first;
+  }
+  if (wallMs && req->hasParam("from")) {
+    uint32_t first = liveSeqAfter(atoll(req->getParam("from")->value().c_str()), wallMs, nowMs);
+    if (first > from) from = first;
+  }
+  if (wallMs && req->hasParam("to")) {
+    uint32_t end = liveSeqAfter(atoll(req->getParam("to")->value().c_str()) + 1, wallMs, nowMs);
+    if (end < to) to = end;
+  }
+
+  bool binary = req->hasParam("format") && strcmp(req->getParam("format")->value().c_str(), "bin") == 0;
+  std::shared_ptr<LiveReader> reader = std::make_shared<LiveReader>(
+      liveRing, from, to < from ? from : to, binary ? LiveReader::BINARY : LiveReader::JSON,
+      METRIC_NAMES, METRIC_DECIMALS, nowMs, wallMs);
+  AsyncWebServerResponse* res = req->beginChunkedResponse(
+      binary ? "application/octet-stream" : "application/json",
+      [reader](uint8_t* buf, size_t maxLen, size_t) -> size_t {
+        size_t n = reader->fill(buf, maxLen); // skrives direkte fra ringen, ingen samlet buffer
+        return n || reader->done() ? n : RESPONSE_TRY_AGAIN;
+      });
+  res->addHeader("Access-Control-Allow-Origin", "*"); // dashboardet må hente direkte
+  req->send(res);
+}
 
-String TOP_DBIRTH = String("spBv1.0/") + GROUP + "/DBIRTH/" + DEVICE;  //dbirth topic
-String TOP_DDATA  = String("spBv1.0/") + GROUP + "/DDATA/"  + DEVICE; //ddata topic
-String TOP_DDEATH = String("spBv1.0/") + GROUP + "/DDEATH/" + DEVICE; //ddeath topic
+// Læses i bidder med en cursor; låsen i HistoryLog holdes kun under hver bid,
+// så poll-løkkens append() højst venter på én bid, ikke hele svaret
+void handleHistory(AsyncWebServerRequest* req) {
+  HEAP_TRACE_SCOPE("http_history");
+  int64_t from = req->hasParam("from") ? atoll(req->getParam("from")->value().c_str()) : 0;
+  int64_t to = req->hasParam("to") ? atoll(req->getParam("to")->value().c_str()) : INT64_MAX;
+  if (to < from) {
+    req->send(400, "text/plain", "to er før from");
+    return;
+  }
+  std::shared_ptr<HistoryReader> reader =
+      std::make_shared<HistoryReader>(historyLog, from, to, METRIC_NAMES, M_COUNT);
+  AsyncWebServerResponse* res = req->beginChunkedResponse(
+      "application/json", [reader](uint8_t* buf, size_t maxLen, size_t) -> size_t {
+        size_t n = reader->fill(buf, maxLen); // direkte fra mappet flash, ingen samlet buffer
+        return n || reader->done() ? n : RESPONSE_TRY_AGAIN;
+      });
+  res->addHeader("Access-Control-Allow-Origin", "*");
+  req->send(res);
+}
 
+typedef SampleRingSse<LIVE_RING_N, M_COUNT> LiveStream;
+std::atomic<int> sseClients{0};
+
+// Serveren kalder filleren når forbindelsen har plads, eller ved TCP-poll
+// (ca. 500 ms) hvis der ikke er noget i luften. Ingen data sendes fra loop().
+void handleStream(AsyncWebServerRequest* req) {
+  HEAP_TRACE_SCOPE("http_stream");
+  if (sseClients.fetch_add(1) >= SSE_MAX_CLIENTS) {
+    sseClients--;
+    req->send(503, "text/plain", "for mange klienter");
+    return;
+  }
+  uint32_t start = liveRing.written(); // nye klienter starter ved nyeste sample
+  if (req->hasHeader("Last-Event-ID")) { // genforbindelse: fortsæt hvis muligt
+    uint32_t resume = (uint32_t)strtoul(req->getHeader("Last-Event-ID")->value().c_str(), nullptr, 10) + 1;
+    if (resume < start && start - resume <= SSE_MAX_LAG) start = resume;
+  }
+  std::shared_ptr<LiveStream> stream(
+      new LiveStream(liveRing, start, METRIC_NAMES, METRIC_DECIMALS, SSE_MAX_LAG),
+      [](LiveStream* s) { // forbindelsen er lukket
+        if (s->dropped()) DLOG("SSE: langsom klient droppet efter %u events", (unsigned)s->sent());
+        sseClients--;
+        delete s;
+      });
+  AsyncWebServerResponse* res = req->beginChunkedResponse(
+      "text/event-stream", [stream](uint8_t* buf, size_t maxLen, size_t) -> size_t {
+        size_t n = stream->fill(buf, maxLen, millis(), wallClockMs());
+        return n || stream->done() ? n : RESPONSE_TRY_AGAIN; // intet nyt: prøv igen senere
+      });
+  res->addHeader("Cache-Control", "no-cache");
+  res->addHeader("Access-Control-Allow-Origin", "*");
+  req->send(res);
+}
 
 // ================= RS485 CONTROL =================
 void preTransmission() { 
-  digitalWrite(MAX485_RE_NEG, HIGH);  //forbered afsendelse
-  digitalWrite(MAX485_DE, HIGH);       //forbered afsendelse
+  digitalWrite(BUS.reNegPin, HIGH);  //forbered afsendelse
+  digitalWrite(BUS.dePin, HIGH);       //forbered afsendelse
 }
 
 void postTransmission() {
-  digitalWrite(MAX485_RE_NEG, LOW);  //forbered modtagelse
-  digitalWrite(MAX485_DE, LOW);     //forbered modtagelse
+  digitalWrite(BUS.reNegPin, LOW);  //forbered modtagelse
+  digitalWrite(BUS.dePin, LOW);     //forbered modtagelse
 }
 
-// ================= GENERIC MODBUS =================
-bool readRegistersBlock(uint16_t regs[11]) {   // Læs 11 input registre fra starter ved adressen 10
-  uint8_t result = modbus.readInputRegisters(10, 11);
-  if (result != modbus.ku8MBSuccess) return false;   // hvis Læsning fejlede return false
-  for (int i = 0; i < 11; i++) {  // gem værdier i array
-    regs[i] = modbus.getResponseBuffer(i); // hent register værdi og gem i array
+// ================= SLAVES =================
+// Én Slave pr. member i profilen; enkeltenheds-profiler har præcis én og
+// bruger de gamle topics. I gateway-mode (fx PlantRoom) deles segmentet af
+// BusScheduler, og hver slave er sin egen Sparkplug device under noden:
+//   spBv1.0/<group>/DDATA/<node>/<device>
+// DBIRTH sendes efter første vellykkede poll (med aktuelle værdier), DDEATH
+// efter GATEWAY_DEATH_AFTER fejlede polls i træk. slaves[0] er den primære
+// enhed, som også driver alarmer, live-data og historik.
+#ifndef GATEWAY_DEATH_AFTER
+#define GATEWAY_DEATH_AFTER 5    // fejlede polls i træk før DDEATH
+#endif
+
+// Bussens udnyttelse måles pr. transaktion (BusMeter.h), og én gang pr.
+// vindue strækkes eller forkortes alle pollperioder, så udnyttelsen holdes
+// omkring målet. POLL_INTERVAL_MS er den korteste periode.
+#ifndef BUS_TARGET_UTIL
+#define BUS_TARGET_UTIL 700      // promille, 70 %
+#endif
+#ifndef BUS_MAX_STRETCH
+#define BUS_MAX_STRETCH 8000     // promille, højst 8 x POLL_INTERVAL_MS
+#endif
+
+// Timeout pr. slave følger dens egne svartider (SlaveHealth.h), og en slave
+// der ikke svarer holdes væk fra bussen af en circuit breaker med
+// eksponentiel backoff og billige helbredstjek (ét register).
+#ifndef MODBUS_TIMEOUT_MIN_MS
+#define MODBUS_TIMEOUT_MIN_MS 50
+#endif
+#ifndef MODBUS_TIMEOUT_MAX_MS
+#define MODBUS_TIMEOUT_MAX_MS 2000   // som ModbusMaster; bruges indtil svartiderne kendes
+#endif
+#ifndef MODBUS_BREAKER_FAILURES
+#define MODBUS_BREAKER_FAILURES 3    // timeouts i træk før slaven parkeres
+#endif
+#ifndef MODBUS_BREAKER_MAX_MS
+#define MODBUS_BREAKER_MAX_MS 60000  // længste pause mellem helbredstjek
+#endif
+
+BusMeter busMeter(BUS.baud);
+PeriodTuner periodTuner(BUS_TARGET_UTIL, BUS_MAX_STRETCH);
+
+struct Slave {
+  const profile::Member* member = nullptr;
+  RtuMaster modbus;                             // egen instans: eget slave-id, timeout og responsbuffer
+  MeteredMaster<RtuMaster> bus{modbus, busMeter, micros, millis}; // samme interface, bogfører bustid
+  CircuitBreaker breaker{MODBUS_BREAKER_FAILURES, POLL_INTERVAL_MS * 4, MODBUS_BREAKER_MAX_MS};
+  Fc23Support fc23 = Fc23Support::Unknown;      // afgøres ved første kommando
+  regmap::RegisterMap registerMap;              // aktivt map + reservebuffer til det næste
+  control::Engine control;                      // lokale regler og PID, se REGULERING
+  WindowAggregator<M_COUNT> aggregator{AGG_WINDOW_MS}; // min/max/mean/count/last pr. metric
+  int      slotTemp = -1, slotTryk = -1, slotRpm = -1; // slots i det aktive map
+  uint32_t rawUntilMs = 0;                      // rå samples sendes indtil dette tidspunkt
+  bool     rawActive = false;
+#if RAW_BATCH > 1
+  RawBatch rawBatch;                            // rå samples der venter på at blive sendt samlet
+#endif
+  bool     online = false;                      // DBIRTH sendt siden (gen)forbindelse eller DDEATH
+  uint8_t  failures = 0;                        // fejlede polls i træk
+  char     prefsKey[8];                         // NVS-nøgle for gemt map
+  char     controlKey[8];                       // NVS-nøgle for gemte regler
+  String   topBirth, topData, topDeath, topCmd;
+};
+
+const size_t SLAVE_COUNT = DeviceTraits::memberCount;
+Slave slaves[SLAVE_COUNT];
+BusScheduler<SLAVE_COUNT> busScheduler; // fair deling af bustiden
+SampleClock sampleClock(POLL_INTERVAL_MS); // esp_timer-takt på faste wall-clock grænser (hvert POLL_INTERVAL_MS)
+SampleTick sampleTick;                     // seneste grænse; tidsstempel for samples pollet på den
+uint32_t lastBusReportMs = 0;
+
+String deviceTopic(const char* type, const profile::Member& m) {
+  if (!DeviceTraits::isGateway) return String("spBv1.0/") + GROUP + "/" + type + "/" + DEVICE; // uændrede topics
+  return String("spBv1.0/") + GROUP + "/" + type + "/" + DEVICE + "/" + m.deviceId;
+}
+
+void beginSlaves() {
+  uint8_t weights[SLAVE_COUNT];
+  for (size_t i = 0; i < SLAVE_COUNT; i++) {
+    Slave& s = slaves[i];
+    s.member = &DeviceTraits::members[i];
+    s.modbus.begin(s.member->slaveId, Serial2); // alle slaves deler Serial2
+    s.modbus.setTimeoutBounds(MODBUS_TIMEOUT_MIN_MS, MODBUS_TIMEOUT_MAX_MS);
+    s.modbus.preTransmission(preTransmission);
+    s.modbus.postTransmission(postTransmission);
+    if (i == 0) strcpy(s.prefsKey, "doc"); // samme nøgle som før gateway-mode
+    else snprintf(s.prefsKey, sizeof(s.prefsKey), "doc%u", (unsigned)i);
+    snprintf(s.controlKey, sizeof(s.controlKey), "ctl%u", (unsigned)i);
+    s.topBirth = deviceTopic("DBIRTH", *s.member);
+    s.topData  = deviceTopic("DDATA", *s.member);
+    s.topDeath = deviceTopic("DDEATH", *s.member);
+    s.topCmd   = deviceTopic("DCMD", *s.member);
+    weights[i] = s.member->weight;
+  }
+  busScheduler.begin(millis(), POLL_INTERVAL_MS, weights);
+}
+
+Slave* slaveByCommandTopic(const char* topic) {
+  for (Slave& s : slaves) {
+    if (strcmp(topic, s.topCmd.c_str()) == 0) return &s;
+  }
+  return nullptr;
+}
+
+Slave* slaveByDeviceId(const char* deviceId) {
+  for (Slave& s : slaves) {
+    if (strcmp(deviceId, s.member->deviceId) == 0) return &s;
   }
-  return true; // læsning succesfuld
+  return nullptr;
 }
 
-// Extract values
-float getTemperature(uint16_t regs[11]) { return regs[9] / 10.0f; } //få temperatur fra array
-float getPressure(uint16_t regs[11])    { return regs[3] / 10.0f; } // få tryk fra array
-float getAirFlow(uint16_t regs[11])     { return regs[5]; }      // få airflow fra array
+// ================= REGISTER MAP =================
+// Hvilke registre der polles styres af et map-dokument pr. slave (se
+// RegisterMap.h), som kan sendes med "regmap=<dokument>" på slavens DCMD og
+// gemmes i NVS. Standard er profilens metric-tabel.
+const char* REQUIRED_METRICS[] = {"temp", "tryk", "rpm"}; // bruges af aggregat og alarmer
+
+Preferences prefs;               // NVS namespace "regmap", én nøgle pr. slave (og én for regler, se REGULERING)
+
+// Kaldes ved skift af map: slå de faste metrics op én gang, ikke pr. sample
+void bindSlots(Slave& s) {
+  const regmap::CompiledMap& map = s.registerMap.active();
+  s.slotTemp = map.slotOf("temp");
+  s.slotTryk = map.slotOf("tryk");
+  s.slotRpm  = map.slotOf("rpm");
+  s.control.bind(map);
+  DLOG("Register-map aktivt for %s: %u metrics, %u Modbus-requests pr. poll",
+       s.member->deviceId, (unsigned)map.size(), (unsigned)map.readCount());
+}
+
+// Læser gemte maps fra NVS, ellers standard-mappet fra profilen
+void loadStoredRegisterMaps() {
+  prefs.begin("regmap", false);
+  for (Slave& s : slaves) {
+    const char* err = nullptr;
+    String stored = prefs.getString(s.prefsKey, "");
+    if (stored.length() > 0 &&
+        s.registerMap.load(stored.c_str(), stored.length(), err, REQUIRED_METRICS, 3)) {
+      DLOG("Register-map for %s indlæst fra NVS", s.member->deviceId);
+    } else {
+      if (stored.length() > 0) DLOG("Gemt register-map afvist (%s), bruger standard", err);
+      s.registerMap.load(s.member->metrics, s.member->metricCount, err, REQUIRED_METRICS, 3);
+    }
+    s.registerMap.beginCycle();
+    bindSlots(s);
+  }
+}
 
 // ================= SPECIALIZED FUNCTIONS =================
+// Skriver et holding register og læser det tilbage som bekræftelse, med
+// FC23 i én transaktion hvor slaven kan (ellers FC06 + FC03, se WriteThenRead.h).
+// state er registerets værdi efter skrivningen.
+uint8_t writeHoldingRegister(Slave& s, uint16_t reg, uint16_t value, uint16_t& state) {
+  Fc23Support before = s.fc23;
+  uint8_t result = writeThenRead(s.bus, s.fc23, reg, value, reg, 1);
+  if (s.fc23 != before) {
+    DLOG("Modbus: %s %s FC23", s.member->deviceId, s.fc23 == Fc23Support::Supported ? "understøtter" : "understøtter ikke");
+  }
+  if (result == RtuMaster::ku8MBResponseTimedOut) s.breaker.onTimeout(millis());
+  else s.breaker.onResponse();
+  if (result == RtuMaster::ku8MBSuccess) state = s.bus.getResponseBuffer(0);
+  return result;
+}
+
+uint8_t writeRunRegister(Slave& s, uint16_t value, uint16_t& state) {
+  return writeHoldingRegister(s, uint16_t(s.member->runRegister), value, state);
+}
+
 void fanStart() {
-  Serial.println("Starter ventilation (fanStart)");
-  uint8_t result = modbus.writeSingleRegister(367, 0); // Skriv til holding register 367 med værdien 0 for sluk og 3 for start.
-  if (result == modbus.ku8MBSuccess) {
-    Serial.println("Ventilation startet: register skriv ok");  //hvis skrivning succesfuld
-  } else {
-    Serial.print("Ventilation start fejlede, modbus fejlkode: "); //hvis skrivning fejlede½
-    Serial.println(result); //vis resultat i terminal 
+  for (Slave& s : slaves) {
+    if (s.member->runRegister < 0) continue; // profilen har intet start/stop-register
+    DLOG("Starter %s (fanStart)", s.member->deviceId);
+    uint16_t state = 0;
+    uint8_t result = writeRunRegister(s, s.member->bootRunValue, state); // holding register fra profilen
+    if (result == s.modbus.ku8MBSuccess) {
+      DLOG("Ventilation startet: register skriv ok, status %u", (unsigned)state);  //hvis skrivning succesfuld
+      if constexpr (DeviceTraits::hasStatusLed) digitalWrite(Device::statusLedPin, state ? HIGH : LOW);
+    } else {
+      DLOG("Ventilation start fejlede, modbus fejlkode: %u", (unsigned)result); //hvis skrivning fejlede
+    }
+  }
+}
+
+// ================= BUILD PAYLOAD =================
+// Payload-format vælges pr. deployment med -DPAYLOAD_FORMAT=... i platformio.ini
+#define PAYLOAD_JSON 0 // fladt JSON {"temp":..,"tryk":..,"rpm":..} (Ingestor-json.py)
+#define PAYLOAD_SPB  1 // Sparkplug B protobuf (SPB_ingester.py)
+#define PAYLOAD_CBOR 2 // CBOR, samme struktur som JSON
+#ifndef PAYLOAD_FORMAT
+#define PAYLOAD_FORMAT PAYLOAD_JSON
+#endif
+
+#if PAYLOAD_FORMAT == PAYLOAD_SPB
+SparkplugSerializer serializer;
+#elif PAYLOAD_FORMAT == PAYLOAD_CBOR
+CborSerializer serializer;
+#else
+JsonStreamSerializer serializer(false); // false = uden timestamp/seq, præcis som den gamle makeJsonPayload
+#endif
+
+uint8_t payloadBuf[2048]; // genbruges til hver publish, ingen String-allokering (plads til en birth med et fuldt register-map)
+static_assert(sizeof(payloadBuf) >= uplink::HEADER_SIZE + RawBatch::CAPACITY, "en ukomprimeret batch skal kunne stå i payloadBuf");
+
+// ================= MQTT SESSION =================
+// Persistent session (clean session = false): brokeren husker abonnementerne
+// og gemmer QoS 1-kommandoer på DCMD/NCMD mens forbindelsen er nede. Efter en
+// genforbindelse fortsætter seq hvor den slap, og der sendes ingen births.
+// Fulde births (NBIRTH med bdSeq, DBIRTH pr. slave med aktuelle værdier)
+// sendes efter opstart og når host-applikationen beder om det med NCMD
+// "Node Control/Rebirth" (eller teksten "rebirth").
+// bdSeq tælles op ved hver opstart og gemmes i NVS. Will-beskeden (NDEATH,
+// eller DDEATH uden gateway) bærer samme bdSeq som seneste birth, også efter
+// en rebirth, da will'en kun kan sættes ved connect.
+// Intet DATA sendes før den birth der annoncerer det: DDATA (også kvitteringer,
+// alarmer og rå samples) kræver slavens DBIRTH, og i gateway-mode kræver
+// DBIRTH og NDATA nodens NBIRTH. Hvad der ikke må sendes endnu droppes eller
+// samles videre til næste periode.
+const char* MQTT_CLIENT_ID = "olimex-client"; // skal være fast, ellers finder brokeren ikke sessionen
+
+uint8_t bdSeq = 0;            // 1-255, se makeDeathPayload()
+uint8_t mqttSeq = 0;          // Sparkplug seq for næste besked; 0 i NBIRTH (uden gateway: DBIRTH)
+bool    birthPending = true;  // fuld birth ved næste forbindelse (opstart eller Rebirth)
+bool    nodeOnline = false;   // gateway: NBIRTH sendt i denne session
+
+void beginMqttSession() {
+  Preferences p;
+  p.begin("mqtt", false);
+  bdSeq = p.getUChar("bdseq", 0) % 255 + 1;
+  p.putUChar("bdseq", bdSeq);
+  p.end();
+}
+
+// Topic for node-rapporter (bus, heap): NDATA efter NBIRTH i gateway-mode,
+// ellers den primære enheds DDATA efter dens DBIRTH. nullptr = ikke endnu.
+const char* nodeReportTopic() {
+  if constexpr (DeviceTraits::isGateway) return nodeOnline ? TOP_NDATA.c_str() : nullptr;
+  return slaves[0].online ? slaves[0].topData.c_str() : nullptr;
+}
+
+// Serialiserer og stempler næste seq; alle MQTT-payloads går herigennem
+size_t serializeSample(Sample& sample, uint8_t* buf, size_t cap) {
+  sample.seq = mqttSeq++; // løber rundt ved 256 som Sparkplug kræver
+  return serializer.serialize(sample, buf, cap);
+}
+
+// Will-payload med bdSeq. PubSubClient tager will'en som C-streng, så den må
+// ikke indeholde 0-bytes; derfor er bdSeq 1-255 og genbruges som seq (CBOR).
+size_t makeDeathPayload(uint8_t* buf, size_t cap) {
+#if PAYLOAD_FORMAT == PAYLOAD_SPB
+  return spb::encodeDeathPayload(bdSeq, buf, cap);
+#else
+  MetricValue metrics[] = { MetricValue::ofInt("bdSeq", bdSeq) };
+  Sample sample;
+  sample.seq = bdSeq;
+  sample.metrics = metrics;
+  sample.count = 1;
+  return serializer.serialize(sample, buf, cap);
+#endif
+}
+
+// NCMD "Node Control/Rebirth" = true (Sparkplug), eller "rebirth" i tekstformaterne
+bool isRebirthRequest(const uint8_t* payload, unsigned int length) {
+  static const char REBIRTH[] = "Node Control/Rebirth";
+  if (length == 7 && memcmp(payload, "rebirth", 7) == 0) return true;
+  bool rebirth = false;
+  uint64_t timestamp = 0, seq = 0;
+  spb::forEachMetric(payload, length, timestamp, seq, [&](const spb::MetricView& m) {
+    if (m.nameLen == sizeof(REBIRTH) - 1 && memcmp(m.name, REBIRTH, m.nameLen) == 0 &&
+        m.kind == spb::ValueKind::Bool && m.u) rebirth = true;
+  });
+  return rebirth;
+}
+
+// Rå sample: alle metrics i det aktive map med deres egne decimaler
+size_t makePayload(const regmap::CompiledMap& map, const int32_t* raw, uint32_t okMask,
+                   int64_t timestampMs = 0) { // lav payload i payloadBuf
+  MetricValue metrics[regmap::MAX_ENTRIES];
+  size_t n = 0;
+  for (size_t slot = 0; slot < map.size(); slot++) {
+    if (!(okMask & (1u << slot))) continue; // blokken fejlede, feltet udelades
+    metrics[n++] = MetricValue::ofFixed(map.name(slot), raw[slot], map.decimals(slot)); // formateres uden float
+  }
+  Sample sample;
+  sample.timestamp = uint64_t(timestampMs); // 0 = udelades
+  sample.metrics = metrics;
+  sample.count = n;
+  return serializeSample(sample, payloadBuf, sizeof(payloadBuf)); // 0 hvis bufferen er for lille
+}
+
+// Rå samples på DDATA: ét pr. besked, eller med RAW_BATCH > 1 samlet i en
+// envelope (se UplinkBatch.h), så MQTT-header og topic kun sendes én gang,
+// og gentagne navne og værdier komprimeres væk. Batchen sendes når den har
+// RAW_BATCH samples, når næste sample ikke kan være der, og når raw-mode slutter.
+#if RAW_BATCH > 1
+#if RAW_COMPRESS
+lzss::Workspace rawWorkspace; // hash-kæder til LZSS, deles af alle slaves (ca. 3 KB)
+#define RAW_WORKSPACE &rawWorkspace
+#else
+#define RAW_WORKSPACE nullptr
+#endif
+
+void flushRawBatch(Slave& s) {
+  if (s.rawBatch.empty()) return;
+  unsigned count = (unsigned)s.rawBatch.count(), bytes = (unsigned)s.rawBatch.bytes();
+  size_t len = s.rawBatch.finish(payloadBuf, sizeof(payloadBuf), RAW_WORKSPACE);
+  if (len) mqtt.publish(s.topData.c_str(), payloadBuf, len, false);
+  DLOG("Rå batch for %s: %u samples, %u -> %u bytes", s.member->deviceId, count, bytes, (unsigned)len);
+}
+#else
+void flushRawBatch(Slave&) {}
+#endif
+
+void publishRawSample(Slave& s, const regmap::CompiledMap& map, const int32_t* raw, uint32_t okMask, int64_t wallMs) {
+  if (!s.online) return; // ingen DDATA før DBIRTH
+#if RAW_BATCH > 1
+  uint8_t seq = mqttSeq;
+#endif
+  size_t len = makePayload(map, raw, okMask, busScheduler.paced() ? wallMs : 0);
+  if (!len) return;
+#if RAW_BATCH > 1
+  if (!s.rawBatch.add(wallMs, payloadBuf, len) && !s.rawBatch.empty()) {
+    // ikke plads: de ældre samples først, så rækkefølgen holder. flushRawBatch
+    // skriver i payloadBuf, så samplet serialiseres igen med samme seq.
+    flushRawBatch(s);
+    mqttSeq = seq;
+    len = makePayload(map, raw, okMask, busScheduler.paced() ? wallMs : 0);
+    if (!len) return;
+    if (s.rawBatch.add(wallMs, payloadBuf, len)) return;
+  } else if (!s.rawBatch.empty()) {
+    // samples fra samme map er næsten lige store: er der ikke plads til ét mere, sendes batchen nu
+    if (s.rawBatch.count() >= RAW_BATCH || s.rawBatch.room() < len + 8) flushRawBatch(s);
+    return;
+  }
+  // større end en hel batch: sendes alene med eget tidsstempel (modtageren kender
+  // en batch på første byte). JSON har intet tidsstempel og stemples ved modtagelse.
+  mqttSeq = seq;
+  len = makePayload(map, raw, okMask, wallMs);
+  if (!len) return;
+#endif
+  mqtt.publish(s.topData.c_str(), payloadBuf, len, false);
+}
+
+// Aggregat for ét vindue. temp/tryk/rpm er middelværdien, så ingestorerne og
+// dashboardet virker uændret; resten er ekstra felter. De første AGG_MEANS
+// har samme navne som mappet og deklareres derfor af dets metrics i DBIRTH.
+const size_t AGG_METRICS = 13;
+const size_t AGG_MEANS = 3;
+
+void aggregateMetrics(const WindowStats (&w)[M_COUNT], MetricValue (&metrics)[AGG_METRICS]) {
+  const WindowStats& t = w[M_TEMP];
+  const WindowStats& p = w[M_TRYK];
+  const WindowStats& r = w[M_RPM];
+  MetricValue m[AGG_METRICS] = {
+    MetricValue::ofFixed("temp", t.mean(), TempValue::decimals),
+    MetricValue::ofFixed("tryk", p.mean(), TrykValue::decimals),
+    MetricValue::ofFixed("rpm", r.mean(), RpmValue::decimals),
+    MetricValue::ofFixed("temp_min", t.min, TempValue::decimals),
+    MetricValue::ofFixed("temp_max", t.max, TempValue::decimals),
+    MetricValue::ofFixed("temp_last", t.last, TempValue::decimals),
+    MetricValue::ofFixed("tryk_min", p.min, TrykValue::decimals),
+    MetricValue::ofFixed("tryk_max", p.max, TrykValue::decimals),
+    MetricValue::ofFixed("tryk_last", p.last, TrykValue::decimals),
+    MetricValue::ofFixed("rpm_min", r.min, RpmValue::decimals),
+    MetricValue::ofFixed("rpm_max", r.max, RpmValue::decimals),
+    MetricValue::ofFixed("rpm_last", r.last, RpmValue::decimals),
+    MetricValue::ofInt("n", t.count), // antal samples i vinduet
+  };
+  memcpy(metrics, m, sizeof(m));
+}
+
+size_t makeAggregatePayload(const WindowStats (&w)[M_COUNT]) {
+  MetricValue metrics[AGG_METRICS];
+  aggregateMetrics(w, metrics);
+  Sample sample;
+  sample.metrics = metrics;
+  sample.count = AGG_METRICS;
+  return serializeSample(sample, payloadBuf, sizeof(payloadBuf));
+}
+
+uint8_t alarmBuf[128]; // egen buffer, så en alarm aldrig venter på payloadBuf
+
+// Alarm-payload: {"alarm_tryk_high":true,"value":..,"score":..,"limit":..}
+// Har ingen temp/tryk/rpm, så ingestorerne skriver den ikke i sensor_data.
+void alarmMetrics(const AlarmDetector& d, float value, bool active, MetricValue (&metrics)[4]) {
+  metrics[0] = MetricValue::ofBool(d.name(), active); // true = aktiv, false = ophørt
+  metrics[1] = MetricValue::ofDouble("value", value, 2);
+  metrics[2] = MetricValue::ofDouble("score", d.score(), 2);
+  metrics[3] = MetricValue::ofDouble("limit", d.limit(), 2);
+}
+
+bool publishAlarm(const AlarmDetector& d, float value, AlarmEvent ev) {
+  if (!slaves[0].online) return false; // før DBIRTH: tilstanden følger med i birth
+  MetricValue metrics[4];
+  alarmMetrics(d, value, ev == AlarmEvent::Raised, metrics);
+  Sample sample;
+  sample.metrics = metrics;
+  sample.count = 4;
+  size_t len = serializeSample(sample, alarmBuf, sizeof(alarmBuf));
+  if (!len) return false;
+  return mqtt.publish(slaves[0].topData.c_str(), alarmBuf, len, false); // alarmer hører til den primære enhed
+}
+
+// Køres lige efter hver Modbus-læsning af den primære enhed, før aggregering og rå samples
+void checkAlarms(const float (&values)[M_COUNT], uint32_t now) {
+  for (AlarmBinding& a : alarms) {
+    AlarmEvent ev = a.detector->update(values[a.metric], now);
+    if (ev == AlarmEvent::None) continue;
+    bool sent = publishAlarm(*a.detector, values[a.metric], ev);
+    DLOG("ALARM %s %s (%.2f, score %.2f)%s", a.detector->name(),
+         ev == AlarmEvent::Raised ? "aktiv" : "ophørt", values[a.metric],
+         a.detector->score(), sent ? "" : " - ikke sendt");
+  }
+}
+
+// ================= KOMMANDOER =================
+// Kvittering på slavens DDATA. Før DBIRTH droppes den; kommandoen er udført,
+// og den nye tilstand kan ses i birth og efterfølgende data.
+void publishAck(Slave& s, const MetricValue* metrics, size_t count) {
+  if (!s.online) {
+    DLOG("Kvittering til %s droppet: ingen DBIRTH endnu", s.member->deviceId);
+    return;
+  }
+  Sample sample;
+  sample.metrics = metrics;
+  sample.count = count;
+  size_t len = serializeSample(sample, alarmBuf, sizeof(alarmBuf));
+  if (len) mqtt.publish(s.topData.c_str(), alarmBuf, len, false);
+}
+
+// Kompilér et nul-termineret map-dokument, skift ind ved næste poll og gem i NVS.
+// Kaldes fra MQTT-callback (loop) og fra HTTP-serverens task; load() er trådsikker.
+bool applyRegmap(Slave& s, const char* doc, size_t length, const char*& err) {
+  err = nullptr;
+  if (!s.registerMap.load(doc, length, err, REQUIRED_METRICS, 3)) {
+    DLOG("Register-map for %s afvist: %s", s.member->deviceId, err ? err : "ukendt fejl");
+    return false;
+  }
+  prefs.putString(s.prefsKey, doc);
+  DLOG("Nyt register-map for %s modtaget, skiftes ind ved næste poll", s.member->deviceId);
+  return true;
+}
+
+char regmapDoc[regmap::MAX_DOC + 1]; // nul-termineret kopi af MQTT-payload
+
+// "regmap=<dokument>" på slavens DCMD, kvitteres med regmap_ok på dens DDATA
+void handleRegmapCommand(Slave& s, const uint8_t* doc, unsigned int length) {
+  const char* err = "dokument for langt";
+  bool ok = false;
+  if (length <= regmap::MAX_DOC) {
+    memcpy(regmapDoc, doc, length);
+    regmapDoc[length] = '\0';
+    ok = applyRegmap(s, regmapDoc, length, err);
+  }
+  MetricValue metrics[] = { MetricValue::ofBool("regmap_ok", ok) }; // kvittering på DDATA
+  publishAck(s, metrics, 1);
+}
+
+// Skriver start/stop-registeret og kvitterer med den tilbagelæste værdi, så
+// afsenderen ikke skal vente på næste poll for at se om kommandoen virkede
+void handleRunCommand(Slave& s, long value) {
+  uint16_t state = 0;
+  uint8_t result = s.member->runRegister < 0 ? RtuMaster::ku8MBIllegalDataAddress
+                                             : writeRunRegister(s, uint16_t(constrain(value, 0L, 65535L)), state);
+  bool ok = result == RtuMaster::ku8MBSuccess && state == value;
+  DLOG("Kommando run=%d til %s: %s (fejlkode %u)", (int)value, s.member->deviceId, ok ? "ok" : "fejlede", (unsigned)result);
+  if constexpr (DeviceTraits::hasStatusLed) {
+    if (result == RtuMaster::ku8MBSuccess) digitalWrite(Device::statusLedPin, state ? HIGH : LOW);
+  }
+  MetricValue metrics[] = { MetricValue::ofBool("run_ok", ok), MetricValue::ofInt("run_state", state) }; // kvittering på DDATA
+  publishAck(s, metrics, result == RtuMaster::ku8MBSuccess ? 2 : 1);
+}
+
+// ================= REGULERING =================
+// Lokale regler og PID pr. slave (se ControlEngine.h) evalueres på hvert
+// friskt poll, og deres skrivninger går gennem kommandokøen sammen med
+// "run=" fra MQTT. Køen tømmes i loop lige efter pollet, så reaktionstiden er
+// bustid (én poll + én skrivning) i stedet for turen over MQTT, QuestDB og Flask.
+// Regler sendes med "control=<dokument>" på slavens DCMD og gemmes i NVS;
+// uden gemte regler bruges -DCONTROL_RULES (standard: ingen).
+// Hver skrivning kvitteres på DDATA med ctl_rule/ctl_value/ctl_ok/ctl_latency_ms,
+// og busrapporten tæller ctl_writes, ctl_failed og største reaktionstid.
+#ifndef CONTROL_RULES
+#define CONTROL_RULES ""
+#endif
+
+control::CommandQueue<16> commandQueue; // kun loop-tasken (poll og MQTT-callback) bruger køen
+
+struct ControlStats {
+  uint32_t writes = 0;
+  uint32_t failed = 0;
+  uint32_t maxLatencyMs = 0;   // fra samplet blev læst til skrivningen var bekræftet
+} controlStats;
+
+// Kompilér et regel-dokument for slaven og gem det i NVS
+bool applyControl(Slave& s, const char* doc, size_t length, const char*& err, bool store) {
+  if (!s.control.load(doc, length, s.member->runRegister, err)) {
+    DLOG("Regler for %s afvist: %s", s.member->deviceId, err ? err : "ukendt fejl");
+    return false;
+  }
+  s.control.bind(s.registerMap.active());
+  if (store) prefs.putString(s.controlKey, doc);
+  DLOG("%u regler aktive for %s", (unsigned)s.control.size(), s.member->deviceId);
+  return true;
+}
+
+// Læser gemte regler fra NVS (kaldes efter loadStoredRegisterMaps, som åbner prefs)
+void loadStoredControlRules() {
+  for (Slave& s : slaves) {
+    const char* err = nullptr;
+    String stored = prefs.getString(s.controlKey, "");
+    if (stored.length() > 0 && applyControl(s, stored.c_str(), stored.length(), err, false)) continue;
+    applyControl(s, CONTROL_RULES, strlen(CONTROL_RULES), err, false);
+  }
+}
+
+char controlDoc[control::MAX_DOC + 1]; // nul-termineret kopi af MQTT-payload
+
+// "control=<dokument>" på slavens DCMD (tomt dokument = ingen regler), kvitteres med control_ok
+void handleControlCommand(Slave& s, const uint8_t* doc, unsigned int length) {
+  const char* err = "dokument for langt";
+  bool ok = false;
+  if (length <= control::MAX_DOC) {
+    memcpy(controlDoc, doc, length);
+    controlDoc[length] = '\0';
+    ok = applyControl(s, controlDoc, length, err, true);
+  }
+  MetricValue metrics[] = { MetricValue::ofBool("control_ok", ok), MetricValue::ofInt("control_rules", s.control.size()) };
+  publishAck(s, metrics, 2);
+}
+
+// Evaluerer slavens regler på et netop læst sample og lægger skrivningerne i køen
+void runControl(size_t i, const regmap::CompiledMap& map, const int32_t* raw, uint32_t okMask, uint32_t sampleMs) {
+  Slave& s = slaves[i];
+  if (!s.control.size()) return;
+  control::Command cmds[control::MAX_RULES];
+  size_t n = s.control.evaluate(map, raw, okMask, sampleMs, cmds, control::MAX_RULES);
+  for (size_t k = 0; k < n; k++) {
+    if (commandQueue.push({uint8_t(i), control::FROM_CONTROL, cmds[k], sampleMs})) continue;
+    s.control.onResult(cmds[k], false, sampleMs); // køen er fuld: prøves igen efter RETRY_MS
+    controlStats.failed++;
+  }
+}
+
+void executeControlCommand(Slave& s, const control::QueuedCommand& q) {
+  const control::Command& c = q.command;
+  uint16_t state = 0;
+  uint8_t result = s.breaker.state() == CircuitBreaker::Open ? RtuMaster::ku8MBResponseTimedOut // parkeret: bussen bruges ikke
+                                                             : writeHoldingRegister(s, c.reg, c.value, state);
+  bool ok = result == RtuMaster::ku8MBSuccess && state == c.value;
+  uint32_t now = millis();
+  uint32_t latency = now - q.sampleMs;
+  s.control.onResult(c, ok, now);
+  controlStats.writes++;
+  if (!ok) controlStats.failed++;
+  if (latency > controlStats.maxLatencyMs) controlStats.maxLatencyMs = latency;
+  if (ok && c.reg == s.member->runRegister) {
+    if constexpr (DeviceTraits::hasStatusLed) digitalWrite(Device::statusLedPin, state ? HIGH : LOW);
+  }
+  DLOG("Regel %u for %s: register %u = %u %s (%u ms efter sample)", (unsigned)c.rule, s.member->deviceId,
+       (unsigned)c.reg, (unsigned)c.value, ok ? "ok" : "fejlede", (unsigned)latency);
+  MetricValue metrics[] = {
+    MetricValue::ofInt("ctl_rule", c.rule),
+    MetricValue::ofInt("ctl_value", c.value),
+    MetricValue::ofBool("ctl_ok", ok),
+    MetricValue::ofInt("ctl_latency_ms", latency),
+  };
+  publishAck(s, metrics, 4);
+}
+
+// Udfører alle ventende skrivninger; kaldes fra loop mellem polls
+void drainCommands() {
+  control::QueuedCommand q;
+  while (commandQueue.pop(q)) {
+    HEAP_TRACE_SCOPE("command");
+    Slave& s = slaves[q.slave];
+    if (q.source == control::FROM_MQTT) handleRunCommand(s, q.command.value);
+    else executeControlCommand(s, q);
+  }
+}
+
+// "raw=N": send rå samples i N sekunder (0 = stop); på NCMD gælder det alle slaves
+// "regmap=...": nyt register-map (se RegisterMap.h), kun på en slaves DCMD
+// "run=N": skriv N til start/stop-registeret (0 = stop), kun på en slaves DCMD (udføres via kommandokøen)
+// "control=<dokument>": lokale regler (se REGULERING), kun på en slaves DCMD
+// NCMD "Node Control/Rebirth" (eller "rebirth"): fuld birth, se MQTT SESSION
+void onMqttMessage(char* topic, uint8_t* payload, unsigned int length) {
+  Slave* target = slaveByCommandTopic(topic);
+  bool nodeTopic = strcmp(topic, TOP_NCMD.c_str()) == 0;
+  if (nodeTopic && isRebirthRequest(payload, length)) {
+    birthPending = true; // sendes fra loop, ikke midt i callbacken
+    return;
+  }
+  bool node = DeviceTraits::isGateway && nodeTopic;
+  if (!target && !node) return;
+  if (length >= 7 && memcmp(payload, "regmap=", 7) == 0) {
+    if (target) handleRegmapCommand(*target, payload + 7, length - 7);
+    return;
+  }
+  if (length >= 8 && memcmp(payload, "control=", 8) == 0) {
+    if (target) handleControlCommand(*target, payload + 8, length - 8);
+    return;
+  }
+  char cmd[32];
+  unsigned int n = length < sizeof(cmd) - 1 ? length : sizeof(cmd) - 1;
+  memcpy(cmd, payload, n);
+  cmd[n] = '\0';
+  if (strncmp(cmd, "raw=", 4) == 0) {
+    long seconds = constrain(atol(cmd + 4), 0L, (long)RAW_MAX_S);
+    for (Slave& s : slaves) {
+      if (!node && &s != target) continue;
+      s.rawActive = seconds > 0;
+      if (!s.rawActive) flushRawBatch(s);
+      s.rawUntilMs = millis() + (uint32_t)seconds * 1000;
+      DLOG("Rå samples for %s %s (%d s)", s.member->deviceId, s.rawActive ? "til" : "fra", (int)seconds);
+    }
+  } else if (strncmp(cmd, "run=", 4) == 0 && target) {
+    control::Command c = {0, 0, 0, uint16_t(constrain(atol(cmd + 4), 0L, 65535L))};
+    if (!commandQueue.push({uint8_t(target - slaves), control::FROM_MQTT, c, (uint32_t)millis()})) {
+      DLOG("Kommandokø fuld, run=%d til %s afvist", (int)c.value, target->member->deviceId);
+    }
+  }
+}
+
+// POST /api/regmap[?device=<id>] med dokumentet som body (samme format som "regmap=");
+// uden device gælder det den primære enhed. Bodyen samles pr. request i
+// _tempObject, så to samtidige POSTs ikke skriver i hinandens dokument.
+struct RegmapBody {
+  size_t len;
+  bool broken; // for lang eller et stykke mangler/kom i forkert rækkefølge
+  char doc[regmap::MAX_DOC + 1];
+};
+
+void onRegmapBody(AsyncWebServerRequest* req, uint8_t* data, size_t len, size_t index, size_t total) {
+  RegmapBody* body = static_cast<RegmapBody*>(req->_tempObject);
+  if (index == 0 && !body) {
+    if (total > regmap::MAX_DOC) return; // afvises i onRegmapPost
+    body = static_cast<RegmapBody*>(malloc(sizeof(RegmapBody)));
+    if (!body) return;
+    body->len = 0;
+    body->broken = false;
+    req->_tempObject = body; // frigives i onRegmapPost (eller af requesten hvis den afbrydes)
+  }
+  if (!body || body->broken) return;
+  if (index != body->len || index + len > regmap::MAX_DOC) {
+    body->broken = true;
+    return;
+  }
+  memcpy(body->doc + index, data, len);
+  body->len += len;
+}
+
+void onRegmapPost(AsyncWebServerRequest* req) {
+  RegmapBody* body = static_cast<RegmapBody*>(req->_tempObject);
+  const char* err = "dokument for langt";
+  bool ok = false;
+  Slave* s = req->hasParam("device") ? slaveByDeviceId(req->getParam("device")->value().c_str()) : &slaves[0];
+  if (!s) {
+    err = "ukendt device";
+  } else if (body && !body->broken && body->len == req->contentLength()) {
+    body->doc[body->len] = '\0';
+    ok = applyRegmap(*s, body->doc, body->len, err);
+  } else if (req->contentLength() == 0) {
+    err = "tomt dokument";
+  } else if (req->contentLength() <= regmap::MAX_DOC) {
+    err = "ufuldstændig body";
+  }
+  free(body);
+  req->_tempObject = nullptr;
+  if (ok) req->send(200, "application/json", "{\"regmap_ok\":true}");
+  else req->send(400, "application/json", String("{\"regmap_ok\":false,\"error\":\"") + err + "\"}");
+}
+
+void beginHttp() {
+  http.on("/api/samples", HTTP_GET, handleSamples);
+  http.on("/api/stream", HTTP_GET, handleStream);
+  http.on("/api/history", HTTP_GET, handleHistory);
+  http.on("/api/regmap", HTTP_POST, onRegmapPost, nullptr, onRegmapBody);
+  http.begin();
+  Serial.println("HTTP: /api/samples, /api/stream, /api/history og /api/regmap på port 80");
+}
+
+// ================= HEAP-INSTRUMENTERING =================
+// Kun med env:esp32-poe-heaptrace (-DHEAP_TRACE + --wrap af malloc/free).
+// Hver periode publiceres heap-tilstand, stak-high-water pr. task og de
+// største allokerings-sites, hvorefter tællerne nulstilles. Site-navnene
+// skifter fra periode til periode og kan ikke deklareres i en birth, så
+// rapporten går på et almindeligt topic uden for Sparkplug (og uden seq).
+#ifdef HEAP_TRACE
+#ifndef HEAP_TRACE_PERIOD_MS
+#define HEAP_TRACE_PERIOD_MS 60000
+#endif
+#define HEAP_TRACE_TOP 5
+
+String TOP_HEAP = String("optilogic/") + DEVICE + "/heap";
+const char* TRACED_TASKS[] = {"loopTask", "async_tcp", "tiT"}; // Arduino loop, webserver, lwIP
+uint32_t lastHeapReportMs = 0;
+
+void publishHeapReport() {
+  heaptrace::HeapStats h = heaptrace::heapStats();
+  heaptrace::Totals tot = heaptrace::totals();
+  heaptrace::SiteStats sites[HEAP_TRACE_TOP];
+  size_t n = heaptrace::snapshot(sites, HEAP_TRACE_TOP);
+
+  static char stackNames[3][24];
+  static char siteNames[HEAP_TRACE_TOP][24];
+  MetricValue metrics[7 + 3 + HEAP_TRACE_TOP];
+  size_t m = 0;
+  metrics[m++] = MetricValue::ofInt("heap_free", h.freeBytes);
+  metrics[m++] = MetricValue::ofInt("heap_largest", h.largestFree); // fragmentering: largest << free
+  metrics[m++] = MetricValue::ofInt("heap_min_free", h.minFree);
+  metrics[m++] = MetricValue::ofInt("heap_live", tot.liveBytes);
+  metrics[m++] = MetricValue::ofInt("heap_allocs", tot.allocs); // i perioden
+  metrics[m++] = MetricValue::ofInt("heap_frees", tot.frees);
+  metrics[m++] = MetricValue::ofInt("heap_failed", tot.failed);
+  for (size_t i = 0; i < 3; i++) {
+    snprintf(stackNames[i], sizeof(stackNames[i]), "stack_%s", TRACED_TASKS[i]);
+    metrics[m++] = MetricValue::ofInt(stackNames[i], heaptrace::stackHighWater(TRACED_TASKS[i]));
+  }
+  for (size_t i = 0; i < n && sites[i].allocs; i++) {
+    if (sites[i].label) snprintf(siteNames[i], sizeof(siteNames[i]), "site_%s", sites[i].label);
+    else snprintf(siteNames[i], sizeof(siteNames[i]), "pc_%08x", (unsigned)sites[i].pc); // addr2line
+    metrics[m++] = MetricValue::ofInt(siteNames[i], int64_t(sites[i].bytes));
+    Serial.printf("HEAP site %-20s %6u allok %8u bytes\n", siteNames[i], (unsigned)sites[i].allocs,
+                  (unsigned)sites[i].bytes);
+  }
+  Serial.printf("HEAP free %u largest %u min %u live %lld allok %u\n", (unsigned)h.freeBytes,
+                (unsigned)h.largestFree, (unsigned)h.minFree, (long long)tot.liveBytes, (unsigned)tot.allocs);
+
+  Sample sample;
+  sample.metrics = metrics;
+  sample.count = m;
+  size_t len = serializer.serialize(sample, payloadBuf, sizeof(payloadBuf));
+  if (len) mqtt.publish(TOP_HEAP.c_str(), payloadBuf, len, false);
+  heaptrace::reset(); // næste rapport viser kun næste periode
+}
+#endif
+
+// ================= GATEWAY (SPARKPLUG NODE) =================
+// Kun i gateway-mode: node-certifikater. Busrapporten sendes i begge modes,
+// og births (se BIRTHS) deklarerer dens metrics.
+
+// Busrapport én gang pr. vindue (gateway: NDATA, ellers DDATA): udnyttelse,
+// ledningstid, svartid og timeouts for segmentet, og pr. slave polls,
+// bustid, overspringte polls, effektiv periode og status, samt samplingstaktens
+// tabte/overhalede ticks og største forsinkelse og reguleringens skrivninger.
+struct BusReport {   // én periodes tal; births deklarerer med et tomt
+  uint32_t util = 0;
+  BusMeter::Totals tot;
+  SampleClock::Stats clk;
+  ControlStats ctl;
+  BusScheduler<SLAVE_COUNT>::Stats st[SLAVE_COUNT];
+};
+const size_t BUS_METRICS = 15 + SLAVE_COUNT * 7;
+
+size_t busReportMetrics(const BusReport& r, MetricValue* metrics) {
+  static char names[SLAVE_COUNT][7][24];
+  uint32_t answered = r.tot.transactions - r.tot.timeouts;
+  size_t m = 0;
+  metrics[m++] = MetricValue::ofFixed("bus_util", r.util, 1); // procent
+  metrics[m++] = MetricValue::ofFixed("bus_target", BUS_TARGET_UTIL, 1);
+  metrics[m++] = MetricValue::ofFixed("bus_stretch", periodTuner.stretch(), 3); // 1.000 = POLL_INTERVAL_MS
+  metrics[m++] = MetricValue::ofInt("bus_tx", r.tot.transactions);
+  metrics[m++] = MetricValue::ofInt("bus_timeouts", r.tot.timeouts);
+  metrics[m++] = MetricValue::ofInt("bus_bytes", int64_t(r.tot.reqBytes) + r.tot.respBytes);
+  metrics[m++] = MetricValue::ofFixed("bus_wire_ms", int64_t(r.tot.wireUs / 100), 1);
+  metrics[m++] = MetricValue::ofFixed("bus_turnaround_ms", answered ? int64_t(r.tot.turnaroundUs / answered / 100) : 0, 1); // middel
+  metrics[m++] = MetricValue::ofInt("tick_skipped", r.clk.skipped);   // grænser timeren ikke nåede
+  metrics[m++] = MetricValue::ofInt("tick_overruns", r.clk.overruns); // ticks loop ikke nåede at hente
+  metrics[m++] = MetricValue::ofInt("tick_resyncs", r.clk.resyncs);   // uret stillet (SNTP)
+  metrics[m++] = MetricValue::ofInt("tick_late_us", r.clk.maxLateUs);
+  metrics[m++] = MetricValue::ofInt("ctl_writes", r.ctl.writes);       // reguleringens skrivninger
+  metrics[m++] = MetricValue::ofInt("ctl_failed", r.ctl.failed);
+  metrics[m++] = MetricValue::ofInt("ctl_latency_ms", r.ctl.maxLatencyMs); // største, sample til bekræftet skrivning
+  for (size_t i = 0; i < SLAVE_COUNT; i++) {
+    const char* id = slaves[i].member->deviceId;
+    snprintf(names[i][0], sizeof(names[i][0]), "%s_polls", id);
+    snprintf(names[i][1], sizeof(names[i][1]), "%s_bus_ms", id);
+    snprintf(names[i][2], sizeof(names[i][2]), "%s_skipped", id);
+    snprintf(names[i][3], sizeof(names[i][3]), "%s_period_ms", id);
+    snprintf(names[i][4], sizeof(names[i][4]), "%s_online", id);
+    snprintf(names[i][5], sizeof(names[i][5]), "%s_timeout_ms", id);
+    snprintf(names[i][6], sizeof(names[i][6]), "%s_breaker", id);
+    metrics[m++] = MetricValue::ofInt(names[i][0], r.st[i].polls);
+    metrics[m++] = MetricValue::ofInt(names[i][1], r.st[i].busMs);
+    metrics[m++] = MetricValue::ofInt(names[i][2], r.st[i].skipped);
+    metrics[m++] = MetricValue::ofInt(names[i][3], busScheduler.periodMs(i));
+    metrics[m++] = MetricValue::ofBool(names[i][4], slaves[i].online);
+    metrics[m++] = MetricValue::ofInt(names[i][5], slaves[i].modbus.timeoutMs()); // adaptiv, fra svartiderne
+    metrics[m++] = MetricValue::ofInt(names[i][6], slaves[i].breaker.state()); // 0 = lukket, 1 = åben, 2 = tjek
+  }
+  return m;
+}
+
+// Sender periodens rapport og justerer samtidig pollperioderne mod BUS_TARGET_UTIL
+void publishBusReport(uint32_t now) {
+  BusReport r;
+  r.util = busMeter.utilizationPermille(now);
+  if (periodTuner.update(r.util)) {
+    for (size_t i = 0; i < SLAVE_COUNT; i++) busScheduler.setPeriod(i, periodTuner.apply(POLL_INTERVAL_MS));
+    DLOG("Bus: %u.%u %% udnyttet, pollperiode nu %u ms", (unsigned)(r.util / 10), (unsigned)(r.util % 10),
+         (unsigned)periodTuner.apply(POLL_INTERVAL_MS));
+  }
+  const char* topic = nodeReportTopic();
+  if (!topic) return; // ingen birth endnu: tællerne samler videre til første rapport
+  r.tot = busMeter.takeTotals();
+  r.clk = sampleClock.takeStats();
+  r.ctl = controlStats;
+  controlStats = ControlStats();
+  for (size_t i = 0; i < SLAVE_COUNT; i++) r.st[i] = busScheduler.takeStats(i);
+
+  MetricValue metrics[BUS_METRICS];
+  Sample sample;
+  sample.metrics = metrics;
+  sample.count = busReportMetrics(r, metrics);
+  size_t len = serializeSample(sample, payloadBuf, sizeof(payloadBuf));
+  if (len) mqtt.publish(topic, payloadBuf, len, false);
+}
+
+// ================= BIRTHS =================
+// En birth deklarerer hver metric der senere kan komme på DATA med navn og
+// type. Værdier der ikke findes endnu (periodetal, aggregater, kvitteringer)
+// sendes som null. Navne der allerede er med springes over, så et map-navn
+// som "n" eller "value" ikke giver to metrics med samme navn.
+MetricValue birthMetrics[regmap::MAX_ENTRIES + AGG_METRICS + 3 * 6 + 9 + BUS_METRICS + 8]; // kun loop
+
+size_t declare(size_t n, const MetricValue& m) {
+  for (size_t i = 0; i < n; i++) {
+    if (strcmp(birthMetrics[i].name, m.name) == 0) return n;
   }
+  birthMetrics[n] = m;
+  return n + 1;
+}
+
+// Busrapportens metrics, alle null (ingen periode endnu)
+size_t declareBusReport(size_t n) {
+  BusReport empty;
+  MetricValue metrics[BUS_METRICS];
+  size_t count = busReportMetrics(empty, metrics);
+  for (size_t i = 0; i < count; i++) n = declare(n, metrics[i].asNull());
+  return n;
 }
 
-// ================= BUILD JSON PAYLOAD =================
-String makeJsonPayload(float t, float p, float rpm) { // lav json payload
-    String json = "{";
-    json += "\"temp\":" + String(t, 1) + ",";      // tilføj temperatur til json
-    json += "\"tryk\":" + String(p, 1) + ",";    // tilføj tryk til json (string(p, 1) konverterer float til string med 1 decimal)
-    json += "\"rpm\":"  + String((int)rpm);       // tilføj rpm til json
-    json += "}"; //afslut json
-    return json;   // return json string til kaldende funktion
+size_t serializeBirth(size_t count) {
+  Sample sample;
+  sample.metrics = birthMetrics;
+  sample.count = count;
+  return serializeSample(sample, payloadBuf, sizeof(payloadBuf));
+}
+
+// NBIRTH: nodens faste parametre og busrapporten; DBIRTH for hver slave følger efter dens næste poll
+bool publishNodeBirth() {
+  size_t n = 0;
+  n = declare(n, MetricValue::ofInt("bdSeq", bdSeq)); // samme som i will'en (NDEATH)
+  n = declare(n, MetricValue::ofBool("Node Control/Rebirth", false));
+  n = declare(n, MetricValue::ofInt("devices", SLAVE_COUNT));
+  n = declare(n, MetricValue::ofInt("poll_ms", POLL_INTERVAL_MS));
+  n = declare(n, MetricValue::ofInt("window_ms", AGG_WINDOW_MS));
+  n = declareBusReport(n);
+  size_t len = serializeBirth(n);
+  return len && mqtt.publish(TOP_NBIRTH.c_str(), payloadBuf, len, false);
+}
+
+// DBIRTH: slavens map med aktuelle værdier (null for blokke der fejlede),
+// aggregatet, kvitteringerne og for den primære enhed alarmerne med deres
+// tilstand. Uden gateway er DBIRTH nodens birth: bdSeq og busrapporten er med.
+size_t makeDeviceBirthPayload(const Slave& s, const regmap::CompiledMap& map, const int32_t* raw, uint32_t okMask) {
+  size_t n = 0;
+  for (size_t slot = 0; slot < map.size(); slot++) {
+    MetricValue m = MetricValue::ofFixed(map.name(slot), raw[slot], map.decimals(slot));
+    n = declare(n, okMask & (1u << slot) ? m : m.asNull());
+  }
+
+  WindowStats empty[M_COUNT];
+  MetricValue agg[AGG_METRICS];
+  aggregateMetrics(empty, agg);
+  for (size_t i = AGG_MEANS; i < AGG_METRICS; i++) n = declare(n, agg[i].asNull()); // middel står i mappet
+
+  if (&s == &slaves[0]) { // alarmer hører til den primære enhed
+    MetricValue alarm[4];
+    for (const AlarmBinding& a : alarms) {
+      alarmMetrics(*a.detector, 0, a.detector->active(), alarm);
+      n = declare(n, alarm[0]); // aktuel tilstand, også for en alarm der skiftede før birth
+    }
+    for (size_t i = 1; i < 4; i++) n = declare(n, alarm[i].asNull());
+  }
+
+  // kvitteringerne (publishAck), samme navne og typer som der
+  n = declare(n, MetricValue::ofBool("regmap_ok", false).asNull());
+  n = declare(n, MetricValue::ofBool("run_ok", false).asNull());
+  n = declare(n, MetricValue::ofInt("run_state", 0).asNull());
+  n = declare(n, MetricValue::ofBool("control_ok", false).asNull());
+  n = declare(n, MetricValue::ofInt("control_rules", s.control.size()));
+  n = declare(n, MetricValue::ofInt("ctl_rule", 0).asNull());
+  n = declare(n, MetricValue::ofInt("ctl_value", 0).asNull());
+  n = declare(n, MetricValue::ofBool("ctl_ok", false).asNull());
+  n = declare(n, MetricValue::ofInt("ctl_latency_ms", 0).asNull());
+
+  if constexpr (!DeviceTraits::isGateway) {
+    n = declare(n, MetricValue::ofInt("bdSeq", bdSeq)); // birth uden NBIRTH
+    n = declareBusReport(n);
+  }
+  return serializeBirth(n);
+}
+
+void publishDeviceBirth(Slave& s, const regmap::CompiledMap& map, const int32_t* raw, uint32_t okMask) {
+  if (DeviceTraits::isGateway && !nodeOnline) return; // DBIRTH først efter NBIRTH
+  // uden gateway er DBIRTH (med bdSeq) sessionens birth og får seq 0; intet
+  // andet sendes før den, så seq kan sættes igen hvis forsøget fejler
+  if constexpr (!DeviceTraits::isGateway) mqttSeq = 0;
+  size_t len = makeDeviceBirthPayload(s, map, raw, okMask);
+  if (!len) {
+    DLOG("MQTT: DBIRTH for %s er større end payloadBuf", s.member->deviceId);
+    return;
+  }
+  if (mqtt.publish(s.topBirth.c_str(), payloadBuf, len, false)) {
+    s.online = true;
+    DLOG("MQTT: DBIRTH sendt for %s (%u bytes)", s.member->deviceId, (unsigned)len);
+  }
+}
+
+void publishDeviceDeath(Slave& s) {
+  flushRawBatch(s); // ventende rå samples hører til før DDEATH
+  Sample sample; // ingen metrics
+  size_t len = serializeSample(sample, alarmBuf, sizeof(alarmBuf));
+  if (len) mqtt.publish(s.topDeath.c_str(), alarmBuf, len, false);
+  s.online = false;
+  DLOG("MQTT: DDEATH sendt for %s (%u fejlede polls)", s.member->deviceId, (unsigned)s.failures);
 }
 
 // ================= MQTT CONNECT =================
+// Fuld birth: NBIRTH (gateway) og DBIRTH pr. slave efter dens næste poll. seq
+// starter forfra med den birth der faktisk sendes først (NBIRTH, ellers DBIRTH).
+// Fejler NBIRTH, prøves den igen fra loop, og intet andet sendes imens.
+void publishBirths() {
+  for (Slave& s : slaves) {
+    flushRawBatch(s); // hører til den gamle session
+    s.online = false;
+  }
+  if constexpr (DeviceTraits::isGateway) {
+    mqttSeq = 0;
+    nodeOnline = publishNodeBirth();
+    if (!nodeOnline) return;
+  }
+  birthPending = false;
+  DLOG("MQTT: birth (bdSeq %u)", (unsigned)bdSeq);
+}
+
 void mqttReconnect() {   // forsøg at forbinde til MQTT broker
-  Serial.println("MQTT: Forsøger at forbinde til broker..."); // besked til terminal
+  DLOG("MQTT: Forsøger at forbinde til broker..."); // besked til terminal
+  // gateway: NDEATH som will (dækker alle devices), ellers DDEATH som før
+  const char* willTopic = DeviceTraits::isGateway ? TOP_NDEATH.c_str() : slaves[0].topDeath.c_str();
+  static char willMsg[48];
+  size_t willLen = makeDeathPayload(reinterpret_cast<uint8_t*>(willMsg), sizeof(willMsg) - 1);
+  if (!willLen || memchr(willMsg, 0, willLen)) strcpy(willMsg, DeviceTraits::isGateway ? "NDEATH" : "DDEATH");
+  else willMsg[willLen] = '\0';
   while (!mqtt.connected()) { // mens ikke forbundet
-    Serial.println("MQTT: Ikke forbundet, prøver igen..."); // besked til terminal 
-    if (mqtt.connect("olimex-client", NULL, NULL, 
-                     TOP_DDEATH.c_str(), 1, false, "DDEATH")) { //hvis forbundet send ddeath besked
-
-      mqtt.publish(TOP_DBIRTH.c_str(), "DBIRTH", false); //efer ddeath send dbirth besked
-      Serial.println("MQTT: DBIRTH sendt"); // besked til terminal
-      Serial.println("MQTT: Forbundet til broker!"); // besked til terminal
+    DLOG("MQTT: Ikke forbundet, prøver igen..."); // besked til terminal 
+    if (mqtt.connect(MQTT_CLIENT_ID, NULL, NULL,
+                     willTopic, 1, false, willMsg, false)) { // death besked som will, clean session = false
+      // abonnementer gentages: billigt, og nødvendigt hvis brokeren har glemt sessionen
+      mqtt.subscribe(TOP_NCMD.c_str(), 1); // Rebirth (og i gateway-mode kommandoer til alle slaves)
+      for (Slave& s : slaves) mqtt.subscribe(s.topCmd.c_str(), 1); // kommandoer (rå samples m.m.), QoS 1 så de venter hos brokeren
+      if (birthPending) publishBirths();
+      else DLOG("MQTT: session genoptaget, seq %u", (unsigned)mqttSeq);
+      DLOG("MQTT: Forbundet til broker!"); // besked til terminal
     }
     delay(1000); // vent 1 sekund før næste forsøg
   }
@@ -99,17 +1270,20 @@ void mqttReconnect() {   // forsøg at forbinde til MQTT broker
 
 // ================= SETUP =================
 void setup() {  // opsætning
-  pinMode(MAX485_RE_NEG, OUTPUT); //opsæt RE pin
-  pinMode(MAX485_DE, OUTPUT); //opsæt DE pin
-  digitalWrite(MAX485_RE_NEG, LOW); // sæt RE til modtagelse
-  digitalWrite(MAX485_DE, LOW); // sæt DE til modtagelse
+  pinMode(BUS.reNegPin, OUTPUT); //opsæt RE pin
+  pinMode(BUS.dePin, OUTPUT); //opsæt DE pin
+  digitalWrite(BUS.reNegPin, LOW); // sæt RE til modtagelse
+  digitalWrite(BUS.dePin, LOW); // sæt DE til modtagelse
+  if constexpr (DeviceTraits::hasStatusLed) pinMode(Device::statusLedPin, OUTPUT); // kun i profiler med LED
 
   Serial.begin(115200); // start serial monitor
-  Serial2.begin(BAUD_RATE, SERIAL_8N1, RX_PIN, TX_PIN); // start serial2 til modbus kommunikation
+  Serial2.begin(BUS.baud, SERIAL_8N1, BUS.rxPin, BUS.txPin); // start serial2 til modbus kommunikation
+
+  beginSlaves(); // én RtuMaster pr. slave på serial2, med pre/postTransmission callbacks
 
-  modbus.begin(MODBUS_SLAVE_ID, Serial2); // start modbus med slave id og serial2
-  modbus.preTransmission(preTransmission); // sæt preTransmission callback
-  modbus.postTransmission(postTransmission); // sæt postTransmission callback
+  loadStoredRegisterMaps(); // register-maps fra NVS (eller standard) før første poll
+  loadStoredControlRules(); // lokale regler fra NVS (eller -DCONTROL_RULES)
+  beginHistory(); // genopbyg tidsindeks fra flash
 
   // Start ventilation kort efter Modbus init
   fanStart(); //tidligere defineret start fan
@@ -124,32 +1298,168 @@ void setup() {  // opsætning
   Serial.println(); // ny linje i terminal
   Serial.print("WiFi forbundet. IP: "); // print besked i terminal
   Serial.println(WiFi.localIP()); // print lokal ip adresse i terminal
+  configTime(0, 0, NTP_SERVER); // UTC; historikken logger først når uret er sat
+  if (sampleClock.start(TIME_VALID_AFTER)) busScheduler.setPaced(true); // polls på wall-clock grænser, ellers millis()-takt
+  beginHttp(); // live data og register-map over HTTP
+  dlog::begin(); // herefter skrives log-linjer af en lavprioritets-task, ikke i poll-løkken
 
+  beginMqttSession(); // ny bdSeq for denne opstart
   mqtt.setServer(MQTT_HOST, MQTT_PORT); // sæt mqtt broker server og port 
+  mqtt.setBufferSize(sizeof(payloadBuf) + 128); // standard er 256 bytes, for lidt til aggregat og register-map
+  mqtt.setCallback(onMqttMessage); // kommandoer på DCMD (og NCMD i gateway-mode)
+}
+
+// ================= POLL =================
+void slaveFailed(Slave& s) {
+  if (s.failures < 255) s.failures++;
+  if constexpr (DeviceTraits::isGateway) {
+    if (s.online && s.failures >= GATEWAY_DEATH_AFTER) publishDeviceDeath(s);
+  }
+}
+
+// Billigt helbredstjek for en parkeret slave: ét register fra første læseblok.
+// Ethvert svar (også en exception) betyder at slaven er tilbage. Tjekket
+// venter den fulde MODBUS_TIMEOUT_MAX_MS: en slave der lige er startet op
+// svarer ofte langsommere end de svartider timeouten har lært.
+void probeSlave(size_t i, uint32_t now) {
+  Slave& s = slaves[i];
+  s.modbus.resetTimeout(); // svartiderne læres forfra når slaven er tilbage
+  const regmap::ReadOp& op = s.registerMap.active().read(0);
+  uint32_t start = millis();
+  uint8_t res = op.table == regmap::HOLDING_REG ? s.bus.readHoldingRegisters(op.start, 1)
+                                                : s.bus.readInputRegisters(op.start, 1);
+  uint32_t end = millis();
+  busScheduler.done(i, end, end - start);
+  if (res == RtuMaster::ku8MBResponseTimedOut) {
+    s.breaker.onTimeout(end);
+    slaveFailed(s);
+    DLOG("Modbus: %s svarer stadig ikke, næste tjek om %u ms", s.member->deviceId,
+         (unsigned)s.breaker.backoffMs());
+    return;
+  }
+  s.breaker.onResponse(); // næste tur er et normalt poll
+  DLOG("Modbus: %s svarer igen", s.member->deviceId);
+}
+
+// Én Modbus-cyklus for slave i: læseplan, alarmer, aggregat, live-data og rå samples
+void pollSlave(size_t i, uint32_t now) {
+  Slave& s = slaves[i];
+  if (s.registerMap.beginCycle()) bindSlots(s); // nyt map skiftes kun ind her, mellem to polls
+  const regmap::CompiledMap& map = s.registerMap.active();
+
+  CircuitBreaker::Action action = s.breaker.check(now);
+  if (action == CircuitBreaker::Skip) { // parkeret: bussen bruges ikke
+    busScheduler.skip(i, now);
+    return;
+  }
+  if (action == CircuitBreaker::Probe) {
+    probeSlave(i, now);
+    return;
+  }
+
+  int32_t raw[regmap::MAX_ENTRIES]; // rå fast-komma værdi pr. slot
+  uint32_t okMask;
+  {
+    HEAP_TRACE_SCOPE("modbus_poll");
+    uint32_t start = millis();
+    okMask = map.poll(s.bus, raw); // læseplanen: få sammenlagte requests (bogført i busMeter)
+    uint32_t end = millis();
+    busScheduler.done(i, end, end - start); // også fejlede polls tæller som bustid
+    if (s.modbus.lastResult() == RtuMaster::ku8MBResponseTimedOut) {
+      s.breaker.onTimeout(end);
+      if (s.breaker.state() == CircuitBreaker::Open) {
+        DLOG("Modbus: %s svarer ikke, parkeres i %u ms", s.member->deviceId, (unsigned)s.breaker.backoffMs());
+      }
+    } else {
+      s.breaker.onResponse();
+    }
+  }
+  uint32_t needed = (1u << s.slotTemp) | (1u << s.slotTryk) | (1u << s.slotRpm);
+  if ((okMask & needed) != needed) { // læsning fejlede, prøv igen ved næste poll
+    slaveFailed(s);
+    return;
+  }
+  s.failures = 0;
+  if (!s.online) publishDeviceBirth(s, map, raw, okMask); // første svar efter birth, Rebirth eller DDEATH
+  runControl(i, map, raw, okMask, millis()); // reglerne først; skrivningerne udføres lige efter pollet
+
+  // mappets decimaler kan afvige fra pipelinens faste skala
+  TempValue t  = TempValue::fromScaled(raw[s.slotTemp], map.decimals(s.slotTemp));
+  TrykValue p  = TrykValue::fromScaled(raw[s.slotTryk], map.decimals(s.slotTryk));
+  RpmValue  af = RpmValue::fromScaled(raw[s.slotRpm], map.decimals(s.slotRpm));
+  int32_t values[M_COUNT] = {t.raw, p.raw, af.raw};
+
+  if (i == 0) { // den primære enhed
+    // alarm-statistikken er den eneste del der har brug for float
+    float alarmValues[M_COUNT] = {t.toFloat(), p.toFloat(), af.toFloat()};
+    checkAlarms(alarmValues, now); // alarmer sendes straks, før normal telemetri
+  }
+
+  s.aggregator.add(now, values); // O(1) pr. sample, kun heltal
+
+  if (i == 0) {
+    liveRing.push(now, values); // til /api/samples og /api/stream (blokerer aldrig)
+    int64_t wallMs = busScheduler.paced() ? sampleTick.wallMs : wallClockMs(); // grænsen, så enhederne har samme tidsstempler
+    if (wallMs) historyLog.append(wallMs, values); // lokal historik, uafhængig af MQTT
+    if (historyTask && historyLog.spareNeeded()) xTaskNotifyGive(historyTask); // slet næste side nu, lige efter pollet
+  }
+
+  if (s.rawActive) { // rå samples kun efter anmodning
+    if ((int32_t)(now - s.rawUntilMs) >= 0) {
+      s.rawActive = false;
+      flushRawBatch(s);
+      DLOG("Rå samples for %s fra (tid udløbet)", s.member->deviceId);
+    } else {
+      HEAP_TRACE_SCOPE("raw_publish");
+      publishRawSample(s, map, raw, okMask, busScheduler.paced() ? sampleTick.wallMs : wallClockMs());
+    }
+  }
 }
 
 // ================= LOOP =================
 void loop() {
   if (!mqtt.connected()) mqttReconnect(); // hvis ikke forbundet til mqtt broker, forsøg at forbinde
-  mqtt.loop();
+  {
+    HEAP_TRACE_SCOPE("mqtt_loop"); // callback + kommandoer
+    mqtt.loop();
+  }
+  if (birthPending && mqtt.connected()) publishBirths(); // NCMD Rebirth
 
-  uint16_t regs[11] = {0}; // array til modbus registre
-  if (!readRegistersBlock(regs)) { // læs registre, hvis fejler:
-    delay(2000); // vent 2 sekunder
-    return; // afslut loop og prøv igen
+  uint32_t now = millis();
+
+#ifdef HEAP_TRACE
+  if ((uint32_t)(now - lastHeapReportMs) >= HEAP_TRACE_PERIOD_MS) {
+    lastHeapReportMs = now;
+    publishHeapReport();
   }
+#endif
 
-  float t  = getTemperature(regs); // få temperatur fra arrays, funktioner defineret på  linje 58 til 60
-  float p  = getPressure(regs); // få tryk fra arrays
-  float af = getAirFlow(regs); // få airflow fra arrays
+  for (Slave& s : slaves) {
+    if (!s.aggregator.due(now)) continue; // vinduet er slut: send aggregat (også selvom Modbus fejler)
+    if (!s.online) continue; // ingen DDATA før DBIRTH: vinduet samler videre og sendes efter birth
+    HEAP_TRACE_SCOPE("aggregat");
+    WindowStats window[M_COUNT];
+    s.aggregator.close(now, window);
+    size_t len = makeAggregatePayload(window);
+    DLOG("Sender aggregat for %s (%s, %u bytes, %u samples)", s.member->deviceId,
+         serializer.name(), (unsigned)len, (unsigned)window[M_TEMP].count);
+    if (len) mqtt.publish(s.topData.c_str(), payloadBuf, len, false);
+  }
 
-  String payload = makeJsonPayload(t, p, af); // lav json payload
-  Serial.print("Sender payload: "); // besked til terminal
-  Serial.println(payload); // vis payload i terminal
-  mqtt.publish(TOP_DDATA.c_str(), payload.c_str(), false); // send data-payload til mqtt broker 
-  Serial.println("Payload sendt til MQTT broker."); // besked til terminal
+  if ((uint32_t)(now - lastBusReportMs) >= AGG_WINDOW_MS) { // busudnyttelse og justering af pollperioder
+    lastBusReportMs = now;
+    publishBusReport(now);
+  }
 
+  SampleTick tick;
+  if (sampleClock.take(tick)) { // ny wall-clock grænse: frigiv de slaves der skal polles på den
+    sampleTick = tick;
+    busScheduler.releaseTick(tick.index, POLL_INTERVAL_MS);
+  }
 
-  delay(2000);
+  drainCommands(); // "run=" fra MQTT-callbacken
+  int next = busScheduler.next(now); // forfalden slave med mindst brugt bustid
+  if (next < 0) return; // ikke tid til næste poll endnu
+  pollSlave(size_t(next), now);
+  drainCommands(); // reguleringens skrivninger, før næste poll
 }
-